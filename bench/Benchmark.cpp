@@ -0,0 +1,363 @@
+#include "Benchmark.h"
+#include "CameraInteractor.h"
+#include "ObjLoader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <random>
+
+using namespace minity;
+using namespace glm;
+
+std::vector<double> Benchmark::measure(std::size_t repetitions, const std::function<void()>& function)
+{
+	std::vector<double> times;
+
+	for (std::size_t i = 0; i < repetitions; i++)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		function();
+		times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	return times;
+}
+
+double Benchmark::median(std::vector<double> values)
+{
+	if (values.empty())
+		return 0.0;
+
+	const std::size_t middle = values.size() / 2;
+	std::nth_element(values.begin(), values.begin() + middle, values.end());
+	return values[middle];
+}
+
+bool Benchmark::loadMesh(const std::string& filename, BenchmarkMesh& mesh)
+{
+	ObjLoader loader;
+
+	if (!loader.loadObjFile(filename))
+		return false;
+
+	loader.generateNormals();
+
+	mesh = BenchmarkMesh();
+	mesh.name = filename;
+	mesh.minimumBounds = loader.minimumBounds();
+	mesh.maximumBounds = loader.maximumBounds();
+
+	std::vector<Meshlet> meshlets;
+
+	for (std::size_t i = 0; i < loader.groupCount(); i++)
+	{
+		Group group;
+
+		if (loader.assembleGroup(i, mesh.vertices, mesh.indices, meshlets, group))
+			mesh.groups.push_back(group);
+	}
+
+	return true;
+}
+
+BenchmarkMesh Benchmark::torusMesh(std::size_t triangleCount)
+{
+	const uint rings = std::max(uint(4), uint(std::sqrt(double(triangleCount) / 2.0)));
+	const uint segments = std::max(uint(4), uint(triangleCount / (2 * std::size_t(rings))));
+	const float tau = 6.2831853f;
+
+	BenchmarkMesh mesh;
+	mesh.name = "torus " + std::to_string(2 * std::size_t(rings) * segments);
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> jitter(-0.1f, 0.1f);
+
+	for (uint r = 0; r < rings; r++)
+	{
+		for (uint s = 0; s < segments; s++)
+		{
+			const float u = tau * (float(r) + jitter(random)) / float(rings);
+			const float v = tau * (float(s) + jitter(random)) / float(segments);
+
+			Vertex vertex;
+			vertex.normal = vec3(std::cos(u) * std::cos(v), std::sin(u) * std::cos(v), std::sin(v));
+			vertex.position = vec3(2.0f * std::cos(u), 2.0f * std::sin(u), 0.0f) + 0.75f * vertex.normal;
+			vertex.texcoord = vec2(float(r) / float(rings), float(s) / float(segments));
+			mesh.vertices.push_back(vertex);
+		}
+	}
+
+	for (uint r = 0; r < rings; r++)
+	{
+		for (uint s = 0; s < segments; s++)
+		{
+			const uint a = r * segments + s;
+			const uint b = ((r + 1) % rings) * segments + s;
+			const uint c = ((r + 1) % rings) * segments + (s + 1) % segments;
+			const uint d = r * segments + (s + 1) % segments;
+
+			mesh.indices.insert(mesh.indices.end(), { a, b, c, a, c, d });
+		}
+	}
+
+	Group group;
+	group.name = "torus";
+	group.endIndex = uint(mesh.indices.size());
+	mesh.minimumBounds = group.minimumBounds = vec3(-2.75f, -2.75f, -0.75f);
+	mesh.maximumBounds = group.maximumBounds = vec3(2.75f, 2.75f, 0.75f);
+	mesh.groups.push_back(group);
+
+	return mesh;
+}
+
+std::string SyntheticObj::description() const
+{
+	static const char* formats[] = { "v", "v/t", "v//n", "v/t/n" };
+
+	std::string text = std::to_string(triangleCount) + " triangles, " + formats[int(format)] + ", ";
+	text += polygonSize == 3 ? std::string("triangles") : polygonSize == 4 ? std::string("quads") : std::to_string(polygonSize) + "-gons";
+	text += ", " + std::to_string(groupCount) + " groups, " + std::to_string(materialCount) + " materials";
+
+	if (negativeIndices)
+		text += ", negative indices";
+
+	return text;
+}
+
+bool Benchmark::writeObjFile(const std::string& filename, const SyntheticObj& obj)
+{
+	const uint polygonSize = std::max(uint(3), obj.polygonSize);
+	// the height field shares the corners of its cells, larger polygons have corners of their own
+	const bool field = polygonSize <= 4;
+	const std::size_t trianglesPerCell = field ? 2 : polygonSize - 2;
+	const std::size_t cellCount = std::max(std::size_t(1), (obj.triangleCount + trianglesPerCell - 1) / trianglesPerCell);
+	const std::size_t columns = std::size_t(std::ceil(std::sqrt(double(cellCount))));
+	const std::size_t rows = (cellCount + columns - 1) / columns;
+	const std::size_t vertexCount = field ? (columns + 1) * (rows + 1) : cellCount * polygonSize;
+	const uint groupCount = uint(std::min<std::size_t>(std::max(uint(1), obj.groupCount), rows));
+	const uint materialCount = std::max(uint(1), obj.materialCount);
+	const float tau = 6.2831853f;
+
+	const bool texcoords = obj.format == ObjFaceFormat::PositionTexcoord || obj.format == ObjFaceFormat::PositionTexcoordNormal;
+	const bool normals = obj.format == ObjFaceFormat::PositionNormal || obj.format == ObjFaceFormat::PositionTexcoordNormal;
+
+	std::filesystem::path materialPath(filename);
+	materialPath.replace_extension("mtl");
+
+	std::unique_ptr<std::FILE, int (*)(std::FILE*)> materialFile(std::fopen(materialPath.string().c_str(), "w"), &std::fclose);
+
+	if (!materialFile)
+		return false;
+
+	for (uint i = 0; i < materialCount; i++)
+	{
+		const float hue = tau * float(i) / float(materialCount);
+		std::fprintf(materialFile.get(), "newmtl material%u\nKa 0.2 0.2 0.2\nKd %.3f %.3f %.3f\nKs 0.5 0.5 0.5\nNs 32\nillum 2\n\n", i,
+			0.5f + 0.4f * std::cos(hue), 0.5f + 0.4f * std::cos(hue + tau / 3.0f), 0.5f + 0.4f * std::cos(hue + 2.0f * tau / 3.0f));
+	}
+
+	// outlives the file, which flushes into it when it is closed
+	std::vector<char> buffer(1 << 20);
+	std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::fopen(filename.c_str(), "w"), &std::fclose);
+
+	if (!file)
+		return false;
+
+	std::setvbuf(file.get(), buffer.data(), _IOFBF, buffer.size());
+
+	std::fprintf(file.get(), "# synthetic model: %s\nmtllib %s\n", obj.description().c_str(), materialPath.filename().string().c_str());
+
+	// a unit square in x and z with a few waves in y, so that the normals vary
+	auto writeVertex = [&](vec2 point)
+	{
+		const float frequency = 4.0f * tau;
+		const float height = 0.02f * std::sin(frequency * point.x) * std::cos(frequency * point.y);
+		const vec3 normal = normalize(vec3(-0.02f * frequency * std::cos(frequency * point.x) * std::cos(frequency * point.y), 1.0f, 0.02f * frequency * std::sin(frequency * point.x) * std::sin(frequency * point.y)));
+
+		std::fprintf(file.get(), "v %.6f %.6f %.6f\n", point.x, height, point.y);
+
+		if (texcoords)
+			std::fprintf(file.get(), "vt %.6f %.6f\n", point.x, point.y);
+
+		if (normals)
+			std::fprintf(file.get(), "vn %.6f %.6f %.6f\n", normal.x, normal.y, normal.z);
+	};
+
+	const vec2 cellSize = vec2(1.0f / float(columns), 1.0f / float(rows));
+
+	if (field)
+	{
+		for (std::size_t r = 0; r <= rows; r++)
+		{
+			for (std::size_t c = 0; c <= columns; c++)
+				writeVertex(vec2(float(c), float(r)) * cellSize);
+		}
+	}
+	else
+	{
+		for (std::size_t i = 0; i < cellCount; i++)
+		{
+			const vec2 center = (vec2(float(i % columns), float(i / columns)) + 0.5f) * cellSize;
+
+			for (uint j = 0; j < polygonSize; j++)
+			{
+				// clockwise in x and z, so that the polygons face upwards like the height field
+				const float angle = -tau * float(j) / float(polygonSize);
+				writeVertex(center + 0.45f * cellSize * vec2(std::cos(angle), std::sin(angle)));
+			}
+		}
+	}
+
+	// all vertices are written before the faces, so every negative index is relative to the same count
+	auto writeCorner = [&](std::size_t vertex)
+	{
+		const long long index = obj.negativeIndices ? (long long)vertex - (long long)vertexCount : (long long)vertex + 1;
+
+		switch (obj.format)
+		{
+		case ObjFaceFormat::Position:
+			std::fprintf(file.get(), " %lld", index);
+			break;
+		case ObjFaceFormat::PositionTexcoord:
+			std::fprintf(file.get(), " %lld/%lld", index, index);
+			break;
+		case ObjFaceFormat::PositionNormal:
+			std::fprintf(file.get(), " %lld//%lld", index, index);
+			break;
+		case ObjFaceFormat::PositionTexcoordNormal:
+			std::fprintf(file.get(), " %lld/%lld/%lld", index, index, index);
+			break;
+		}
+	};
+
+	uint group = groupCount;
+	uint material = materialCount;
+
+	for (std::size_t r = 0; r < rows; r++)
+	{
+		const uint rowGroup = uint(r * groupCount / rows);
+		const uint rowMaterial = uint(r * materialCount / rows);
+
+		if (rowGroup != group)
+			std::fprintf(file.get(), "g group%u\n", rowGroup);
+
+		if (rowGroup != group || rowMaterial != material)
+			std::fprintf(file.get(), "usemtl material%u\n", rowMaterial);
+
+		group = rowGroup;
+		material = rowMaterial;
+
+		for (std::size_t c = 0; c < columns && r * columns + c < cellCount; c++)
+		{
+			if (polygonSize == 3)
+			{
+				const std::size_t a = r * (columns + 1) + c;
+				const std::size_t b = a + columns + 1;
+
+				std::fputc('f', file.get());
+				writeCorner(a);
+				writeCorner(b);
+				writeCorner(b + 1);
+				std::fputs("\nf", file.get());
+				writeCorner(a);
+				writeCorner(b + 1);
+				writeCorner(a + 1);
+				std::fputc('\n', file.get());
+			}
+			else if (field)
+			{
+				const std::size_t a = r * (columns + 1) + c;
+				const std::size_t b = a + columns + 1;
+
+				std::fputc('f', file.get());
+				writeCorner(a);
+				writeCorner(b);
+				writeCorner(b + 1);
+				writeCorner(a + 1);
+				std::fputc('\n', file.get());
+			}
+			else
+			{
+				const std::size_t first = (r * columns + c) * polygonSize;
+
+				std::fputc('f', file.get());
+
+				for (uint j = 0; j < polygonSize; j++)
+					writeCorner(first + j);
+
+				std::fputc('\n', file.get());
+			}
+		}
+	}
+
+	return std::fflush(file.get()) == 0 && !std::ferror(file.get());
+}
+
+std::vector<Ray> Benchmark::randomRays(const BenchmarkMesh& mesh, std::size_t count)
+{
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+
+	const vec3 center = 0.5f * (mesh.minimumBounds + mesh.maximumBounds);
+	const vec3 extent = 0.5f * (mesh.maximumBounds - mesh.minimumBounds);
+	const float radius = 2.0f * length(extent);
+
+	std::vector<Ray> rays(count);
+
+	for (auto& ray : rays)
+	{
+		vec3 direction;
+
+		do
+		{
+			direction = vec3(uniform(random), uniform(random), uniform(random));
+		} while (dot(direction, direction) < 1e-4f || dot(direction, direction) > 1.0f);
+
+		ray.origin = center + radius * normalize(direction);
+		ray.direction = normalize(center + extent * vec3(uniform(random), uniform(random), uniform(random)) - ray.origin);
+	}
+
+	return rays;
+}
+
+std::vector<Ray> Benchmark::primaryRays(const BenchmarkMesh& mesh, ivec2 size)
+{
+	// the camera the viewer starts with
+	const mat4 modelTransform = CameraInteractor::initialModelTransform(mesh.minimumBounds, mesh.maximumBounds);
+	const mat4 projectionTransform = CameraInteractor::initialProjectionTransform(float(size.x) / float(size.y));
+	const mat4 inverseModelViewProjection = inverse(projectionTransform * CameraInteractor::initialViewTransform() * modelTransform);
+
+	std::vector<Ray> rays;
+	rays.reserve(std::size_t(size.x) * std::size_t(size.y));
+
+	for (int packetY = 0; packetY < size.y; packetY += 2)
+	{
+		for (int packetX = 0; packetX < size.x; packetX += 4)
+		{
+			for (int y = packetY; y < std::min(packetY + 2, size.y); y++)
+			{
+				for (int x = packetX; x < std::min(packetX + 4, size.x); x++)
+				{
+					const vec2 position = 2.0f * vec2((float(x) + 0.5f) / float(size.x), (float(y) + 0.5f) / float(size.y)) - 1.0f;
+					vec4 near = inverseModelViewProjection * vec4(position, -1.0f, 1.0f);
+					vec4 far = inverseModelViewProjection * vec4(position, 1.0f, 1.0f);
+					near /= near.w;
+					far /= far.w;
+
+					Ray ray;
+					ray.origin = vec3(near);
+					ray.direction = vec3(far - near);
+					ray.maximumDistance = length(ray.direction);
+					ray.direction /= ray.maximumDistance;
+					rays.push_back(ray);
+				}
+			}
+		}
+	}
+
+	return rays;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Bvh.h"
+#include "Model.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace minity
+{
+	// triangles of a model at full resolution as the benchmarks use them, without any GL resources
+	struct BenchmarkMesh
+	{
+		std::string name;
+		std::vector<Vertex> vertices;
+		std::vector<glm::uint> indices;
+		std::vector<Group> groups;
+		glm::vec3 minimumBounds = glm::vec3(0.0f);
+		glm::vec3 maximumBounds = glm::vec3(0.0f);
+	};
+
+	// attributes referenced by the faces of a synthetic OBJ file, i.e. v, v/t, v//n and v/t/n
+	enum class ObjFaceFormat { Position, PositionTexcoord, PositionNormal, PositionTexcoordNormal };
+
+	// Layout of a synthetic OBJ file: a wavy height field of triangles or quads sharing their vertices, or of
+	// separate regular polygons with polygonSize corners. Groups and materials are bands of rows of the field.
+	struct SyntheticObj
+	{
+		std::size_t triangleCount = 100000;
+		ObjFaceFormat format = ObjFaceFormat::PositionTexcoordNormal;
+		glm::uint polygonSize = 3;
+		glm::uint groupCount = 16;
+		glm::uint materialCount = 4;
+		bool negativeIndices = false;
+
+		std::string description() const;
+	};
+
+	class Benchmark
+	{
+	public:
+		// wall clock time in seconds of every one of the given number of calls
+		static std::vector<double> measure(std::size_t repetitions, const std::function<void()>& function);
+		static double median(std::vector<double> values);
+
+		// loads an OBJ file the way Model does, but skips the model cache, returns false if it cannot be read
+		static bool loadMesh(const std::string& filename, BenchmarkMesh& mesh);
+		// torus with about the given number of triangles, slightly perturbed so that no two are coplanar
+		static BenchmarkMesh torusMesh(std::size_t triangleCount);
+		// writes the OBJ file and a material library next to it, returns false if they cannot be written
+		static bool writeObjFile(const std::string& filename, const SyntheticObj& obj);
+
+		// rays from a sphere around the mesh towards random points within its bounds
+		static std::vector<Ray> randomRays(const BenchmarkMesh& mesh, std::size_t count);
+		// Rays through the pixel centers of an image of the mesh from the initial view of the viewer, in the
+		// packets of 4x2 pixels the ray tracer uses.
+		static std::vector<Ray> primaryRays(const BenchmarkMesh& mesh, glm::ivec2 size);
+	};
+
+	// Build time, size and query throughput of Bvh on each mesh, single and multi-threaded.
+	int runBvhBenchmark(const std::vector<BenchmarkMesh>& meshes);
+	// Throughput of the traversal kernels of WideBvh against Bvh, for coherent and incoherent rays.
+	int runRayBenchmark(const std::vector<BenchmarkMesh>& meshes);
+	// Time and throughput of the stages of loading synthetic OBJ files of the given triangle counts, from
+	// parsing to the model cache, and for a range of face formats, polygon sizes, groups and materials at
+	// the variation triangle count.
+	int runLoaderBenchmark(const std::vector<std::size_t>& triangleCounts, std::size_t variationTriangleCount);
+}
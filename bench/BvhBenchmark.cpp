@@ -0,0 +1,167 @@
+#include "Benchmark.h"
+#include "Bvh.h"
+#include "FrustumCuller.h"
+#include "Parallel.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <random>
+
+using namespace minity;
+using namespace glm;
+
+namespace
+{
+	const std::size_t buildRepetitions = 5;
+	const std::size_t queryRepetitions = 3;
+	const std::size_t rayCount = 1000000;
+	const std::size_t rayBlockSize = 4096;
+	const std::size_t boxCount = 10000;
+	const std::size_t frustumCount = 1000;
+
+	// expected cost of a random ray according to the surface area heuristic, in triangle intersections
+	double heuristicCost(const Bvh& bvh)
+	{
+		auto area = [](const BvhNode& node)
+		{
+			const vec3 extent = node.maximumBounds - node.minimumBounds;
+			return double(extent.x) * extent.y + double(extent.y) * extent.z + double(extent.z) * extent.x;
+		};
+
+		const double rootArea = area(bvh.nodes().front());
+		double cost = 0.0;
+
+		for (const auto& node : bvh.nodes())
+			cost += area(node) / rootArea * (node.isLeaf() ? double(node.triangleCount) : 1.0);
+
+		return cost;
+	}
+
+	// millions of rays per second, and the number of rays that hit something
+	template <typename Trace>
+	double traceRays(const std::vector<Ray>& rays, unsigned int threadCount, std::size_t& hitCount, const Trace& trace)
+	{
+		std::atomic<std::size_t> hits(0);
+
+		const auto times = Benchmark::measure(queryRepetitions, [&]()
+		{
+			hits = 0;
+
+			parallelFor((rays.size() + rayBlockSize - 1) / rayBlockSize, [&](std::size_t block)
+			{
+				const std::size_t end = std::min(rays.size(), (block + 1) * rayBlockSize);
+				std::size_t blockHits = 0;
+
+				for (std::size_t i = block * rayBlockSize; i < end; i++)
+					blockHits += trace(rays[i]) ? 1 : 0;
+
+				hits += blockHits;
+			}, threadCount);
+		});
+
+		hitCount = hits;
+		return double(rays.size()) / Benchmark::median(times) * 1e-6;
+	}
+}
+
+int minity::runBvhBenchmark(const std::vector<BenchmarkMesh>& meshes)
+{
+	const unsigned int threadCount = hardwareThreadCount();
+
+	for (const auto& mesh : meshes)
+	{
+		const std::vector<uint> triangles = Bvh::groupTriangles(mesh.groups);
+		Bvh bvh;
+
+		const double buildTime = Benchmark::median(Benchmark::measure(buildRepetitions, [&]()
+		{
+			bvh.build(mesh.vertices, mesh.indices, triangles);
+		}));
+
+		std::printf("%s\n", mesh.name.c_str());
+		std::printf("  build:         %.1f ms, %.2f Mtriangles/s on %u threads\n", buildTime * 1e3, double(triangles.size()) / buildTime * 1e-6, threadCount);
+
+		if (bvh.empty())
+			continue;
+
+		std::printf("  hierarchy:     %zu triangles, %zu nodes, depth %zu, SAH cost %.1f\n", bvh.triangleCount(), bvh.nodes().size(), bvh.depth(), heuristicCost(bvh));
+
+		const std::vector<Ray> rays = Benchmark::randomRays(mesh, rayCount);
+		std::size_t hits = 0;
+
+		auto closestHit = [&](const Ray& ray)
+		{
+			RayHit hit;
+			return bvh.intersect(ray, hit);
+		};
+
+		auto anyHit = [&](const Ray& ray)
+		{
+			return bvh.occluded(ray);
+		};
+
+		const double closestSingle = traceRays(rays, 1, hits, closestHit);
+		const double closestParallel = traceRays(rays, threadCount, hits, closestHit);
+		std::printf("  closest hit:   %.2f Mrays/s, %.2f Mrays/s on %u threads, %.1f%% hits\n", closestSingle, closestParallel, threadCount, 100.0 * double(hits) / double(rays.size()));
+
+		const double anySingle = traceRays(rays, 1, hits, anyHit);
+		const double anyParallel = traceRays(rays, threadCount, hits, anyHit);
+		std::printf("  any hit:       %.2f Mrays/s, %.2f Mrays/s on %u threads\n", anySingle, anyParallel, threadCount);
+
+		// boxes of a hundredth of the extent of the mesh at random positions
+		std::mt19937 random(11);
+		std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+		const vec3 extent = mesh.maximumBounds - mesh.minimumBounds;
+		std::vector<vec3> boxes;
+
+		for (std::size_t i = 0; i < boxCount; i++)
+			boxes.push_back(mesh.minimumBounds + extent * vec3(uniform(random), uniform(random), uniform(random)));
+
+		std::vector<uint> found;
+		std::size_t foundCount = 0;
+
+		const double boxTime = Benchmark::median(Benchmark::measure(queryRepetitions, [&]()
+		{
+			foundCount = 0;
+
+			for (const auto& box : boxes)
+			{
+				found.clear();
+				bvh.query(box, box + 0.01f * extent, found);
+				foundCount += found.size();
+			}
+		}));
+
+		std::printf("  box query:     %.1f us per query, %.1f triangles on average\n", boxTime / double(boxCount) * 1e6, double(foundCount) / double(boxCount));
+
+		// narrow frusta from around the mesh towards its center
+		const vec3 center = 0.5f * (mesh.minimumBounds + mesh.maximumBounds);
+		const float radius = length(extent);
+		std::vector<std::array<vec4, 6>> frusta;
+
+		for (const auto& ray : Benchmark::randomRays(mesh, frustumCount))
+		{
+			const mat4 view = lookAt(center - ray.direction * radius, center, std::abs(ray.direction.y) < 0.9f ? vec3(0.0f, 1.0f, 0.0f) : vec3(1.0f, 0.0f, 0.0f));
+			frusta.push_back(FrustumCuller::frustumPlanes(perspective(radians(20.0f), 1.0f, 0.01f * radius, 4.0f * radius) * view));
+		}
+
+		const double frustumTime = Benchmark::median(Benchmark::measure(queryRepetitions, [&]()
+		{
+			foundCount = 0;
+
+			for (const auto& planes : frusta)
+			{
+				found.clear();
+				bvh.query(planes, found);
+				foundCount += found.size();
+			}
+		}));
+
+		std::printf("  frustum query: %.1f us per query, %.1f%% of the triangles on average\n", frustumTime / double(frustumCount) * 1e6, 100.0 * double(foundCount) / double(frustumCount * bvh.triangleCount()));
+	}
+
+	return 0;
+}
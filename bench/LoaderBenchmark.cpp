@@ -0,0 +1,259 @@
+#include "Benchmark.h"
+#include "ModelCache.h"
+#include "ObjLoader.h"
+#include "VertexCompressor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <system_error>
+
+using namespace minity;
+using namespace glm;
+
+namespace
+{
+	// the default of Model
+	const std::size_t chunkTriangleBudget = 64 * 1024;
+	// larger files are loaded only once
+	const std::size_t repeatedTriangleCount = 2000000;
+	const std::size_t repetitions = 3;
+
+	struct StageTimes
+	{
+		// in seconds
+		double parse = 0.0;
+		double normals = 0.0;
+		double assembly = 0.0;
+		double postProcessing = 0.0;
+		double cacheWrite = 0.0;
+		double cacheRead = 0.0;
+	};
+
+	double secondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// The CPU side of what Model does with the assembled groups before they are drawn: the loader thread
+	// hands a copy of them to update(), which encodes vertices and indices for the buffers. The compact
+	// format is encoded, as it is the more expensive one.
+	void postProcess(const ModelData& data)
+	{
+		ModelData published;
+		published.vertices = data.vertices;
+		published.indices = data.indices;
+		published.meshlets = data.meshlets;
+		published.groups = data.groups;
+		published.groupVectors = data.groupVectors;
+
+		const PositionQuantization quantization = VertexCompressor::quantization(data.minimumBounds, data.maximumBounds);
+		std::vector<CompactVertex> compactVertices(published.vertices.size());
+		VertexCompressor::encode(published.vertices.data(), published.vertices.size(), quantization, compactVertices.data());
+
+		std::vector<unsigned char> indexData;
+		std::vector<IndexRange> ranges;
+
+		for (const auto& g : published.groups)
+		{
+			for (const auto& c : g.chunks)
+				VertexCompressor::encodeIndices(published.indices.data() + c.startIndex, c.endIndex - c.startIndex, true, indexData, ranges);
+
+			for (const auto& l : g.levels)
+				VertexCompressor::encodeIndices(published.indices.data() + l.startIndex, l.endIndex - l.startIndex, true, indexData, ranges);
+		}
+	}
+
+	// runs the stages of Model::runLoader() without the model and the textures, and then the model cache
+	bool loadStages(const std::string& filename, StageTimes& times, std::size_t& triangleCount, std::size_t& cacheSize)
+	{
+		ObjLoader loader;
+		loader.setChunkTriangleBudget(chunkTriangleBudget);
+
+		auto start = std::chrono::steady_clock::now();
+
+		if (!loader.loadObjFile(filename))
+			return false;
+
+		times.parse = secondsSince(start);
+		triangleCount = loader.indexCount() / 3;
+
+		ModelData data;
+
+		start = std::chrono::steady_clock::now();
+		loader.generateNormals(data.normalWeighting, data.creaseAngle);
+		times.normals = secondsSince(start);
+
+		data.materials = loader.materials();
+		data.minimumBounds = loader.minimumBounds();
+		data.maximumBounds = loader.maximumBounds();
+		data.modelCenter = 0.5f * (data.minimumBounds + data.maximumBounds);
+		data.chunkTriangleBudget = chunkTriangleBudget;
+
+		start = std::chrono::steady_clock::now();
+
+		for (std::size_t i = 0; i < loader.groupCount(); i++)
+		{
+			Group group;
+
+			if (!loader.assembleGroup(i, data.vertices, data.indices, data.meshlets, group))
+				continue;
+
+			data.groupVectors.push_back(normalize(0.5f * (group.minimumBounds + group.maximumBounds) - data.modelCenter));
+			data.groups.push_back(std::move(group));
+		}
+
+		times.assembly = secondsSince(start);
+
+		start = std::chrono::steady_clock::now();
+		postProcess(data);
+		times.postProcessing = secondsSince(start);
+
+		start = std::chrono::steady_clock::now();
+
+		if (!ModelCache::write(filename, data, loader.dependencies()))
+			return false;
+
+		times.cacheWrite = secondsSince(start);
+
+		ModelData cachedData;
+		start = std::chrono::steady_clock::now();
+
+		if (!ModelCache::read(filename, cachedData))
+			return false;
+
+		times.cacheRead = secondsSince(start);
+
+		std::error_code error;
+		cacheSize = std::size_t(std::filesystem::file_size(ModelCache::cacheFilename(filename), error));
+		std::filesystem::remove(ModelCache::cacheFilename(filename), error);
+
+		return true;
+	}
+
+	bool runCase(const SyntheticObj& obj, const std::filesystem::path& directory)
+	{
+		const std::string filename = (directory / "minity-bench-loader.obj").string();
+		std::printf("%s\n", obj.description().c_str());
+
+		if (!Benchmark::writeObjFile(filename, obj))
+		{
+			std::fprintf(stderr, "could not write %s\n", filename.c_str());
+			return false;
+		}
+
+		std::error_code error;
+		const double fileSize = double(std::filesystem::file_size(filename, error));
+
+		std::vector<StageTimes> times(obj.triangleCount > repeatedTriangleCount ? 1 : repetitions);
+		std::size_t triangleCount = 0;
+		std::size_t cacheSize = 0;
+		bool succeeded = true;
+
+		for (auto& t : times)
+			succeeded = succeeded && loadStages(filename, t, triangleCount, cacheSize);
+
+		std::filesystem::remove(filename, error);
+		std::filesystem::remove(std::filesystem::path(filename).replace_extension("mtl"), error);
+
+		if (!succeeded)
+		{
+			std::fprintf(stderr, "could not load %s\n", filename.c_str());
+			return false;
+		}
+
+		auto median = [&](double StageTimes::*stage)
+		{
+			std::vector<double> values;
+
+			for (const auto& t : times)
+				values.push_back(t.*stage);
+
+			return std::max(Benchmark::median(values), 1e-9);
+		};
+
+		const double parse = median(&StageTimes::parse);
+		const double normals = median(&StageTimes::normals);
+		const double assembly = median(&StageTimes::assembly);
+		const double postProcessing = median(&StageTimes::postProcessing);
+		const double cacheWrite = median(&StageTimes::cacheWrite);
+		const double cacheRead = median(&StageTimes::cacheRead);
+		const double triangles = double(triangleCount);
+
+		std::printf("  parse:         %8.1f ms, %7.1f MB/s, %6.2f Mtriangles/s\n", parse * 1e3, fileSize / parse * 1e-6, triangles / parse * 1e-6);
+		if (obj.format == ObjFaceFormat::Position || obj.format == ObjFaceFormat::PositionTexcoord)
+			std::printf("  normals:       %8.1f ms, %6.2f Mtriangles/s\n", normals * 1e3, triangles / normals * 1e-6);
+		else
+			std::printf("  normals:       none generated, the file has normals\n");
+
+		std::printf("  assembly:      %8.1f ms, %6.2f Mtriangles/s\n", assembly * 1e3, triangles / assembly * 1e-6);
+		std::printf("  post-processing: %6.1f ms, %6.2f Mtriangles/s\n", postProcessing * 1e3, triangles / postProcessing * 1e-6);
+		std::printf("  cache write:   %8.1f ms, %7.1f MB/s, %6.2f Mtriangles/s\n", cacheWrite * 1e3, double(cacheSize) / cacheWrite * 1e-6, triangles / cacheWrite * 1e-6);
+		std::printf("  cache read:    %8.1f ms, %7.1f MB/s, %6.2f Mtriangles/s\n", cacheRead * 1e3, double(cacheSize) / cacheRead * 1e-6, triangles / cacheRead * 1e-6);
+		std::printf("  total:         %8.1f ms for %.1f MB of OBJ, %zu triangles\n", (parse + normals + assembly + postProcessing) * 1e3, fileSize * 1e-6, triangleCount);
+
+		return true;
+	}
+}
+
+int minity::runLoaderBenchmark(const std::vector<std::size_t>& triangleCounts, std::size_t variationTriangleCount)
+{
+	std::error_code error;
+	const std::filesystem::path directory = std::filesystem::temp_directory_path(error);
+
+	if (error)
+	{
+		std::fprintf(stderr, "no directory for temporary files\n");
+		return 1;
+	}
+
+	std::vector<SyntheticObj> cases;
+
+	for (std::size_t triangleCount : triangleCounts)
+	{
+		SyntheticObj obj;
+		obj.triangleCount = triangleCount;
+		cases.push_back(obj);
+	}
+
+	// the variations of the file layout
+	SyntheticObj base;
+	base.triangleCount = variationTriangleCount;
+
+	for (ObjFaceFormat format : { ObjFaceFormat::Position, ObjFaceFormat::PositionTexcoord, ObjFaceFormat::PositionNormal })
+	{
+		SyntheticObj obj = base;
+		obj.format = format;
+		cases.push_back(obj);
+	}
+
+	for (uint polygonSize : { 4u, 8u })
+	{
+		SyntheticObj obj = base;
+		obj.polygonSize = polygonSize;
+		cases.push_back(obj);
+	}
+
+	SyntheticObj singleGroup = base;
+	singleGroup.groupCount = 1;
+	singleGroup.materialCount = 1;
+	cases.push_back(singleGroup);
+
+	SyntheticObj manyGroups = base;
+	manyGroups.groupCount = 1024;
+	manyGroups.materialCount = 256;
+	cases.push_back(manyGroups);
+
+	SyntheticObj negativeIndices = base;
+	negativeIndices.negativeIndices = true;
+	cases.push_back(negativeIndices);
+
+	for (const auto& obj : cases)
+	{
+		if (!runCase(obj, directory))
+			return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,134 @@
+#include "Benchmark.h"
+#include "Bvh.h"
+#include "Parallel.h"
+#include "WideBvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace minity;
+using namespace glm;
+
+namespace
+{
+	const std::size_t repetitions = 3;
+	const ivec2 imageSize = ivec2(1024, 768);
+	const std::size_t randomRayCount = 500000;
+	const std::size_t rayBlockSize = 4096;
+
+	// millions of rays per second for tracing the rays in blocks on the given number of threads
+	template <typename Trace>
+	double traceRays(std::size_t rayCount, unsigned int threadCount, const Trace& trace)
+	{
+		const auto times = Benchmark::measure(repetitions, [&]()
+		{
+			parallelFor((rayCount + rayBlockSize - 1) / rayBlockSize, [&](std::size_t block)
+			{
+				trace(block * rayBlockSize, std::min(rayCount, (block + 1) * rayBlockSize));
+			}, threadCount);
+		});
+
+		return double(rayCount) / Benchmark::median(times) * 1e-6;
+	}
+
+	// rays whose closest hit is not the one of Bvh, apart from equally close ones on shared edges
+	std::size_t differences(const std::vector<RayHit>& hits, const std::vector<RayHit>& expected)
+	{
+		std::size_t count = 0;
+
+		for (std::size_t i = 0; i < hits.size(); i++)
+		{
+			if (hits[i].valid() != expected[i].valid())
+				count++;
+			else if (hits[i].valid() && hits[i].triangle != expected[i].triangle && std::abs(hits[i].distance - expected[i].distance) > 1e-5f * expected[i].distance)
+				count++;
+		}
+
+		return count;
+	}
+}
+
+int minity::runRayBenchmark(const std::vector<BenchmarkMesh>& meshes)
+{
+	const unsigned int threadCount = hardwareThreadCount();
+	const TraversalKernel kernels[] = { TraversalKernel::Scalar, TraversalKernel::Sse, TraversalKernel::Avx2 };
+
+	std::printf("fastest supported kernel: %s\n", WideBvh::kernelName(WideBvh::fastestKernel()));
+
+	for (const auto& mesh : meshes)
+	{
+		Bvh bvh;
+		bvh.build(mesh.vertices, mesh.indices, Bvh::groupTriangles(mesh.groups));
+
+		std::printf("%s\n", mesh.name.c_str());
+
+		if (bvh.empty())
+			continue;
+
+		// primary rays through a view of the whole mesh, and incoherent ones
+		const std::vector<Ray> primaryRays = Benchmark::primaryRays(mesh, imageSize);
+		const std::vector<Ray> randomRays = Benchmark::randomRays(mesh, randomRayCount);
+		std::vector<RayHit> primaryHits(primaryRays.size()), expectedPrimaryHits(primaryRays.size());
+		std::vector<RayHit> randomHits(randomRays.size()), expectedRandomHits(randomRays.size());
+
+		const double binaryPrimary = traceRays(primaryRays.size(), 1, [&](std::size_t begin, std::size_t end)
+		{
+			for (std::size_t i = begin; i < end; i++)
+				bvh.intersect(primaryRays[i], expectedPrimaryHits[i]);
+		});
+
+		const double binaryRandom = traceRays(randomRays.size(), 1, [&](std::size_t begin, std::size_t end)
+		{
+			for (std::size_t i = begin; i < end; i++)
+				bvh.intersect(randomRays[i], expectedRandomHits[i]);
+		});
+
+		std::printf("  %-12s %zu nodes\n", "binary", bvh.nodes().size());
+		std::printf("    single rays:  %.2f Mrays/s primary, %.2f Mrays/s incoherent\n", binaryPrimary, binaryRandom);
+
+		for (TraversalKernel kernel : kernels)
+		{
+			if (!WideBvh::kernelSupported(kernel))
+			{
+				std::printf("  %-12s not supported by this processor or build\n", WideBvh::kernelName(kernel));
+				continue;
+			}
+
+			WideBvh wideBvh;
+			wideBvh.build(bvh, kernel);
+
+			const double singlePrimary = traceRays(primaryRays.size(), 1, [&](std::size_t begin, std::size_t end)
+			{
+				for (std::size_t i = begin; i < end; i++)
+					wideBvh.intersect(primaryRays[i], primaryHits[i]);
+			});
+
+			const std::size_t singleDifferences = differences(primaryHits, expectedPrimaryHits);
+
+			const double singleRandom = traceRays(randomRays.size(), 1, [&](std::size_t begin, std::size_t end)
+			{
+				for (std::size_t i = begin; i < end; i++)
+					wideBvh.intersect(randomRays[i], randomHits[i]);
+			});
+
+			const std::size_t randomDifferences = differences(randomHits, expectedRandomHits);
+
+			auto tracePackets = [&](std::size_t begin, std::size_t end)
+			{
+				for (std::size_t i = begin; i < end; i += WideBvh::packetSize)
+					wideBvh.intersect(&primaryRays[i], std::min(WideBvh::packetSize, end - i), &primaryHits[i]);
+			};
+
+			const double packetPrimary = traceRays(primaryRays.size(), 1, tracePackets);
+			const std::size_t packetDifferences = differences(primaryHits, expectedPrimaryHits);
+			const double packetParallel = traceRays(primaryRays.size(), threadCount, tracePackets);
+
+			std::printf("  %-12s %zu nodes, %zu rays differ from binary\n", WideBvh::kernelName(kernel), wideBvh.nodeCount(), singleDifferences + randomDifferences + packetDifferences);
+			std::printf("    single rays:  %.2f Mrays/s primary, %.2f Mrays/s incoherent\n", singlePrimary, singleRandom);
+			std::printf("    packets:      %.2f Mrays/s primary, %.2f Mrays/s on %u threads\n", packetPrimary, packetParallel, threadCount);
+		}
+	}
+
+	return 0;
+}
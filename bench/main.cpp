@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Benchmark.h"
+
+using namespace minity;
+
+namespace
+{
+	void printUsage()
+	{
+		std::printf(
+			"usage: minity-bench <suite> [model.obj ...]\n"
+			"       minity-bench loader [--large] [triangles ...]\n"
+			"\n"
+			"suites:\n"
+			"  bvh     bounding volume hierarchy build time and query throughput\n"
+			"  rays    ray throughput of the SIMD traversal kernels\n"
+			"  loader  throughput of the stages of loading synthetic OBJ files\n"
+			"\n"
+			"Without models, synthetic meshes of 100k and 1M triangles are used. The loader suite\n"
+			"writes its own files of 10k, 100k and 1M triangles, or of the given triangle counts,\n"
+			"and varies their layout at the largest of these. --large adds files of 10M and 50M\n"
+			"triangles, which take several GB of disk space and memory.\n");
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2 || std::strcmp(argv[1], "--help") == 0)
+	{
+		printUsage();
+		return argc < 2 ? 1 : 0;
+	}
+
+	const std::string suite = argv[1];
+
+	if (suite == "loader")
+	{
+		std::vector<std::size_t> triangleCounts;
+		bool large = false;
+
+		for (int i = 2; i < argc; i++)
+		{
+			if (std::strcmp(argv[i], "--large") == 0)
+			{
+				large = true;
+				continue;
+			}
+
+			char* end = nullptr;
+			const unsigned long long triangleCount = std::strtoull(argv[i], &end, 10);
+
+			if (*end != '\0' || triangleCount == 0)
+			{
+				std::fprintf(stderr, "invalid triangle count %s\n", argv[i]);
+				return 1;
+			}
+
+			triangleCounts.push_back(std::size_t(triangleCount));
+		}
+
+		if (triangleCounts.empty())
+			triangleCounts = { 10000, 100000, 1000000 };
+
+		// the layout variations would take too long at the large sizes
+		const std::size_t variationTriangleCount = *std::max_element(triangleCounts.begin(), triangleCounts.end());
+
+		if (large)
+			triangleCounts.insert(triangleCounts.end(), { 10000000, 50000000 });
+
+		return runLoaderBenchmark(triangleCounts, variationTriangleCount);
+	}
+
+	std::vector<BenchmarkMesh> meshes;
+
+	for (int i = 2; i < argc; i++)
+	{
+		BenchmarkMesh mesh;
+
+		if (!Benchmark::loadMesh(argv[i], mesh))
+		{
+			std::fprintf(stderr, "could not load %s\n", argv[i]);
+			return 1;
+		}
+
+		meshes.push_back(std::move(mesh));
+	}
+
+	if (meshes.empty())
+	{
+		meshes.push_back(Benchmark::torusMesh(100000));
+		meshes.push_back(Benchmark::torusMesh(1000000));
+	}
+
+	if (suite == "bvh")
+		return runBvhBenchmark(meshes);
+
+	if (suite == "rays")
+		return runRayBenchmark(meshes);
+
+	std::fprintf(stderr, "unknown suite %s\n", suite.c_str());
+	printUsage();
+	return 1;
+}
@@ -43,6 +43,14 @@ uniform int bumpMenu;
 uniform float bumpAmplitude;
 uniform float bumpWavenumber;
 
+// Screen-door transparency for cross-fading between levels of detail: fragments are only kept if their dither
+// threshold lies within the range, so two levels drawn with complementary ranges cover every pixel once.
+uniform vec2 fadeRange = vec2(0.0, 1.0);
+
+// the group picked with the mouse is blended with the highlight color by its alpha
+uniform bool highlighted = false;
+uniform vec4 highlightColor = vec4(1.0, 0.6, 0.1, 0.5);
+
 
 in fragmentData
 {
@@ -73,8 +81,20 @@ float customBump2(float u, float v)
     return sineComponent + tangentComponent;
 }
 
+// ordered 4x4 Bayer dither threshold in (0,1)
+float ditherThreshold(ivec2 pixel)
+{
+	const float bayer[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+	return (bayer[(pixel.y & 3) * 4 + (pixel.x & 3)] + 0.5) / 16.0;
+}
+
 void main()
 {
+	float threshold = ditherThreshold(ivec2(gl_FragCoord.xy));
+
+	if (threshold < fadeRange.x || threshold >= fadeRange.y)
+		discard;
+
 	vec4 result = vec4(0.5,0.5,0.5,1.0);
 
 	//Normal Mapping code
@@ -88,8 +108,10 @@ void main()
 	}
 	if (normalMenu == 2)
 	{
-		// Sample the tangent space normal map
-		vec3 tangentSpaceNormal = 2.0 * texture(tangentNormals, fragment.texCoord).rgb - 1.0;
+		// Sample the tangent space normal map, it is stored with two channels (BC5) and z is reconstructed
+		vec3 tangentSpaceNormal;
+		tangentSpaceNormal.xy = 2.0 * texture(tangentNormals, fragment.texCoord).rg - 1.0;
+		tangentSpaceNormal.z = sqrt(max(0.0, 1.0 - dot(tangentSpaceNormal.xy, tangentSpaceNormal.xy)));
 
 		// Transform the tangent space normal to world space
 		normal = normalize(tangentSpaceNormal.x * fragment.tangent + tangentSpaceNormal.y * fragment.bitangent + tangentSpaceNormal.z * fragment.normal);
@@ -240,5 +262,8 @@ void main()
 		result = toonResult;
 	}
 
+	if (highlighted)
+		result.rgb = mix(result.rgb, highlightColor.rgb, highlightColor.a);
+
 	fragColor = result;
 }
\ No newline at end of file
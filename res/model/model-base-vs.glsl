@@ -4,6 +4,14 @@
 
 uniform mat4 modelViewProjectionMatrix;
 
+// compact vertices store positions quantized to the model bounds and octahedral-encoded normals
+uniform bool compactVertices = false;
+uniform vec3 positionOffset = vec3(0.0);
+uniform vec3 positionScale = vec3(1.0);
+
+// displacement of the group being drawn, e.g. when the model is exploded
+uniform vec3 groupOffset = vec3(0.0);
+
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texCoord;
@@ -15,12 +23,32 @@ out vertexData
 	vec2 texCoord;
 } vertex;
 
+vec3 decodeOctahedral(vec2 encoded)
+{
+	vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -fold : fold;
+	n.y += n.y >= 0.0 ? -fold : fold;
+	return normalize(n);
+}
+
 void main()
 {
-	vec4 pos = modelViewProjectionMatrix*vec4(position,1.0);
+	vec3 objectPosition = position;
+	vec3 objectNormal = normal;
+
+	if (compactVertices)
+	{
+		objectPosition = positionOffset + positionScale * position;
+		objectNormal = decodeOctahedral(normal.xy);
+	}
+
+	objectPosition += groupOffset;
+
+	vec4 pos = modelViewProjectionMatrix*vec4(objectPosition,1.0);
 
-	vertex.position = position; 
-	vertex.normal = normal;
+	vertex.position = objectPosition; 
+	vertex.normal = objectNormal;
 	vertex.texCoord = texCoord;	
 	
 	gl_Position = pos;
@@ -1,5 +1,6 @@
 #version 400
 #extension GL_ARB_shading_language_include : require
+#extension GL_ARB_shader_storage_buffer_object : enable
 #include "/raytrace-globals.glsl"
 
 uniform mat4 modelViewProjectionMatrix;
@@ -24,6 +25,200 @@ uniform vec3 cylinderAxis; // This should be normalized
 uniform float cylinderHeight;
 uniform float cylinderRadius;
 
+uniform bool primitivesEnabled = true;
+
+// Triangles of the model with a hierarchy over them, see GpuBvh.h. Without shader storage buffers, only the
+// primitives are traced.
+#ifdef GL_ARB_shader_storage_buffer_object
+uniform bool modelEnabled = false;
+uniform bool shadowsEnabled = false;
+
+// lighting as in model-base-fs.glsl, with the light in the object space of the model
+uniform vec3 lightPosition;
+uniform vec3 lightIntensity;
+uniform vec3 ambientLightIntensity;
+uniform float shininessMultiplier;
+uniform bool ambientEnabled;
+uniform bool diffuseEnabled;
+uniform bool specularEnabled;
+
+// Nodes in depth-first order: the first child of an inner node follows it, a node that is missed or a leaf
+// continues at its miss index. Leaves hold the first triangle << 4 | the triangle count.
+struct BvhNode
+{
+	vec3 minimumBounds;
+	uint missIndex;
+	vec3 maximumBounds;
+	uint triangles;
+};
+
+// the w component of the vertex holds the bits of the material index
+struct BvhTriangle
+{
+	vec4 vertex;
+	vec4 edge1;
+	vec4 edge2;
+};
+
+// the w component of the specular color is the shininess
+struct BvhMaterial
+{
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+};
+
+layout(std430) buffer BvhNodes
+{
+	BvhNode bvhNodes[];
+};
+
+layout(std430) buffer BvhTriangles
+{
+	BvhTriangle bvhTriangles[];
+};
+
+// three vertex normals per triangle
+layout(std430) buffer BvhNormals
+{
+	vec4 bvhNormals[];
+};
+
+layout(std430) buffer BvhMaterials
+{
+	BvhMaterial bvhMaterials[];
+};
+
+// Moeller and Trumbore for both sides of the triangle, as in Bvh.cpp
+bool intersectTriangle(vec3 rayOrigin, vec3 rayDirection, BvhTriangle triangle, float maximumDistance, out float t, out vec2 barycentrics)
+{
+	vec3 p = cross(rayDirection, triangle.edge2.xyz);
+	float determinant = dot(triangle.edge1.xyz, p);
+
+	if (determinant == 0.0)
+		return false;
+
+	float inverseDeterminant = 1.0 / determinant;
+	vec3 s = rayOrigin - triangle.vertex.xyz;
+	float u = dot(s, p) * inverseDeterminant;
+
+	if (u < 0.0 || u > 1.0)
+		return false;
+
+	vec3 q = cross(s, triangle.edge1.xyz);
+	float v = dot(rayDirection, q) * inverseDeterminant;
+
+	if (v < 0.0 || u + v > 1.0)
+		return false;
+
+	t = dot(triangle.edge2.xyz, q) * inverseDeterminant;
+	barycentrics = vec2(u, v);
+
+	return t >= 0.0 && t <= maximumDistance;
+}
+
+// Finds the closest triangle hit within the distance, or any hit if anyHit is set. The traversal needs no
+// stack, but visits the children of a node in a fixed order.
+bool intersectModel(vec3 rayOrigin, vec3 rayDirection, float maximumDistance, bool anyHit, out float t, out uint triangle, out vec2 barycentrics)
+{
+	// keeps the slab distances finite for axis-parallel rays
+	vec3 inverseDirection = 1.0 / (rayDirection + vec3(equal(rayDirection, vec3(0.0))) * 1e-20);
+	uint nodeCount = uint(bvhNodes.length());
+	uint index = 0u;
+	bool found = false;
+
+	t = maximumDistance;
+	triangle = 0u;
+	barycentrics = vec2(0.0);
+
+	while (index < nodeCount)
+	{
+		BvhNode node = bvhNodes[index];
+		vec3 t0 = (node.minimumBounds - rayOrigin) * inverseDirection;
+		vec3 t1 = (node.maximumBounds - rayOrigin) * inverseDirection;
+		vec3 entries = min(t0, t1);
+		vec3 exits = max(t0, t1);
+		float entry = max(max(entries.x, entries.y), max(entries.z, 0.0));
+		float exit = min(min(exits.x, exits.y), min(exits.z, t));
+
+		if (entry > exit)
+		{
+			index = node.missIndex;
+			continue;
+		}
+
+		if (node.triangles == 0u)
+		{
+			index++;
+			continue;
+		}
+
+		uint first = node.triangles >> 4;
+		uint last = first + (node.triangles & 15u);
+
+		for (uint i = first; i < last; i++)
+		{
+			float distance;
+			vec2 weights;
+
+			if (intersectTriangle(rayOrigin, rayDirection, bvhTriangles[i], t, distance, weights))
+			{
+				t = distance;
+				triangle = i;
+				barycentrics = weights;
+				found = true;
+
+				if (anyHit)
+					return true;
+			}
+		}
+
+		index = node.missIndex;
+	}
+
+	return found;
+}
+
+vec3 modelColor(vec3 rayOrigin, vec3 rayDirection, float t, uint triangle, vec2 barycentrics)
+{
+	vec3 normal = (1.0 - barycentrics.x - barycentrics.y) * bvhNormals[3u * triangle].xyz + barycentrics.x * bvhNormals[3u * triangle + 1u].xyz + barycentrics.y * bvhNormals[3u * triangle + 2u].xyz;
+
+	if (dot(normal, normal) == 0.0)
+		normal = cross(bvhTriangles[triangle].edge1.xyz, bvhTriangles[triangle].edge2.xyz);
+
+	normal = normalize(normal);
+
+	BvhMaterial material = bvhMaterials[floatBitsToUint(bvhTriangles[triangle].vertex.w)];
+	vec3 position = rayOrigin + t * rayDirection;
+	vec3 lightDirection = normalize(lightPosition - position);
+	vec3 halfwayDirection = normalize(lightDirection - rayDirection);
+
+	vec3 color = vec3(0.0);
+
+	if (ambientEnabled)
+		color += ambientLightIntensity * material.ambient.rgb;
+
+	if (shadowsEnabled)
+	{
+		float shadowT;
+		uint shadowTriangle;
+		vec2 shadowBarycentrics;
+		vec3 toLight = lightPosition - position;
+
+		if (intersectModel(position + 1e-4 * toLight, toLight, 1.0 - 2e-4, true, shadowT, shadowTriangle, shadowBarycentrics))
+			return color;
+	}
+
+	if (diffuseEnabled)
+		color += max(dot(normal, lightDirection), 0.0) * lightIntensity * material.diffuse.rgb;
+
+	if (specularEnabled && material.specular.w > 0.0)
+		color += pow(max(dot(normal, halfwayDirection), 0.0), material.specular.w) * lightIntensity * material.specular.rgb * shininessMultiplier;
+
+	return color;
+}
+#endif
+
 float calcDepth(vec3 pos)
 {
 	float far = gl_DepthRange.far; 
@@ -170,52 +365,73 @@ void main()
 	vec3 rayOrigin = near.xyz;
 	vec3 rayDirection = normalize((far-near).xyz);
 
-    float tSphere, tBoxMin, tBoxMax, tPlane;
-    bool hitSphere = intersectSphere(rayOrigin, rayDirection, sphereCenter, sphereRadius, tSphere);
-    bool hitBox = intersectBox(rayOrigin, rayDirection, boxCenter - boxDimensions * 0.5, boxCenter + boxDimensions * 0.5, tBoxMin, tBoxMax);
-    bool hitPlane = intersectPlane(rayOrigin, rayDirection, planeCenter, planeNormal, tPlane);
-    float tCylinder;
-    bool hitCylinder = intersectCylinder(rayOrigin, rayDirection, cylinderBaseCenter, cylinderAxis, cylinderHeight, cylinderRadius, tCylinder);
-
     float INFINITY = 1000;
 
     float closestT = INFINITY;
     vec3 color = vec3(0.0); // Background color
 
-    // Check if the sphere was hit and is the closest
-    if (hitSphere) {
-        closestT = tSphere;
-        vec3 hitPoint = rayOrigin + tSphere * rayDirection;
-        color = sphereColor(hitPoint);
+    if (primitivesEnabled) {
+        float tSphere, tBoxMin, tBoxMax, tPlane;
+        bool hitSphere = intersectSphere(rayOrigin, rayDirection, sphereCenter, sphereRadius, tSphere);
+        bool hitBox = intersectBox(rayOrigin, rayDirection, boxCenter - boxDimensions * 0.5, boxCenter + boxDimensions * 0.5, tBoxMin, tBoxMax);
+        bool hitPlane = intersectPlane(rayOrigin, rayDirection, planeCenter, planeNormal, tPlane);
+        float tCylinder;
+        bool hitCylinder = intersectCylinder(rayOrigin, rayDirection, cylinderBaseCenter, cylinderAxis, cylinderHeight, cylinderRadius, tCylinder);
+
+        // Check if the sphere was hit and is the closest
+        if (hitSphere) {
+            closestT = tSphere;
+            vec3 hitPoint = rayOrigin + tSphere * rayDirection;
+            color = sphereColor(hitPoint);
+        }
+
+        // Check if the box was hit and is closer than the current closest
+        if (hitBox && tBoxMin < closestT) {
+            closestT = tBoxMin;
+            vec3 hitPoint = rayOrigin + tBoxMin * rayDirection;
+            vec3 boxMin = boxCenter - boxDimensions * 0.5;
+            vec3 boxMax = boxCenter + boxDimensions * 0.5;
+            color = cubeColor(hitPoint, boxMin, boxMax);
+        }
+
+        // Check if the plane was hit and is closer than the current closest
+        if (hitPlane && tPlane < closestT) {
+            closestT = tPlane;
+            vec3 hitPoint = rayOrigin + tPlane * rayDirection;
+            color = planeColor(hitPoint);
+        }
+
+        if (hitCylinder && tCylinder < closestT) {
+            closestT = tCylinder;
+            // Calculate cylinder color or shading here
+            // Placeholder color for the cylinder
+            color = vec3(0.5, 0.3, 0.2); 
+        }
     }
 
-    // Check if the box was hit and is closer than the current closest
-    if (hitBox && tBoxMin < closestT) {
-        closestT = tBoxMin;
-        vec3 hitPoint = rayOrigin + tBoxMin * rayDirection;
-        vec3 boxMin = boxCenter - boxDimensions * 0.5;
-        vec3 boxMax = boxCenter + boxDimensions * 0.5;
-        color = cubeColor(hitPoint, boxMin, boxMax);
-    }
+    bool hit = closestT < INFINITY;
 
-    // Check if the plane was hit and is closer than the current closest
-    if (hitPlane && tPlane < closestT) {
-        closestT = tPlane;
-        vec3 hitPoint = rayOrigin + tPlane * rayDirection;
-        color = planeColor(hitPoint);
-    }
+#ifdef GL_ARB_shader_storage_buffer_object
+    // the model is hit up to the far plane, which may be farther away than the primitives are traced
+    float tModel;
+    uint modelTriangle;
+    vec2 modelBarycentrics;
 
-    if (hitCylinder && tCylinder < closestT) {
-        closestT = tCylinder;
-        // Calculate cylinder color or shading here
-        // Placeholder color for the cylinder
-        color = vec3(0.5, 0.3, 0.2); 
+    if (modelEnabled && intersectModel(rayOrigin, rayDirection, hit ? closestT : length((far - near).xyz), false, tModel, modelTriangle, modelBarycentrics)) {
+        closestT = tModel;
+        color = modelColor(rayOrigin, rayDirection, tModel, modelTriangle, modelBarycentrics);
+        hit = true;
     }
+#endif
+
+    // without the primitives, only the model is composited with the rasterized scene
+    if (!hit && !primitivesEnabled)
+        discard;
 
     // Set the fragment color and depth
     fragColor = vec4(color, 1.0);
 
-    if (closestT < INFINITY) {
+    if (hit) {
         gl_FragDepth = calcDepth(rayOrigin + closestT * rayDirection);
     } else {
         // No intersection, set depth to the farthest point
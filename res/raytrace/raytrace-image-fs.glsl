@@ -0,0 +1,22 @@
+#version 400
+#extension GL_ARB_shading_language_include : require
+#include "/raytrace-globals.glsl"
+
+// image of the model traced on the CPU, with the window space depth of every pixel (1 where nothing was hit)
+uniform sampler2D colorTexture;
+uniform sampler2D depthTexture;
+
+in vec2 fragPosition;
+out vec4 fragColor;
+
+void main()
+{
+	vec2 texCoord = 0.5 * fragPosition + 0.5;
+	float depth = texture(depthTexture, texCoord).r;
+
+	if (depth >= 1.0)
+		discard;
+
+	fragColor = texture(colorTexture, texCoord);
+	gl_FragDepth = depth;
+}
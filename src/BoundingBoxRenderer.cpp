@@ -73,6 +73,11 @@ BoundingBoxRenderer::BoundingBoxRenderer(Viewer* viewer) : Renderer(viewer)
 	});
 }
 
+const char* BoundingBoxRenderer::name() const
+{
+	return "Bounding Box";
+}
+
 void BoundingBoxRenderer::display()
 {
 	auto currentState = State::currentState();
@@ -25,6 +25,7 @@ namespace minity
 	public:
 		BoundingBoxRenderer(Viewer *viewer);
 		virtual void display();
+		virtual const char* name() const;
 
 	private:
 		
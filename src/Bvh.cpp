@@ -0,0 +1,726 @@
+#include "Bvh.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+using namespace minity;
+using namespace glm;
+
+namespace
+{
+	// number of intervals per axis whose boundaries are the split candidates
+	const int binCount = 16;
+	// nodes with more triangles are always split, others only if the heuristic estimates a gain
+	const uint maximumLeafSize = 8;
+	// cost of visiting an inner node relative to intersecting a triangle
+	const float traversalCost = 1.0f;
+	// Beyond this depth, nodes are split in the middle of their longest centroid axis instead, which bounds
+	// the depth of the hierarchy by this plus 32 and keeps the traversal stacks below from overflowing.
+	const std::size_t maximumHeuristicDepth = 32;
+	const std::size_t stackSize = 64;
+	// ranges of triangles that are binned in parallel
+	const std::size_t blockSize = 16 * 1024;
+
+	static_assert(sizeof(BvhNode) == 32, "nodes are expected to take 32 bytes");
+
+	struct Bounds
+	{
+		vec3 minimum = vec3(std::numeric_limits<float>::max());
+		vec3 maximum = vec3(-std::numeric_limits<float>::max());
+
+		void extend(vec3 point)
+		{
+			minimum = min(minimum, point);
+			maximum = max(maximum, point);
+		}
+
+		void extend(const Bounds& bounds)
+		{
+			minimum = min(minimum, bounds.minimum);
+			maximum = max(maximum, bounds.maximum);
+		}
+
+		// half the surface area, which is all the heuristic needs
+		float halfArea() const
+		{
+			if (minimum.x > maximum.x)
+				return 0.0f;
+
+			const vec3 extent = maximum - minimum;
+			return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+		}
+	};
+
+	struct Bin
+	{
+		Bounds bounds;
+		uint count = 0;
+	};
+
+	using Bins = std::array<std::array<Bin, binCount>, 3>;
+
+	// bounds and centroids of the input triangles, indexed by their position in the list passed to build()
+	struct BuildInput
+	{
+		std::vector<Bounds> bounds;
+		std::vector<vec3> centroids;
+	};
+
+	// node of the hierarchy whose triangles are references[begin, end)
+	struct BuildTask
+	{
+		uint node = 0;
+		uint begin = 0;
+		uint end = 0;
+		std::size_t depth = 1;
+	};
+
+	// maps centroids to bins, the last bin is closed
+	struct Binning
+	{
+		vec3 minimum = vec3(0.0f);
+		vec3 scale = vec3(0.0f);
+
+		Binning(const Bounds& centroidBounds) : minimum(centroidBounds.minimum)
+		{
+			const vec3 extent = centroidBounds.maximum - centroidBounds.minimum;
+
+			for (int axis = 0; axis < 3; axis++)
+				scale[axis] = extent[axis] > 0.0f ? float(binCount) / extent[axis] : 0.0f;
+		}
+
+		int bin(vec3 centroid, int axis) const
+		{
+			return std::min(binCount - 1, int((centroid[axis] - minimum[axis]) * scale[axis]));
+		}
+	};
+
+	void computeBounds(const BuildInput& input, const uint* references, uint begin, uint end, Bounds& bounds, Bounds& centroidBounds)
+	{
+		for (uint i = begin; i < end; i++)
+		{
+			bounds.extend(input.bounds[references[i]]);
+			centroidBounds.extend(input.centroids[references[i]]);
+		}
+	}
+
+	void binTriangles(const BuildInput& input, const uint* references, uint begin, uint end, const Binning& binning, Bins& bins)
+	{
+		for (uint i = begin; i < end; i++)
+		{
+			const uint triangle = references[i];
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				Bin& bin = bins[axis][binning.bin(input.centroids[triangle], axis)];
+				bin.bounds.extend(input.bounds[triangle]);
+				bin.count++;
+			}
+		}
+	}
+
+	// Makes the node a leaf or splits its triangles and returns the start of the second half. Large nodes are
+	// bounded and binned in blocks in parallel.
+	uint splitNode(const BuildInput& input, uint* references, const BuildTask& task, BvhNode& node, bool parallel)
+	{
+		const uint count = task.end - task.begin;
+		const std::size_t blockCount = parallel ? (count + blockSize - 1) / blockSize : 1;
+
+		Bounds bounds;
+		Bounds centroidBounds;
+
+		if (blockCount > 1)
+		{
+			std::vector<Bounds> blockBounds(blockCount);
+			std::vector<Bounds> blockCentroidBounds(blockCount);
+
+			parallelFor(blockCount, [&](std::size_t block)
+			{
+				const uint begin = task.begin + uint(block * blockSize);
+				computeBounds(input, references, begin, std::min(task.end, uint(begin + blockSize)), blockBounds[block], blockCentroidBounds[block]);
+			});
+
+			for (std::size_t block = 0; block < blockCount; block++)
+			{
+				bounds.extend(blockBounds[block]);
+				centroidBounds.extend(blockCentroidBounds[block]);
+			}
+		}
+		else
+		{
+			computeBounds(input, references, task.begin, task.end, bounds, centroidBounds);
+		}
+
+		node.minimumBounds = bounds.minimum;
+		node.maximumBounds = bounds.maximum;
+		node.firstIndex = task.begin;
+		node.triangleCount = count;
+
+		if (count <= 1)
+			return task.end;
+
+		const Binning binning(centroidBounds);
+		int splitAxis = -1;
+		int splitBin = 0;
+
+		if (task.depth < maximumHeuristicDepth)
+		{
+			Bins bins;
+
+			if (blockCount > 1)
+			{
+				std::vector<Bins> blockBins(blockCount);
+
+				parallelFor(blockCount, [&](std::size_t block)
+				{
+					const uint begin = task.begin + uint(block * blockSize);
+					binTriangles(input, references, begin, std::min(task.end, uint(begin + blockSize)), binning, blockBins[block]);
+				});
+
+				for (const auto& block : blockBins)
+				{
+					for (int axis = 0; axis < 3; axis++)
+					{
+						for (int i = 0; i < binCount; i++)
+						{
+							bins[axis][i].bounds.extend(block[axis][i].bounds);
+							bins[axis][i].count += block[axis][i].count;
+						}
+					}
+				}
+			}
+			else
+			{
+				binTriangles(input, references, task.begin, task.end, binning, bins);
+			}
+
+			// sweep the bins from both sides to get the cost of every split between two of them
+			const float nodeArea = bounds.halfArea();
+			float bestCost = std::numeric_limits<float>::infinity();
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (binning.scale[axis] == 0.0f)
+					continue;
+
+				std::array<float, binCount> rightCosts;
+				Bounds rightBounds;
+				uint rightCount = 0;
+
+				for (int i = binCount - 1; i > 0; i--)
+				{
+					rightBounds.extend(bins[axis][i].bounds);
+					rightCount += bins[axis][i].count;
+					rightCosts[i] = rightBounds.halfArea() * float(rightCount);
+				}
+
+				Bounds leftBounds;
+				uint leftCount = 0;
+
+				for (int i = 1; i < binCount; i++)
+				{
+					leftBounds.extend(bins[axis][i - 1].bounds);
+					leftCount += bins[axis][i - 1].count;
+
+					const float cost = leftBounds.halfArea() * float(leftCount) + rightCosts[i];
+
+					if (leftCount > 0 && leftCount < count && cost < bestCost)
+					{
+						bestCost = cost;
+						splitAxis = axis;
+						splitBin = i;
+					}
+				}
+			}
+
+			if (splitAxis >= 0 && nodeArea > 0.0f && count <= maximumLeafSize && traversalCost + bestCost / nodeArea >= float(count))
+				return task.end;
+		}
+
+		if (splitAxis >= 0)
+		{
+			const uint* middle = std::partition(references + task.begin, references + task.end, [&](uint triangle)
+			{
+				return binning.bin(input.centroids[triangle], splitAxis) < splitBin;
+			});
+
+			return uint(middle - references);
+		}
+
+		if (count <= maximumLeafSize)
+			return task.end;
+
+		// all centroids fall into one bin or the node is too deep, split in the middle of the longest axis
+		int axis = 0;
+		const vec3 extent = centroidBounds.maximum - centroidBounds.minimum;
+
+		if (extent.y > extent[axis])
+			axis = 1;
+
+		if (extent.z > extent[axis])
+			axis = 2;
+
+		const uint middle = task.begin + count / 2;
+
+		std::nth_element(references + task.begin, references + middle, references + task.end, [&](uint first, uint second)
+		{
+			return input.centroids[first][axis] < input.centroids[second][axis];
+		});
+
+		return middle;
+	}
+
+	// Builds the nodes of the pending tasks and their descendants, where the nodes of the tasks already exist.
+	// Tasks with at most deferredSize triangles are moved to deferred instead if it is given. Returns the depth
+	// of the deepest leaf.
+	std::size_t buildNodes(const BuildInput& input, uint* references, std::vector<BvhNode>& nodes, std::vector<BuildTask> pending, bool parallel, std::size_t deferredSize = 0, std::vector<BuildTask>* deferred = nullptr)
+	{
+		std::size_t depth = 0;
+
+		while (!pending.empty())
+		{
+			const BuildTask task = pending.back();
+			pending.pop_back();
+
+			if (deferred && task.end - task.begin <= deferredSize)
+			{
+				deferred->push_back(task);
+				continue;
+			}
+
+			BvhNode node;
+			const uint middle = splitNode(input, references, task, node, parallel);
+
+			if (middle < task.end)
+			{
+				node.firstIndex = uint(nodes.size());
+				node.triangleCount = 0;
+				nodes.resize(nodes.size() + 2);
+
+				pending.push_back({ node.firstIndex, task.begin, middle, task.depth + 1 });
+				pending.push_back({ node.firstIndex + 1, middle, task.end, task.depth + 1 });
+			}
+			else
+			{
+				depth = std::max(depth, task.depth);
+			}
+
+			nodes[task.node] = node;
+		}
+
+		return depth;
+	}
+
+	inline vec3 inverseDirection(vec3 direction)
+	{
+		vec3 result;
+
+		// keeps the slab distances finite for axis-parallel rays
+		for (int axis = 0; axis < 3; axis++)
+			result[axis] = std::abs(direction[axis]) > 1e-20f ? 1.0f / direction[axis] : std::copysign(1e20f, direction[axis]);
+
+		return result;
+	}
+
+	// distance at which the ray enters the box, infinity if it misses it within the distance range
+	inline float intersectBox(const BvhNode& node, vec3 origin, vec3 inverseDirection, float minimumDistance, float maximumDistance)
+	{
+		const float x0 = (node.minimumBounds.x - origin.x) * inverseDirection.x;
+		const float x1 = (node.maximumBounds.x - origin.x) * inverseDirection.x;
+		const float y0 = (node.minimumBounds.y - origin.y) * inverseDirection.y;
+		const float y1 = (node.maximumBounds.y - origin.y) * inverseDirection.y;
+		const float z0 = (node.minimumBounds.z - origin.z) * inverseDirection.z;
+		const float z1 = (node.maximumBounds.z - origin.z) * inverseDirection.z;
+
+		const float entry = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), minimumDistance));
+		const float exit = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), maximumDistance));
+
+		return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+	}
+
+	// Moeller and Trumbore, "Fast, Minimum Storage Ray/Triangle Intersection", for both sides of the triangle
+	inline bool intersectTriangle(const vec3* vertices, const Ray& ray, float maximumDistance, float& distance, vec2& barycentrics)
+	{
+		const vec3 edge1 = vertices[1] - vertices[0];
+		const vec3 edge2 = vertices[2] - vertices[0];
+		const vec3 p = cross(ray.direction, edge2);
+		const float determinant = dot(edge1, p);
+
+		if (determinant == 0.0f)
+			return false;
+
+		const float inverseDeterminant = 1.0f / determinant;
+		const vec3 s = ray.origin - vertices[0];
+		const float u = dot(s, p) * inverseDeterminant;
+
+		if (u < 0.0f || u > 1.0f)
+			return false;
+
+		const vec3 q = cross(s, edge1);
+		const float v = dot(ray.direction, q) * inverseDeterminant;
+
+		if (v < 0.0f || u + v > 1.0f)
+			return false;
+
+		const float t = dot(edge2, q) * inverseDeterminant;
+
+		if (t < ray.minimumDistance || t > maximumDistance)
+			return false;
+
+		distance = t;
+		barycentrics = vec2(u, v);
+		return true;
+	}
+
+	// Visits the nodes front to back and skips those behind the closest hit so far. The triangle of the hit is
+	// its index in the order of the leaves.
+	template <bool anyHit>
+	bool traverse(const std::vector<BvhNode>& nodes, const std::vector<vec3>& positions, const Ray& ray, RayHit& hit)
+	{
+		if (nodes.empty())
+			return false;
+
+		const vec3 inverse = inverseDirection(ray.direction);
+		float maximumDistance = ray.maximumDistance;
+
+		if (intersectBox(nodes[0], ray.origin, inverse, ray.minimumDistance, maximumDistance) == std::numeric_limits<float>::infinity())
+			return false;
+
+		struct StackEntry
+		{
+			uint node;
+			float distance;
+		};
+
+		StackEntry stack[stackSize];
+		std::size_t stackCount = 0;
+		uint current = 0;
+		bool found = false;
+
+		for (;;)
+		{
+			const BvhNode& node = nodes[current];
+
+			if (node.isLeaf())
+			{
+				for (uint i = node.firstIndex; i < node.firstIndex + node.triangleCount; i++)
+				{
+					if (intersectTriangle(&positions[3 * std::size_t(i)], ray, maximumDistance, hit.distance, hit.barycentrics))
+					{
+						maximumDistance = hit.distance;
+						hit.triangle = i;
+						found = true;
+
+						if (anyHit)
+							return true;
+					}
+				}
+			}
+			else
+			{
+				uint nearChild = node.firstIndex;
+				uint farChild = node.firstIndex + 1;
+				float nearDistance = intersectBox(nodes[nearChild], ray.origin, inverse, ray.minimumDistance, maximumDistance);
+				float farDistance = intersectBox(nodes[farChild], ray.origin, inverse, ray.minimumDistance, maximumDistance);
+
+				if (farDistance < nearDistance)
+				{
+					std::swap(nearChild, farChild);
+					std::swap(nearDistance, farDistance);
+				}
+
+				if (nearDistance != std::numeric_limits<float>::infinity())
+				{
+					if (farDistance != std::numeric_limits<float>::infinity())
+						stack[stackCount++] = { farChild, farDistance };
+
+					current = nearChild;
+					continue;
+				}
+			}
+
+			// continue with the closest postponed node that is not behind the closest hit
+			do
+			{
+				if (stackCount == 0)
+					return found;
+
+				stackCount--;
+			} while (stack[stackCount].distance > maximumDistance);
+
+			current = stack[stackCount].node;
+		}
+	}
+}
+
+void Bvh::build(const std::vector<Vertex>& vertices, const std::vector<uint>& indices, const std::vector<uint>& triangles)
+{
+	clear();
+
+	const uint triangleCount = uint(triangles.size());
+
+	if (triangleCount == 0)
+		return;
+
+	const std::size_t inputBlockCount = (triangleCount + blockSize - 1) / blockSize;
+	BuildInput input;
+	input.bounds.resize(triangleCount);
+	input.centroids.resize(triangleCount);
+
+	parallelFor(inputBlockCount, [&](std::size_t block)
+	{
+		const std::size_t end = std::min<std::size_t>(triangleCount, (block + 1) * blockSize);
+
+		for (std::size_t i = block * blockSize; i < end; i++)
+		{
+			Bounds& bounds = input.bounds[i];
+
+			for (std::size_t k = 0; k < 3; k++)
+				bounds.extend(vertices[indices[3 * std::size_t(triangles[i]) + k]].position);
+
+			input.centroids[i] = 0.5f * (bounds.minimum + bounds.maximum);
+		}
+	});
+
+	std::vector<uint> references(triangleCount);
+
+	for (uint i = 0; i < triangleCount; i++)
+		references[i] = i;
+
+	// The upper levels are built one node at a time with parallel binning, until there are enough subtrees
+	// to keep all threads busy. These are then built on their own and appended to the upper levels.
+	const std::size_t subtreeSize = std::max<std::size_t>(4 * blockSize, triangleCount / (8 * std::size_t(hardwareThreadCount())));
+	std::vector<BuildTask> subtrees;
+
+	m_nodes.resize(1);
+	m_depth = buildNodes(input, references.data(), m_nodes, { BuildTask{ 0, 0, triangleCount, 1 } }, true, subtreeSize, &subtrees);
+
+	std::sort(subtrees.begin(), subtrees.end(), [](const BuildTask& first, const BuildTask& second)
+	{
+		return first.end - first.begin > second.end - second.begin;
+	});
+
+	std::vector<std::vector<BvhNode>> subtreeNodes(subtrees.size());
+	std::vector<std::size_t> subtreeDepths(subtrees.size());
+
+	parallelFor(subtrees.size(), [&](std::size_t i)
+	{
+		const BuildTask& subtree = subtrees[i];
+		subtreeNodes[i].resize(1);
+		subtreeDepths[i] = buildNodes(input, references.data(), subtreeNodes[i], { BuildTask{ 0, subtree.begin, subtree.end, subtree.depth } }, false);
+	});
+
+	for (std::size_t i = 0; i < subtrees.size(); i++)
+	{
+		// the root of a subtree replaces its placeholder, the other nodes are moved behind the existing ones
+		const std::vector<BvhNode>& nodes = subtreeNodes[i];
+		const uint offset = uint(m_nodes.size()) - 1;
+
+		for (std::size_t n = 0; n < nodes.size(); n++)
+		{
+			BvhNode node = nodes[n];
+
+			if (!node.isLeaf())
+				node.firstIndex += offset;
+
+			if (n == 0)
+				m_nodes[subtrees[i].node] = node;
+			else
+				m_nodes.push_back(node);
+		}
+
+		m_depth = std::max(m_depth, subtreeDepths[i]);
+	}
+
+	// store the triangles in the order of the leaves
+	m_triangles.resize(triangleCount);
+	m_positions.resize(3 * std::size_t(triangleCount));
+
+	parallelFor(inputBlockCount, [&](std::size_t block)
+	{
+		const std::size_t end = std::min<std::size_t>(triangleCount, (block + 1) * blockSize);
+
+		for (std::size_t i = block * blockSize; i < end; i++)
+		{
+			m_triangles[i] = triangles[references[i]];
+
+			for (std::size_t k = 0; k < 3; k++)
+				m_positions[3 * i + k] = vertices[indices[3 * std::size_t(m_triangles[i]) + k]].position;
+		}
+	});
+}
+
+void Bvh::build(const Model& model)
+{
+	build(model.vertices(), model.indices(), groupTriangles(model.groups()));
+}
+
+void Bvh::clear()
+{
+	m_nodes.clear();
+	m_triangles.clear();
+	m_positions.clear();
+	m_depth = 0;
+}
+
+std::vector<uint> Bvh::groupTriangles(const std::vector<Group>& groups)
+{
+	std::vector<uint> triangles;
+
+	for (const auto& group : groups)
+	{
+		for (uint i = group.startIndex; i + 3 <= group.endIndex; i += 3)
+			triangles.push_back(i / 3);
+	}
+
+	return triangles;
+}
+
+bool Bvh::empty() const
+{
+	return m_nodes.empty();
+}
+
+std::size_t Bvh::triangleCount() const
+{
+	return m_triangles.size();
+}
+
+const std::vector<BvhNode>& Bvh::nodes() const
+{
+	return m_nodes;
+}
+
+const std::vector<uint>& Bvh::triangles() const
+{
+	return m_triangles;
+}
+
+const std::vector<vec3>& Bvh::positions() const
+{
+	return m_positions;
+}
+
+std::size_t Bvh::depth() const
+{
+	return m_depth;
+}
+
+bool Bvh::intersect(const Ray& ray, RayHit& hit) const
+{
+	RayHit closest;
+
+	if (!traverse<false>(m_nodes, m_positions, ray, closest))
+		return false;
+
+	hit = closest;
+	hit.triangle = m_triangles[closest.triangle];
+	return true;
+}
+
+bool Bvh::occluded(const Ray& ray) const
+{
+	RayHit hit;
+	return traverse<true>(m_nodes, m_positions, ray, hit);
+}
+
+void Bvh::query(vec3 minimumBounds, vec3 maximumBounds, std::vector<uint>& triangles) const
+{
+	auto overlaps = [&](vec3 minimum, vec3 maximum)
+	{
+		return minimum.x <= maximumBounds.x && minimum.y <= maximumBounds.y && minimum.z <= maximumBounds.z &&
+			maximum.x >= minimumBounds.x && maximum.y >= minimumBounds.y && maximum.z >= minimumBounds.z;
+	};
+
+	if (m_nodes.empty() || !overlaps(m_nodes[0].minimumBounds, m_nodes[0].maximumBounds))
+		return;
+
+	uint stack[stackSize];
+	std::size_t stackCount = 0;
+	stack[stackCount++] = 0;
+
+	while (stackCount > 0)
+	{
+		const BvhNode& node = m_nodes[stack[--stackCount]];
+
+		if (node.isLeaf())
+		{
+			for (uint i = node.firstIndex; i < node.firstIndex + node.triangleCount; i++)
+			{
+				const vec3* vertices = &m_positions[3 * std::size_t(i)];
+
+				if (overlaps(min(min(vertices[0], vertices[1]), vertices[2]), max(max(vertices[0], vertices[1]), vertices[2])))
+					triangles.push_back(m_triangles[i]);
+			}
+		}
+		else
+		{
+			for (uint child = node.firstIndex; child < node.firstIndex + 2; child++)
+			{
+				if (overlaps(m_nodes[child].minimumBounds, m_nodes[child].maximumBounds))
+					stack[stackCount++] = child;
+			}
+		}
+	}
+}
+
+void Bvh::query(const std::array<vec4, 6>& planes, std::vector<uint>& triangles) const
+{
+	// a box is outside if its corner farthest along the normal of a plane is behind it
+	auto boxVisible = [&](const BvhNode& node)
+	{
+		for (const auto& plane : planes)
+		{
+			const vec3 corner(plane.x >= 0.0f ? node.maximumBounds.x : node.minimumBounds.x, plane.y >= 0.0f ? node.maximumBounds.y : node.minimumBounds.y, plane.z >= 0.0f ? node.maximumBounds.z : node.minimumBounds.z);
+
+			if (dot(vec3(plane), corner) + plane.w < 0.0f)
+				return false;
+		}
+
+		return true;
+	};
+
+	auto triangleVisible = [&](const vec3* vertices)
+	{
+		for (const auto& plane : planes)
+		{
+			const vec3 normal(plane);
+
+			if (dot(normal, vertices[0]) + plane.w < 0.0f && dot(normal, vertices[1]) + plane.w < 0.0f && dot(normal, vertices[2]) + plane.w < 0.0f)
+				return false;
+		}
+
+		return true;
+	};
+
+	if (m_nodes.empty() || !boxVisible(m_nodes[0]))
+		return;
+
+	uint stack[stackSize];
+	std::size_t stackCount = 0;
+	stack[stackCount++] = 0;
+
+	while (stackCount > 0)
+	{
+		const BvhNode& node = m_nodes[stack[--stackCount]];
+
+		if (node.isLeaf())
+		{
+			for (uint i = node.firstIndex; i < node.firstIndex + node.triangleCount; i++)
+			{
+				if (triangleVisible(&m_positions[3 * std::size_t(i)]))
+					triangles.push_back(m_triangles[i]);
+			}
+		}
+		else
+		{
+			for (uint child = node.firstIndex; child < node.firstIndex + 2; child++)
+			{
+				if (boxVisible(m_nodes[child]))
+					stack[stackCount++] = child;
+			}
+		}
+	}
+}
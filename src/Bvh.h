@@ -0,0 +1,101 @@
+#pragma once
+
+#include "Model.h"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace minity
+{
+	// Node of a bounding volume hierarchy in 32 bytes and aligned to them, so that a node never spans two cache
+	// lines. Inner nodes have their two children at firstIndex and firstIndex + 1, leaves refer to the triangles
+	// [firstIndex, firstIndex + triangleCount) in the order of the hierarchy.
+	struct alignas(32) BvhNode
+	{
+		glm::vec3 minimumBounds = glm::vec3(0.0f);
+		glm::uint firstIndex = 0;
+		glm::vec3 maximumBounds = glm::vec3(0.0f);
+		glm::uint triangleCount = 0;
+
+		bool isLeaf() const
+		{
+			return triangleCount > 0;
+		}
+	};
+
+	// points origin + t * direction for t in [minimumDistance, maximumDistance]
+	struct Ray
+	{
+		glm::vec3 origin = glm::vec3(0.0f);
+		glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+		float minimumDistance = 0.0f;
+		float maximumDistance = std::numeric_limits<float>::infinity();
+	};
+
+	struct RayHit
+	{
+		static constexpr glm::uint noTriangle = std::numeric_limits<glm::uint>::max();
+
+		// the triangle as passed to Bvh::build()
+		glm::uint triangle = noTriangle;
+		// in multiples of the ray direction
+		float distance = std::numeric_limits<float>::infinity();
+		// weights of the second and third vertex of the triangle at the hit point
+		glm::vec2 barycentrics = glm::vec2(0.0f);
+
+		bool valid() const
+		{
+			return triangle != noTriangle;
+		}
+	};
+
+	// Bounding volume hierarchy over triangles for ray and range queries. The positions of the triangles are
+	// copied into the order of the leaves, so that the hierarchy does not depend on the vertices afterwards.
+	class Bvh
+	{
+	public:
+		// Builds the hierarchy over the triangles (indices[3 t], indices[3 t + 1], indices[3 t + 2]) for every t
+		// in triangles, which is what the queries report. Splits are chosen by the surface area heuristic over
+		// binned triangle centroids. The upper levels are binned in parallel, the subtrees below them are built
+		// in parallel to each other.
+		void build(const std::vector<Vertex>& vertices, const std::vector<glm::uint>& indices, const std::vector<glm::uint>& triangles);
+		// builds the hierarchy over the triangles of all groups at full resolution, see groupTriangles()
+		void build(const Model& model);
+		void clear();
+
+		// the triangles t of the full resolution index ranges of the groups, with indices starting at 3 t
+		static std::vector<glm::uint> groupTriangles(const std::vector<Group>& groups);
+
+		bool empty() const;
+		std::size_t triangleCount() const;
+		// the root is the first node
+		const std::vector<BvhNode>& nodes() const;
+		// the triangles in the order of the leaves
+		const std::vector<glm::uint>& triangles() const;
+		// three vertex positions per triangle, in the order of the leaves
+		const std::vector<glm::vec3>& positions() const;
+		// number of nodes on the longest path from the root to a leaf, including both
+		std::size_t depth() const;
+
+		// finds the closest intersection within the distance range of the ray, returns false if there is none
+		bool intersect(const Ray& ray, RayHit& hit) const;
+		// returns true as soon as any intersection within the distance range of the ray is found
+		bool occluded(const Ray& ray) const;
+
+		// appends every triangle whose bounding box overlaps the given box
+		void query(glm::vec3 minimumBounds, glm::vec3 maximumBounds, std::vector<glm::uint>& triangles) const;
+		// Appends every triangle that may intersect the frustum given by planes as returned by
+		// FrustumCuller::frustumPlanes(); triangles with all vertices behind one of the planes are left out.
+		void query(const std::array<glm::vec4, 6>& planes, std::vector<glm::uint>& triangles) const;
+
+	private:
+		std::vector<BvhNode> m_nodes;
+		std::vector<glm::uint> m_triangles;
+		std::vector<glm::vec3> m_positions;
+		std::size_t m_depth = 0;
+	};
+}
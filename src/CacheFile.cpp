@@ -0,0 +1,168 @@
+#include "CacheFile.h"
+
+#include <cstring>
+#include <filesystem>
+
+using namespace minity;
+
+bool minity::stampFile(const std::string& filename, FileStamp& stamp)
+{
+	std::error_code error;
+	const std::filesystem::path path = std::filesystem::absolute(filename, error).lexically_normal();
+
+	if (error)
+		return false;
+
+	const auto size = std::filesystem::file_size(path, error);
+
+	if (error)
+		return false;
+
+	const auto time = std::filesystem::last_write_time(path, error);
+
+	if (error)
+		return false;
+
+	stamp.path = path.string();
+	stamp.size = std::uint64_t(size);
+	stamp.time = std::int64_t(time.time_since_epoch().count());
+	return true;
+}
+
+FileStamp minity::missingFileStamp(const std::string& filename)
+{
+	std::error_code error;
+	const std::filesystem::path path = std::filesystem::absolute(filename, error).lexically_normal();
+
+	FileStamp stamp;
+	stamp.path = error ? filename : path.string();
+	return stamp;
+}
+
+CacheWriter::CacheWriter(const std::string& filename) : m_filename(filename), m_temporaryFilename(filename + ".tmp"), m_stream(m_temporaryFilename, std::ios::binary | std::ios::trunc)
+{
+}
+
+CacheWriter::~CacheWriter()
+{
+	if (!m_closed)
+	{
+		m_stream.close();
+
+		std::error_code error;
+		std::filesystem::remove(m_temporaryFilename, error);
+	}
+}
+
+CacheWriter::operator bool() const
+{
+	return !m_stream.fail();
+}
+
+void CacheWriter::writeBytes(const void* data, std::size_t size)
+{
+	if (size > 0)
+		m_stream.write(static_cast<const char*>(data), std::streamsize(size));
+
+	m_offset += size;
+}
+
+void CacheWriter::writeString(const std::string& value)
+{
+	write(std::uint64_t(value.size()));
+	writeBytes(value.data(), value.size());
+}
+
+void CacheWriter::writeStamp(const FileStamp& stamp)
+{
+	writeString(stamp.path);
+	write(stamp.size);
+	write(stamp.time);
+}
+
+void CacheWriter::align()
+{
+	static const char padding[cacheAlignment] = {};
+	writeBytes(padding, (cacheAlignment - m_offset % cacheAlignment) % cacheAlignment);
+}
+
+bool CacheWriter::close()
+{
+	m_closed = true;
+	m_stream.close();
+
+	std::error_code error;
+
+	if (m_stream.fail())
+	{
+		std::filesystem::remove(m_temporaryFilename, error);
+		return false;
+	}
+
+	std::filesystem::rename(m_temporaryFilename, m_filename, error);
+
+	if (error)
+	{
+		std::filesystem::remove(m_temporaryFilename, error);
+		return false;
+	}
+
+	return true;
+}
+
+CacheReader::CacheReader(const char* begin, const char* end) : m_begin(begin), m_current(begin), m_end(end)
+{
+}
+
+CacheReader::operator bool() const
+{
+	return !m_failed;
+}
+
+CacheReader& CacheReader::readBytes(void* data, std::size_t size)
+{
+	if (m_failed || std::size_t(m_end - m_current) < size)
+	{
+		m_failed = true;
+		return *this;
+	}
+
+	if (size > 0)
+		std::memcpy(data, m_current, size);
+
+	m_current += size;
+	return *this;
+}
+
+CacheReader& CacheReader::readString(std::string& value)
+{
+	std::uint64_t size = 0;
+
+	if (!read(size) || size > std::uint64_t(m_end - m_current))
+	{
+		m_failed = true;
+		return *this;
+	}
+
+	value.assign(m_current, std::size_t(size));
+	m_current += size;
+	return *this;
+}
+
+CacheReader& CacheReader::readStamp(FileStamp& stamp)
+{
+	return readString(stamp.path).read(stamp.size).read(stamp.time);
+}
+
+CacheReader& CacheReader::align()
+{
+	const std::size_t offset = std::size_t(m_current - m_begin);
+	const std::size_t padding = (cacheAlignment - offset % cacheAlignment) % cacheAlignment;
+
+	if (m_failed || std::size_t(m_end - m_current) < padding)
+		m_failed = true;
+	else
+		m_current += padding;
+
+	return *this;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace minity
+{
+	// Building blocks of the binary cache files (processed models and textures) stored next to their sources.
+
+	// identifies a particular version of a source file
+	struct FileStamp
+	{
+		std::string path;
+		std::uint64_t size = 0;
+		std::int64_t time = 0;
+
+		bool operator==(const FileStamp& other) const
+		{
+			return path == other.path && size == other.size && time == other.time;
+		}
+	};
+
+	bool stampFile(const std::string& filename, FileStamp& stamp);
+	// stamp of a file that does not exist, with size and time 0, so that creating the file later changes its stamp
+	FileStamp missingFileStamp(const std::string& filename);
+
+	// Arrays start at multiples of this, so they are aligned for their element types in a mapping of the file.
+	// They are still copied out of the mapping, as the model keeps its vertices and indices on the CPU as well.
+	const std::size_t cacheAlignment = 16;
+
+	// Writes a cache file to a temporary file first and renames it on close(),
+	// so that an interrupted write never leaves a truncated cache behind.
+	class CacheWriter
+	{
+	public:
+		CacheWriter(const std::string& filename);
+		~CacheWriter();
+
+		explicit operator bool() const;
+
+		void writeBytes(const void* data, std::size_t size);
+
+		template <typename T>
+		void write(const T& value)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable types can be written directly");
+			writeBytes(&value, sizeof(T));
+		}
+
+		void writeString(const std::string& value);
+		void writeStamp(const FileStamp& stamp);
+
+		template <typename T>
+		void writeArray(const std::vector<T>& values)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable types can be written directly");
+			write(std::uint64_t(values.size()));
+			align();
+			writeBytes(values.data(), values.size() * sizeof(T));
+		}
+
+		void align();
+
+		// returns false if anything could not be written, the cache file is not replaced in that case
+		bool close();
+
+	private:
+		std::string m_filename;
+		std::string m_temporaryFilename;
+		std::ofstream m_stream;
+		std::size_t m_offset = 0;
+		bool m_closed = false;
+	};
+
+	// Counterpart of CacheWriter working on the mapped cache file. Like LineScanner in the OBJ parser,
+	// it stays in a failed state after the first read that would go past the end of the file.
+	class CacheReader
+	{
+	public:
+		CacheReader(const char* begin, const char* end);
+
+		explicit operator bool() const;
+
+		CacheReader& readBytes(void* data, std::size_t size);
+
+		template <typename T>
+		CacheReader& read(T& value)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable types can be read directly");
+			return readBytes(&value, sizeof(T));
+		}
+
+		CacheReader& readString(std::string& value);
+		CacheReader& readStamp(FileStamp& stamp);
+
+		template <typename T>
+		CacheReader& readArray(std::vector<T>& values)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable types can be read directly");
+
+			std::uint64_t count = 0;
+
+			if (!read(count) || !align() || count > std::uint64_t(m_end - m_current) / sizeof(T))
+			{
+				m_failed = true;
+				return *this;
+			}
+
+			values.resize(std::size_t(count));
+			return readBytes(values.data(), values.size() * sizeof(T));
+		}
+
+		CacheReader& align();
+
+	private:
+		const char* m_begin;
+		const char* m_current;
+		const char* m_end;
+		bool m_failed = false;
+	};
+}
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
@@ -21,11 +22,20 @@
 #include <glm/gtx/string_cast.hpp>
 
 #include "Viewer.h"
+#include "Model.h"
 
 using namespace minity;
 using namespace glm;
 using namespace gl;
 
+namespace
+{
+	const float fieldOfView = radians(60.0f);
+	const float nearPlane = 0.125f;
+	const float farPlane = 32768.0f;
+	const float cameraDistance = 2.0f*sqrt(3.0f);
+}
+
 CameraInteractor::CameraInteractor(Viewer * viewer) : Interactor(viewer)
 {
 	resetProjectionTransform();
@@ -36,6 +46,7 @@ CameraInteractor::CameraInteractor(Viewer * viewer) : Interactor(viewer)
 	globjects::debug() << "  Drag middle mouse - pan";
 	globjects::debug() << "  Drag right mouse - zoom";
 	globjects::debug() << "  Shift + Left mouse - light position";
+	globjects::debug() << "  Click left mouse - select group";
 	globjects::debug() << "  H - toggle headlight";
 	globjects::debug() << "  B - benchmark";
 	globjects::debug() << "  Home - reset view";
@@ -50,9 +61,9 @@ void CameraInteractor::framebufferSizeEvent(int width, int height)
 	float aspect = float(width) / float(height);
 
 	if (m_perspective)
-		viewer()->setProjectionTransform(perspective(m_fov, aspect, m_near, m_far));
+		viewer()->setProjectionTransform(initialProjectionTransform(aspect));
 	else
-		viewer()->setProjectionTransform(ortho(-1.0f*aspect, 1.0f*aspect, -1.0f, 1.0f, m_near, m_far));
+		viewer()->setProjectionTransform(ortho(-1.0f*aspect, 1.0f*aspect, -1.0f, 1.0f, nearPlane, farPlane));
 }
 
 void CameraInteractor::keyEvent(int key, int scancode, int action, int mods)
@@ -113,8 +124,7 @@ void CameraInteractor::keyEvent(int key, int scancode, int action, int mods)
 		std::cout << "Starting benchmark" << std::endl;
 
 		m_benchmark = true;
-		m_startTime = glfwGetTime();
-		m_frameCount = 0;
+		viewer()->benchmark().start(FrameBenchmark::Settings());
 	}
 	else if (key == GLFW_KEY_H && action == GLFW_RELEASE)
 	{
@@ -129,6 +139,14 @@ void CameraInteractor::mouseButtonEvent(int button, int action, int mods)
 		m_rotating = true;
 		m_xPrevious = m_xCurrent;
 		m_yPrevious = m_yCurrent;
+		m_xPressed = m_xCurrent;
+		m_yPressed = m_yCurrent;
+	}
+	else if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE && m_rotating && !m_light && std::abs(m_xCurrent - m_xPressed) < 3.0 && std::abs(m_yCurrent - m_yPressed) < 3.0)
+	{
+		// a click without dragging
+		m_rotating = false;
+		pick(m_xCurrent, m_yCurrent);
 	}
 	else if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS)
 	{
@@ -160,7 +178,7 @@ void CameraInteractor::cursorPosEvent(double xpos, double ypos)
 		vec3 v = arcballVector(m_xCurrent, m_yCurrent);
 		mat4 viewTransform = viewer()->viewTransform();
 
-		mat4 lightTransform = inverse(viewTransform)*translate(mat4(1.0f), -0.5f*v*m_distance)*viewTransform;
+		mat4 lightTransform = inverse(viewTransform)*translate(mat4(1.0f), -0.5f*v*cameraDistance)*viewTransform;
 		viewer()->setLightTransform(lightTransform);
 	}
 
@@ -237,6 +255,9 @@ void CameraInteractor::cursorPosEvent(double xpos, double ypos)
 		}
 	}
 
+	if (m_pickOnHover && !m_light && !m_rotating && !m_scaling && !m_panning)
+		pick(m_xCurrent, m_yCurrent);
+
 	m_xPrevious = m_xCurrent;
 	m_yPrevious = m_yCurrent;
 
@@ -251,31 +272,19 @@ void CameraInteractor::scrollEvent(double xoffset, double yoffset)
 
 void CameraInteractor::display()
 {
-	if (m_benchmark)
+	if (m_benchmark && viewer()->benchmark().finished())
 	{
-		m_frameCount++;
-
-		mat4 viewTransform = viewer()->viewTransform();
-		mat4 inverseViewTransform = inverse(viewTransform);
-		vec4 transformedAxis = inverseViewTransform * vec4(0.0, 1.0, 0.0, 0.0);
-
-		mat4 newViewTransform = rotate(viewTransform, pi<float>() / 180.0f, vec3(transformedAxis));
-		viewer()->setViewTransform(newViewTransform);
-
-
-		if (m_frameCount >= 360)
-		{
-			double currentTime = glfwGetTime();
-
-			std::cout << "Benchmark finished." << std::endl;
-			std::cout << "Rendered " << m_frameCount << " frames in " << (currentTime - m_startTime) << " seconds." << std::endl;
-			std::cout << "Average frames/second: " << double(m_frameCount) / (currentTime - m_startTime) << std::endl;
+		std::cout << "Benchmark finished." << std::endl;
+		viewer()->benchmark().printSummary(std::cout);
 
-			m_benchmark = false;
-		}
+		m_benchmark = false;
+	}
 
+	// a selection refers to the groups of the model the hierarchy was built for
+	m_picker.update(*viewer()->scene()->model());
 
-	}
+	if (!m_picker.ready())
+		viewer()->scene()->selection() = Selection();
 
 	if (ImGui::BeginMenu("Camera"))
 	{
@@ -290,6 +299,24 @@ void CameraInteractor::display()
 		}
 
 		ImGui::Checkbox("Headlight", &m_headlight);
+		ImGui::Checkbox("Pick on Hover", &m_pickOnHover);
+
+		const Selection& selection = viewer()->scene()->selection();
+		const std::vector<Group>& groups = viewer()->scene()->model()->groups();
+
+		if (m_picker.building())
+			ImGui::Text("Building picking hierarchy ...");
+		else if (m_picker.ready())
+			ImGui::Text("Picking hierarchy: %zu triangles, built in %.0f ms", m_picker.triangleCount(), m_picker.buildTime() * 1e3);
+
+		if (selection.valid() && selection.group < groups.size())
+		{
+			ImGui::Text("Group: %s", groups.at(selection.group).name.c_str());
+			ImGui::Text("Triangle: %u, barycentrics (%.3f, %.3f)", selection.triangle, selection.barycentrics.x, selection.barycentrics.y);
+			ImGui::Text("Position: (%.3f, %.3f, %.3f)", selection.position.x, selection.position.y, selection.position.z);
+			ImGui::Text("Picked in %.3f ms", m_pickTime * 1e3);
+		}
+
 		ImGui::EndMenu();
 	}
 }
@@ -302,8 +329,51 @@ void CameraInteractor::resetProjectionTransform()
 
 void CameraInteractor::resetViewTransform()
 {
-	viewer()->setViewTransform(lookAt(vec3(0.0f, 0.0f, -m_distance), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f)));
-	viewer()->setLightTransform(lookAt(vec3(0.0f, 0.0f, -0.5f*m_distance), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f)));
+	viewer()->setViewTransform(initialViewTransform());
+	viewer()->setLightTransform(initialLightTransform());
+}
+
+mat4 CameraInteractor::initialModelTransform(vec3 minimumBounds, vec3 maximumBounds)
+{
+	vec3 boundingBoxSize = maximumBounds - minimumBounds;
+	float maximumSize = std::max(std::max(boundingBoxSize.x, boundingBoxSize.y), boundingBoxSize.z);
+
+	return scale(mat4(1.0f), vec3(2.0f) / vec3(maximumSize)) * translate(mat4(1.0f), -0.5f * (minimumBounds + maximumBounds));
+}
+
+mat4 CameraInteractor::initialViewTransform()
+{
+	return lookAt(vec3(0.0f, 0.0f, -cameraDistance), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
+}
+
+mat4 CameraInteractor::initialLightTransform()
+{
+	return lookAt(vec3(0.0f, 0.0f, -0.5f*cameraDistance), vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
+}
+
+mat4 CameraInteractor::initialProjectionTransform(float aspect)
+{
+	return perspective(fieldOfView, aspect, nearPlane, farPlane);
+}
+
+void CameraInteractor::pick(double x, double y)
+{
+	const ivec2 viewportSize = viewer()->viewportSize();
+	const vec2 position = vec2(2.0f*float(x) / float(viewportSize.x) - 1.0f, -2.0f*float(y) / float(viewportSize.y) + 1.0f);
+	Selection selection;
+
+	// a load may have been started since the last frame, the hierarchies are dropped once the picker notices it
+	if (viewer()->scene()->model()->isLoading())
+	{
+		viewer()->scene()->selection() = selection;
+		return;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	m_picker.pick(viewer()->modelViewProjectionTransform(), position, viewer()->scene()->groupOffsets(), selection);
+	m_pickTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	viewer()->scene()->selection() = selection;
 }
 
 vec3 CameraInteractor::arcballVector(double x, double y)
@@ -1,5 +1,6 @@
 #pragma once
 #include "Interactor.h"
+#include "Picker.h"
 #include <glm/glm.hpp>
 
 namespace minity
@@ -20,14 +21,20 @@ namespace minity
 		void resetProjectionTransform();
 		void resetViewTransform();
 
+		// The camera a model is first displayed with, also used for rendering without a window: the bounding box
+		// of the model is scaled to the canonical view volume and seen from the front in perspective, with the
+		// light halfway between the camera and the center.
+		static glm::mat4 initialModelTransform(glm::vec3 minimumBounds, glm::vec3 maximumBounds);
+		static glm::mat4 initialViewTransform();
+		static glm::mat4 initialLightTransform();
+		static glm::mat4 initialProjectionTransform(float aspect);
+
 	private:
 
 		glm::vec3 arcballVector(double x, double y);
+		// selects the group under the cursor, or nothing if no triangle is hit
+		void pick(double x, double y);
 
-		float m_fov = glm::radians(60.0f);
-		float m_near = 0.125f;
-		float m_far = 32768.0f;
-		float m_distance = 2.0f*sqrt(3.0f);
 		bool m_perspective = true;
 		bool m_headlight = true;
 
@@ -35,11 +42,16 @@ namespace minity
 		bool m_rotating = false;
 		bool m_scaling = false;
 		bool m_panning = false;
+		// the benchmark was started with the key and its results have not been printed yet
 		bool m_benchmark = false;
-		double m_startTime = 0.0;
-		glm::uint m_frameCount = 0;
 		double m_xPrevious = 0.0, m_yPrevious = 0.0;
 		double m_xCurrent = 0.0, m_yCurrent = 0.0;
+
+		Picker m_picker;
+		bool m_pickOnHover = false;
+		double m_xPressed = 0.0, m_yPressed = 0.0;
+		// in seconds
+		double m_pickTime = 0.0;
 	};
 
 }
\ No newline at end of file
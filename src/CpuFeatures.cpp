@@ -0,0 +1,88 @@
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define MINITY_CPUID
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#define MINITY_CPUID
+#include <cpuid.h>
+#endif
+
+using namespace minity;
+
+namespace
+{
+#ifdef MINITY_CPUID
+	// registers eax, ebx, ecx and edx of the given leaf and subleaf
+	void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int registers[4])
+	{
+#ifdef _MSC_VER
+		int values[4];
+		__cpuidex(values, int(leaf), int(subleaf));
+
+		for (int i = 0; i < 4; i++)
+			registers[i] = (unsigned int)(values[i]);
+#else
+		__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+	}
+
+	// state components the operating system has enabled in XCR0
+	unsigned long long enabledStateComponents()
+	{
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else
+		unsigned int low, high;
+		__asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+		return (static_cast<unsigned long long>(high) << 32) | low;
+#endif
+	}
+
+	CpuFeatures query()
+	{
+		CpuFeatures features;
+		unsigned int registers[4];
+
+		cpuid(0, 0, registers);
+		const unsigned int leafCount = registers[0];
+
+		if (leafCount < 1)
+			return features;
+
+		cpuid(1, 0, registers);
+		features.sse2 = (registers[3] & (1u << 26)) != 0;
+		features.sse41 = (registers[2] & (1u << 19)) != 0;
+
+		const bool osxsave = (registers[2] & (1u << 27)) != 0;
+		const bool avx = (registers[2] & (1u << 28)) != 0;
+		const bool fma = (registers[2] & (1u << 12)) != 0;
+
+		// the XMM and YMM state have to be enabled, otherwise AVX instructions fault
+		if (!osxsave || !avx || (enabledStateComponents() & 0x6) != 0x6)
+			return features;
+
+		features.avx = true;
+		features.fma = fma;
+
+		if (leafCount >= 7)
+		{
+			cpuid(7, 0, registers);
+			features.avx2 = (registers[1] & (1u << 5)) != 0;
+		}
+
+		return features;
+	}
+#else
+	CpuFeatures query()
+	{
+		return CpuFeatures();
+	}
+#endif
+}
+
+const CpuFeatures& CpuFeatures::detect()
+{
+	static const CpuFeatures features = query();
+	return features;
+}
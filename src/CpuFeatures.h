@@ -0,0 +1,19 @@
+#pragma once
+
+namespace minity
+{
+	// Instruction set extensions of the processor the program runs on, for choosing between code paths that
+	// are compiled for different ones. All are false on other architectures than x86.
+	struct CpuFeatures
+	{
+		bool sse2 = false;
+		bool sse41 = false;
+		// only if the operating system also saves the AVX registers on context switches
+		bool avx = false;
+		bool avx2 = false;
+		bool fma = false;
+
+		// queried once with CPUID and cached afterwards
+		static const CpuFeatures& detect();
+	};
+}
@@ -0,0 +1,331 @@
+#include "FrameBenchmark.h"
+#include "Viewer.h"
+#include "Model.h"
+
+#include <glbinding/gl/gl.h>
+#include <glbinding/gl/enum.h>
+#include <glbinding/gl/functions.h>
+#include <glbinding-aux/ContextInfo.h>
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+
+using namespace minity;
+using namespace gl;
+using namespace glm;
+using namespace globjects;
+
+namespace
+{
+	std::string escapeJson(const std::string& text)
+	{
+		std::string escaped;
+
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+
+			if (static_cast<unsigned char>(c) >= 0x20)
+				escaped += c;
+		}
+
+		return escaped;
+	}
+
+	std::string escapeCsv(const std::string& text)
+	{
+		std::string escaped = "\"";
+
+		for (char c : text)
+		{
+			if (c == '"')
+				escaped += '"';
+
+			escaped += c;
+		}
+
+		return escaped + "\"";
+	}
+
+	void writeJsonDistribution(std::ostream& stream, const FrameBenchmark::Distribution& distribution)
+	{
+		stream << "{ \"min\": " << distribution.minimum << ", \"median\": " << distribution.median << ", \"p95\": " << distribution.percentile95
+			<< ", \"p99\": " << distribution.percentile99 << ", \"max\": " << distribution.maximum << ", \"mean\": " << distribution.mean << " }";
+	}
+
+	void writeCsvDistribution(std::ostream& stream, const FrameBenchmark::Distribution& distribution)
+	{
+		stream << "," << distribution.minimum << "," << distribution.median << "," << distribution.percentile95 << "," << distribution.percentile99 << "," << distribution.maximum << "," << distribution.mean;
+	}
+
+	// the counts of values in bins of the given width, starting at 0
+	std::vector<std::size_t> histogram(const std::vector<double>& values, double binWidth, std::size_t binCount)
+	{
+		std::vector<std::size_t> counts(binCount, 0);
+
+		for (double value : values)
+			counts[std::min(binCount - 1, std::size_t(std::max(0.0, value / binWidth)))]++;
+
+		return counts;
+	}
+
+	template <typename Value>
+	std::vector<double> values(const std::vector<FrameBenchmark::Frame>& frames, Value FrameBenchmark::Frame::* member)
+	{
+		std::vector<double> result;
+		result.reserve(frames.size());
+
+		for (const auto& frame : frames)
+			result.push_back(double(frame.*member));
+
+		return result;
+	}
+}
+
+FrameBenchmark::Distribution FrameBenchmark::Distribution::of(std::vector<double> values)
+{
+	Distribution distribution;
+
+	if (values.empty())
+		return distribution;
+
+	std::sort(values.begin(), values.end());
+
+	auto percentile = [&](double p)
+	{
+		const std::size_t rank = std::size_t(std::ceil(p * double(values.size())));
+		return values[std::min(values.size(), std::max(rank, std::size_t(1))) - 1];
+	};
+
+	distribution.minimum = values.front();
+	distribution.median = percentile(0.5);
+	distribution.percentile95 = percentile(0.95);
+	distribution.percentile99 = percentile(0.99);
+	distribution.maximum = values.back();
+	distribution.mean = std::accumulate(values.begin(), values.end(), 0.0) / double(values.size());
+	return distribution;
+}
+
+FrameBenchmark::FrameBenchmark(Viewer* viewer) : m_viewer(viewer)
+{
+}
+
+void FrameBenchmark::start(const Settings& settings)
+{
+	m_settings = settings;
+	m_settings.frameCount = std::max(m_settings.frameCount, 1u);
+	m_running = true;
+	m_finished = false;
+	m_frame = 0;
+	m_startViewTransform = m_viewer->viewTransform();
+	m_frames.clear();
+	m_queries.clear();
+}
+
+void FrameBenchmark::cancel()
+{
+	m_running = false;
+}
+
+bool FrameBenchmark::running() const
+{
+	return m_running;
+}
+
+bool FrameBenchmark::finished() const
+{
+	return m_finished;
+}
+
+void FrameBenchmark::beginFrame()
+{
+	if (!m_running)
+		return;
+
+	// the warm-up frames orbit once, then the recorded ones, each by a fixed angle from the start
+	const bool warmup = m_frame < m_settings.warmupFrames;
+	const uint orbitFrame = warmup ? m_frame : m_frame - m_settings.warmupFrames;
+	const uint orbitFrameCount = warmup ? m_settings.warmupFrames : m_settings.frameCount;
+	const vec4 transformedAxis = inverse(m_startViewTransform) * vec4(0.0f, 1.0f, 0.0f, 0.0f);
+	m_viewer->setViewTransform(rotate(m_startViewTransform, 2.0f * pi<float>() * float(orbitFrame) / float(orbitFrameCount), vec3(transformedAxis)));
+
+	if (!warmup)
+	{
+		m_queries.push_back(Query::create());
+		m_queries.back()->counter(GL_TIMESTAMP);
+	}
+
+	m_frameStart = std::chrono::steady_clock::now();
+}
+
+void FrameBenchmark::endFrame(std::size_t drawnTriangles, std::size_t drawCalls)
+{
+	if (!m_running)
+		return;
+
+	if (m_frame >= m_settings.warmupFrames)
+	{
+		m_queries.push_back(Query::create());
+		m_queries.back()->counter(GL_TIMESTAMP);
+
+		Frame frame;
+		frame.cpuTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_frameStart).count();
+		frame.drawnTriangles = drawnTriangles;
+		frame.drawCalls = drawCalls;
+		m_frames.push_back(frame);
+	}
+
+	m_frame++;
+
+	if (m_frame >= m_settings.warmupFrames + m_settings.frameCount)
+	{
+		collectGpuTimes();
+		m_viewer->setViewTransform(m_startViewTransform);
+		m_running = false;
+		m_finished = true;
+	}
+}
+
+const std::vector<FrameBenchmark::Frame>& FrameBenchmark::frames() const
+{
+	return m_frames;
+}
+
+void FrameBenchmark::collectGpuTimes()
+{
+	for (std::size_t i = 0; i < m_frames.size(); i++)
+	{
+		const GLuint64 begin = m_queries[2 * i]->get64(GL_QUERY_RESULT);
+		const GLuint64 end = m_queries[2 * i + 1]->get64(GL_QUERY_RESULT);
+		m_frames[i].gpuTime = end > begin ? double(end - begin) * 1e-6 : 0.0;
+	}
+
+	m_queries.clear();
+}
+
+void FrameBenchmark::printSummary(std::ostream& stream) const
+{
+	const Distribution cpuTime = Distribution::of(values(m_frames, &Frame::cpuTime));
+	const Distribution gpuTime = Distribution::of(values(m_frames, &Frame::gpuTime));
+	const Distribution drawnTriangles = Distribution::of(values(m_frames, &Frame::drawnTriangles));
+	const Distribution drawCalls = Distribution::of(values(m_frames, &Frame::drawCalls));
+
+	const std::streamsize precision = stream.precision();
+	stream << std::fixed << std::setprecision(3);
+	stream << "Benchmark of " << m_frames.size() << " frames after " << m_settings.warmupFrames << " warm-up frames" << std::endl;
+	stream << "  CPU ms: min " << cpuTime.minimum << ", median " << cpuTime.median << ", p95 " << cpuTime.percentile95 << ", p99 " << cpuTime.percentile99 << ", max " << cpuTime.maximum << std::endl;
+	stream << "  GPU ms: min " << gpuTime.minimum << ", median " << gpuTime.median << ", p95 " << gpuTime.percentile95 << ", p99 " << gpuTime.percentile99 << ", max " << gpuTime.maximum << std::endl;
+	stream << std::setprecision(0);
+	stream << "  Triangles per frame: median " << drawnTriangles.median << ", draw calls per frame: median " << drawCalls.median << std::endl;
+	stream << std::defaultfloat << std::setprecision(precision);
+}
+
+bool FrameBenchmark::writeJson(const std::string& filename) const
+{
+	std::ofstream stream(filename);
+
+	if (!stream)
+		return false;
+
+	const std::vector<double> cpuTimes = values(m_frames, &Frame::cpuTime);
+	const std::vector<double> gpuTimes = values(m_frames, &Frame::gpuTime);
+	const Model& model = *m_viewer->scene()->model();
+	const ivec2 viewportSize = m_viewer->viewportSize();
+
+	// bins of 1, 2 or 5 times a power of ten milliseconds, at most 100 of them up to the slowest frame
+	const double maximumTime = std::max(Distribution::of(cpuTimes).maximum, Distribution::of(gpuTimes).maximum);
+	double binWidth = 0.01;
+
+	for (int i = 0; maximumTime / binWidth > 100.0; i++)
+		binWidth *= (i % 3 == 1) ? 2.5 : 2.0;
+
+	const std::size_t binCount = std::size_t(maximumTime / binWidth) + 1;
+
+	auto writeCounts = [&](const std::vector<std::size_t>& counts)
+	{
+		stream << "[";
+
+		for (std::size_t i = 0; i < counts.size(); i++)
+			stream << (i > 0 ? ", " : "") << counts[i];
+
+		stream << "]";
+	};
+
+	stream << "{" << std::endl;
+	stream << "  \"model\": \"" << escapeJson(model.filename()) << "\"," << std::endl;
+	stream << "  \"renderer\": \"" << escapeJson(glbinding::aux::ContextInfo::renderer()) << "\"," << std::endl;
+	stream << "  \"viewportSize\": [" << viewportSize.x << ", " << viewportSize.y << "]," << std::endl;
+	stream << "  \"loadTime\": " << model.loadingTime() << "," << std::endl;
+	stream << "  \"warmupFrames\": " << m_settings.warmupFrames << "," << std::endl;
+	stream << "  \"frameCount\": " << m_frames.size() << "," << std::endl;
+	stream << "  \"cpuTime\": ";
+	writeJsonDistribution(stream, Distribution::of(cpuTimes));
+	stream << "," << std::endl << "  \"gpuTime\": ";
+	writeJsonDistribution(stream, Distribution::of(gpuTimes));
+	stream << "," << std::endl << "  \"drawnTriangles\": ";
+	writeJsonDistribution(stream, Distribution::of(values(m_frames, &Frame::drawnTriangles)));
+	stream << "," << std::endl << "  \"drawCalls\": ";
+	writeJsonDistribution(stream, Distribution::of(values(m_frames, &Frame::drawCalls)));
+	stream << "," << std::endl;
+	stream << "  \"histogram\": { \"binWidth\": " << binWidth << ", \"cpuTime\": ";
+	writeCounts(histogram(cpuTimes, binWidth, binCount));
+	stream << ", \"gpuTime\": ";
+	writeCounts(histogram(gpuTimes, binWidth, binCount));
+	stream << " }," << std::endl;
+	stream << "  \"frames\": [" << std::endl;
+
+	for (std::size_t i = 0; i < m_frames.size(); i++)
+	{
+		const Frame& frame = m_frames[i];
+		stream << "    { \"cpuTime\": " << frame.cpuTime << ", \"gpuTime\": " << frame.gpuTime << ", \"drawnTriangles\": " << frame.drawnTriangles << ", \"drawCalls\": " << frame.drawCalls << " }" << (i + 1 < m_frames.size() ? "," : "") << std::endl;
+	}
+
+	stream << "  ]" << std::endl;
+	stream << "}" << std::endl;
+
+	return bool(stream);
+}
+
+bool FrameBenchmark::writeCsv(const std::string& filename) const
+{
+	// the header is only written into a new file, so that runs of different builds and models can be collected
+	const bool exists = std::ifstream(filename).good();
+	std::ofstream stream(filename, std::ios::app);
+
+	if (!stream)
+		return false;
+
+	if (!exists)
+	{
+		stream << "model,renderer,width,height,load_time_s,warmup_frames,frames";
+
+		for (const char* metric : { "cpu_ms", "gpu_ms", "triangles", "draw_calls" })
+		{
+			for (const char* statistic : { "min", "median", "p95", "p99", "max", "mean" })
+				stream << "," << metric << "_" << statistic;
+		}
+
+		stream << std::endl;
+	}
+
+	const Model& model = *m_viewer->scene()->model();
+	const ivec2 viewportSize = m_viewer->viewportSize();
+
+	stream << escapeCsv(model.filename()) << "," << escapeCsv(glbinding::aux::ContextInfo::renderer()) << "," << viewportSize.x << "," << viewportSize.y << ","
+		<< model.loadingTime() << "," << m_settings.warmupFrames << "," << m_frames.size();
+	writeCsvDistribution(stream, Distribution::of(values(m_frames, &Frame::cpuTime)));
+	writeCsvDistribution(stream, Distribution::of(values(m_frames, &Frame::gpuTime)));
+	writeCsvDistribution(stream, Distribution::of(values(m_frames, &Frame::drawnTriangles)));
+	writeCsvDistribution(stream, Distribution::of(values(m_frames, &Frame::drawCalls)));
+	stream << std::endl;
+
+	return bool(stream);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <globjects/Query.h>
+
+#include <chrono>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace minity
+{
+	class Viewer;
+
+	// Measures the frames of the viewer while the view orbits the model: after a number of warm-up frames, the
+	// CPU time of every frame, its GPU time from timestamp queries and what the model renderer drew are recorded.
+	// The orbit only depends on the view at the start and the frame count, so runs are comparable.
+	class FrameBenchmark
+	{
+	public:
+		struct Settings
+		{
+			glm::uint warmupFrames = 60;
+			glm::uint frameCount = 360;
+		};
+
+		struct Frame
+		{
+			// in milliseconds
+			double cpuTime = 0.0;
+			double gpuTime = 0.0;
+			std::size_t drawnTriangles = 0;
+			std::size_t drawCalls = 0;
+		};
+
+		// nearest-rank percentiles and the mean of a set of values
+		struct Distribution
+		{
+			double minimum = 0.0;
+			double median = 0.0;
+			double percentile95 = 0.0;
+			double percentile99 = 0.0;
+			double maximum = 0.0;
+			double mean = 0.0;
+
+			static Distribution of(std::vector<double> values);
+		};
+
+		FrameBenchmark(Viewer* viewer);
+
+		// starts orbiting from the current view with the next frame
+		void start(const Settings& settings);
+		void cancel();
+		bool running() const;
+		// true once all frames of the last run have been recorded, until the next start
+		bool finished() const;
+
+		// called by the viewer around everything it draws in a frame
+		void beginFrame();
+		void endFrame(std::size_t drawnTriangles, std::size_t drawCalls);
+
+		// the recorded frames, GPU times are only complete once the benchmark has finished
+		const std::vector<Frame>& frames() const;
+
+		// summary of the last finished run as text, as JSON and as a CSV line that can be appended to earlier runs
+		void printSummary(std::ostream& stream) const;
+		bool writeJson(const std::string& filename) const;
+		bool writeCsv(const std::string& filename) const;
+
+	private:
+		// waits for the timestamps of all recorded frames
+		void collectGpuTimes();
+
+		Viewer* m_viewer;
+		Settings m_settings;
+		bool m_running = false;
+		bool m_finished = false;
+		// counts the warm-up frames first
+		glm::uint m_frame = 0;
+		glm::mat4 m_startViewTransform = glm::mat4(1.0f);
+		std::chrono::steady_clock::time_point m_frameStart;
+
+		std::vector<Frame> m_frames;
+		// timestamps at the start and the end of every recorded frame
+		std::vector<std::unique_ptr<globjects::Query>> m_queries;
+	};
+}
@@ -0,0 +1,117 @@
+#include "FrustumCuller.h"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MINITY_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace minity;
+using namespace glm;
+
+std::array<vec4, 6> FrustumCuller::frustumPlanes(const mat4& matrix)
+{
+	// Gribb and Hartmann: -w <= x, y, z <= w in clip space, with the rows of the matrix
+	const vec4 row0(matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0]);
+	const vec4 row1(matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1]);
+	const vec4 row2(matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2]);
+	const vec4 row3(matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3]);
+
+	return { row3 + row0, row3 - row0, row3 + row1, row3 - row1, row3 + row2, row3 - row2 };
+}
+
+void FrustumCuller::clear()
+{
+	m_centerX.clear();
+	m_centerY.clear();
+	m_centerZ.clear();
+	m_extentX.clear();
+	m_extentY.clear();
+	m_extentZ.clear();
+}
+
+std::size_t FrustumCuller::addBox(vec3 minimumBounds, vec3 maximumBounds)
+{
+	const vec3 center = 0.5f * (minimumBounds + maximumBounds);
+	const vec3 extent = 0.5f * (maximumBounds - minimumBounds);
+
+	m_centerX.push_back(center.x);
+	m_centerY.push_back(center.y);
+	m_centerZ.push_back(center.z);
+	m_extentX.push_back(extent.x);
+	m_extentY.push_back(extent.y);
+	m_extentZ.push_back(extent.z);
+
+	return m_centerX.size() - 1;
+}
+
+std::size_t FrustumCuller::boxCount() const
+{
+	return m_centerX.size();
+}
+
+void FrustumCuller::cull(const std::array<vec4, 6>& planes, std::vector<unsigned char>& visible) const
+{
+	// A box is outside of a plane if even its corner farthest along the normal is behind it, that is if the
+	// distance of its center is less than -dot(abs(normal), extent). Boxes outside of any plane are culled.
+	const std::size_t count = boxCount();
+	visible.assign(count, 1);
+
+	std::size_t i = 0;
+
+#ifdef MINITY_SSE2
+	__m128 normalX[6], normalY[6], normalZ[6], distance[6];
+	__m128 absoluteX[6], absoluteY[6], absoluteZ[6];
+
+	for (int p = 0; p < 6; p++)
+	{
+		normalX[p] = _mm_set1_ps(planes[p].x);
+		normalY[p] = _mm_set1_ps(planes[p].y);
+		normalZ[p] = _mm_set1_ps(planes[p].z);
+		distance[p] = _mm_set1_ps(planes[p].w);
+		absoluteX[p] = _mm_set1_ps(std::abs(planes[p].x));
+		absoluteY[p] = _mm_set1_ps(std::abs(planes[p].y));
+		absoluteZ[p] = _mm_set1_ps(std::abs(planes[p].z));
+	}
+
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 centerX = _mm_loadu_ps(&m_centerX[i]);
+		const __m128 centerY = _mm_loadu_ps(&m_centerY[i]);
+		const __m128 centerZ = _mm_loadu_ps(&m_centerZ[i]);
+		const __m128 extentX = _mm_loadu_ps(&m_extentX[i]);
+		const __m128 extentY = _mm_loadu_ps(&m_extentY[i]);
+		const __m128 extentZ = _mm_loadu_ps(&m_extentZ[i]);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		for (int p = 0; p < 6; p++)
+		{
+			const __m128 centerDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX[p], centerX), _mm_mul_ps(normalY[p], centerY)), _mm_add_ps(_mm_mul_ps(normalZ[p], centerZ), distance[p]));
+			const __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absoluteX[p], extentX), _mm_mul_ps(absoluteY[p], extentY)), _mm_mul_ps(absoluteZ[p], extentZ));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(centerDistance, radius), _mm_setzero_ps()));
+		}
+
+		const int mask = _mm_movemask_ps(inside);
+
+		for (int k = 0; k < 4; k++)
+			visible[i + k] = (mask >> k) & 1;
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		for (const auto& p : planes)
+		{
+			const float centerDistance = p.x * m_centerX[i] + p.y * m_centerY[i] + p.z * m_centerZ[i] + p.w;
+			const float radius = std::abs(p.x) * m_extentX[i] + std::abs(p.y) * m_extentY[i] + std::abs(p.z) * m_extentZ[i];
+
+			if (centerDistance + radius < 0.0f)
+			{
+				visible[i] = 0;
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace minity
+{
+	// Conservative view frustum test of axis-aligned boxes. The boxes are kept in a structure-of-arrays layout,
+	// so that every plane is tested against four of them at once.
+	class FrustumCuller
+	{
+	public:
+		// planes of the view frustum of a (model view) projection matrix, in the space the matrix transforms from,
+		// as (normal, distance) with the normals facing inwards
+		static std::array<glm::vec4, 6> frustumPlanes(const glm::mat4& matrix);
+
+		void clear();
+		// adds a box and returns its index
+		std::size_t addBox(glm::vec3 minimumBounds, glm::vec3 maximumBounds);
+		std::size_t boxCount() const;
+
+		// sets visible[i] to 1 for every box that may intersect the frustum and to 0 for all others
+		void cull(const std::array<glm::vec4, 6>& planes, std::vector<unsigned char>& visible) const;
+
+	private:
+		// centers and half extents of the boxes
+		std::vector<float> m_centerX;
+		std::vector<float> m_centerY;
+		std::vector<float> m_centerZ;
+		std::vector<float> m_extentX;
+		std::vector<float> m_extentY;
+		std::vector<float> m_extentZ;
+	};
+}
@@ -0,0 +1,137 @@
+#include "GpuBvh.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace minity;
+using namespace glm;
+
+static_assert(sizeof(GpuBvhNode) == 32, "nodes have to match the std430 layout of the shader");
+static_assert(sizeof(GpuBvhTriangle) == 48, "triangles have to match the std430 layout of the shader");
+static_assert(sizeof(GpuBvhMaterial) == 48, "materials have to match the std430 layout of the shader");
+
+bool GpuBvhData::build(const std::vector<Vertex>& vertices, const std::vector<uint>& indices, const std::vector<Group>& groups, const std::vector<Material>& modelMaterials)
+{
+	clear();
+
+	const std::vector<uint> groupTriangles = Bvh::groupTriangles(groups);
+
+	if (groupTriangles.size() >= maximumTriangleCount)
+		return false;
+
+	for (const auto& material : modelMaterials)
+	{
+		GpuBvhMaterial gpuMaterial;
+		gpuMaterial.ambient = vec4(material.ambient, 1.0f);
+		gpuMaterial.diffuse = vec4(material.diffuse, 1.0f);
+		gpuMaterial.specular = vec4(material.specular, material.shininess);
+		materials.push_back(gpuMaterial);
+	}
+
+	// the same default as the CPU ray tracer
+	GpuBvhMaterial defaultMaterial;
+	defaultMaterial.diffuse = vec4(vec3(0.8f), 1.0f);
+	materials.push_back(defaultMaterial);
+
+	std::vector<uint> triangleMaterials(indices.size() / 3, uint(materials.size() - 1));
+
+	for (const auto& group : groups)
+	{
+		const uint material = std::min(group.materialIndex, uint(materials.size() - 1));
+
+		for (uint i = group.startIndex; i + 3 <= group.endIndex; i += 3)
+			triangleMaterials[i / 3] = material;
+	}
+
+	Bvh bvh;
+	bvh.build(vertices, indices, groupTriangles);
+	nodes = flatten(bvh);
+
+	const std::vector<vec3>& positions = bvh.positions();
+	const std::vector<uint>& leafTriangles = bvh.triangles();
+	triangles.resize(leafTriangles.size());
+	normals.resize(3 * leafTriangles.size());
+
+	for (std::size_t i = 0; i < leafTriangles.size(); i++)
+	{
+		float material;
+		const uint materialIndex = triangleMaterials[leafTriangles[i]];
+		std::memcpy(&material, &materialIndex, sizeof(material));
+
+		triangles[i].vertex = vec4(positions[3 * i], material);
+		triangles[i].edge1 = vec4(positions[3 * i + 1] - positions[3 * i], 0.0f);
+		triangles[i].edge2 = vec4(positions[3 * i + 2] - positions[3 * i], 0.0f);
+
+		for (std::size_t j = 0; j < 3; j++)
+			normals[3 * i + j] = vec4(vertices[indices[3 * std::size_t(leafTriangles[i]) + j]].normal, 0.0f);
+	}
+
+	return true;
+}
+
+void GpuBvhData::clear()
+{
+	nodes.clear();
+	triangles.clear();
+	normals.clear();
+	materials.clear();
+}
+
+std::vector<GpuBvhNode> GpuBvhData::flatten(const Bvh& bvh)
+{
+	const std::vector<BvhNode>& binaryNodes = bvh.nodes();
+	std::vector<GpuBvhNode> nodes;
+
+	if (binaryNodes.empty())
+		return nodes;
+
+	// depth-first order, with the index of every binary node in it
+	std::vector<uint> order;
+	std::vector<uint> flatIndices(binaryNodes.size());
+	std::vector<uint> stack = { 0 };
+	order.reserve(binaryNodes.size());
+
+	while (!stack.empty())
+	{
+		const uint binaryIndex = stack.back();
+		stack.pop_back();
+
+		flatIndices[binaryIndex] = uint(order.size());
+		order.push_back(binaryIndex);
+
+		const BvhNode& node = binaryNodes[binaryIndex];
+
+		if (!node.isLeaf())
+		{
+			stack.push_back(node.firstIndex + 1);
+			stack.push_back(node.firstIndex);
+		}
+	}
+
+	nodes.resize(order.size());
+
+	// the root continues past the end, a first child at its sibling and a second child where its parent does
+	nodes[0].missIndex = uint(order.size());
+
+	for (std::size_t i = 0; i < order.size(); i++)
+	{
+		const BvhNode& node = binaryNodes[order[i]];
+		GpuBvhNode& flatNode = nodes[i];
+		flatNode.minimumBounds = node.minimumBounds;
+		flatNode.maximumBounds = node.maximumBounds;
+
+		if (node.isLeaf())
+		{
+			flatNode.triangles = node.firstIndex << 4 | node.triangleCount;
+		}
+		else
+		{
+			const uint first = flatIndices[node.firstIndex];
+			const uint second = flatIndices[node.firstIndex + 1];
+			nodes[first].missIndex = second;
+			nodes[second].missIndex = flatNode.missIndex;
+		}
+	}
+
+	return nodes;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Bvh.h"
+#include "Model.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace minity
+{
+	// Node of the hierarchy as raytrace-fs.glsl reads it (std430, 32 bytes). Nodes are stored in depth-first
+	// order, so the first child of an inner node follows it directly. A ray that misses a node or has tested
+	// a leaf continues at missIndex, which makes the traversal stackless.
+	struct GpuBvhNode
+	{
+		glm::vec3 minimumBounds = glm::vec3(0.0f);
+		glm::uint missIndex = 0;
+		glm::vec3 maximumBounds = glm::vec3(0.0f);
+		// first triangle << 4 | triangle count for leaves, 0 for inner nodes
+		glm::uint triangles = 0;
+	};
+
+	// first vertex and the two edges from it, the w component of the vertex holds the bits of the material index
+	struct GpuBvhTriangle
+	{
+		glm::vec4 vertex = glm::vec4(0.0f);
+		glm::vec4 edge1 = glm::vec4(0.0f);
+		glm::vec4 edge2 = glm::vec4(0.0f);
+	};
+
+	// colors of a material, the w component of the specular color is the shininess
+	struct GpuBvhMaterial
+	{
+		glm::vec4 ambient = glm::vec4(0.0f);
+		glm::vec4 diffuse = glm::vec4(0.0f);
+		glm::vec4 specular = glm::vec4(0.0f);
+	};
+
+	// The full resolution triangles of a model with a hierarchy over them, in the layout of the shader storage
+	// buffers of raytrace-fs.glsl. Building it needs no GL context, so it can be done on a worker thread.
+	struct GpuBvhData
+	{
+		// leaves refer to triangles by 28 bits
+		static const std::size_t maximumTriangleCount = std::size_t(1) << 28;
+
+		std::vector<GpuBvhNode> nodes;
+		std::vector<GpuBvhTriangle> triangles;
+		// three vertex normals per triangle
+		std::vector<glm::vec4> normals;
+		// the materials of the model followed by a default one for groups without a valid material
+		std::vector<GpuBvhMaterial> materials;
+
+		// returns false and leaves the data empty if the model has too many triangles
+		bool build(const std::vector<Vertex>& vertices, const std::vector<glm::uint>& indices, const std::vector<Group>& groups, const std::vector<Material>& modelMaterials);
+		void clear();
+
+		// reorders the nodes of a hierarchy depth-first and links them for stackless traversal
+		static std::vector<GpuBvhNode> flatten(const Bvh& bvh);
+	};
+}
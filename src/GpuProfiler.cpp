@@ -0,0 +1,179 @@
+#include "GpuProfiler.h"
+
+#include <glbinding/gl/enum.h>
+#include <glbinding/gl/functions.h>
+#include <globjects/globjects.h>
+
+#include <algorithm>
+
+using namespace minity;
+using namespace gl;
+using namespace globjects;
+
+namespace
+{
+	// in the order of the members of PipelineStatistics
+	const std::array<GLenum, 6> statisticsTargets = {
+		GL_VERTICES_SUBMITTED_ARB,
+		GL_PRIMITIVES_SUBMITTED_ARB,
+		GL_VERTEX_SHADER_INVOCATIONS_ARB,
+		GL_CLIPPING_INPUT_PRIMITIVES_ARB,
+		GL_CLIPPING_OUTPUT_PRIMITIVES_ARB,
+		GL_FRAGMENT_SHADER_INVOCATIONS_ARB
+	};
+
+	// weight of the latest time in the average
+	const double averageWeight = 0.05;
+
+	bool debugGroupsSupported()
+	{
+		static const bool supported = globjects::hasExtension(GLextension::GL_KHR_debug);
+		return supported;
+	}
+}
+
+bool GpuProfiler::pipelineStatisticsSupported()
+{
+	static const bool supported = globjects::hasExtension(GLextension::GL_ARB_pipeline_statistics_query);
+	return supported;
+}
+
+bool GpuProfiler::isEnabled() const
+{
+	return m_enabled;
+}
+
+void GpuProfiler::setEnabled(bool enabled)
+{
+	m_enabled = enabled;
+}
+
+bool GpuProfiler::pipelineStatisticsEnabled() const
+{
+	return m_pipelineStatisticsEnabled;
+}
+
+void GpuProfiler::setPipelineStatisticsEnabled(bool enabled)
+{
+	m_pipelineStatisticsEnabled = enabled && pipelineStatisticsSupported();
+}
+
+void GpuProfiler::beginPass(const std::string& name)
+{
+	if (debugGroupsSupported())
+		glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name.c_str());
+
+	if (!m_enabled)
+		return;
+
+	std::vector<PassQueries>& frameQueries = m_frameQueries[m_frame % frameLatency];
+
+	if (m_passCount == frameQueries.size())
+		frameQueries.emplace_back();
+
+	PassQueries& queries = frameQueries[m_passCount++];
+	queries.name = name;
+	queries.pending = true;
+	queries.statistics = m_pipelineStatisticsEnabled;
+
+	if (!queries.timer)
+		queries.timer = Query::create();
+
+	queries.timer->begin(GL_TIME_ELAPSED);
+
+	if (queries.statistics)
+	{
+		for (std::size_t i = 0; i < statisticsTargets.size(); i++)
+		{
+			if (!queries.statisticsQueries[i])
+				queries.statisticsQueries[i] = Query::create();
+
+			queries.statisticsQueries[i]->begin(statisticsTargets[i]);
+		}
+	}
+
+	m_currentPass = &queries;
+}
+
+void GpuProfiler::endPass()
+{
+	if (m_currentPass)
+	{
+		m_currentPass->timer->end(GL_TIME_ELAPSED);
+
+		if (m_currentPass->statistics)
+		{
+			for (std::size_t i = 0; i < statisticsTargets.size(); i++)
+				m_currentPass->statisticsQueries[i]->end(statisticsTargets[i]);
+		}
+
+		m_currentPass = nullptr;
+	}
+
+	if (debugGroupsSupported())
+		glPopDebugGroup();
+}
+
+void GpuProfiler::endFrame()
+{
+	m_frame++;
+	m_passCount = 0;
+
+	// the slot of the next frame holds the oldest frame in flight
+	for (PassQueries& queries : m_frameQueries[m_frame % frameLatency])
+	{
+		if (queries.pending)
+			readBack(queries);
+
+		queries.pending = false;
+	}
+}
+
+const std::vector<GpuProfiler::Pass>& GpuProfiler::passes() const
+{
+	return m_passes;
+}
+
+void GpuProfiler::readBack(PassQueries& queries)
+{
+	if (!queries.timer->resultAvailable())
+		return;
+
+	if (queries.statistics)
+	{
+		for (const auto& query : queries.statisticsQueries)
+		{
+			if (!query->resultAvailable())
+				return;
+		}
+	}
+
+	auto pass = std::find_if(m_passes.begin(), m_passes.end(), [&](const Pass& pass) { return pass.name == queries.name; });
+
+	if (pass == m_passes.end())
+	{
+		m_passes.emplace_back();
+		pass = m_passes.end() - 1;
+		pass->name = queries.name;
+		pass->averageGpuTime = double(queries.timer->get64(GL_QUERY_RESULT)) * 1e-6;
+	}
+
+	pass->gpuTime = double(queries.timer->get64(GL_QUERY_RESULT)) * 1e-6;
+	pass->averageGpuTime += averageWeight * (pass->gpuTime - pass->averageGpuTime);
+	pass->statisticsValid = queries.statistics;
+
+	if (queries.statistics)
+	{
+		GLuint64* counters[] = {
+			&pass->statistics.verticesSubmitted,
+			&pass->statistics.primitivesSubmitted,
+			&pass->statistics.vertexShaderInvocations,
+			&pass->statistics.clippingInputPrimitives,
+			&pass->statistics.clippingOutputPrimitives,
+			&pass->statistics.fragmentShaderInvocations
+		};
+
+		for (std::size_t i = 0; i < statisticsTargets.size(); i++)
+			*counters[i] = queries.statisticsQueries[i]->get64(GL_QUERY_RESULT);
+	}
+}
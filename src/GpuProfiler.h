@@ -0,0 +1,82 @@
+#pragma once
+
+#include <glbinding/gl/gl.h>
+#include <globjects/Query.h>
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace minity
+{
+	// counters of the pipeline statistics queries of a pass, see GL_ARB_pipeline_statistics_query
+	struct PipelineStatistics
+	{
+		gl::GLuint64 verticesSubmitted = 0;
+		gl::GLuint64 primitivesSubmitted = 0;
+		gl::GLuint64 vertexShaderInvocations = 0;
+		gl::GLuint64 clippingInputPrimitives = 0;
+		gl::GLuint64 clippingOutputPrimitives = 0;
+		gl::GLuint64 fragmentShaderInvocations = 0;
+	};
+
+	// Measures the GPU time of the passes of a frame, such as the renderers of the viewer, and optionally their
+	// pipeline statistics. Every pass is also a debug group for external profilers. The queries of a frame are
+	// read back frameLatency - 1 frames later, only if their results are available, so nothing ever waits for
+	// the GPU; results that are not ready by then are dropped. Passes must not be nested.
+	class GpuProfiler
+	{
+	public:
+		static const std::size_t frameLatency = 3;
+
+		struct Pass
+		{
+			std::string name;
+			// in milliseconds, of the last frame read back and averaged exponentially over the recent ones
+			double gpuTime = 0.0;
+			double averageGpuTime = 0.0;
+			// only valid if the statistics were enabled when the pass was measured
+			bool statisticsValid = false;
+			PipelineStatistics statistics;
+		};
+
+		static bool pipelineStatisticsSupported();
+
+		bool isEnabled() const;
+		void setEnabled(bool enabled);
+		bool pipelineStatisticsEnabled() const;
+		// ignored if the statistics are not supported
+		void setPipelineStatisticsEnabled(bool enabled);
+
+		void beginPass(const std::string& name);
+		void endPass();
+		// reads back the oldest frame still in flight, call once after all passes of a frame
+		void endFrame();
+
+		// in the order the passes were first measured
+		const std::vector<Pass>& passes() const;
+
+	private:
+		struct PassQueries
+		{
+			std::string name;
+			bool pending = false;
+			bool statistics = false;
+			std::unique_ptr<globjects::Query> timer;
+			std::array<std::unique_ptr<globjects::Query>, 6> statisticsQueries;
+		};
+
+		void readBack(PassQueries& queries);
+
+		bool m_enabled = true;
+		bool m_pipelineStatisticsEnabled = false;
+		std::size_t m_frame = 0;
+		// the queries of the passes of the frames in flight, reused once they have been read back
+		std::array<std::vector<PassQueries>, frameLatency> m_frameQueries;
+		std::size_t m_passCount = 0;
+		PassQueries* m_currentPass = nullptr;
+
+		std::vector<Pass> m_passes;
+	};
+}
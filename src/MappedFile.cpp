@@ -0,0 +1,161 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace minity;
+
+MappedFile::MappedFile()
+{
+
+}
+
+MappedFile::MappedFile(const std::string& filename)
+{
+	open(filename);
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string& filename)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	m_file = file;
+	m_size = std::size_t(fileSize.QuadPart);
+	m_open = true;
+
+	if (m_size == 0)
+		return true;
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+	if (mapping == NULL)
+	{
+		close();
+		return false;
+	}
+
+	m_mapping = mapping;
+	m_data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+	if (m_data == nullptr)
+	{
+		close();
+		return false;
+	}
+#else
+	int file = ::open(filename.c_str(), O_RDONLY);
+
+	if (file < 0)
+		return false;
+
+	struct stat fileStat;
+
+	if (fstat(file, &fileStat) != 0 || !S_ISREG(fileStat.st_mode))
+	{
+		::close(file);
+		return false;
+	}
+
+	m_file = file;
+	m_size = std::size_t(fileStat.st_size);
+	m_open = true;
+
+	if (m_size == 0)
+		return true;
+
+	void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+	if (data == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+
+	// the loaders read the mapping front to back exactly once
+	madvise(data, m_size, MADV_SEQUENTIAL);
+	m_data = static_cast<const char*>(data);
+#endif
+
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (m_data)
+		UnmapViewOfFile(m_data);
+
+	if (m_mapping)
+		CloseHandle(m_mapping);
+
+	if (m_file)
+		CloseHandle(m_file);
+
+	m_mapping = nullptr;
+	m_file = nullptr;
+#else
+	if (m_data)
+		munmap(const_cast<char*>(m_data), m_size);
+
+	if (m_file >= 0)
+		::close(m_file);
+
+	m_file = -1;
+#endif
+
+	m_data = nullptr;
+	m_size = 0;
+	m_open = false;
+}
+
+bool MappedFile::isOpen() const
+{
+	return m_open;
+}
+
+const char* MappedFile::data() const
+{
+	return m_data;
+}
+
+std::size_t MappedFile::size() const
+{
+	return m_size;
+}
+
+const char* MappedFile::begin() const
+{
+	return m_data;
+}
+
+const char* MappedFile::end() const
+{
+	return m_data + m_size;
+}
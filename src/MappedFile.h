@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace minity
+{
+	// Read-only memory mapping of a whole file. The contents stay valid until the
+	// object is closed or destroyed; an empty file opens successfully with size() == 0.
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		MappedFile(const std::string& filename);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool open(const std::string& filename);
+		void close();
+
+		bool isOpen() const;
+		const char* data() const;
+		std::size_t size() const;
+
+		const char* begin() const;
+		const char* end() const;
+
+	private:
+		const char* m_data = nullptr;
+		std::size_t m_size = 0;
+		bool m_open = false;
+
+#ifdef _WIN32
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#else
+		int m_file = -1;
+#endif
+	};
+}
@@ -0,0 +1,682 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace minity;
+using namespace glm;
+
+const std::size_t MeshOptimizer::vertexCacheSize = 16;
+const std::size_t MeshOptimizer::maxMeshletVertices = 64;
+const std::size_t MeshOptimizer::maxMeshletTriangles = 124;
+
+namespace
+{
+	// parameters of the vertex scores, as proposed by Forsyth
+	const int scoringCacheSize = 32;
+	const float lastTriangleScore = 0.75f;
+	const float cacheDecayPower = 1.5f;
+	const float valenceBoostScale = 2.0f;
+	const float valenceBoostPower = 0.5f;
+
+	float vertexScore(int cachePosition, uint remainingTriangles)
+	{
+		// vertices without remaining triangles never need to be considered again
+		if (remainingTriangles == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+
+		if (cachePosition >= 0)
+		{
+			// the vertices of the last triangle get a fixed score, so that the next triangle does not just reuse them
+			if (cachePosition < 3)
+			{
+				score = lastTriangleScore;
+			}
+			else
+			{
+				const float scaler = 1.0f / float(scoringCacheSize - 3);
+				score = std::pow(1.0f - float(cachePosition - 3) * scaler, cacheDecayPower);
+			}
+		}
+
+		// vertices with few remaining triangles are preferred, so that no lone triangles are left behind
+		score += valenceBoostScale * std::pow(float(remainingTriangles), -valenceBoostPower);
+		return score;
+	}
+
+	// Simulates a FIFO cache access of the vertices of a triangle and returns the number of misses. A vertex is
+	// in the cache if fewer than cacheSize misses happened since it was loaded.
+	std::size_t cacheMisses(const uint* triangle, std::vector<std::size_t>& loadTimes, std::size_t& misses)
+	{
+		std::size_t triangleMisses = 0;
+
+		for (int c = 0; c < 3; c++)
+		{
+			const uint v = triangle[c];
+
+			if (loadTimes[v] == 0 || misses - loadTimes[v] + 1 > MeshOptimizer::vertexCacheSize)
+			{
+				misses++;
+				loadTimes[v] = misses;
+				triangleMisses++;
+			}
+		}
+
+		return triangleMisses;
+	}
+}
+
+std::size_t MeshOptimizer::vertexCacheMisses(const std::vector<uint>& indices, std::size_t vertexCount, std::size_t cacheSize)
+{
+	// a vertex is in the FIFO cache if fewer than cacheSize misses happened since it was loaded
+	std::vector<std::size_t> loadTimes(vertexCount, 0);
+	std::size_t misses = 0;
+
+	for (auto i : indices)
+	{
+		if (loadTimes[i] == 0 || misses - loadTimes[i] + 1 > cacheSize)
+		{
+			misses++;
+			loadTimes[i] = misses;
+		}
+	}
+
+	return misses;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<uint>& indices, std::size_t vertexCount)
+{
+	const std::size_t triangleCount = indices.size() / 3;
+
+	if (triangleCount < 2)
+		return;
+
+	// triangles adjacent to every vertex
+	std::vector<uint> adjacencyOffsets(vertexCount + 1, 0);
+
+	for (std::size_t i = 0; i < triangleCount * 3; i++)
+		adjacencyOffsets[indices[i] + 1]++;
+
+	for (std::size_t v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+	std::vector<uint> adjacency(triangleCount * 3);
+	std::vector<uint> remainingTriangles(vertexCount);
+	{
+		std::vector<uint> next(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+		for (std::size_t i = 0; i < triangleCount * 3; i++)
+			adjacency[next[indices[i]]++] = uint(i / 3);
+
+		for (std::size_t v = 0; v < vertexCount; v++)
+			remainingTriangles[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+	}
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+
+	for (std::size_t v = 0; v < vertexCount; v++)
+		vertexScores[v] = vertexScore(-1, remainingTriangles[v]);
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+
+	for (std::size_t t = 0; t < triangleCount; t++)
+		triangleScores[t] = vertexScores[indices[3 * t]] + vertexScores[indices[3 * t + 1]] + vertexScores[indices[3 * t + 2]];
+
+	std::vector<uint> result;
+	result.reserve(triangleCount * 3);
+
+	// the simulated LRU cache, with room for the three vertices pushed in front of it
+	std::vector<uint> cache;
+	std::vector<uint> nextCache;
+	cache.reserve(scoringCacheSize + 3);
+	nextCache.reserve(scoringCacheSize + 3);
+
+	std::size_t nextUnemitted = 0;
+	std::size_t bestTriangle = 0;
+
+	// start with the best triangle overall
+	for (std::size_t t = 1; t < triangleCount; t++)
+	{
+		if (triangleScores[t] > triangleScores[bestTriangle])
+			bestTriangle = t;
+	}
+
+	while (result.size() < triangleCount * 3)
+	{
+		emitted[bestTriangle] = true;
+
+		const uint* triangle = &indices[3 * bestTriangle];
+		result.insert(result.end(), triangle, triangle + 3);
+
+		// move the triangle's vertices to the front of the cache
+		nextCache.assign(triangle, triangle + 3);
+
+		for (auto v : cache)
+		{
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				nextCache.push_back(v);
+		}
+
+		for (int c = 0; c < 3; c++)
+		{
+			const uint v = triangle[c];
+			uint* begin = &adjacency[adjacencyOffsets[v]];
+			uint* end = begin + remainingTriangles[v];
+
+			// remove the triangle from the vertex's remaining triangles
+			std::iter_swap(std::find(begin, end, uint(bestTriangle)), end - 1);
+			remainingTriangles[v]--;
+		}
+
+		// vertices falling out of the cache lose their cache score
+		for (std::size_t i = scoringCacheSize; i < nextCache.size(); i++)
+		{
+			cachePositions[nextCache[i]] = -1;
+			vertexScores[nextCache[i]] = vertexScore(-1, remainingTriangles[nextCache[i]]);
+		}
+
+		if (nextCache.size() > std::size_t(scoringCacheSize))
+			nextCache.resize(scoringCacheSize);
+
+		cache.swap(nextCache);
+
+		for (std::size_t i = 0; i < cache.size(); i++)
+		{
+			cachePositions[cache[i]] = int(i);
+			vertexScores[cache[i]] = vertexScore(int(i), remainingTriangles[cache[i]]);
+		}
+
+		// only triangles of cached vertices change their score, the next triangle is the best of them
+		float bestScore = -1.0f;
+
+		for (auto v : cache)
+		{
+			for (uint i = adjacencyOffsets[v]; i < adjacencyOffsets[v] + remainingTriangles[v]; i++)
+			{
+				const uint t = adjacency[i];
+				const float score = vertexScores[indices[3 * t]] + vertexScores[indices[3 * t + 1]] + vertexScores[indices[3 * t + 2]];
+				triangleScores[t] = score;
+
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = t;
+				}
+			}
+		}
+
+		// if no cached vertex has triangles left, continue with the next triangle in input order
+		if (bestScore < 0.0f)
+		{
+			while (nextUnemitted < triangleCount && emitted[nextUnemitted])
+				nextUnemitted++;
+
+			bestTriangle = nextUnemitted;
+		}
+	}
+
+	std::copy(result.begin(), result.end(), indices.begin());
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<uint>& indices, const std::vector<vec3>& positions, float threshold)
+{
+	const std::size_t triangleCount = indices.size() / 3;
+
+	if (triangleCount < 2)
+		return;
+
+	// Hard boundaries are where all three vertices of a triangle miss the cache, as the cache contents are
+	// unrelated there anyway.
+	std::vector<std::size_t> hardStarts;
+	{
+		std::vector<std::size_t> loadTimes(positions.size(), 0);
+		std::size_t misses = 0;
+
+		for (std::size_t t = 0; t < triangleCount; t++)
+		{
+			if (cacheMisses(&indices[3 * t], loadTimes, misses) == 3 || t == 0)
+				hardStarts.push_back(t);
+		}
+
+		hardStarts.push_back(triangleCount);
+	}
+
+	// Every hard cluster is split further where the cache miss ratio of the part so far, starting with an
+	// empty cache, is within the threshold factor of the ratio of the whole hard cluster.
+	std::vector<std::size_t> clusterStarts;
+	{
+		std::vector<std::size_t> loadTimes(positions.size(), 0);
+		std::size_t misses = 0;
+
+		for (std::size_t h = 0; h + 1 < hardStarts.size(); h++)
+		{
+			const std::size_t start = hardStarts[h];
+			const std::size_t end = hardStarts[h + 1];
+
+			// advancing the miss counter past the cache size empties the cache
+			misses += vertexCacheSize;
+			std::size_t hardMisses = 0;
+
+			for (std::size_t t = start; t < end; t++)
+				hardMisses += cacheMisses(&indices[3 * t], loadTimes, misses);
+
+			const float clusterThreshold = threshold * float(hardMisses) / float(end - start);
+
+			misses += vertexCacheSize;
+			std::size_t clusterMisses = 0;
+			std::size_t clusterStart = start;
+			clusterStarts.push_back(start);
+
+			for (std::size_t t = start; t < end; t++)
+			{
+				clusterMisses += cacheMisses(&indices[3 * t], loadTimes, misses);
+
+				if (t + 1 < end && float(clusterMisses) <= clusterThreshold * float(t + 1 - clusterStart))
+				{
+					clusterStarts.push_back(t + 1);
+					clusterStart = t + 1;
+					clusterMisses = 0;
+					misses += vertexCacheSize;
+				}
+			}
+		}
+	}
+
+	if (clusterStarts.size() < 2)
+		return;
+
+	clusterStarts.push_back(triangleCount);
+
+	const std::size_t clusterCount = clusterStarts.size() - 1;
+
+	// area weighted centroid and normal of every cluster and of the whole list
+	std::vector<vec3> clusterCentroids(clusterCount, vec3(0.0f));
+	std::vector<vec3> clusterNormals(clusterCount, vec3(0.0f));
+	vec3 centroid(0.0f);
+	float area = 0.0f;
+
+	for (std::size_t i = 0; i < clusterCount; i++)
+	{
+		float clusterArea = 0.0f;
+
+		for (std::size_t t = clusterStarts[i]; t < clusterStarts[i + 1]; t++)
+		{
+			const vec3& p0 = positions[indices[3 * t]];
+			const vec3& p1 = positions[indices[3 * t + 1]];
+			const vec3& p2 = positions[indices[3 * t + 2]];
+
+			const vec3 normal = cross(p1 - p0, p2 - p0);
+			const float triangleArea = length(normal);
+
+			clusterCentroids[i] += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			clusterNormals[i] += normal;
+			clusterArea += triangleArea;
+		}
+
+		centroid += clusterCentroids[i];
+		area += clusterArea;
+
+		if (clusterArea > 0.0f)
+			clusterCentroids[i] /= clusterArea;
+	}
+
+	if (area > 0.0f)
+		centroid /= area;
+
+	std::vector<float> sortKeys(clusterCount, 0.0f);
+
+	for (std::size_t i = 0; i < clusterCount; i++)
+	{
+		const float normalLength = length(clusterNormals[i]);
+
+		if (normalLength > 0.0f)
+			sortKeys[i] = dot(clusterCentroids[i] - centroid, clusterNormals[i] / normalLength);
+	}
+
+	std::vector<std::size_t> order(clusterCount);
+
+	for (std::size_t i = 0; i < clusterCount; i++)
+		order[i] = i;
+
+	std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint> result;
+	result.reserve(triangleCount * 3);
+
+	for (auto i : order)
+		result.insert(result.end(), indices.begin() + 3 * clusterStarts[i], indices.begin() + 3 * clusterStarts[i + 1]);
+
+	std::copy(result.begin(), result.end(), indices.begin());
+}
+
+void MeshOptimizer::buildMeshlets(std::vector<uint>& indices, const std::vector<vec3>& positions, std::vector<Meshlet>& meshlets)
+{
+	const std::size_t triangleCount = indices.size() / 3;
+
+	if (indices.empty())
+		return;
+
+	// Triangles are connected through shared positions rather than shared vertices, so that meshlets can grow
+	// across creases and texture seams. Vertices with equal positions get the same position index.
+	std::vector<uint> positionIndices(positions.size());
+	uint positionCount = 0;
+	{
+		std::vector<uint> order(positions.size());
+
+		for (std::size_t v = 0; v < positions.size(); v++)
+			order[v] = uint(v);
+
+		auto less = [&](uint a, uint b)
+		{
+			const vec3& p = positions[a];
+			const vec3& q = positions[b];
+			return p.x < q.x || (p.x == q.x && (p.y < q.y || (p.y == q.y && p.z < q.z)));
+		};
+
+		std::sort(order.begin(), order.end(), less);
+
+		for (std::size_t i = 0; i < order.size(); i++)
+		{
+			if (i > 0 && less(order[i - 1], order[i]))
+				positionCount++;
+
+			positionIndices[order[i]] = positionCount;
+		}
+
+		positionCount++;
+	}
+
+	// triangles adjacent to every position
+	std::vector<uint> adjacencyOffsets(positionCount + 1, 0);
+
+	for (std::size_t i = 0; i < triangleCount * 3; i++)
+		adjacencyOffsets[positionIndices[indices[i]] + 1]++;
+
+	for (std::size_t p = 0; p < positionCount; p++)
+		adjacencyOffsets[p + 1] += adjacencyOffsets[p];
+
+	std::vector<uint> adjacency(triangleCount * 3);
+	{
+		std::vector<uint> next(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+		for (std::size_t i = 0; i < triangleCount * 3; i++)
+			adjacency[next[positionIndices[indices[i]]]++] = uint(i / 3);
+	}
+
+	std::vector<bool> assigned(triangleCount, false);
+	// vertices and positions marked with the stamp of the current meshlet are already part of it, and triangles
+	// marked with it are among its candidates
+	std::vector<uint> stamps(positions.size(), 0);
+	std::vector<uint> positionStamps(positionCount, 0);
+	std::vector<uint> candidateStamps(triangleCount, 0);
+	uint stamp = 0;
+
+	std::vector<uint> result;
+	result.reserve(indices.size());
+	std::vector<uint> meshletTriangles;
+	std::vector<uint> candidates;
+	std::size_t nextSeed = 0;
+
+	auto newVertexCount = [&](uint t)
+	{
+		const uint* triangle = &indices[3 * t];
+		std::size_t count = 0;
+
+		for (int c = 0; c < 3; c++)
+		{
+			if (stamps[triangle[c]] != stamp && (c == 0 || triangle[c] != triangle[0]) && (c < 2 || triangle[2] != triangle[1]))
+				count++;
+		}
+
+		return count;
+	};
+
+	while (true)
+	{
+		while (nextSeed < triangleCount && assigned[nextSeed])
+			nextSeed++;
+
+		if (nextSeed == triangleCount)
+			break;
+
+		// Meshlets grow from the first unassigned triangle in the current order, so that they follow the order
+		// of the list. Each step adds the adjacent triangle that brings the fewest new vertices, and among those
+		// the one closest to the center of the meshlet's vertices.
+		Meshlet meshlet;
+		meshlet.startIndex = uint(result.size());
+		stamp++;
+		meshletTriangles.clear();
+		candidates.clear();
+
+		vec3 positionSum(0.0f);
+		vec3 minimumBounds(std::numeric_limits<float>::max());
+		vec3 maximumBounds(-std::numeric_limits<float>::max());
+		uint triangle = uint(nextSeed);
+
+		while (true)
+		{
+			const std::size_t newVertices = newVertexCount(triangle);
+			meshlet.vertexCount += uint(newVertices);
+			assigned[triangle] = true;
+			meshletTriangles.push_back(triangle);
+
+			for (int c = 0; c < 3; c++)
+			{
+				const uint v = indices[3 * triangle + c];
+
+				if (stamps[v] == stamp)
+					continue;
+
+				stamps[v] = stamp;
+				positionSum += positions[v];
+				minimumBounds = min(minimumBounds, positions[v]);
+				maximumBounds = max(maximumBounds, positions[v]);
+
+				const uint p = positionIndices[v];
+
+				if (positionStamps[p] == stamp)
+					continue;
+
+				positionStamps[p] = stamp;
+
+				for (uint i = adjacencyOffsets[p]; i < adjacencyOffsets[p + 1]; i++)
+				{
+					const uint t = adjacency[i];
+
+					if (!assigned[t] && candidateStamps[t] != stamp)
+					{
+						candidateStamps[t] = stamp;
+						candidates.push_back(t);
+					}
+				}
+			}
+
+			if (meshletTriangles.size() == maxMeshletTriangles)
+				break;
+
+			const vec3 center = positionSum / float(meshlet.vertexCount);
+			std::size_t bestNewVertices = 4;
+			float bestDistance = std::numeric_limits<float>::max();
+			uint best = uint(triangleCount);
+
+			auto consider = [&](uint t)
+			{
+				const std::size_t candidateNewVertices = newVertexCount(t);
+
+				if (meshlet.vertexCount + candidateNewVertices > maxMeshletVertices || candidateNewVertices > bestNewVertices)
+					return;
+
+				const vec3 offset = (positions[indices[3 * t]] + positions[indices[3 * t + 1]] + positions[indices[3 * t + 2]]) / 3.0f - center;
+				const float distance = dot(offset, offset);
+
+				if (candidateNewVertices < bestNewVertices || distance < bestDistance)
+				{
+					bestNewVertices = candidateNewVertices;
+					bestDistance = distance;
+					best = t;
+				}
+			};
+
+			// The neighbours of the last triangle are searched first, which keeps the growth local. Only if none of
+			// them is free of new vertices, all candidates are searched.
+			for (int c = 0; c < 3; c++)
+			{
+				const uint p = positionIndices[indices[3 * triangle + c]];
+
+				for (uint i = adjacencyOffsets[p]; i < adjacencyOffsets[p + 1]; i++)
+				{
+					if (!assigned[adjacency[i]])
+						consider(adjacency[i]);
+				}
+			}
+
+			for (std::size_t i = 0; bestNewVertices > 0 && i < candidates.size(); i++)
+			{
+				// candidates assigned in the meantime are removed lazily
+				if (assigned[candidates[i]])
+				{
+					candidates[i--] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+
+				consider(candidates[i]);
+			}
+
+			if (best < triangleCount)
+			{
+				triangle = best;
+				continue;
+			}
+
+			// Without connected triangles left, the next triangle in order is taken if it lies close to the
+			// meshlet, widened by half its extent, so that triangle soups form meshlets as well.
+			if (!candidates.empty())
+				break;
+
+			while (nextSeed < triangleCount && assigned[nextSeed])
+				nextSeed++;
+
+			if (nextSeed == triangleCount || meshlet.vertexCount + newVertexCount(uint(nextSeed)) > maxMeshletVertices)
+				break;
+
+			const vec3 centroid = (positions[indices[3 * nextSeed]] + positions[indices[3 * nextSeed + 1]] + positions[indices[3 * nextSeed + 2]]) / 3.0f;
+			const vec3 margin = 0.5f * (maximumBounds - minimumBounds);
+			bool close = true;
+
+			for (int i = 0; i < 3; i++)
+				close = close && centroid[i] >= minimumBounds[i] - margin[i] && centroid[i] <= maximumBounds[i] + margin[i];
+
+			if (!close)
+				break;
+
+			triangle = uint(nextSeed);
+		}
+
+		// the triangles keep their relative order within the meshlet, which preserves vertex cache locality
+		std::sort(meshletTriangles.begin(), meshletTriangles.end());
+
+		for (auto t : meshletTriangles)
+			result.insert(result.end(), indices.begin() + 3 * t, indices.begin() + 3 * t + 3);
+
+		meshlet.endIndex = uint(result.size());
+		meshlets.push_back(meshlet);
+	}
+
+	// incomplete triangles at the end belong to the last meshlet
+	result.insert(result.end(), indices.begin() + 3 * triangleCount, indices.end());
+
+	if (meshlets.empty())
+		meshlets.emplace_back();
+
+	meshlets.back().endIndex = uint(result.size());
+	indices.swap(result);
+
+	for (auto& m : meshlets)
+		computeMeshletBounds(indices, positions, m);
+}
+
+void MeshOptimizer::computeMeshletBounds(const std::vector<uint>& indices, const std::vector<vec3>& positions, Meshlet& meshlet)
+{
+	const std::size_t end = std::min<std::size_t>(meshlet.endIndex, indices.size() - indices.size() % 3);
+
+	if (meshlet.startIndex >= end)
+		return;
+
+	// the sphere is centered in the bounding box of the vertices
+	vec3 minimumBounds(std::numeric_limits<float>::max());
+	vec3 maximumBounds(-std::numeric_limits<float>::max());
+
+	for (std::size_t i = meshlet.startIndex; i < end; i++)
+	{
+		minimumBounds = min(minimumBounds, positions[indices[i]]);
+		maximumBounds = max(maximumBounds, positions[indices[i]]);
+	}
+
+	meshlet.center = 0.5f * (minimumBounds + maximumBounds);
+	meshlet.radius = 0.0f;
+
+	for (std::size_t i = meshlet.startIndex; i < end; i++)
+		meshlet.radius = std::max(meshlet.radius, length(positions[indices[i]] - meshlet.center));
+
+	// The cone axis is the average triangle normal. The apex is placed on the axis behind all triangle planes,
+	// so that a camera seeing the apex within the cutoff angle of the axis sees every triangle from behind.
+	std::vector<vec3> normals;
+	vec3 axis(0.0f);
+
+	for (std::size_t t = meshlet.startIndex; t < end; t += 3)
+	{
+		const vec3& p0 = positions[indices[t]];
+		const vec3 normal = cross(positions[indices[t + 1]] - p0, positions[indices[t + 2]] - p0);
+		const float normalLength = length(normal);
+
+		if (normalLength > 0.0f)
+		{
+			normals.push_back(normal / normalLength);
+			axis += normals.back();
+		}
+	}
+
+	meshlet.coneApex = meshlet.center;
+	meshlet.coneAxis = vec3(0.0f);
+	meshlet.coneCutoff = 1.0f;
+
+	const float axisLength = length(axis);
+
+	if (axisLength == 0.0f)
+		return;
+
+	axis /= axisLength;
+
+	float minimumDot = 1.0f;
+
+	for (const auto& n : normals)
+		minimumDot = std::min(minimumDot, dot(axis, n));
+
+	// normals spreading over (nearly) a hemisphere or more leave no useful cone
+	if (minimumDot <= 0.1f)
+		return;
+
+	float maximumDistance = 0.0f;
+	std::size_t n = 0;
+
+	for (std::size_t t = meshlet.startIndex; t < end; t += 3)
+	{
+		const vec3& p0 = positions[indices[t]];
+
+		if (length(cross(positions[indices[t + 1]] - p0, positions[indices[t + 2]] - p0)) == 0.0f)
+			continue;
+
+		const vec3& normal = normals[n++];
+		maximumDistance = std::max(maximumDistance, dot(meshlet.center - p0, normal) / dot(axis, normal));
+	}
+
+	meshlet.coneApex = meshlet.center - axis * maximumDistance;
+	meshlet.coneAxis = axis;
+	meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+}
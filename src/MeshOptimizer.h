@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Model.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace minity
+{
+	// Reordering of triangle lists for rendering efficiency. All functions work on indexed triangle lists
+	// whose indices are in the range [0, vertexCount).
+	class MeshOptimizer
+	{
+	public:
+		// size of the simulated FIFO post-transform vertex cache
+		static const std::size_t vertexCacheSize;
+
+		// number of vertex shader invocations the triangle list causes with a FIFO cache of the given size
+		static std::size_t vertexCacheMisses(const std::vector<glm::uint>& indices, std::size_t vertexCount, std::size_t cacheSize = vertexCacheSize);
+
+		// reorders the triangles for post-transform vertex cache locality (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+		static void optimizeVertexCache(std::vector<glm::uint>& indices, std::size_t vertexCount);
+
+		// Reorders the triangles of a cache optimized list to reduce overdraw (Sander et al., "Fast Triangle
+		// Reordering for Vertex Locality and Reduced Overdraw"). The list is split into clusters whose cache
+		// efficiency stays within the threshold factor, then clusters on the outside of the mesh, which are
+		// likely to occlude others, are moved to the front.
+		static void optimizeOverdraw(std::vector<glm::uint>& indices, const std::vector<glm::vec3>& positions, float threshold = 1.05f);
+
+		// limits of the meshlets built below
+		static const std::size_t maxMeshletVertices;
+		static const std::size_t maxMeshletTriangles;
+
+		// Groups the triangles into meshlets of connected, spatially close triangles and reorders the list so that
+		// every meshlet is a consecutive range. Meshlets are started in the order of the list and keep the
+		// relative order of their triangles, so most of the cache and overdraw optimization is retained. The
+		// index ranges of the meshlets are relative to the list and cover it completely.
+		static void buildMeshlets(std::vector<glm::uint>& indices, const std::vector<glm::vec3>& positions, std::vector<Meshlet>& meshlets);
+
+		// bounding sphere and normal cone of the triangles in [meshlet.startIndex, meshlet.endIndex)
+		static void computeMeshletBounds(const std::vector<glm::uint>& indices, const std::vector<glm::vec3>& positions, Meshlet& meshlet);
+	};
+}
@@ -0,0 +1,521 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+using namespace minity;
+using namespace glm;
+
+namespace
+{
+	// no levels of detail with fewer triangles are built
+	const std::size_t minimumLevelTriangles = 128;
+	// a level is only kept if it reduces the triangles of the previous one to at most this fraction
+	const float minimumLevelReduction = 0.8f;
+	// weight of the planes through open edges relative to those of the triangles
+	const float borderWeight = 10.0f;
+	// collapses must not turn a remaining triangle by more than about 75 degrees
+	const float minimumNormalCosine = 0.25f;
+	const int maximumPasses = 100;
+
+	const uint noVertex = std::numeric_limits<uint>::max();
+
+	enum class VertexKind : unsigned char
+	{
+		// interior vertex whose position has no other vertices, can be collapsed onto any neighbor
+		Manifold,
+		// vertex on an open border, can only be collapsed onto its neighbors along the border
+		Border,
+		// one of the two vertices at a position on a normal or texture seam, both are collapsed along the seam together
+		Seam,
+		// vertex with a more complex neighborhood that is never collapsed
+		Locked
+	};
+
+	// quadric error p^T A p + 2 b^T p + c of the squared distances to a set of weighted planes
+	struct Quadric
+	{
+		float a00 = 0.0f, a11 = 0.0f, a22 = 0.0f;
+		float a10 = 0.0f, a20 = 0.0f, a21 = 0.0f;
+		float b0 = 0.0f, b1 = 0.0f, b2 = 0.0f;
+		float c = 0.0f;
+		float weight = 0.0f;
+
+		Quadric() = default;
+
+		// plane dot(normal, p) + distance = 0 with a unit normal
+		Quadric(vec3 normal, float distance, float w)
+		{
+			a00 = w * normal.x * normal.x;
+			a11 = w * normal.y * normal.y;
+			a22 = w * normal.z * normal.z;
+			a10 = w * normal.y * normal.x;
+			a20 = w * normal.z * normal.x;
+			a21 = w * normal.z * normal.y;
+			b0 = w * distance * normal.x;
+			b1 = w * distance * normal.y;
+			b2 = w * distance * normal.z;
+			c = w * distance * distance;
+			weight = w;
+		}
+
+		Quadric& operator+=(const Quadric& q)
+		{
+			a00 += q.a00;
+			a11 += q.a11;
+			a22 += q.a22;
+			a10 += q.a10;
+			a20 += q.a20;
+			a21 += q.a21;
+			b0 += q.b0;
+			b1 += q.b1;
+			b2 += q.b2;
+			c += q.c;
+			weight += q.weight;
+			return *this;
+		}
+
+		// weighted mean of the squared distances of p to the planes
+		float error(vec3 p) const
+		{
+			const float rx = a00 * p.x + a10 * p.y + a20 * p.z + 2.0f * b0;
+			const float ry = a10 * p.x + a11 * p.y + a21 * p.z + 2.0f * b1;
+			const float rz = a20 * p.x + a21 * p.y + a22 * p.z + 2.0f * b2;
+			const float result = rx * p.x + ry * p.y + rz * p.z + c;
+
+			return weight > 0.0f ? std::abs(result) / weight : 0.0f;
+		}
+	};
+
+	struct Collapse
+	{
+		uint from;
+		uint to;
+		float cost;
+	};
+}
+
+float MeshSimplifier::simplify(std::vector<uint>& indices, const std::vector<vec3>& positions, std::size_t targetIndexCount, float maximumError)
+{
+	const std::size_t vertexCount = positions.size();
+
+	// incomplete and degenerate triangles are dropped right away
+	{
+		std::size_t triangleEnd = 0;
+
+		for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			const uint i0 = indices[i], i1 = indices[i + 1], i2 = indices[i + 2];
+
+			if (i0 != i1 && i1 != i2 && i2 != i0)
+			{
+				indices[triangleEnd++] = i0;
+				indices[triangleEnd++] = i1;
+				indices[triangleEnd++] = i2;
+			}
+		}
+
+		indices.resize(triangleEnd);
+	}
+
+	if (indices.size() <= targetIndexCount)
+		return 0.0f;
+
+	std::vector<bool> used(vertexCount, false);
+
+	for (auto i : indices)
+		used[i] = true;
+
+	// positions are normalized to the unit cube, so that the quadrics stay well within float precision
+	vec3 minimum(std::numeric_limits<float>::max());
+	vec3 maximum(std::numeric_limits<float>::lowest());
+
+	for (auto i : indices)
+	{
+		minimum = min(minimum, positions[i]);
+		maximum = max(maximum, positions[i]);
+	}
+
+	const float extent = std::max(std::max(maximum.x - minimum.x, maximum.y - minimum.y), maximum.z - minimum.z);
+
+	if (extent <= 0.0f)
+		return 0.0f;
+
+	std::vector<vec3> points(vertexCount);
+
+	for (std::size_t v = 0; v < vertexCount; v++)
+		points[v] = (positions[v] - minimum) / extent;
+
+	// The used vertices with equal positions are linked in a ring, and all of them are represented by the first
+	// one. Quadrics and the triangles around a position are kept for the representative only.
+	std::vector<uint> remap(vertexCount);
+	std::vector<uint> wedge(vertexCount);
+	{
+		std::vector<uint> order;
+		order.reserve(vertexCount);
+
+		for (std::size_t v = 0; v < vertexCount; v++)
+		{
+			remap[v] = uint(v);
+			wedge[v] = uint(v);
+
+			if (used[v])
+				order.push_back(uint(v));
+		}
+
+		auto less = [&](uint a, uint b)
+		{
+			const vec3& p = positions[a];
+			const vec3& q = positions[b];
+			return p.x < q.x || (p.x == q.x && (p.y < q.y || (p.y == q.y && (p.z < q.z || (p.z == q.z && a < b)))));
+		};
+
+		std::sort(order.begin(), order.end(), less);
+
+		for (std::size_t i = 0; i < order.size(); )
+		{
+			std::size_t end = i + 1;
+
+			while (end < order.size() && positions[order[end]] == positions[order[i]])
+				end++;
+
+			for (std::size_t j = i; j < end; j++)
+			{
+				remap[order[j]] = order[i];
+				wedge[order[j]] = order[j + 1 < end ? j + 1 : i];
+			}
+
+			i = end;
+		}
+	}
+
+	// outgoing edges of every vertex
+	std::vector<uint> edgeOffsets(vertexCount + 1, 0);
+	std::vector<uint> edgeTargets(indices.size());
+
+	for (auto i : indices)
+		edgeOffsets[i + 1]++;
+
+	std::partial_sum(edgeOffsets.begin(), edgeOffsets.end(), edgeOffsets.begin());
+
+	{
+		std::vector<uint> next(edgeOffsets.begin(), edgeOffsets.end() - 1);
+
+		for (std::size_t t = 0; t < indices.size(); t += 3)
+		{
+			for (int c = 0; c < 3; c++)
+				edgeTargets[next[indices[t + c]]++] = indices[t + (c + 1) % 3];
+		}
+	}
+
+	auto hasEdge = [&](uint a, uint b)
+	{
+		for (uint e = edgeOffsets[a]; e < edgeOffsets[a + 1]; e++)
+		{
+			if (edgeTargets[e] == b)
+				return true;
+		}
+
+		return false;
+	};
+
+	// Edges without an opposite edge between the same vertices are open: they lie on a border or a seam. The
+	// vertices store the other vertex of their only incoming and outgoing open edge, noVertex if there is
+	// none, or themselves if there are several.
+	std::vector<uint> openIn(vertexCount, noVertex);
+	std::vector<uint> openOut(vertexCount, noVertex);
+
+	for (std::size_t t = 0; t < indices.size(); t += 3)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			const uint a = indices[t + c];
+			const uint b = indices[t + (c + 1) % 3];
+
+			if (!hasEdge(b, a))
+			{
+				openOut[a] = openOut[a] == noVertex ? b : a;
+				openIn[b] = openIn[b] == noVertex ? a : b;
+			}
+		}
+	}
+
+	std::vector<VertexKind> kinds(vertexCount, VertexKind::Locked);
+
+	for (std::size_t i = 0; i < vertexCount; i++)
+	{
+		const uint v = uint(i);
+
+		if (!used[v] || remap[v] != v)
+			continue;
+
+		const uint w = wedge[v];
+
+		if (w == v)
+		{
+			if (openIn[v] == noVertex && openOut[v] == noVertex)
+				kinds[v] = VertexKind::Manifold;
+			else if (openIn[v] != noVertex && openOut[v] != noVertex && openIn[v] != v && openOut[v] != v)
+				kinds[v] = VertexKind::Border;
+		}
+		else if (wedge[w] == v)
+		{
+			// both vertices continue the seam to the same positions, in opposite directions
+			const bool open = openIn[v] != noVertex && openOut[v] != noVertex && openIn[w] != noVertex && openOut[w] != noVertex;
+			const bool single = openIn[v] != v && openOut[v] != v && openIn[w] != w && openOut[w] != w;
+
+			if (open && single && remap[openIn[v]] == remap[openOut[w]] && remap[openOut[v]] == remap[openIn[w]])
+			{
+				kinds[v] = VertexKind::Seam;
+				kinds[w] = VertexKind::Seam;
+			}
+		}
+	}
+
+	std::vector<Quadric> quadrics(vertexCount);
+
+	for (std::size_t t = 0; t < indices.size(); t += 3)
+	{
+		const vec3& p0 = points[indices[t]];
+		const vec3 normal = cross(points[indices[t + 1]] - p0, points[indices[t + 2]] - p0);
+		const float area = length(normal);
+
+		if (area == 0.0f)
+			continue;
+
+		const Quadric plane(normal / area, -dot(normal / area, p0), area);
+
+		for (int c = 0; c < 3; c++)
+			quadrics[remap[indices[t + c]]] += plane;
+
+		// planes perpendicular to the triangle keep open edges in place
+		for (int c = 0; c < 3; c++)
+		{
+			const uint a = indices[t + c];
+			const uint b = indices[t + (c + 1) % 3];
+
+			if (hasEdge(b, a))
+				continue;
+
+			const vec3 edge = points[b] - points[a];
+			const float edgeLength = length(edge);
+
+			if (edgeLength == 0.0f)
+				continue;
+
+			const vec3 edgeNormal = normalize(cross(edge, normal));
+			const Quadric edgePlane(edgeNormal, -dot(edgeNormal, points[a]), borderWeight * edgeLength * edgeLength);
+
+			quadrics[remap[a]] += edgePlane;
+			quadrics[remap[b]] += edgePlane;
+		}
+	}
+
+	auto canCollapse = [&](uint a, uint b)
+	{
+		switch (kinds[a])
+		{
+		case VertexKind::Manifold:
+			return true;
+		case VertexKind::Border:
+			return kinds[b] == VertexKind::Border && (openOut[a] == b || openIn[a] == b);
+		case VertexKind::Seam:
+			return kinds[b] == VertexKind::Seam && (openOut[a] == b || openIn[a] == b) && (openOut[wedge[a]] == wedge[b] || openIn[wedge[a]] == wedge[b]);
+		default:
+			return false;
+		}
+	};
+
+	// after collapsing a onto its neighbor b along open edges, b continues them to the other neighbor of a
+	auto relink = [&](uint a, uint b)
+	{
+		if (openOut[a] == b && openIn[a] != noVertex && openIn[a] != b)
+		{
+			openOut[openIn[a]] = b;
+			openIn[b] = openIn[a];
+		}
+		else if (openIn[a] == b && openOut[a] != noVertex && openOut[a] != b)
+		{
+			openIn[openOut[a]] = b;
+			openOut[b] = openOut[a];
+		}
+	};
+
+	const float errorLimit = maximumError < std::numeric_limits<float>::max() ? (maximumError / extent) * (maximumError / extent) : maximumError;
+	float resultError = 0.0f;
+
+	std::vector<uint> triangleOffsets(vertexCount + 1);
+	std::vector<uint> triangles(indices.size());
+	std::vector<uint> collapseTargets(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<Collapse> collapses;
+
+	// whether moving the vertices at the position of a to the position of b turns one of the remaining triangles around a
+	auto flips = [&](uint a, uint b)
+	{
+		const uint ra = remap[a];
+		const uint rb = remap[b];
+
+		for (uint k = triangleOffsets[ra]; k < triangleOffsets[ra + 1]; k++)
+		{
+			const uint* triangle = &indices[3 * triangles[k]];
+			vec3 corners[3];
+			vec3 moved[3];
+			bool collapsed = false;
+
+			for (int c = 0; c < 3; c++)
+			{
+				corners[c] = points[triangle[c]];
+				moved[c] = remap[triangle[c]] == ra ? points[b] : corners[c];
+				collapsed = collapsed || remap[triangle[c]] == rb;
+			}
+
+			if (collapsed)
+				continue;
+
+			const vec3 before = cross(corners[1] - corners[0], corners[2] - corners[0]);
+			const vec3 after = cross(moved[1] - moved[0], moved[2] - moved[0]);
+
+			if (dot(before, after) < minimumNormalCosine * length(before) * length(after))
+				return true;
+		}
+
+		return false;
+	};
+
+	for (int pass = 0; pass < maximumPasses && indices.size() > targetIndexCount; pass++)
+	{
+		const std::size_t triangleCount = indices.size() / 3;
+
+		// triangles around every position
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+
+		for (auto i : indices)
+			triangleOffsets[remap[i] + 1]++;
+
+		std::partial_sum(triangleOffsets.begin(), triangleOffsets.end(), triangleOffsets.begin());
+
+		{
+			std::vector<uint> next(triangleOffsets.begin(), triangleOffsets.end() - 1);
+
+			for (std::size_t i = 0; i < indices.size(); i++)
+				triangles[next[remap[indices[i]]]++] = uint(i / 3);
+		}
+
+		// the cheaper direction of every edge, interior edges are seen from both of their triangles
+		collapses.clear();
+
+		for (std::size_t t = 0; t < indices.size(); t += 3)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				const uint a = indices[t + c];
+				const uint b = indices[t + (c + 1) % 3];
+
+				if (remap[a] > remap[b] && openOut[a] != b)
+					continue;
+
+				const float costAB = canCollapse(a, b) ? quadrics[remap[a]].error(points[b]) : std::numeric_limits<float>::max();
+				const float costBA = canCollapse(b, a) ? quadrics[remap[b]].error(points[a]) : std::numeric_limits<float>::max();
+
+				if (costAB <= costBA && costAB < std::numeric_limits<float>::max())
+					collapses.push_back({ a, b, costAB });
+				else if (costBA < costAB)
+					collapses.push_back({ b, a, costBA });
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+		// every collapse removes about two triangles
+		const std::size_t neededCollapses = (triangleCount - targetIndexCount / 3) / 2 + 1;
+		std::size_t collapseCount = 0;
+
+		std::iota(collapseTargets.begin(), collapseTargets.end(), 0);
+		std::fill(touched.begin(), touched.end(), false);
+
+		for (const auto& collapse : collapses)
+		{
+			if (collapse.cost > errorLimit || collapseCount >= neededCollapses)
+				break;
+
+			const uint ra = remap[collapse.from];
+			const uint rb = remap[collapse.to];
+
+			if (touched[ra] || touched[rb] || flips(collapse.from, collapse.to))
+				continue;
+
+			collapseTargets[collapse.from] = collapse.to;
+			relink(collapse.from, collapse.to);
+
+			if (kinds[collapse.from] == VertexKind::Seam)
+			{
+				collapseTargets[wedge[collapse.from]] = wedge[collapse.to];
+				relink(wedge[collapse.from], wedge[collapse.to]);
+			}
+
+			quadrics[rb] += quadrics[ra];
+
+			// the triangles around the collapsed position change, so none of their positions are collapsed again in this pass
+			for (uint k = triangleOffsets[ra]; k < triangleOffsets[ra + 1]; k++)
+			{
+				for (int c = 0; c < 3; c++)
+					touched[remap[indices[3 * triangles[k] + c]]] = true;
+			}
+
+			resultError = std::max(resultError, collapse.cost);
+			collapseCount++;
+		}
+
+		if (collapseCount == 0)
+			break;
+
+		std::size_t triangleEnd = 0;
+
+		for (std::size_t t = 0; t < indices.size(); t += 3)
+		{
+			const uint i0 = collapseTargets[indices[t]];
+			const uint i1 = collapseTargets[indices[t + 1]];
+			const uint i2 = collapseTargets[indices[t + 2]];
+
+			if (remap[i0] != remap[i1] && remap[i1] != remap[i2] && remap[i2] != remap[i0])
+			{
+				indices[triangleEnd++] = i0;
+				indices[triangleEnd++] = i1;
+				indices[triangleEnd++] = i2;
+			}
+		}
+
+		indices.resize(triangleEnd);
+	}
+
+	return std::sqrt(resultError) * extent;
+}
+
+void MeshSimplifier::buildLevelsOfDetail(const std::vector<uint>& indices, const std::vector<vec3>& positions, std::vector<uint>& levelIndices, std::vector<LevelOfDetail>& levels)
+{
+	std::vector<uint> current(indices.begin(), indices.begin() + indices.size() / 3 * 3);
+	float error = 0.0f;
+
+	while (current.size() / 6 >= minimumLevelTriangles)
+	{
+		std::vector<uint> simplified = current;
+		error += simplify(simplified, positions, current.size() / 6 * 3);
+
+		if (float(simplified.size()) > minimumLevelReduction * float(current.size()))
+			break;
+
+		MeshOptimizer::optimizeVertexCache(simplified, positions.size());
+
+		LevelOfDetail level;
+		level.startIndex = uint(levelIndices.size());
+		levelIndices.insert(levelIndices.end(), simplified.begin(), simplified.end());
+		level.endIndex = uint(levelIndices.size());
+		level.error = error;
+		levels.push_back(level);
+
+		current.swap(simplified);
+	}
+}
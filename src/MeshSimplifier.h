@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Model.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace minity
+{
+	// Reduction of indexed triangle lists by edge collapses in the order of the quadric error metric (Garland and
+	// Heckbert, "Surface Simplification Using Quadric Error Metrics"). Vertices are neither moved nor created, so
+	// simplified lists refer to the vertices of the original one.
+	class MeshSimplifier
+	{
+	public:
+		// Collapses edges until at most targetIndexCount indices are left or no further edge can be collapsed
+		// within maximumError, an object space distance. Vertices with equal positions but different attributes
+		// form normal and texture seams, which are only collapsed along themselves on both sides, so that they
+		// keep their shape; open borders are preserved the same way. Returns the error of the result.
+		static float simplify(std::vector<glm::uint>& indices, const std::vector<glm::vec3>& positions, std::size_t targetIndexCount, float maximumError = std::numeric_limits<float>::max());
+
+		// Appends a chain of simplified versions of the triangle list to levelIndices, each with about half the
+		// triangles of the previous one, until a level gets too small or cannot be reduced much further. Every
+		// level is simplified from the previous one and optimized for the vertex cache; its error includes the
+		// errors of all previous levels. The index ranges of the levels are relative to levelIndices.
+		static void buildLevelsOfDetail(const std::vector<glm::uint>& indices, const std::vector<glm::vec3>& positions, std::vector<glm::uint>& levelIndices, std::vector<LevelOfDetail>& levels);
+	};
+}
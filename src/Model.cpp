@@ -1,25 +1,25 @@
 #include "Model.h"
+#include "ObjLoader.h"
+#include "ModelCache.h"
+#include "Parallel.h"
+#include "TextureCache.h"
+#include "VertexCompressor.h"
 
-#include <list>
-#include <fstream>
 #include <string>
-#include <sstream>
-#include <cstdlib>
-#include <iterator>
 #include <iostream>
 #include <limits>
-#include <unordered_map>
+#include <algorithm>
 #include <array>
-#include <algorithm> 
-#include <cctype>
-#include <locale>
-#include <filesystem>
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
 #include <globjects/globjects.h>
 #include <globjects/logging.h>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/string_cast.hpp>
 
@@ -28,1022 +28,680 @@ using namespace gl;
 using namespace glm;
 using namespace globjects;
 
-std::string trimLeft(const std::string &str, const std::string &whitespace = "\n\r\t ")
+namespace
 {
-	size_t uIndex = str.find_first_not_of(whitespace);
-	if (uIndex != std::string::npos)
-		return str.substr(uIndex);
+	// texture maps of a material together with the image files they are loaded from
+	struct MaterialTexture
+	{
+		std::string Material::* path;
+		std::shared_ptr<Texture> Material::* texture;
+		TextureKind kind;
+	};
+
+	const std::array<MaterialTexture, 7> materialTextures = { {
+		{ &Material::ambientTexturePath, &Material::ambientTexture, TextureKind::Color },
+		{ &Material::diffuseTexturePath, &Material::diffuseTexture, TextureKind::Color },
+		{ &Material::specularTexturePath, &Material::specularTexture, TextureKind::Color },
+		{ &Material::shininessTexturePath, &Material::shininessTexture, TextureKind::Scalar },
+		{ &Material::bumpTexturePath, &Material::bumpTexture, TextureKind::Scalar },
+		{ &Material::objectNormalsPath, &Material::objectNormals, TextureKind::ObjectNormals },
+		{ &Material::tangentNormalsPath, &Material::tangentNormals, TextureKind::TangentNormals }
+	} };
+
+	struct PendingTexture
+	{
+		// material maps using the texture, as pairs of material index and index into materialTextures
+		std::vector<std::pair<std::size_t, std::size_t>> targets;
+		TextureKind kind = TextureKind::Color;
+		TextureImage image;
+		// set instead of the image if the texture was found in the texture cache
+		std::shared_ptr<Texture> texture;
+	};
 
-	return "";
+	struct StagedTexture
+	{
+		PendingTexture texture;
+		std::unique_ptr<Buffer> pixelBuffer;
+		std::size_t byteSize = 0;
+	};
+
+	// Upper limit for the pixel data staged for upload per update(), so that large textures do not
+	// stall a single frame. At least one texture is staged per call, regardless of its size.
+	const std::size_t textureUploadBudget = 64 * 1024 * 1024;
+
+	template <typename T>
+	void append(std::vector<T>& target, std::vector<T>& source)
+	{
+		if (target.empty())
+			target = std::move(source);
+		else
+			target.insert(target.end(), std::make_move_iterator(source.begin()), std::make_move_iterator(source.end()));
+	}
 }
 
-std::string trimRight(const std::string &str, const std::string &whitespace = "\n\r\t ")
+// State shared between a model and its background loader thread.
+struct Model::LoadState
+{
+	std::thread thread;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::atomic<bool> cancelled{ false };
+	std::atomic<float> geometryProgress{ 0.0f };
+	std::atomic<std::size_t> textureCount{ 0 };
+	std::atomic<std::size_t> decodedTextureCount{ 0 };
+	// set on the GL thread before the loader starts
+	bool colorCompression = true;
+
+	// everything below is guarded by the mutex
+	std::mutex mutex;
+
+	// Published by the loader and not yet taken over by update(). Materials and bounds are valid once
+	// headerPublished is set, groups, vertices and indices are appended as they are assembled.
+	ModelData pending;
+	std::vector<PendingTexture> textures;
+	std::size_t indexCount = 0;
+	std::size_t vertexCountEstimate = 0;
+
+	bool headerPublished = false;
+	bool headerTaken = false;
+	bool finished = false;
+	bool succeeded = false;
+
+	// only accessed on the GL thread: decoded textures waiting for upload, and textures
+	// whose pixel buffers were filled during the last update() and that are created in the next one
+	std::deque<PendingTexture> uploadQueue;
+	std::vector<StagedTexture> stagedTextures;
+};
+
+Model::Model()
 {
-	size_t  uIndex = str.find_last_not_of(whitespace);
-	if (uIndex != std::string::npos)
-		return str.substr(0, uIndex + 1);
 
-	return str;
 }
 
-std::string trim(const std::string &str, const std::string & whitespace = "\n\r\t ")
+Model::Model(const std::string& filename)
 {
-	return trimRight(trimLeft(str, whitespace), whitespace);
+	load(filename);
 }
 
-template<class e, class t, int N>
-std::basic_istream<e, t>& operator>>(std::basic_istream<e, t>& in, const e(&sliteral)[N])
+Model::~Model()
 {
-	std::array<e, N - 1> buffer; //get buffer
-	in >> buffer[0]; //skips whitespace
-	if (N > 2)
-		in.read(&buffer[1], N - 2); //read the rest
-	if (strncmp(&buffer[0], sliteral, N - 1)) //if it failed
-		in.setstate(in.rdstate() | std::ios::failbit); //set the state
-	return in;
+	if (m_loadState)
+	{
+		m_loadState->cancelled = true;
+
+		if (m_loadState->thread.joinable())
+			m_loadState->thread.join();
+	}
 }
 
-template<class e, class t>
-std::basic_istream<e, t>& operator>>(std::basic_istream<e, t>& in, const e& cliteral)
+void Model::load(const std::string& filename)
 {
-	e buffer;  //get buffer
-	in >> buffer; //read data
-	if (buffer != cliteral) //if it failed
-		in.setstate(in.rdstate() | std::ios::failbit); //set the state
-	return in;
+	loadAsync(filename);
+	m_loadState->thread.join();
+
+	// texture uploads are spread over several updates
+	while (m_loadState)
+		update();
 }
 
-//redirect mutable char arrays to their normal function
-template<class e, class t, int N>
-std::basic_istream<e, t>& operator>>(std::basic_istream<e, t>& in, e(&carray)[N])
+void Model::loadAsync(const std::string& filename)
 {
-	return std::operator>>(in, carray);
+	if (m_loadState)
+	{
+		m_loadState->cancelled = true;
+		m_loadState->thread.join();
+		m_loadState.reset();
+	}
+
+	globjects::debug() << "Loading file " << filename << " ...";
+
+	m_filename = filename;
+	m_data = ModelData();
+	m_loadingTime = 0.0;
+	m_generation++;
+
+	// the previous buffers may still be referenced by the vertex array, so everything is recreated
+	m_vertexArray = std::make_unique<VertexArray>();
+	m_vertexBuffer = std::make_unique<Buffer>();
+	m_indexBuffer = std::make_unique<Buffer>();
+	m_vertexCapacity = 0;
+	m_indexCapacity = 0;
+	m_indexBufferSize = 0;
+	m_indexRanges.clear();
+	m_chunkIndexRanges.clear();
+
+	m_loadState = std::make_unique<LoadState>();
+	m_loadState->colorCompression = ObjLoader::s3tcSupported();
+	m_loadState->thread = std::thread(&Model::runLoader, std::ref(*m_loadState), filename, m_chunkTriangleBudget, m_normalWeighting, m_creaseAngle);
 }
 
-class ObjLoader
+void Model::runLoader(LoadState& state, const std::string& filename, std::size_t chunkTriangleBudget, NormalWeighting normalWeighting, float creaseAngle)
 {
-public:
+	// rough share of parsing in the geometry loading time, used for the progress display
+	const float parsingProgress = 0.5f;
 
-	struct ObjGroup
+	auto finish = [&](bool succeeded)
 	{
-		std::string name;
-		std::string material;
-		std::vector<uint> positionIndices;
-		std::vector<uint> normalIndices;
-		std::vector<uint> texCoordIndices;
+		std::lock_guard<std::mutex> lock(state.mutex);
+		state.finished = true;
+		state.succeeded = succeeded;
 	};
 
-	struct ObjMaterial
-	{
-		// Material Name
-		std::string name;
-		// Ambient Color
-		vec3 Ka = vec3(0.2f,0.2f,0.2f);
-		// Diffuse Color
-		vec3 Kd = vec3(0.8f,0.8f,0.8f);
-		// Specular Color
-		vec3 Ks = vec3(1.0f,1.0f,1.0f);
-		// Specular Exponent
-		float Ns = 0.0f;
-		// Dissolve
-		float d = 1.0f;
-		// Illumination
-		int illum = 0;
-		// Ambient Texture Map
-		std::string map_Ka;
-		// Diffuse Texture Map
-		std::string map_Kd;
-		// Specular Texture Map
-		std::string map_Ks;
-		// Specular Hightlight Map
-		std::string map_Ns;
-		// Alpha Texture Map
-		std::string map_d;
-		// Bump Map
-		std::string map_bump;
-		//Assignment 2 new imports
-		//Object Normals Map
-		std::string  map_ObjectNormals;
-		//Tangent Normals Map
-		std::string map_TangentNormals;
-	};
+	// Textures are decoded on a pool of worker threads as soon as the materials have been published,
+	// while this thread continues with the geometry. The pool waits for its tasks when it is destroyed.
+	std::unique_ptr<ThreadPool> decoders;
 
-	bool loadObjFile(const std::string & filename)
+	auto decodeTextures = [&](const std::vector<Material>& materials)
 	{
-		std::filesystem::path path(filename);
-		std::ifstream is(filename);
-
-		if (!is.is_open())
-			return false;
-
-		std::vector< vec3 > positions;
-		std::vector< vec3 > normals;
-		std::vector< vec2 > texCoords;
-
-		positions.push_back(vec3(0.0f));
-		normals.push_back(vec3(0.0f));
-		texCoords.push_back(vec2(1.0f));
+		// every image is loaded once for each kind of map it is used as, however many maps refer to it
+		std::vector<PendingTexture> textures;
+		std::map<std::pair<std::string, TextureKind>, std::size_t> textureIndices;
 
-		std::unordered_map< std::string, int > materialMap;
-		std::vector<ObjMaterial> materials;
+		for (std::size_t i = 0; i < materials.size(); i++)
+		{
+			for (std::size_t j = 0; j < materialTextures.size(); j++)
+			{
+				const std::string& texturePath = materials[i].*materialTextures[j].path;
+				const TextureKind kind = materialTextures[j].kind;
 
-		ObjMaterial defaultMaterial;
-		defaultMaterial.name = "default";
+				if (texturePath.empty())
+					continue;
 
-		materialMap.insert(std::make_pair(defaultMaterial.name, int(materials.size())));
-		materials.push_back(defaultMaterial);
+				auto inserted = textureIndices.emplace(std::make_pair(TextureCache::canonicalPath(texturePath), kind), textures.size());
 
-		std::string currentMaterial;
-		currentMaterial = defaultMaterial.name;
+				if (inserted.second)
+				{
+					textures.emplace_back();
+					textures.back().kind = kind;
+					textures.back().image.filename = texturePath;
+				}
 
-		std::unordered_map< std::string, typename std::list<ObjGroup>::iterator > groupMap;
-		std::list<ObjGroup> groupList;
-		std::list<ObjGroup>::iterator groupIterator;
+				textures[inserted.first->second].targets.emplace_back(i, j);
+			}
+		}
 
-		ObjGroup defaultGroup;
-		defaultGroup.name = "default";
-		defaultGroup.material = currentMaterial;
-		groupList.push_back(defaultGroup);
-		groupIterator = groupList.end();
-		groupIterator--;
-		groupMap[defaultGroup.name] = groupIterator;
+		// textures already uploaded for another model are taken from the cache
+		std::vector<PendingTexture> cachedTextures;
 
-		std::string buffer;
+		std::vector<PendingTexture> uncachedTextures;
 
-		while (is.good())
+		for (auto& t : textures)
 		{
-			if (getline(is, buffer))
-			{
-				std::istringstream iss(buffer);
-				std::string token;
+			t.texture = TextureCache::instance().find(t.image.filename, t.kind);
 
-				if (iss >> token)
-				{
-					switch (token.at(0))
-					{
-						// v, vn, vt
-					case 'v':
-					{
-						if (token == "v")
-						{
-							vec3 p(0.0f);
-
-							if (iss >> p.x >> p.y >> p.z)
-								positions.push_back(p);
-						}
-						else if (token == "vn")
-						{
-							vec3 n(0.0f);
-
-							if (iss >> n.x >> n.y >> n.z)
-								normals.push_back(n);
-						}
-						else if (token == "vt")
-						{
-							vec2 t(0.0f);
-
-							if (iss >> t.x >> t.y)
-								texCoords.push_back(t);
-						}
-					}
-					break;
-
-					// mtllib
-					case 'm':
-					{
-						// the Wavefront obj specification does not really allow for spaces in the mtl file name,
-						// since multiple libraries are supposed to be separated by spaces, but many programs
-						// do not take care of that -- therefore, we first try whether it is a single filename,
-						// and only if that fails we use the interpretation according to the specification
-						std::string libraryName;
-
-						if (getline(iss, libraryName))
-						{
-							libraryName = trim(libraryName);
-							std::filesystem::path libraryPath = libraryName;
-
-							// first try
-							if (libraryPath.is_absolute())
-							{
-								if (loadMtlFile(libraryPath.string(), materials, materialMap))
-									break;
-							}
-
-							std::stringstream mss(libraryName);
-
-							while (mss >> libraryName)
-							{
-								libraryName = trim(libraryName);
-								std::filesystem::path libraryPath = path.parent_path();
-								libraryPath.append(libraryName);
-								loadMtlFile(libraryPath.string(), materials, materialMap);
-							}
-						}
-					}
-					break;
-
-					// use material
-					case 'u':
-					{
-						std::string materialName;
-
-						if (getline(iss, materialName))
-						{
-							materialName = trim(materialName);
-							currentMaterial = materialName;
-							groupIterator->material = currentMaterial;
-						}
-					}
-					break;
-
-					// group
-					case 'g':
-					case 'o':
-					{
-						std::string groupName;
-						
-						if (getline(iss,groupName))
-						{
-							groupName = trim(groupName);
-							std::unordered_map< std::string, typename std::list<ObjGroup>::iterator >::iterator j = groupMap.find(groupName);
-
-							if (j == groupMap.end())
-							{
-								ObjGroup newGroup;
-								newGroup.name = groupName;
-
-								groupList.push_back(newGroup);
-								groupIterator = groupList.end();
-								groupIterator--;
-							}
-							else
-								groupIterator = j->second;
-
-							groupIterator->material = currentMaterial;
-						}
-					}
-					break;
-
-					// face
-					case 'f':
-					{
-						int v = 0, n = 0, t = 0;
-
-						if (buffer.find("//") != std::string::npos)
-						{
-							// v//n
-							if (iss >> v >> ("//") >> n)
-							{
-								groupIterator->positionIndices.push_back(v < 0 ? (uint) (v + positions.size()) : (uint) (v));
-								groupIterator->texCoordIndices.push_back(0);
-								groupIterator->normalIndices.push_back(n < 0 ? (uint) (n + normals.size()) : (uint) (n));
-							}
-
-							if (iss >> v >> ("//") >> n)
-							{
-								groupIterator->positionIndices.push_back(v < 0 ? (uint) (v + positions.size()) : (uint) (v));
-								groupIterator->texCoordIndices.push_back(0);
-								groupIterator->normalIndices.push_back(n < 0 ? (uint) (n + normals.size()) : (uint) (n));
-							}
-
-							if (iss >> v >> ("//") >> n)
-							{
-								groupIterator->positionIndices.push_back(v < 0 ? (uint) (v + positions.size()) : (uint) (v));
-								groupIterator->texCoordIndices.push_back(0);
-								groupIterator->normalIndices.push_back(n < 0 ? (uint) (n + normals.size()) : (uint) (n));
-							}
-
-							while (iss >> v >> ("//") >> n)
-							{
-								groupIterator->positionIndices.push_back(groupIterator->positionIndices[groupIterator->positionIndices.size() - 3]);
-								groupIterator->texCoordIndices.push_back(0);
-								groupIterator->normalIndices.push_back(groupIterator->normalIndices[groupIterator->normalIndices.size() - 3]);
-
-								groupIterator->positionIndices.push_back(groupIterator->positionIndices[groupIterator->positionIndices.size() - 2]);
-								groupIterator->texCoordIndices.push_back(0);
-								groupIterator->normalIndices.push_back(groupIterator->normalIndices[groupIterator->normalIndices.size() - 2]);
-
-								groupIterator->positionIndices.push_back(v < 0 ? (uint) (v + positions.size()) : (uint) (v));
-								groupIterator->texCoordIndices.push_back(0);
-								groupIterator->normalIndices.push_back(n < 0 ? (uint) (n + normals.size()) : (uint) (n));
-							}
-
-							break;
-						}
-
-						iss = std::istringstream(buffer);
-						iss >> token;
-
-						if (iss >> v >> ("/") >> t >> ("/") >> n)
-						{
-							// v/t/n
-							groupIterator->positionIndices.push_back(v < 0 ? (uint) (v + positions.size()) : (uint) (v));
-							groupIterator->texCoordIndices.push_back(t < 0 ? (uint) (t + texCoords.size()) : (uint) (t));
-							groupIterator->normalIndices.push_back(n < 0 ? (uint) (n + normals.size()) : (uint) (n));
-
-							if (iss >> v >> ("/") >> t >> ("/") >> n)
-							{
-								groupIterator->positionIndices.push_back(v < 0 ? (uint) (v + positions.size()) : (uint) (v));
-								groupIterator->texCoordIndices.push_back(t < 0 ? (uint) (t + texCoords.size()) : (uint) (t));
-								groupIterator->normalIndices.push_back(n < 0 ? (uint) (n + normals.size()) : (uint) (n));
-							}
-
-							if (iss >> v >> ("/") >> t >> ("/") >> n)
-							{
-								groupIterator->positionIndices.push_back(v < 0 ? (uint) (v + positions.size()) : (uint) (v));
-								groupIterator->texCoordIndices.push_back(t < 0 ? (uint) (t + texCoords.size()) : (uint) (t));
-								groupIterator->normalIndices.push_back(n < 0 ? (uint) (n + normals.size()) : (uint) (n));
-							}
-
-							while (iss >> v >> ("/") >> t >> ("/") >> n)
-							{
-								groupIterator->positionIndices.push_back(groupIterator->positionIndices[groupIterator->positionIndices.size() - 3]);
-								groupIterator->texCoordIndices.push_back(groupIterator->texCoordIndices[groupIterator->texCoordIndices.size() - 3]);
-								groupIterator->normalIndices.push_back(groupIterator->normalIndices[groupIterator->normalIndices.size() - 3]);
-
-								groupIterator->positionIndices.push_back(groupIterator->positionIndices[groupIterator->positionIndices.size() - 2]);
-								groupIterator->texCoordIndices.push_back(groupIterator->texCoordIndices[groupIterator->texCoordIndices.size() - 2]);
-								groupIterator->normalIndices.push_back(groupIterator->normalIndices[groupIterator->normalIndices.size() - 2]);
-
-								groupIterator->positionIndices.push_back(v < 0 ? (uint) (v + positions.size()) : (uint) (v));
-								groupIterator->texCoordIndices.push_back(t < 0 ? (uint) (t + texCoords.size()) : (uint) (t));
-								groupIterator->normalIndices.push_back(n < 0 ? (uint) (n + normals.size()) : (uint) (n));
-							}
-
-							break;
-						}
-
-						iss = std::istringstream(buffer);
-						iss >> token;
-
-						if (iss >> v >> ("/") >> t)
-						{
-							// v/t
-							groupIterator->positionIndices.push_back(v < 0 ? (uint) (v + positions.size()) : (uint) (v));
-							groupIterator->texCoordIndices.push_back(t < 0 ? (uint) (t + texCoords.size()) : (uint) (t));
-							groupIterator->normalIndices.push_back(0);
-
-							if (iss >> v >> ("/") >> t)
-							{
-								groupIterator->positionIndices.push_back(v < 0 ? (uint) (v + positions.size()) : (uint) (v));
-								groupIterator->texCoordIndices.push_back(t < 0 ? (uint) (t + texCoords.size()) : (uint) (t));
-								groupIterator->normalIndices.push_back(0);
-							}
-
-							if (iss >> v >> ("/") >> t)
-							{
-								groupIterator->positionIndices.push_back(v < 0 ? (uint) (v + positions.size()) : (uint) (v));
-								groupIterator->texCoordIndices.push_back(t < 0 ? (uint) (t + texCoords.size()) : (uint) (t));
-								groupIterator->normalIndices.push_back(0);
-							}
-
-							while (iss >> v >> ("/") >> t)
-							{
-								groupIterator->positionIndices.push_back(groupIterator->positionIndices[groupIterator->positionIndices.size() - 3]);
-								groupIterator->texCoordIndices.push_back(groupIterator->texCoordIndices[groupIterator->texCoordIndices.size() - 3]);
-								groupIterator->normalIndices.push_back(0);
-
-								groupIterator->positionIndices.push_back(groupIterator->positionIndices[groupIterator->positionIndices.size() - 2]);
-								groupIterator->texCoordIndices.push_back(groupIterator->texCoordIndices[groupIterator->texCoordIndices.size() - 2]);
-								groupIterator->normalIndices.push_back(0);
-
-								groupIterator->positionIndices.push_back(v < 0 ? (uint) (v + positions.size()) : (uint) (v));
-								groupIterator->texCoordIndices.push_back(t < 0 ? (uint) (t + texCoords.size()) : (uint) (t));
-								groupIterator->normalIndices.push_back(0);
-							}
-
-							break;
-						}
-						else
-						{
-							iss = std::istringstream(buffer);
-							iss >> token;
-
-							// v
-							if (iss >> v)
-							{
-								groupIterator->positionIndices.push_back(v < 0 ? (uint) (v + positions.size()) : (uint) (v));
-								groupIterator->texCoordIndices.push_back(0);
-								groupIterator->normalIndices.push_back(0);
-							}
-
-							if (iss >> v)
-							{
-								groupIterator->positionIndices.push_back(v < 0 ? (uint) (v + positions.size()) : (uint) (v));
-								groupIterator->texCoordIndices.push_back(0);
-								groupIterator->normalIndices.push_back(0);
-							}
-
-							if (iss >> v)
-							{
-								groupIterator->positionIndices.push_back(v < 0 ? (uint) (v + positions.size()) : (uint) (v));
-								groupIterator->texCoordIndices.push_back(0);
-								groupIterator->normalIndices.push_back(0);
-							}
-
-							while (iss >> v)
-							{
-								groupIterator->positionIndices.push_back(groupIterator->positionIndices[groupIterator->positionIndices.size() - 3]);
-								groupIterator->texCoordIndices.push_back(0);
-								groupIterator->normalIndices.push_back(0);
-
-								groupIterator->positionIndices.push_back(groupIterator->positionIndices[groupIterator->positionIndices.size() - 2]);
-								groupIterator->texCoordIndices.push_back(0);
-								groupIterator->normalIndices.push_back(0);
-
-								groupIterator->positionIndices.push_back(v < 0 ? (uint) (v + positions.size()) : (uint) (v));
-								groupIterator->texCoordIndices.push_back(0);
-								groupIterator->normalIndices.push_back(0);
-							}
-						}
-					}
-					break;
-					}
-				}
-			}
+			if (t.texture)
+				cachedTextures.push_back(std::move(t));
+			else
+				uncachedTextures.push_back(std::move(t));
 		}
 
-		if (materials.size() <= 1)
+		textures.swap(uncachedTextures);
+
+		if (!cachedTextures.empty())
 		{
-			std::filesystem::path libraryPath = path;
-			libraryPath.replace_extension("mtl");
-			loadMtlFile(libraryPath.string(), materials, materialMap);
+			std::lock_guard<std::mutex> lock(state.mutex);
+			append(state.textures, cachedTextures);
 		}
 
-		// compute normals if not present in the file
-		if (normals.size() <= 1)
-		{
-			// compute face normals
-			for (std::list<ObjGroup>::iterator i = groupList.begin(); i != groupList.end(); i++)
-			{
-				if (i->positionIndices.size() > 0)
-				{
-					for (uint j = 0; j < i->positionIndices.size() - 2; j += 3)
-					{
-						const vec3 & p0 = positions[i->positionIndices[j + 0]];
-						const vec3 & p1 = positions[i->positionIndices[j + 1]];
-						const vec3 & p2 = positions[i->positionIndices[j + 2]];
-
-						if (i->normalIndices[j + 0] == 0 || i->normalIndices[j + 1] == 0 || i->normalIndices[j + 2] == 0)
-						{
-							if (i->normalIndices[j + 0] == 0)
-								i->normalIndices[j + 0] = uint(normals.size());
-
-							if (i->normalIndices[j + 1] == 0)
-								i->normalIndices[j + 1] = uint(normals.size());
-
-							if (i->normalIndices[j + 2] == 0)
-								i->normalIndices[j + 2] = uint(normals.size());
-
-							const vec3 a(p2 - p1);
-							const vec3 b(p0 - p1);
-							const vec3 n = normalize(cross(a, b));
-							normals.push_back(n);
-						}
-					}
-				}
-			}
+		state.textureCount = textures.size();
+
+		if (textures.empty())
+			return;
 
-			// compute vertex normals
-			std::vector< vec3 > vertexNormals(positions.size());
-			std::vector< vec3 > groupNormals(positions.size());
+		decoders = std::make_unique<ThreadPool>(unsigned(std::min<std::size_t>(textures.size(), hardwareThreadCount())));
 
-			for (std::list<ObjGroup>::iterator i = groupList.begin(); i != groupList.end(); i++)
+		for (auto& t : textures)
+		{
+			decoders->enqueue([&state, texture = std::move(t)]() mutable
 			{
-				if (i->positionIndices.size() > 0)
+				if (state.cancelled)
+					return;
+
+				if (ObjLoader::decodeTexture(texture.image.filename, texture.kind, state.colorCompression, texture.image))
 				{
-					for (uint j = 0; j < i->positionIndices.size() - 2; j += 3)
-					{
-						groupNormals[i->positionIndices[j + 0]] = groupNormals[i->positionIndices[j + 0]] + normals[i->normalIndices[j + 0]];
-						groupNormals[i->positionIndices[j + 1]] = groupNormals[i->positionIndices[j + 1]] + normals[i->normalIndices[j + 1]];
-						groupNormals[i->positionIndices[j + 2]] = groupNormals[i->positionIndices[j + 2]] + normals[i->normalIndices[j + 2]];
-					}
-
-					for (uint j = 0; j < i->positionIndices.size() - 2; j += 3)
-					{
-						vertexNormals[i->positionIndices[j + 0]] = normalize(groupNormals[i->positionIndices[j + 0]]);
-						vertexNormals[i->positionIndices[j + 1]] = normalize(groupNormals[i->positionIndices[j + 1]]);
-						vertexNormals[i->positionIndices[j + 2]] = normalize(groupNormals[i->positionIndices[j + 2]]);
-					}
-
-					for (uint j = 0; j < i->positionIndices.size() - 2; j += 3)
-					{
-						groupNormals[i->positionIndices[j + 0]] = vec3(0.0f);
-						groupNormals[i->positionIndices[j + 1]] = vec3(0.0f);
-						groupNormals[i->positionIndices[j + 2]] = vec3(0.0f);
-					}
-
-					i->normalIndices = i->positionIndices;
+					std::lock_guard<std::mutex> lock(state.mutex);
+					state.textures.push_back(std::move(texture));
 				}
-			}
 
-			normals.swap(vertexNormals);
+				state.decodedTextureCount++;
+			});
 		}
+	};
 
-		m_vertices.resize(positions.size());
+	ModelData cachedData;
+
+	if (ModelCache::read(filename, cachedData) && cachedData.chunkTriangleBudget == chunkTriangleBudget && cachedData.normalWeighting == normalWeighting && cachedData.creaseAngle == creaseAngle)
+	{
+		const std::vector<Material> materials = cachedData.materials;
 
-		for (std::list<ObjGroup>::iterator i = groupList.begin(); i != groupList.end(); i++)
 		{
-			if (i->positionIndices.size() > 0)
-			{
-				Group newGroup;
-				newGroup.name = i->name;
-				newGroup.startIndex = uint(m_indices.size());
+			std::lock_guard<std::mutex> lock(state.mutex);
+			state.indexCount = cachedData.indices.size();
+			state.vertexCountEstimate = cachedData.vertices.size();
+			state.pending = std::move(cachedData);
+			state.headerPublished = true;
+		}
+
+		state.geometryProgress = 1.0f;
+		decodeTextures(materials);
+	}
+	else
+	{
+		ObjLoader loader;
+		loader.setChunkTriangleBudget(chunkTriangleBudget);
 
-				std::unordered_map<std::string, int>::iterator j = materialMap.find(i->material);
+		if (!loader.loadObjFile(filename))
+			return finish(false);
 
-				if (j != materialMap.end())
-					newGroup.materialIndex = j->second;
-				else
-					newGroup.materialIndex = 0;
+		const vec3 modelCenter = 0.5f * (loader.minimumBounds() + loader.maximumBounds());
 
-				for (uint j = 0; j < i->positionIndices.size(); j++)
-				{
-					const uint index = i->positionIndices[j];
-
-					Vertex vertex;
-					vertex.position = positions[index];
-					vertex.normal = normals[i->normalIndices[j]];
-					vertex.texcoord = texCoords[i->texCoordIndices[j]];
-
-					if (m_vertices[index].position == vertex.position)
-					{
-						if (m_vertices[index].texcoord != vertex.texcoord || m_vertices[index].normal != vertex.normal)
-						{
-							m_indices.push_back(uint(m_vertices.size()));
-							m_vertices.push_back(vertex);
-						}
-						else
-						{
-							m_vertices[index] = vertex;
-							m_indices.push_back(index);
-						}
-					}
-					else
-					{
-						m_vertices[index] = vertex;
-						m_indices.push_back(index);
-					}
-				}
+		// everything the model cache is written from once the last group is assembled, on this thread
+		// rather than in update(), as writing a large model would stall a frame
+		ModelData assembled;
+		assembled.materials = loader.materials();
+		assembled.minimumBounds = loader.minimumBounds();
+		assembled.maximumBounds = loader.maximumBounds();
+		assembled.modelCenter = modelCenter;
+		assembled.chunkTriangleBudget = chunkTriangleBudget;
+		assembled.normalWeighting = normalWeighting;
+		assembled.creaseAngle = creaseAngle;
 
-				newGroup.endIndex = uint(m_indices.size());
-				m_groups.push_back(newGroup);
-			}
+		{
+			std::lock_guard<std::mutex> lock(state.mutex);
+			state.pending.materials = loader.materials();
+			state.pending.minimumBounds = loader.minimumBounds();
+			state.pending.maximumBounds = loader.maximumBounds();
+			state.pending.modelCenter = modelCenter;
+			state.pending.chunkTriangleBudget = chunkTriangleBudget;
+			state.pending.normalWeighting = normalWeighting;
+			state.pending.creaseAngle = creaseAngle;
+			state.indexCount = loader.indexCount();
+			state.vertexCountEstimate = loader.vertexCountEstimate();
+			state.headerPublished = true;
 		}
 
-		m_materials.reserve(materials.size());
-		
+		state.geometryProgress = parsingProgress;
+		decodeTextures(loader.materials());
+
+		loader.generateNormals(normalWeighting, creaseAngle);
 
-		for (auto & m : materials)
+		std::size_t assembledIndexCount = 0;
+
+		for (std::size_t i = 0; i < loader.groupCount(); i++)
 		{
-			Material newMaterial;
-			newMaterial.ambient = m.Ka;
-			newMaterial.diffuse = m.Kd;
-			newMaterial.specular = m.Ks;
-			newMaterial.shininess = m.Ns;
+			if (state.cancelled)
+				return finish(false);
 
-			if (!m.map_Ka.empty())
-			{
-				std::filesystem::path texturePath = m.map_Ka;
+			std::vector<Vertex> vertices;
+			std::vector<uint> indices;
+			std::vector<Meshlet> meshlets;
+			Group group;
 
-				if (!texturePath.is_absolute())
-				{
-					texturePath = path.parent_path();
-					texturePath.append(m.map_Ka);
-				}
+			if (!loader.assembleGroup(i, vertices, indices, meshlets, group))
+				continue;
 
-				newMaterial.ambientTexture = std::move(loadTexture(texturePath.string()));
-			}
+			//Group bounding box center
+			auto groupCenterOfBoundingBox = 0.5f * (group.minimumBounds + group.maximumBounds);
+			auto groupVector = normalize(groupCenterOfBoundingBox - modelCenter);
 
-			if (!m.map_Kd.empty())
-			{
-				std::filesystem::path texturePath = m.map_Kd;
+			// the simplified levels of detail are not part of the index count of the file
+			assembledIndexCount += group.endIndex - group.startIndex;
 
-				if (!texturePath.is_absolute())
-				{
-					texturePath = path.parent_path();
-					texturePath.append(m.map_Kd);
-				}
+			assembled.vertices.insert(assembled.vertices.end(), vertices.begin(), vertices.end());
+			assembled.indices.insert(assembled.indices.end(), indices.begin(), indices.end());
+			assembled.meshlets.insert(assembled.meshlets.end(), meshlets.begin(), meshlets.end());
+			assembled.groups.push_back(group);
+			assembled.groupVectors.push_back(groupVector);
 
-				newMaterial.diffuseTexture = std::move(loadTexture(texturePath.string()));
+			{
+				std::lock_guard<std::mutex> lock(state.mutex);
+				append(state.pending.vertices, vertices);
+				append(state.pending.indices, indices);
+				append(state.pending.meshlets, meshlets);
+				state.pending.groups.push_back(std::move(group));
+				state.pending.groupVectors.push_back(groupVector);
 			}
 
-			if (!m.map_Ks.empty())
-			{
-				std::filesystem::path texturePath = m.map_Ks;
+			state.geometryProgress = parsingProgress + (1.0f - parsingProgress) * float(assembledIndexCount) / float(loader.indexCount());
+		}
 
-				if (!texturePath.is_absolute())
-				{
-					texturePath = path.parent_path();
-					texturePath.append(m.map_Ks);
-				}
+		globjects::debug() << "Vertex cache miss ratio: " << loader.originalCacheMissRatio() << " before, " << loader.cacheMissRatio() << " after optimization";
 
-				newMaterial.specularTexture = std::move(loadTexture(texturePath.string()));
-			}
+		if (!state.cancelled && !ModelCache::write(filename, assembled, loader.dependencies()))
+			globjects::debug() << "Could not write model cache " << ModelCache::cacheFilename(filename);
+	}
 
-			if (!m.map_Ns.empty())
-			{
-				std::filesystem::path texturePath = m.map_Ns;
+	if (decoders)
+		decoders->wait();
 
-				if (!texturePath.is_absolute())
-				{
-					texturePath = path.parent_path();
-					texturePath.append(m.map_Ns);
-				}
+	finish(!state.cancelled);
+}
 
-				newMaterial.shininessTexture = std::move(loadTexture(texturePath.string()));
-			}
+bool Model::update()
+{
+	if (!m_loadState)
+		return false;
 
-			if (!m.map_bump.empty())
-			{
-				std::filesystem::path texturePath = m.map_bump;
+	LoadState& state = *m_loadState;
 
-				if (!texturePath.is_absolute())
-				{
-					texturePath = path.parent_path();
-					texturePath.append(m.map_bump);
-				}
+	ModelData pending;
+	std::vector<PendingTexture> textures;
+	std::size_t indexCount = 0;
+	std::size_t vertexCountEstimate = 0;
+	bool header = false;
+	bool finished = false;
 
-				newMaterial.bumpTexture = std::move(loadTexture(texturePath.string()));
-			}
-			//Assignment 2 - Object / Tangent Normal Map
-			if (!m.map_ObjectNormals.empty())
-			{
-				std::filesystem::path texturePath = m.map_ObjectNormals;
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
 
-				if (!texturePath.is_absolute())
-				{
-					texturePath = path.parent_path();
-					texturePath.append(m.map_ObjectNormals);
-				}
+		if (state.headerPublished && !state.headerTaken)
+		{
+			header = true;
+			indexCount = state.indexCount;
+			vertexCountEstimate = state.vertexCountEstimate;
+			state.headerTaken = true;
+		}
 
-				newMaterial.objectNormals = std::move(loadTexture(texturePath.string()));
-			}
+		pending = std::move(state.pending);
+		state.pending = ModelData();
+		textures.swap(state.textures);
+		finished = state.finished;
+	}
 
-			if (!m.map_TangentNormals.empty())
-			{
-				std::filesystem::path texturePath = m.map_TangentNormals;
+	if (header)
+	{
+		m_data.materials = std::move(pending.materials);
+		m_data.minimumBounds = pending.minimumBounds;
+		m_data.maximumBounds = pending.maximumBounds;
+		m_data.modelCenter = pending.modelCenter;
+		m_data.chunkTriangleBudget = pending.chunkTriangleBudget;
+		m_data.normalWeighting = pending.normalWeighting;
+		m_data.creaseAngle = pending.creaseAngle;
+		m_positionQuantization = VertexCompressor::quantization(m_data.minimumBounds, m_data.maximumBounds);
+
+		// the index ranges of the groups start at four byte boundaries, so 32 bit indices are the worst case
+		resizeIndexBuffer(indexCount * sizeof(uint));
+		resizeVertexBuffer(vertexCountEstimate);
+	}
 
-				if (!texturePath.is_absolute())
-				{
-					texturePath = path.parent_path();
-					texturePath.append(m.map_TangentNormals);
-				}
+	if (!pending.vertices.empty())
+	{
+		reserveVertices(m_data.vertices.size() + pending.vertices.size());
+		writeVertices(pending.vertices.data(), pending.vertices.size(), m_data.vertices.size());
+		append(m_data.vertices, pending.vertices);
+	}
 
-				newMaterial.tangentNormals = std::move(loadTexture(texturePath.string()));
-			}
+	append(m_data.indices, pending.indices);
+	appendIndexRanges(pending.groups);
+	append(m_data.groups, pending.groups);
+	append(m_data.meshlets, pending.meshlets);
+	append(m_data.groupVectors, pending.groupVectors);
 
-			m_materials.push_back(newMaterial);
+	auto assignTexture = [&](const PendingTexture& t)
+	{
+		for (const auto& target : t.targets)
+			m_data.materials.at(target.first).*materialTextures[target.second].texture = t.texture;
+	};
 
-		}
+	// the pixel buffers staged during the previous call have had a frame to transfer their data
+	for (auto& t : state.stagedTextures)
+	{
+		const TextureSampling sampling;
+		std::shared_ptr<Texture> texture = ObjLoader::createTexture(t.texture.image, *t.pixelBuffer, sampling);
 
-		return true;
+		t.texture.texture = TextureCache::instance().insert(t.texture.image.filename, t.texture.kind, sampling, std::move(texture), t.byteSize);
+		assignTexture(t.texture);
 	}
 
-	bool loadMtlFile(const std::string & filename, std::vector<ObjMaterial> & materials, std::unordered_map< std::string, int > & materialMap)
-	{
-		std::ifstream is(filename);
+	state.stagedTextures.clear();
 
-		if (!is.is_open())
-			return false;
+	for (auto& t : textures)
+		state.uploadQueue.push_back(std::move(t));
 
-		std::string buffer;
-		int currentMaterialIndex = 0;
+	std::size_t stagedBytes = 0;
 
-		while (is.good())
+	while (!state.uploadQueue.empty() && (stagedBytes == 0 || stagedBytes + state.uploadQueue.front().image.byteSize() <= textureUploadBudget))
+	{
+		if (state.uploadQueue.front().texture)
 		{
-			if (getline(is, buffer))
-			{
-				std::istringstream iss(buffer);
-				std::string token;
-
-				if (iss >> token)
-				{
-					if (token == "newmtl")
-					{
-						std::string materialName;
-
-						if (getline(iss, materialName))
-						{
-							materialName = trim(materialName);
-
-							auto i = materialMap.find(materialName);
-
-							if (i == materialMap.end())
-							{
-								ObjMaterial newMaterial;
-								newMaterial.name = materialName;
-								currentMaterialIndex = uint(materials.size());
-								materialMap.insert(std::make_pair(newMaterial.name, currentMaterialIndex));
-								materials.push_back(newMaterial);
-							}
-							else
-							{
-								currentMaterialIndex = i->second;
-							}
-						}
-					}
-					// Ambient Color
-					else if (token == "Ka")
-					{
-						vec3 Ka(0.0f);
-						if (iss >> Ka.x >> Ka.y >> Ka.z)
-							materials[currentMaterialIndex].Ka = Ka;
-					}
-					// Diffuse Color
-					else if (token == "Kd")
-					{
-						vec3 Kd(0.0f);
-						if (iss >> Kd.x >> Kd.y >> Kd.z)
-							materials[currentMaterialIndex].Kd = Kd;
-					}
-					// Specular Color
-					else if (token == "Ks")
-					{
-						vec3 Ks(0.0f);
-						if (iss >> Ks.x >> Ks.y >> Ks.z)
-							materials[currentMaterialIndex].Ks = Ks;
-					}
-					// Specular Exponent
-					else if (token == "Ns")
-					{
-						float Ns = 0.0f;
-						if (iss >> Ns)
-							materials[currentMaterialIndex].Ns = Ns;
-					}
-					// Dissolve
-					else if (token == "d")
-					{
-						float d = 0.0f;
-						if (iss >> d)
-							materials[currentMaterialIndex].d = d;
-					}
-					// Illumination
-					else if (token == "illum")
-					{
-						int illum = 0;
-						if (iss >> illum)
-							materials[currentMaterialIndex].illum = illum;
-					}
-					// Ambient Texture Map
-					else if (token == "map_Ka")
-					{
-						std::string map_Ka;
-						if (getline(iss, map_Ka))
-						{
-							map_Ka = trim(map_Ka);
-							materials[currentMaterialIndex].map_Ka = map_Ka;
-						}
-					}
-					// Diffuse Texture Map
-					else if (token == "map_Kd")
-					{
-						std::string map_Kd;
-						if (getline(iss, map_Kd))
-						{
-							map_Kd = trim(map_Kd);
-							materials[currentMaterialIndex].map_Kd = map_Kd;
-						}
-					}
-					// Specular Texture Map
-					else if (token == "map_Ks")
-					{
-						std::string map_Ks;
-						if (getline(iss, map_Ks))
-						{
-							map_Ks = trim(map_Ks);
-							materials[currentMaterialIndex].map_Ks = map_Ks;
-						}
-					}
-					// Specular Hightlight Map
-					else if (token == "map_Ns")
-					{
-						std::string map_Ns;
-						if (getline(iss, map_Ns))
-						{
-							map_Ns = trim(map_Ns);
-							materials[currentMaterialIndex].map_Ns = map_Ns;
-						}
-					}
-					// Alpha Texture Map
-					else if (token == "map_d")
-					{
-						std::string map_d;
-						if (getline(iss, map_d))
-						{
-							map_d = trim(map_d);
-							materials[currentMaterialIndex].map_d = map_d;
-						}
-					}
-					// Bump Map
-					else if (token == "map_bump" || token == "map_Bump" || token == "bump")
-					{
-						std::string map_bump;
-						if (getline(iss, map_bump))
-						{
-							map_bump = trim(map_bump);
-							materials[currentMaterialIndex].map_bump = map_bump;
-						}
-					}
-					//Assignment 2
-					// Object Normal Map
-					else if (token == "map_objectnormals" || token == "map_objectNormals" || token == "map_ObjectNormals" || token == "objectnormals" || token == "objectNormals")
-					{
-						std::string map_ObjectNormals;
-						if (getline(iss, map_ObjectNormals))
-						{
-							map_ObjectNormals = trim(map_ObjectNormals);
-							materials[currentMaterialIndex].map_ObjectNormals = map_ObjectNormals;
-						}
-					}
-					// Tangent Normal Map
-					else if (token == "map_tangentnormals" || token == "map_tangentNormals" || token == "map_TangentNormals" || token == "tangentnormals" || token == "tangentNormals")
-					{
-						std::string map_TangentNormals;
-						if (getline(iss, map_TangentNormals))
-						{
-							map_TangentNormals = trim(map_TangentNormals);
-							materials[currentMaterialIndex].map_TangentNormals = map_TangentNormals;
-						}
-					}
-				}
-			}
+			assignTexture(state.uploadQueue.front());
+			state.uploadQueue.pop_front();
+			continue;
 		}
 
-		return true;
+		StagedTexture staged;
+		staged.texture = std::move(state.uploadQueue.front());
+		state.uploadQueue.pop_front();
+
+		staged.pixelBuffer = ObjLoader::stageTexture(staged.texture.image);
+		staged.byteSize = staged.texture.image.byteSize();
+		stagedBytes += staged.byteSize;
+
+		// the data has been copied, only the level layout is needed from here on
+		std::vector<unsigned char>().swap(staged.texture.image.data);
+		state.stagedTextures.push_back(std::move(staged));
 	}
 
-	std::unique_ptr<Texture> loadTexture(const std::string & filename)
-	{
-		int width, height, channels;
+	if (finished && state.uploadQueue.empty() && state.stagedTextures.empty())
+		finishLoading();
 
-		stbi_set_flip_vertically_on_load(true);
-		unsigned char *data = stbi_load(filename.c_str(), &width, &height, &channels, 0);
+	return header;
+}
 
-		if (data)
-		{
-			std::cout << "Loaded " << filename << std::endl;
+void Model::finishLoading()
+{
+	LoadState& state = *m_loadState;
 
-			auto texture = Texture::create(GL_TEXTURE_2D);
-			texture->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-			texture->setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-			texture->setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
-			texture->setParameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
+	if (state.thread.joinable())
+		state.thread.join();
 
-			GLenum format = GL_RGBA;
+	if (state.cancelled)
+		globjects::debug() << "Loading of " << m_filename << " cancelled.";
+	else if (!state.succeeded)
+		globjects::debug() << "Error loading << " << m_filename << "!";
 
-			switch (channels)
-			{
-			case 1:
-				format = GL_RED;
-				break;
+	m_loadingTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - state.start).count();
 
-			case 2:
-				format = GL_RG;
-				break;
+	// the buffers grow geometrically during loading
+	if (m_vertexCapacity > m_data.vertices.size())
+		resizeVertexBuffer(m_data.vertices.size());
 
-			case 3:
-				format = GL_RGB;
-				break;
+	if (m_indexCapacity > m_indexBufferSize)
+		resizeIndexBuffer(m_indexBufferSize);
 
-			case 4:
-				format = GL_RGBA;
-				break;
-			}
-				
-			texture->image2D(0, format, ivec2(width,height), 0, format, GL_UNSIGNED_BYTE, data);
-			texture->generateMipmap();
+	m_loadState.reset();
 
-			stbi_image_free(data);
+	std::cout << "vertices: " << m_data.vertices.size() << std::endl;
+	std::cout << "indices: " << m_data.indices.size() << std::endl;
+	std::cout << "vertex buffer: " << m_vertexCapacity * vertexSize() << " bytes, index buffer: " << m_indexBufferSize << " bytes" << std::endl;
 
-			return texture;
-		}
+	globjects::debug() << "Minimum bounds: " << m_data.minimumBounds;
+	globjects::debug() << "Maximum bounds: " << m_data.maximumBounds;
+}
 
-		return std::unique_ptr<Texture>();
-	}
+void Model::cancelLoading()
+{
+	if (m_loadState)
+		m_loadState->cancelled = true;
+}
 
-	const std::vector<Group> & groups() const
-	{
-		return m_groups;
-	}
+bool Model::isLoading() const
+{
+	return m_loadState != nullptr;
+}
 
-	const std::vector<Vertex> & vertices() const
-	{
-		return m_vertices;
-	}
+double Model::loadingTime() const
+{
+	return m_loadingTime;
+}
 
-	const std::vector<uint> & indices() const
-	{
-		return m_indices;
-	}
+std::size_t Model::generation() const
+{
+	return m_generation;
+}
 
-	const std::vector<Material> & materials() const
-	{
-		return m_materials;
-	}
+float Model::loadingProgress() const
+{
+	if (!m_loadState)
+		return 1.0f;
 
-private:
+	// geometry dominates the loading time, textures are decoded concurrently
+	const float geometryShare = 0.9f;
+	const LoadState& state = *m_loadState;
+	const std::size_t textureCount = state.textureCount;
+	const float textureProgress = textureCount > 0 ? float(state.decodedTextureCount) / float(textureCount) : 1.0f;
 
-	std::vector < Group > m_groups;
-	std::vector < Vertex > m_vertices;
-	std::vector < glm::uint > m_indices;
-	std::vector < Material > m_materials;
+	return geometryShare * state.geometryProgress + (1.0f - geometryShare) * textureProgress;
+}
 
-};
+std::size_t Model::vertexSize() const
+{
+	return m_vertexFormat == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex);
+}
 
-Model::Model()
+void Model::reserveVertices(std::size_t count)
 {
+	if (count > m_vertexCapacity)
+		resizeVertexBuffer(std::max(count, 2 * m_vertexCapacity));
+}
+
+void Model::resizeVertexBuffer(std::size_t capacity)
+{
+	auto buffer = std::make_unique<Buffer>();
+	buffer->setData(capacity * vertexSize(), nullptr, GL_DYNAMIC_DRAW);
+
+	if (!m_data.vertices.empty())
+		m_vertexBuffer->copySubData(buffer.get(), 0, 0, m_data.vertices.size() * vertexSize());
+
+	m_vertexBuffer = std::move(buffer);
+	m_vertexCapacity = capacity;
 
+	bindVertexArray();
 }
 
-Model::Model(const std::string& filename)
+void Model::resizeIndexBuffer(std::size_t capacity)
 {
-	load(filename);
+	auto buffer = std::make_unique<Buffer>();
+	buffer->setData(capacity, nullptr, GL_STATIC_DRAW);
+
+	if (m_indexBufferSize > 0)
+		m_indexBuffer->copySubData(buffer.get(), 0, 0, m_indexBufferSize);
+
+	m_indexBuffer = std::move(buffer);
+	m_indexCapacity = capacity;
+
+	bindVertexArray();
 }
 
-void Model::load(const std::string& filename)
+void Model::writeVertices(const Vertex* vertices, std::size_t count, std::size_t first)
 {
-	globjects::debug() << "Loading file " << filename << " ...";
+	if (count == 0)
+		return;
+
+	if (m_vertexFormat == VertexFormat::Compact)
+	{
+		std::vector<CompactVertex> compactVertices(count);
+		VertexCompressor::encode(vertices, count, m_positionQuantization, compactVertices.data());
+		m_vertexBuffer->setSubData(compactVertices.data(), count * sizeof(CompactVertex), first * sizeof(CompactVertex));
+	}
+	else
+	{
+		m_vertexBuffer->setSubData(vertices, count * sizeof(Vertex), first * sizeof(Vertex));
+	}
+}
 
-	m_minimumBounds = vec3(std::numeric_limits<float>::max());
-	m_maximumBounds = vec3(-std::numeric_limits<float>::max());
+void Model::appendIndexRanges(const std::vector<Group>& groups)
+{
+	if (groups.empty())
+		return;
 
-	ObjLoader loader;
+	std::vector<unsigned char> data;
+	const bool allowShort = m_vertexFormat == VertexFormat::Compact;
 
-	if (loader.loadObjFile(filename))
+	auto encodeLevel = [&](uint startIndex, uint endIndex)
 	{
-		m_filename = filename;
-		m_vertices = loader.vertices();
-		m_indices = loader.indices();
-		m_materials = loader.materials();
-		m_groups = loader.groups();
-		
-
-		for (auto i : m_indices)
-		{
-			const auto & v = m_vertices[i];
-			m_minimumBounds = min(m_minimumBounds, v.position);
-			m_maximumBounds = max(m_maximumBounds, v.position);
-		}
+		std::vector<IndexRange> ranges;
+		VertexCompressor::encodeIndices(m_data.indices.data() + startIndex, endIndex - startIndex, allowShort, data, ranges);
+
+		for (auto& r : ranges)
+			r.offset += m_indexBufferSize;
 
-		m_modelCenter = 0.5f * (m_minimumBounds + m_maximumBounds);
+		return ranges;
+	};
 
-		std::cout << "vertices: " << m_vertices.size() << std::endl;
-		std::cout << "indices: " << m_indices.size() << std::endl;
+	for (const auto& g : groups)
+	{
+		// the full resolution is encoded chunk by chunk, so that every chunk can also be drawn on its own
+		std::vector<std::vector<IndexRange>> levelRanges(1);
+		std::vector<std::vector<IndexRange>> chunkRanges;
 
-		for (auto &i : m_groups) //Group bounding box center
+		for (const auto& c : g.chunks)
 		{
-			auto group_minimumBounds = vec3(std::numeric_limits<float>::max());
-			auto group_maximumBounds = vec3(-std::numeric_limits<float>::max());
+			chunkRanges.push_back(encodeLevel(c.startIndex, c.endIndex));
+			levelRanges.front().insert(levelRanges.front().end(), chunkRanges.back().begin(), chunkRanges.back().end());
+		}
 
-			for (auto j = i.startIndex; j < i.endIndex; j++)
-			{
-				auto vertexIndex = m_indices[j];
-				const auto& v = m_vertices[vertexIndex];
-				group_minimumBounds = min(group_minimumBounds, v.position);
-				group_maximumBounds = max(group_maximumBounds, v.position);
-				if (std::find(i.indexes.begin(), i.indexes.end(), vertexIndex) == i.indexes.end())
-				{
-					i.indexes.push_back(vertexIndex);
+		for (const auto& l : g.levels)
+			levelRanges.push_back(encodeLevel(l.startIndex, l.endIndex));
 
-				}
-			}
-			auto groupCenterOfBoundingBox = 0.5f * (group_minimumBounds + group_maximumBounds);
-			m_groupVectors.push_back(normalize(groupCenterOfBoundingBox - m_modelCenter)); //Add normalized vector to list
-		}
+		m_indexRanges.push_back(std::move(levelRanges));
+		m_chunkIndexRanges.push_back(std::move(chunkRanges));
+	}
 
+	// keeps the start of the next ranges aligned
+	data.resize((data.size() + 3) & ~std::size_t(3), 0);
 
-		globjects::debug() << "Minimum bounds: " << m_minimumBounds;
-		globjects::debug() << "Maximum bounds: " << m_maximumBounds;
+	if (m_indexBufferSize + data.size() > m_indexCapacity)
+		resizeIndexBuffer(std::max(m_indexBufferSize + data.size(), 2 * m_indexCapacity));
 
-		m_vertexBuffer->setStorage(m_vertices, gl::GL_DYNAMIC_STORAGE_BIT);
-		m_indexBuffer->setStorage(m_indices, gl::GL_NONE_BIT);
+	m_indexBuffer->setSubData(data.data(), data.size(), m_indexBufferSize);
+	m_indexBufferSize += data.size();
+}
 
+void Model::bindVertexArray()
+{
+	if (m_vertexFormat == VertexFormat::Compact)
+	{
 		auto vertexBindingPosition = m_vertexArray->binding(0);
 		vertexBindingPosition->setAttribute(0);
-		vertexBindingPosition->setBuffer(m_vertexBuffer.get(), 0, sizeof(Vertex));
-		vertexBindingPosition->setFormat(3, GL_FLOAT);
+		vertexBindingPosition->setBuffer(m_vertexBuffer.get(), offsetof(CompactVertex, position), sizeof(CompactVertex));
+		vertexBindingPosition->setFormat(3, GL_UNSIGNED_SHORT, GL_TRUE);
 		m_vertexArray->enable(0);
 
 		auto vertexBindingNormal = m_vertexArray->binding(1);
 		vertexBindingNormal->setAttribute(1);
-		vertexBindingNormal->setBuffer(m_vertexBuffer.get(), sizeof(vec3), sizeof(Vertex));
-		vertexBindingNormal->setFormat(3, GL_FLOAT);
+		vertexBindingNormal->setBuffer(m_vertexBuffer.get(), offsetof(CompactVertex, normal), sizeof(CompactVertex));
+		vertexBindingNormal->setFormat(2, GL_SHORT, GL_TRUE);
 		m_vertexArray->enable(1);
 
 		auto vertexBindingTexCoord = m_vertexArray->binding(2);
 		vertexBindingTexCoord->setAttribute(2);
-		vertexBindingTexCoord->setBuffer(m_vertexBuffer.get(), sizeof(vec3) + sizeof(vec3), sizeof(Vertex));
-		vertexBindingTexCoord->setFormat(2, GL_FLOAT);
+		vertexBindingTexCoord->setBuffer(m_vertexBuffer.get(), offsetof(CompactVertex, texcoord), sizeof(CompactVertex));
+		vertexBindingTexCoord->setFormat(2, GL_HALF_FLOAT);
 		m_vertexArray->enable(2);
 
 		m_vertexArray->bindElementBuffer(m_indexBuffer.get());
-
-	}
-	else
-	{
-		globjects::debug() << "Error loading << " << filename << "!";
+		return;
 	}
+
+	auto vertexBindingPosition = m_vertexArray->binding(0);
+	vertexBindingPosition->setAttribute(0);
+	vertexBindingPosition->setBuffer(m_vertexBuffer.get(), 0, sizeof(Vertex));
+	vertexBindingPosition->setFormat(3, GL_FLOAT);
+	m_vertexArray->enable(0);
+
+	auto vertexBindingNormal = m_vertexArray->binding(1);
+	vertexBindingNormal->setAttribute(1);
+	vertexBindingNormal->setBuffer(m_vertexBuffer.get(), sizeof(vec3), sizeof(Vertex));
+	vertexBindingNormal->setFormat(3, GL_FLOAT);
+	m_vertexArray->enable(1);
+
+	auto vertexBindingTexCoord = m_vertexArray->binding(2);
+	vertexBindingTexCoord->setAttribute(2);
+	vertexBindingTexCoord->setBuffer(m_vertexBuffer.get(), sizeof(vec3) + sizeof(vec3), sizeof(Vertex));
+	vertexBindingTexCoord->setFormat(2, GL_FLOAT);
+	m_vertexArray->enable(2);
+
+	m_vertexArray->bindElementBuffer(m_indexBuffer.get());
 }
 
 const std::string & Model::filename() const
@@ -1053,32 +711,115 @@ const std::string & Model::filename() const
 
 const std::vector<Group> & Model::groups() const
 {
-	return m_groups;
+	return m_data.groups;
 }
 
 const std::vector<Vertex> & Model::vertices() const
 {
-	return m_vertices;
+	return m_data.vertices;
 }
 
 const std::vector<uint> & Model::indices() const
 {
-	return m_indices;
+	return m_data.indices;
 }
 
 const std::vector<Material> & Model::materials() const
 {
-	return m_materials;
+	return m_data.materials;
+}
+
+const std::vector<Meshlet> & Model::meshlets() const
+{
+	return m_data.meshlets;
 }
 
 vec3 Model::minimumBounds() const
 {
-	return m_minimumBounds;
+	return m_data.minimumBounds;
 }
 
 vec3 Model::maximumBounds() const
 {
-	return m_maximumBounds;
+	return m_data.maximumBounds;
+}
+
+VertexFormat Model::vertexFormat() const
+{
+	return m_vertexFormat;
+}
+
+void Model::setVertexFormat(VertexFormat format)
+{
+	if (format == m_vertexFormat)
+		return;
+
+	m_vertexFormat = format;
+
+	// Both buffers are recreated in the new format. While loading, the index buffer keeps its capacity for
+	// the worst case, otherwise it is allocated with the exact size of the encoded ranges.
+	auto vertexBuffer = std::make_unique<Buffer>();
+	vertexBuffer->setData(m_vertexCapacity * vertexSize(), nullptr, GL_DYNAMIC_DRAW);
+	m_vertexBuffer = std::move(vertexBuffer);
+	writeVertices(m_data.vertices.data(), m_data.vertices.size(), 0);
+
+	if (!isLoading())
+		m_indexCapacity = 0;
+
+	auto indexBuffer = std::make_unique<Buffer>();
+	indexBuffer->setData(m_indexCapacity, nullptr, GL_STATIC_DRAW);
+	m_indexBuffer = std::move(indexBuffer);
+	m_indexBufferSize = 0;
+	m_indexRanges.clear();
+	m_chunkIndexRanges.clear();
+	appendIndexRanges(m_data.groups);
+
+	bindVertexArray();
+}
+
+const PositionQuantization& Model::positionQuantization() const
+{
+	return m_positionQuantization;
+}
+
+const std::vector<IndexRange>& Model::indexRanges(std::size_t group, std::size_t level) const
+{
+	return m_indexRanges.at(group).at(level);
+}
+
+const std::vector<IndexRange>& Model::chunkIndexRanges(std::size_t group, std::size_t chunk) const
+{
+	return m_chunkIndexRanges.at(group).at(chunk);
+}
+
+std::size_t Model::chunkTriangleBudget() const
+{
+	return m_chunkTriangleBudget;
+}
+
+void Model::setChunkTriangleBudget(std::size_t budget)
+{
+	m_chunkTriangleBudget = budget;
+}
+
+NormalWeighting Model::normalWeighting() const
+{
+	return m_normalWeighting;
+}
+
+void Model::setNormalWeighting(NormalWeighting weighting)
+{
+	m_normalWeighting = weighting;
+}
+
+float Model::creaseAngle() const
+{
+	return m_creaseAngle;
+}
+
+void Model::setCreaseAngle(float angle)
+{
+	m_creaseAngle = angle;
 }
 
 VertexArray & Model::vertexArray()
@@ -1099,10 +840,10 @@ Buffer & Model::indexBuffer()
 //
 vec3 Model::modelCenter() const
 {
-	return m_modelCenter;
+	return m_data.modelCenter;
 }
 
 const std::vector<glm::vec3>& Model::groupVectors() const
 {
-	return m_groupVectors;
+	return m_data.groupVectors;
 }
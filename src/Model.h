@@ -1,6 +1,7 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
 #include <glbinding/gl/gl.h>
 #include <glbinding/gl/enum.h>
 #include <glbinding/gl/functions.h>
@@ -20,19 +21,106 @@ namespace minity
 		glm::vec2 texcoord;
 	};
 
+	// layout of the vertices in the vertex buffer
+	enum class VertexFormat
+	{
+		// Vertex as it is
+		Full,
+		// CompactVertex, decoded in the vertex shader
+		Compact
+	};
+
+	// Vertex in half the size: the position quantized to 16 bits per component relative to the model
+	// bounds, the normal octahedral-encoded into two 16 bit signed normalized values and the texture
+	// coordinates as half floats.
+	struct CompactVertex
+	{
+		// the fourth component is unused and keeps the following attributes aligned
+		glm::u16vec4 position = glm::u16vec4(0);
+		glm::uint normal = 0;
+		glm::uint texcoord = 0;
+	};
+
+	// maps quantized positions in [0,1] back to object space as offset + scale * position
+	struct PositionQuantization
+	{
+		glm::vec3 offset = glm::vec3(0.0f);
+		glm::vec3 scale = glm::vec3(1.0f);
+	};
+
+	// where a part of the indices of a group is stored in the index buffer and how it is drawn
+	struct IndexRange
+	{
+		gl::GLenum type = gl::GL_UNSIGNED_INT;
+		// in bytes from the start of the index buffer
+		std::size_t offset = 0;
+		glm::uint count = 0;
+		// added to every index, 16 bit indices are relative to the first vertex used by the group
+		glm::uint baseVertex = 0;
+	};
+
+	// Cluster of consecutive triangles of a group, small enough to be culled on its own. The meshlets of a
+	// group cover all of its indices in order.
+	struct Meshlet
+	{
+		glm::uint startIndex = 0;
+		glm::uint endIndex = 0;
+		glm::uint vertexCount = 0;
+
+		// bounding sphere
+		glm::vec3 center = glm::vec3(0.0f);
+		float radius = 0.0f;
+
+		// Normal cone: all triangles face away from a camera at position p if
+		// dot(normalize(coneApex - p), coneAxis) > coneCutoff. The cutoff is 1 if the normals spread too far.
+		glm::vec3 coneApex = glm::vec3(0.0f);
+		glm::vec3 coneAxis = glm::vec3(0.0f);
+		float coneCutoff = 1.0f;
+	};
+
+	// Spatially coherent part of the triangles of a group, culled on its own. Groups with more triangles than the
+	// chunk budget are split into several chunks when they are loaded, all others consist of a single one.
+	struct Chunk
+	{
+		glm::uint startIndex = 0;
+		glm::uint endIndex = 0;
+		glm::vec3 minimumBounds = glm::vec3(0.0f);
+		glm::vec3 maximumBounds = glm::vec3(0.0f);
+	};
+
+	// simplified version of the triangles of a group, drawn instead of the group when its error is small on screen
+	struct LevelOfDetail
+	{
+		glm::uint startIndex = 0;
+		glm::uint endIndex = 0;
+		// upper bound for the distance of the simplified surface from the original one, in object space
+		float error = 0.0f;
+	};
+
 	struct Group
 	{
 		std::string name;
 		glm::uint materialIndex = 0;
 		glm::uint startIndex = 0;
 		glm::uint endIndex = 0;
+		// chunks covering the indices of the group in order
+		std::vector<Chunk> chunks = std::vector<Chunk>{};
+		// range in the meshlets of the model
+		glm::uint startMeshlet = 0;
+		glm::uint endMeshlet = 0;
+		glm::vec3 minimumBounds = glm::vec3(0.0f);
+		glm::vec3 maximumBounds = glm::vec3(0.0f);
 		
 		glm::uint count() const
 		{
 			return endIndex - startIndex + 1;
 		}
 		
+		// distinct vertices used by the group, in the order of their first use
 		std::vector<glm::uint> indexes = std::vector<glm::uint>{};
+
+		// simplified versions of the group from fine to coarse, their indices follow those of the group
+		std::vector<LevelOfDetail> levels = std::vector<LevelOfDetail>{};
 	};
 
 	struct Material
@@ -50,6 +138,44 @@ namespace minity
 		std::shared_ptr<globjects::Texture> bumpTexture;
 		std::shared_ptr<globjects::Texture> objectNormals;
 		std::shared_ptr<globjects::Texture> tangentNormals;
+
+		// resolved image files of the texture maps above, empty if a map is not used
+		std::string ambientTexturePath;
+		std::string diffuseTexturePath;
+		std::string specularTexturePath;
+		std::string shininessTexturePath;
+		std::string bumpTexturePath;
+		std::string objectNormalsPath;
+		std::string tangentNormalsPath;
+	};
+
+	// how face normals contribute to generated vertex normals
+	enum class NormalWeighting
+	{
+		Angle,
+		Area
+	};
+
+	// CPU side contents of a model, as produced by the OBJ loader or read from the model cache
+	struct ModelData
+	{
+		std::vector < Group > groups;
+		std::vector < Vertex > vertices;
+		std::vector < glm::uint > indices;
+		std::vector < Material > materials;
+		std::vector < Meshlet > meshlets;
+
+		glm::vec3 minimumBounds = glm::vec3(0.0);
+		glm::vec3 maximumBounds = glm::vec3(0.0);
+		//
+		glm::vec3 modelCenter = glm::vec3(0.0);
+		std::vector < glm::vec3 > groupVectors;
+
+		// the number of triangles the groups were split into chunks of
+		std::size_t chunkTriangleBudget = 0;
+		// how missing normals were generated, see ObjLoader::generateNormals()
+		NormalWeighting normalWeighting = NormalWeighting::Angle;
+		float creaseAngle = 60.0f;
 	};
 
 	class Model
@@ -57,13 +183,38 @@ namespace minity
 	public:
 		Model();
 		Model(const std::string& filename);
+		~Model();
+
+		// loads the model and returns when it is completely available
 		void load(const std::string& filename);
+
+		// Starts loading the model on a background thread. Bounds and materials become available first,
+		// then the groups one after another, while textures are decoded concurrently and filled into the
+		// materials as their uploads complete; update() has to be called on the GL thread (once per frame)
+		// to take them over. Until then, the model only contains the groups loaded so far.
+		void loadAsync(const std::string& filename);
+
+		// uploads everything the background loader has published since the last call,
+		// returns true if the bounds of the model changed
+		bool update();
+
+		// stops the background loader, the groups loaded so far remain available
+		void cancelLoading();
+		bool isLoading() const;
+		// approximate fraction of the loading work done so far
+		float loadingProgress() const;
+		// in seconds from the start of loading until everything including the textures was available, 0 while loading
+		double loadingTime() const;
+		// incremented by every load, identifies the contents of the model for those that derive data from it
+		std::size_t generation() const;
+
 		const std::string & filename() const;
 
 		const std::vector<Group> & groups() const;
 		const std::vector<Vertex> & vertices() const;
 		const std::vector<glm::uint> & indices() const;
 		const std::vector<Material> & materials() const;
+		const std::vector<Meshlet> & meshlets() const;
 
 		glm::vec3 minimumBounds() const;
 		glm::vec3 maximumBounds() const;
@@ -71,24 +222,70 @@ namespace minity
 		glm::vec3 modelCenter() const;
 		const std::vector<glm::vec3>& groupVectors() const;
 
+		// The layout of the vertex and index buffers. The compact format is optional, as quantization
+		// loses precision; the CPU side vertices above always keep the full precision.
+		VertexFormat vertexFormat() const;
+		// re-encodes the buffers if the model is already (partially) loaded
+		void setVertexFormat(VertexFormat format);
+		// has to be applied to the positions in the vertex shader for the compact format
+		const PositionQuantization& positionQuantization() const;
+		// The ranges a group is drawn with, one for each part of the group that is encoded separately. Level 0
+		// is the group itself, level l > 0 the simplified version in group.levels[l - 1].
+		const std::vector<IndexRange>& indexRanges(std::size_t group, std::size_t level = 0) const;
+
+		// the ranges the given chunk of a group is drawn with at full resolution, part of those of level 0
+		const std::vector<IndexRange>& chunkIndexRanges(std::size_t group, std::size_t chunk) const;
+
+		// Groups with more triangles are split into chunks by the following loads, 64k by default and 0 to keep
+		// every group in one chunk. A cached model is only used if it was split with the same budget.
+		std::size_t chunkTriangleBudget() const;
+		void setChunkTriangleBudget(std::size_t budget);
+
+		// How the following loads generate normals for files without them, weighted by the corner angle and
+		// split at creases of 60 degrees by default. A cached model is only used if it was loaded the same way.
+		NormalWeighting normalWeighting() const;
+		void setNormalWeighting(NormalWeighting weighting);
+		// in degrees
+		float creaseAngle() const;
+		void setCreaseAngle(float angle);
+
 		globjects::VertexArray & vertexArray();
 		globjects::Buffer & vertexBuffer();
 		globjects::Buffer & indexBuffer();
 
 	private:
+		struct LoadState;
+
+		static void runLoader(LoadState& state, const std::string& filename, std::size_t chunkTriangleBudget, NormalWeighting normalWeighting, float creaseAngle);
+
+		std::size_t vertexSize() const;
+		void reserveVertices(std::size_t count);
+		void resizeVertexBuffer(std::size_t capacity);
+		void resizeIndexBuffer(std::size_t capacity);
+		void writeVertices(const Vertex* vertices, std::size_t count, std::size_t first);
+		void appendIndexRanges(const std::vector<Group>& groups);
+		void bindVertexArray();
+		void finishLoading();
 
 		std::string m_filename;
-		
-		std::vector < Group > m_groups;
-		std::vector < Vertex > m_vertices;
-		std::vector < glm::uint > m_indices;
-		std::vector < Material > m_materials;
+		ModelData m_data;
 
-		glm::vec3 m_minimumBounds = glm::vec3(0.0);
-		glm::vec3 m_maximumBounds = glm::vec3(0.0);
-		//
-		glm::vec3 m_modelCenter = glm::vec3(0.0);
-		std::vector < glm::vec3 > m_groupVectors;
+		std::unique_ptr<LoadState> m_loadState;
+		double m_loadingTime = 0.0;
+		std::size_t m_generation = 0;
+		std::size_t m_vertexCapacity = 0;
+		// in bytes, as the index ranges of the groups may have different index types
+		std::size_t m_indexCapacity = 0;
+		std::size_t m_indexBufferSize = 0;
+
+		VertexFormat m_vertexFormat = VertexFormat::Full;
+		PositionQuantization m_positionQuantization;
+		// per group and level of detail, and per group and chunk
+		std::vector<std::vector<std::vector<IndexRange>>> m_indexRanges;
+		std::vector<std::vector<std::vector<IndexRange>>> m_chunkIndexRanges;
+		std::size_t m_chunkTriangleBudget = 64 * 1024;
+		NormalWeighting m_normalWeighting = NormalWeighting::Angle;
+		float m_creaseAngle = 60.0f;
 
 		std::unique_ptr<globjects::VertexArray> m_vertexArray = std::make_unique<globjects::VertexArray>();
 		std::unique_ptr<globjects::Buffer> m_vertexBuffer = std::make_unique<globjects::Buffer>();
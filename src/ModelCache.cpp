@@ -0,0 +1,272 @@
+#include "ModelCache.h"
+#include "Model.h"
+#include "MappedFile.h"
+#include "CacheFile.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+
+using namespace minity;
+using namespace glm;
+
+const unsigned int ModelCache::version = 10;
+
+namespace
+{
+	const char cacheMagic[8] = { 'M', 'I', 'N', 'I', 'T', 'Y', '\r', '\n' };
+
+	// all texture paths of a material, in the order they are stored in the cache
+	template <typename MaterialType>
+	auto texturePaths(MaterialType& material)
+	{
+		return std::array<decltype(&material.ambientTexturePath), 7>{
+			&material.ambientTexturePath,
+			&material.diffuseTexturePath,
+			&material.specularTexturePath,
+			&material.shininessTexturePath,
+			&material.bumpTexturePath,
+			&material.objectNormalsPath,
+			&material.tangentNormalsPath
+		};
+	}
+}
+
+std::string ModelCache::cacheFilename(const std::string& filename)
+{
+	std::filesystem::path path(filename);
+	path.replace_extension("minity");
+	return path.string();
+}
+
+bool ModelCache::read(const std::string& filename, ModelData& data)
+{
+	FileStamp source;
+
+	if (!stampFile(filename, source))
+		return false;
+
+	MappedFile file(cacheFilename(filename));
+
+	if (!file.isOpen())
+		return false;
+
+	CacheReader reader(file.begin(), file.end());
+
+	char magic[sizeof(cacheMagic)] = {};
+	std::uint32_t fileVersion = 0;
+	std::uint32_t vertexSize = 0;
+	std::uint32_t indexSize = 0;
+
+	reader.readBytes(magic, sizeof(magic)).read(fileVersion).read(vertexSize).read(indexSize);
+
+	if (!reader || std::memcmp(magic, cacheMagic, sizeof(magic)) != 0 || fileVersion != version || vertexSize != sizeof(Vertex) || indexSize != sizeof(uint))
+		return false;
+
+	// The first dependency is the model file itself, the others are material libraries, including those that
+	// were looked up but did not exist, so that the cache is rebuilt once they are added.
+	std::uint64_t dependencyCount = 0;
+
+	if (!reader.read(dependencyCount) || dependencyCount == 0)
+		return false;
+
+	for (std::uint64_t i = 0; i < dependencyCount; i++)
+	{
+		FileStamp cached;
+
+		if (!reader.readStamp(cached))
+			return false;
+
+		FileStamp current;
+
+		if (i == 0)
+			current = source;
+		else if (!stampFile(cached.path, current))
+			current = missingFileStamp(cached.path);
+
+		if (!(current == cached))
+			return false;
+	}
+
+	vec3 minimumBounds(0.0f);
+	vec3 maximumBounds(0.0f);
+	vec3 modelCenter(0.0f);
+
+	std::uint64_t chunkTriangleBudget = 0;
+	std::uint32_t normalWeighting = 0;
+	float creaseAngle = 0.0f;
+
+	reader.read(minimumBounds).read(maximumBounds).read(modelCenter).read(chunkTriangleBudget).read(normalWeighting).read(creaseAngle);
+
+	std::uint64_t materialCount = 0;
+	reader.read(materialCount);
+
+	std::vector<Material> materials;
+
+	for (std::uint64_t i = 0; reader && i < materialCount; i++)
+	{
+		Material material;
+		reader.readString(material.name).read(material.ambient).read(material.diffuse).read(material.specular).read(material.shininess);
+
+		for (auto path : texturePaths(material))
+			reader.readString(*path);
+
+		materials.push_back(std::move(material));
+	}
+
+	std::uint64_t groupCount = 0;
+	reader.read(groupCount);
+
+	std::vector<Group> groups;
+
+	for (std::uint64_t i = 0; reader && i < groupCount; i++)
+	{
+		Group group;
+		reader.readString(group.name).read(group.materialIndex).read(group.startIndex).read(group.endIndex).read(group.startMeshlet).read(group.endMeshlet).read(group.minimumBounds).read(group.maximumBounds).readArray(group.indexes).readArray(group.chunks).readArray(group.levels);
+		groups.push_back(std::move(group));
+	}
+
+	std::vector<vec3> groupVectors;
+	std::vector<Vertex> vertices;
+	std::vector<uint> indices;
+	std::vector<Meshlet> meshlets;
+
+	reader.readArray(groupVectors).readArray(vertices).readArray(indices).readArray(meshlets);
+
+	if (!reader || groupVectors.size() != groups.size())
+		return false;
+
+	// a damaged cache must not lead to out-of-bounds accesses in the renderers
+	for (auto i : indices)
+	{
+		if (i >= vertices.size())
+			return false;
+	}
+
+	for (const auto& g : groups)
+	{
+		if (g.materialIndex >= materials.size() || g.startIndex > g.endIndex || g.endIndex > indices.size())
+			return false;
+
+		if (g.startMeshlet > g.endMeshlet || g.endMeshlet > meshlets.size())
+			return false;
+
+		for (auto m = g.startMeshlet; m < g.endMeshlet; m++)
+		{
+			if (meshlets[m].startIndex < g.startIndex || meshlets[m].startIndex > meshlets[m].endIndex || meshlets[m].endIndex > g.endIndex)
+				return false;
+		}
+
+		for (const auto& c : g.chunks)
+		{
+			if (c.startIndex < g.startIndex || c.startIndex > c.endIndex || c.endIndex > g.endIndex)
+				return false;
+		}
+
+		for (const auto& l : g.levels)
+		{
+			if (l.startIndex > l.endIndex || l.endIndex > indices.size())
+				return false;
+		}
+
+		for (auto i : g.indexes)
+		{
+			if (i >= vertices.size())
+				return false;
+		}
+	}
+
+	data.minimumBounds = minimumBounds;
+	data.maximumBounds = maximumBounds;
+	data.modelCenter = modelCenter;
+	data.chunkTriangleBudget = std::size_t(chunkTriangleBudget);
+	data.normalWeighting = NormalWeighting(normalWeighting);
+	data.creaseAngle = creaseAngle;
+	data.materials = std::move(materials);
+	data.groups = std::move(groups);
+	data.groupVectors = std::move(groupVectors);
+	data.vertices = std::move(vertices);
+	data.indices = std::move(indices);
+	data.meshlets = std::move(meshlets);
+
+	return true;
+}
+
+bool ModelCache::write(const std::string& filename, const ModelData& data, const std::vector<std::string>& dependencies)
+{
+	std::vector<FileStamp> stamps(1);
+
+	if (!stampFile(filename, stamps.front()))
+		return false;
+
+	for (const auto& d : dependencies)
+	{
+		FileStamp stamp;
+
+		if (!stampFile(d, stamp))
+			stamp = missingFileStamp(d);
+
+		stamps.push_back(stamp);
+	}
+
+	CacheWriter writer(cacheFilename(filename));
+
+	if (!writer)
+		return false;
+
+	writer.writeBytes(cacheMagic, sizeof(cacheMagic));
+	writer.write(std::uint32_t(version));
+	writer.write(std::uint32_t(sizeof(Vertex)));
+	writer.write(std::uint32_t(sizeof(uint)));
+
+	writer.write(std::uint64_t(stamps.size()));
+
+	for (const auto& s : stamps)
+		writer.writeStamp(s);
+
+	writer.write(data.minimumBounds);
+	writer.write(data.maximumBounds);
+	writer.write(data.modelCenter);
+	writer.write(std::uint64_t(data.chunkTriangleBudget));
+	writer.write(std::uint32_t(data.normalWeighting));
+	writer.write(data.creaseAngle);
+
+	writer.write(std::uint64_t(data.materials.size()));
+
+	for (const auto& m : data.materials)
+	{
+		writer.writeString(m.name);
+		writer.write(m.ambient);
+		writer.write(m.diffuse);
+		writer.write(m.specular);
+		writer.write(m.shininess);
+
+		for (auto path : texturePaths(m))
+			writer.writeString(*path);
+	}
+
+	writer.write(std::uint64_t(data.groups.size()));
+
+	for (const auto& g : data.groups)
+	{
+		writer.writeString(g.name);
+		writer.write(g.materialIndex);
+		writer.write(g.startIndex);
+		writer.write(g.endIndex);
+		writer.write(g.startMeshlet);
+		writer.write(g.endMeshlet);
+		writer.write(g.minimumBounds);
+		writer.write(g.maximumBounds);
+		writer.writeArray(g.indexes);
+		writer.writeArray(g.chunks);
+		writer.writeArray(g.levels);
+	}
+
+	writer.writeArray(data.groupVectors);
+	writer.writeArray(data.vertices);
+	writer.writeArray(data.indices);
+	writer.writeArray(data.meshlets);
+
+	return writer.close();
+}
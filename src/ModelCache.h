@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace minity
+{
+	struct ModelData;
+
+	// Binary cache of a fully processed model, stored as "<name>.minity" next to the source file.
+	// It contains the final vertex and index arrays in the layout they are uploaded with, including the levels of
+	// detail, plus groups, meshlets, materials (with resolved texture paths) and bounds, so that later loads need
+	// no parsing at all.
+	// The cache records path, size and modification time of every file the model was built from
+	// and is only used while all of them are unchanged.
+	class ModelCache
+	{
+	public:
+		// has to be increased whenever the file layout or the processing that produces the cached data changes
+		static const unsigned int version;
+
+		static std::string cacheFilename(const std::string& filename);
+
+		static bool read(const std::string& filename, ModelData& data);
+		static bool write(const std::string& filename, const ModelData& data, const std::vector<std::string>& dependencies);
+	};
+}
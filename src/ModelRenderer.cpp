@@ -188,6 +188,16 @@ std::vector<mat4> viewList;
 std::vector<mat4> lightList;
 
 
+const ModelRenderer::Statistics& ModelRenderer::statistics() const
+{
+	return m_statistics;
+}
+
+const char* ModelRenderer::name() const
+{
+	return "Model";
+}
+
 void ModelRenderer::display()
 {
 	// Save OpenGL state
@@ -219,21 +229,21 @@ void ModelRenderer::display()
 	const std::vector<Material> & materials = viewer()->scene()->model()->materials();
 
 	static std::vector<bool> groupEnabled(groups.size(), true);
+	// groups are added while a model is loading, and a new model replaces them
+	groupEnabled.resize(groups.size(), true);
 	static bool wireframeEnabled = true;
 	static bool lightSourceEnabled = true;
 	static vec4 wireframeLineColor = vec4(1.0f);
+	// the group picked with the mouse is blended with the highlight color by its alpha
+	static vec4 highlightColor = vec4(1.0f, 0.6f, 0.1f, 0.5f);
+	const Selection& selection = viewer()->scene()->selection();
 
 	//New menu options for Shader
 	static bool blinnPhongEnabled = false;
-	static bool ambientEnabled = true;
-	static bool diffuseEnabled = true;
-	static bool specularEnabled = true;
 	static bool toonEnabled = false;
 	static int shaderMenu = 1;
-	//Light options
-	static vec3 worldLightIntensity = vec3(1,1,1);
-	static vec3 ambientLightIntensity = vec3(0.1f,0.08f,0.06f);
-	static float shininessMultiplier = 1.0f;
+	//Light options, shared with the ray tracer
+	Lighting& lighting = viewer()->scene()->lighting();
 
 	//Normal mapping
 	static int normalMenu = 0;
@@ -245,7 +255,24 @@ void ModelRenderer::display()
 	//Assignment 3
 	//Animation
 	static float explodedFloat = 0;
+	static bool compactVertices = viewer()->scene()->model()->vertexFormat() == VertexFormat::Compact;
+	static int normalWeighting = int(viewer()->scene()->model()->normalWeighting());
+	static float creaseAngle = viewer()->scene()->model()->creaseAngle();
+	// in units of 1024 triangles
+	static int chunkTriangleBudget = int(viewer()->scene()->model()->chunkTriangleBudget() / 1024);
 	const std::vector<vec3>& groupVectors = viewer()->scene()->model()->groupVectors();
+
+	//Level of detail
+	static bool levelOfDetailEnabled = true;
+	static float levelOfDetailPixelError = 1.0f;
+	static bool levelOfDetailFade = true;
+	// per group: the level drawn, the level it replaced and how far the cross-fade between them has progressed
+	static std::vector<uint> groupLevels;
+	static std::vector<uint> fadingLevels;
+	static std::vector<float> fadeProgress;
+	groupLevels.resize(groups.size(), 0);
+	fadingLevels.resize(groups.size(), 0);
+	fadeProgress.resize(groups.size(), 1.0f);
 	
 
 	if (viewer()->doKeyFrame())
@@ -308,22 +335,8 @@ void ModelRenderer::display()
 					newLight = interpolateMatrix((animationFloat - 2), lightList.at(1), lightList.at(2), lightList.at(3), lightList.at(3));
 				}
 
-				std::vector<Vertex> vertices = viewer()->scene()->model()->vertices(); 
-				for (uint i = 0; i < groups.size(); i++) 
-				{
-					auto& group = groups.at(i); 
-					auto vector = groupVectors.at(i); 
-
-					for (auto j : group.indexes) 
-					{
-						Vertex& vertex = vertices.at(j); 
-						vertex.position += (explodedFloat * vector); 
-					}
-
-				}
 				viewer()->setLightTransform(newLight);
 				viewer()->setViewTransform(newView);
-				viewer()->scene()->model()->vertexBuffer().setSubData(vertices);
 				animationFloat += 0.005;
 			}
 		} else 
@@ -332,6 +345,120 @@ void ModelRenderer::display()
 	else { animationFloat = 0; viewer()->animationDone();}
 	
 
+	// Exploding moves every group along its vector, the vertex shader adds the offset of the group being drawn,
+	// so the vertex buffer is never touched after loading.
+	std::vector<vec3> groupOffsets(groups.size(), vec3(0.0f));
+
+	for (uint i = 0; i < groups.size() && i < groupVectors.size(); i++)
+		groupOffsets[i] = explodedFloat * groupVectors.at(i);
+
+	// picking has to hit the groups where they are drawn
+	viewer()->scene()->groupOffsets() = groupOffsets;
+
+	// The chunks of all groups are culled against the view frustum in model space, a group is visible if any of
+	// its chunks is. Exploded groups are culled at their offset positions.
+	static bool frustumCullingEnabled = true;
+	std::vector<std::size_t> firstChunks(groups.size() + 1, 0);
+	m_chunkCuller.clear();
+
+	for (uint i = 0; i < groups.size(); i++)
+	{
+		firstChunks[i] = m_chunkCuller.boxCount();
+
+		for (const Chunk& chunk : groups.at(i).chunks)
+			m_chunkCuller.addBox(chunk.minimumBounds + groupOffsets[i], chunk.maximumBounds + groupOffsets[i]);
+	}
+
+	firstChunks[groups.size()] = m_chunkCuller.boxCount();
+
+	if (frustumCullingEnabled)
+		m_chunkCuller.cull(FrustumCuller::frustumPlanes(modelViewProjectionMatrix), m_chunkVisibility);
+	else
+		m_chunkVisibility.assign(m_chunkCuller.boxCount(), 1);
+
+	// The coarsest level of every group is chosen whose error, projected at the distance of the group's bounding
+	// sphere, stays below the allowed number of pixels. The scale of the model view transform applies to both.
+	const float fadeDuration = 0.25f;
+	const float modelViewScale = length(vec3(modelViewMatrix[0]));
+	const bool perspectiveProjection = projectionMatrix[2][3] != 0.0f;
+	// pixels per view space unit, at unit distance for perspective projections
+	const float pixelScale = 0.5f * viewportSize.y * projectionMatrix[1][1];
+
+	auto levelTriangles = [&](const Group& group, uint level)
+	{
+		return level == 0 ? (group.endIndex - group.startIndex) / 3 : (group.levels.at(level - 1).endIndex - group.levels.at(level - 1).startIndex) / 3;
+	};
+
+	std::vector<bool> groupVisible(groups.size(), false);
+	std::size_t groupTriangles = 0;
+	Statistics statistics;
+
+	for (uint i = 0; i < groups.size(); i++)
+	{
+		const Group& group = groups.at(i);
+		uint level = 0;
+
+		if (levelOfDetailEnabled)
+		{
+			const vec3 center = vec3(modelViewMatrix * vec4(0.5f * (group.minimumBounds + group.maximumBounds) + groupOffsets[i], 1.0f));
+			const float radius = 0.5f * modelViewScale * length(group.maximumBounds - group.minimumBounds);
+			const float distance = perspectiveProjection ? length(center) - radius : 1.0f;
+
+			// the camera inside the bounding sphere always gets the full resolution
+			if (distance > 0.0f)
+			{
+				level = uint(group.levels.size());
+
+				while (level > 0 && modelViewScale * group.levels.at(level - 1).error * pixelScale / distance > levelOfDetailPixelError)
+					level--;
+			}
+		}
+
+		if (level != groupLevels[i])
+		{
+			fadingLevels[i] = groupLevels[i];
+			groupLevels[i] = level;
+			fadeProgress[i] = levelOfDetailFade ? 0.0f : 1.0f;
+		}
+		else
+		{
+			fadeProgress[i] = std::min(fadeProgress[i] + ImGui::GetIO().DeltaTime / fadeDuration, 1.0f);
+		}
+
+		if (!groupEnabled.at(i))
+			continue;
+
+		groupTriangles += levelTriangles(group, 0);
+
+		for (std::size_t c = firstChunks[i]; c < firstChunks[i + 1]; c++)
+		{
+			if (m_chunkVisibility[c])
+			{
+				groupVisible[i] = true;
+				statistics.drawnChunks++;
+
+				if (level == 0)
+					statistics.drawnTriangles += (group.chunks.at(c - firstChunks[i]).endIndex - group.chunks.at(c - firstChunks[i]).startIndex) / 3;
+			}
+			else
+			{
+				statistics.culledChunks++;
+			}
+		}
+
+		if (groupVisible[i])
+		{
+			statistics.drawnGroups++;
+
+			if (level > 0)
+				statistics.drawnTriangles += levelTriangles(group, level);
+		}
+		else
+		{
+			statistics.culledGroups++;
+		}
+	}
+
 	if (ImGui::BeginMenu("Model"))
 	{
 		//Shader
@@ -349,31 +476,19 @@ void ModelRenderer::display()
 		ImGui::RadioButton("No bumb mapping", &bumpMenu, 0);
 		ImGui::RadioButton("Bump funciton 1", &bumpMenu, 1);
 		ImGui::RadioButton("Bump funciton 2", &bumpMenu, 2);
+		//Vertex format
+		ImGui::Separator();
+		if (ImGui::Checkbox("Compact Vertices", &compactVertices))
+			viewer()->scene()->model()->setVertexFormat(compactVertices ? VertexFormat::Compact : VertexFormat::Full);
 		//Animation
 		ImGui::Separator();
-		if (ImGui::SliderFloat("Explode", &explodedFloat, 0, 5)) 
-		{
-
-			std::vector<Vertex> vertices = viewer()->scene()->model()->vertices();
-			for (uint i = 0; i < groups.size(); i++)
-			{ 
-				auto& group = groups.at(i);
-				auto vector = groupVectors.at(i);
-
-				for (auto j : group.indexes)
-				{
-					Vertex& vertex = vertices.at(j);
-					vertex.position += ((explodedFloat)*vector);
-				}
-				
-			}
-			viewer()->scene()->model()->vertexBuffer().setSubData(vertices);
-		}
+		ImGui::SliderFloat("Explode", &explodedFloat, 0, 5);
 
 
 
 		ImGui::Separator();
 		ImGui::Checkbox("Light Source Enabled", &lightSourceEnabled);
+		ImGui::ColorEdit4("Highlight Color", (float*)&highlightColor, ImGuiColorEditFlags_AlphaBar);
 
 		
 		
@@ -390,12 +505,12 @@ void ModelRenderer::display()
 		{
 			if (ImGui::CollapsingHeader("Blinn-Phong"))
 			{
-				ImGui::Checkbox("Ambient Enabled", &ambientEnabled);
-				ImGui::Checkbox("Diffuse Enabled", &diffuseEnabled);
-				ImGui::Checkbox("Specular Enabled", &specularEnabled);
-				ImGui::ColorEdit3("World Light Intensity", (float*)&worldLightIntensity, ImGuiColorEditFlags_AlphaBar);
-				ImGui::ColorEdit3("Ambient Light Intensity", (float*)&ambientLightIntensity, ImGuiColorEditFlags_AlphaBar);
-				ImGui::SliderFloat("Shininess Multiplier", &shininessMultiplier, 0.0f, 100.0f);
+				ImGui::Checkbox("Ambient Enabled", &lighting.ambientEnabled);
+				ImGui::Checkbox("Diffuse Enabled", &lighting.diffuseEnabled);
+				ImGui::Checkbox("Specular Enabled", &lighting.specularEnabled);
+				ImGui::ColorEdit3("World Light Intensity", (float*)&lighting.lightIntensity, ImGuiColorEditFlags_AlphaBar);
+				ImGui::ColorEdit3("Ambient Light Intensity", (float*)&lighting.ambientLightIntensity, ImGuiColorEditFlags_AlphaBar);
+				ImGui::SliderFloat("Shininess Multiplier", &lighting.shininessMultiplier, 0.0f, 100.0f);
 
 			}
 		}
@@ -414,6 +529,60 @@ void ModelRenderer::display()
 
 
 
+		if (ImGui::CollapsingHeader("Level of Detail"))
+		{
+			ImGui::Checkbox("Level of Detail Enabled", &levelOfDetailEnabled);
+			ImGui::SliderFloat("Pixel Error", &levelOfDetailPixelError, 0.1f, 10.0f);
+			ImGui::Checkbox("Cross-Fade", &levelOfDetailFade);
+			ImGui::Text("Triangles: %zu of %zu", statistics.drawnTriangles, groupTriangles);
+
+			for (uint i = 0; i < groups.size(); i++)
+			{
+				const Group& group = groups.at(i);
+				ImGui::Text("%s: level %u of %zu, %u triangles", group.name.c_str(), groupLevels[i], group.levels.size(), levelTriangles(group, groupLevels[i]));
+			}
+		}
+
+		if (ImGui::CollapsingHeader("Culling"))
+		{
+			ImGui::Checkbox("Frustum Culling Enabled", &frustumCullingEnabled);
+			ImGui::Text("Groups: %zu drawn, %zu culled", statistics.drawnGroups, statistics.culledGroups);
+			ImGui::Text("Chunks: %zu drawn, %zu culled", statistics.drawnChunks, statistics.culledChunks);
+			ImGui::Text("Triangles: %zu", statistics.drawnTriangles);
+			// counted while drawing, so this is the number of the previous frame
+			ImGui::Text("Draw calls: %zu", m_statistics.drawCalls);
+
+			// groups are split into chunks while loading, so a new budget reloads the model, 0 keeps every group whole
+			ImGui::SliderInt("Chunk Triangles", &chunkTriangleBudget, 0, 1024, "%dk");
+
+			if (ImGui::IsItemDeactivatedAfterEdit())
+			{
+				viewer()->scene()->model()->setChunkTriangleBudget(std::size_t(chunkTriangleBudget) * 1024);
+
+				if (!viewer()->scene()->model()->filename().empty())
+					viewer()->scene()->model()->loadAsync(viewer()->scene()->model()->filename());
+			}
+		}
+
+		if (ImGui::CollapsingHeader("Generated Normals"))
+		{
+			// only used for files without normals, applied by reloading the model
+			bool reload = ImGui::RadioButton("Angle Weighted", &normalWeighting, int(NormalWeighting::Angle));
+			reload = ImGui::RadioButton("Area Weighted", &normalWeighting, int(NormalWeighting::Area)) || reload;
+			// not while the slider is dragged, as every reload starts over
+			ImGui::SliderFloat("Crease Angle", &creaseAngle, 0.0f, 180.0f, "%.0f degrees");
+			reload = ImGui::IsItemDeactivatedAfterEdit() || reload;
+
+			if (reload)
+			{
+				viewer()->scene()->model()->setNormalWeighting(NormalWeighting(normalWeighting));
+				viewer()->scene()->model()->setCreaseAngle(creaseAngle);
+
+				if (!viewer()->scene()->model()->filename().empty())
+					viewer()->scene()->model()->loadAsync(viewer()->scene()->model()->filename());
+			}
+		}
+
 		if (ImGui::CollapsingHeader("Groups"))
 		{
 			for (uint i = 0; i < groups.size(); i++)
@@ -436,23 +605,27 @@ void ModelRenderer::display()
 	vec4 worldLightPosition = inverseModelLightMatrix * vec4(0.0f, 0.0f, 0.0f, 1.0f);
 
 	shaderProgramModelBase->setUniform("modelViewProjectionMatrix", modelViewProjectionMatrix);
+	shaderProgramModelBase->setUniform("compactVertices", viewer()->scene()->model()->vertexFormat() == VertexFormat::Compact);
+	shaderProgramModelBase->setUniform("positionOffset", viewer()->scene()->model()->positionQuantization().offset);
+	shaderProgramModelBase->setUniform("positionScale", viewer()->scene()->model()->positionQuantization().scale);
 	shaderProgramModelBase->setUniform("viewportSize", viewportSize);
 	shaderProgramModelBase->setUniform("worldCameraPosition", vec3(worldCameraPosition));
 	shaderProgramModelBase->setUniform("worldLightPosition", vec3(worldLightPosition));
 	shaderProgramModelBase->setUniform("wireframeEnabled", wireframeEnabled);
 	shaderProgramModelBase->setUniform("wireframeLineColor", wireframeLineColor);
+	shaderProgramModelBase->setUniform("highlightColor", highlightColor);
 
 	//Light intensity
-	shaderProgramModelBase->setUniform("worldLightIntensity", worldLightIntensity);
-	shaderProgramModelBase->setUniform("ambientLightIntensity", ambientLightIntensity);
+	shaderProgramModelBase->setUniform("worldLightIntensity", lighting.lightIntensity);
+	shaderProgramModelBase->setUniform("ambientLightIntensity", lighting.ambientLightIntensity);
 
 
 	//Shader Menu options
 	shaderProgramModelBase->setUniform("shaderMenu", shaderMenu);
-	shaderProgramModelBase->setUniform("ambientEnabled", ambientEnabled);
-	shaderProgramModelBase->setUniform("diffuseEnabled", diffuseEnabled);
-	shaderProgramModelBase->setUniform("specularEnabled", specularEnabled);
-	shaderProgramModelBase->setUniform("shininessMultiplier", shininessMultiplier);
+	shaderProgramModelBase->setUniform("ambientEnabled", lighting.ambientEnabled);
+	shaderProgramModelBase->setUniform("diffuseEnabled", lighting.diffuseEnabled);
+	shaderProgramModelBase->setUniform("specularEnabled", lighting.specularEnabled);
+	shaderProgramModelBase->setUniform("shininessMultiplier", lighting.shininessMultiplier);
 
 	//Normal mapping
 	shaderProgramModelBase->setUniform("normalMenu", normalMenu);
@@ -466,11 +639,36 @@ void ModelRenderer::display()
 	
 	shaderProgramModelBase->use();
 
+	auto drawRanges = [&](const std::vector<IndexRange>& ranges)
+	{
+		for (const IndexRange & range : ranges)
+			viewer()->scene()->model()->vertexArray().drawElementsBaseVertex(GL_TRIANGLES, range.count, range.type, (void*)range.offset, range.baseVertex);
+
+		statistics.drawCalls += ranges.size();
+	};
+
+	// the full resolution is drawn chunk by chunk, skipping the culled ones, simplified levels are drawn as a whole
+	auto drawLevel = [&](uint group, uint level, vec2 fadeRange)
+	{
+		shaderProgramModelBase->setUniform("fadeRange", fadeRange);
+
+		if (level > 0)
+		{
+			drawRanges(viewer()->scene()->model()->indexRanges(group, level));
+			return;
+		}
+
+		for (std::size_t c = firstChunks[group]; c < firstChunks[group + 1]; c++)
+		{
+			if (m_chunkVisibility[c])
+				drawRanges(viewer()->scene()->model()->chunkIndexRanges(group, c - firstChunks[group]));
+		}
+	};
 
 
 	for (uint i = 0; i < groups.size(); i++)
 	{
-		if (groupEnabled.at(i))
+		if (groupEnabled.at(i) && groupVisible[i])
 		{
 			const Material & material = materials.at(groups.at(i).materialIndex);
 
@@ -479,6 +677,9 @@ void ModelRenderer::display()
 			shaderProgramModelBase->setUniform("diffuseColor", material.diffuse);
 			shaderProgramModelBase->setUniform("specularColor", material.specular);
 			shaderProgramModelBase->setUniform("shininess", material.shininess);
+			// a selection refers to the groups of the previous model until the camera interactor clears it
+			shaderProgramModelBase->setUniform("highlighted", !viewer()->scene()->model()->isLoading() && i == selection.group);
+			shaderProgramModelBase->setUniform("groupOffset", groupOffsets[i]);
 
 			
 
@@ -544,7 +745,16 @@ void ModelRenderer::display()
 			
 
 
-			viewer()->scene()->model()->vertexArray().drawElements(GL_TRIANGLES, groups.at(i).count(), GL_UNSIGNED_INT, (void*)(sizeof(GLuint)*groups.at(i).startIndex));
+			// while fading, the new level covers a growing share of the pixels and the previous one the rest
+			if (fadeProgress[i] < 1.0f && fadingLevels[i] <= groups.at(i).levels.size())
+			{
+				drawLevel(i, groupLevels[i], vec2(0.0f, fadeProgress[i]));
+				drawLevel(i, fadingLevels[i], vec2(fadeProgress[i], 1.0f));
+			}
+			else
+			{
+				drawLevel(i, groupLevels[i], vec2(0.0f, 1.0f));
+			}
 
 			if (material.diffuseTexture)
 			{
@@ -574,6 +784,8 @@ void ModelRenderer::display()
 
 	viewer()->scene()->model()->vertexArray().unbind();
 
+	m_statistics = statistics;
+
 
 	if (lightSourceEnabled)
 	{
@@ -1,5 +1,6 @@
 #pragma once
 #include "Renderer.h"
+#include "FrustumCuller.h"
 #include <memory>
 
 #include <glm/glm.hpp>
@@ -29,9 +30,28 @@ namespace minity
 	public:
 		ModelRenderer(Viewer *viewer);
 		virtual void display();
+		virtual const char* name() const;
+
+		// what the last frame drew and culled, for profiling
+		struct Statistics
+		{
+			std::size_t drawnGroups = 0;
+			std::size_t culledGroups = 0;
+			std::size_t drawnChunks = 0;
+			std::size_t culledChunks = 0;
+			std::size_t drawnTriangles = 0;
+			std::size_t drawCalls = 0;
+		};
+
+		const Statistics& statistics() const;
 
 	private:
 
+		// bounds of all chunks of the model, rebuilt every frame as exploding moves them
+		FrustumCuller m_chunkCuller;
+		std::vector<unsigned char> m_chunkVisibility;
+		Statistics m_statistics;
+
 		std::unique_ptr<globjects::VertexArray> m_lightArray = std::make_unique<globjects::VertexArray>();
 		std::unique_ptr<globjects::Buffer> m_lightVertices = std::make_unique<globjects::Buffer>();
 	};
@@ -0,0 +1,993 @@
+#include "ObjLoader.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Parallel.h"
+
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <limits>
+#include <algorithm>
+#include <filesystem>
+#include <globjects/globjects.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MINITY_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace minity;
+using namespace gl;
+using namespace glm;
+using namespace globjects;
+
+std::string trimLeft(const std::string &str, const std::string &whitespace = "\n\r\t ")
+{
+	size_t uIndex = str.find_first_not_of(whitespace);
+	if (uIndex != std::string::npos)
+		return str.substr(uIndex);
+
+	return "";
+}
+
+std::string trimRight(const std::string &str, const std::string &whitespace = "\n\r\t ")
+{
+	size_t  uIndex = str.find_last_not_of(whitespace);
+	if (uIndex != std::string::npos)
+		return str.substr(0, uIndex + 1);
+
+	return str;
+}
+
+std::string trim(const std::string &str, const std::string & whitespace = "\n\r\t ")
+{
+	return trimRight(trimLeft(str, whitespace), whitespace);
+}
+
+namespace
+{
+	// Bounds of the positions referenced by the given indices. Large index ranges are split into blocks whose
+	// bounds are computed in parallel, each block is reduced with SIMD min/max over all three coordinates at once.
+	void computeBounds(const std::vector<vec3> & positions, const std::vector<uint> & indices, vec3 & minimumBounds, vec3 & maximumBounds)
+	{
+		const std::size_t blockSize = 64 * 1024;
+		const std::size_t blockCount = (indices.size() + blockSize - 1) / blockSize;
+
+		std::vector<vec3> blockMinima(blockCount);
+		std::vector<vec3> blockMaxima(blockCount);
+
+		parallelFor(blockCount, [&](std::size_t block)
+		{
+			const std::size_t begin = block * blockSize;
+			const std::size_t end = std::min(indices.size(), begin + blockSize);
+
+#ifdef MINITY_SSE2
+			__m128 minimum = _mm_set1_ps(std::numeric_limits<float>::max());
+			__m128 maximum = _mm_set1_ps(-std::numeric_limits<float>::max());
+
+			for (std::size_t i = begin; i < end; i++)
+			{
+				const vec3 & p = positions[indices[i]];
+				const __m128 position = _mm_setr_ps(p.x, p.y, p.z, p.z);
+				minimum = _mm_min_ps(minimum, position);
+				maximum = _mm_max_ps(maximum, position);
+			}
+
+			float minimumValues[4], maximumValues[4];
+			_mm_storeu_ps(minimumValues, minimum);
+			_mm_storeu_ps(maximumValues, maximum);
+
+			blockMinima[block] = vec3(minimumValues[0], minimumValues[1], minimumValues[2]);
+			blockMaxima[block] = vec3(maximumValues[0], maximumValues[1], maximumValues[2]);
+#else
+			vec3 minimum(std::numeric_limits<float>::max());
+			vec3 maximum(-std::numeric_limits<float>::max());
+
+			for (std::size_t i = begin; i < end; i++)
+			{
+				minimum = min(minimum, positions[indices[i]]);
+				maximum = max(maximum, positions[indices[i]]);
+			}
+
+			blockMinima[block] = minimum;
+			blockMaxima[block] = maximum;
+#endif
+		});
+
+		minimumBounds = vec3(std::numeric_limits<float>::max());
+		maximumBounds = vec3(-std::numeric_limits<float>::max());
+
+		for (std::size_t i = 0; i < blockCount; i++)
+		{
+			minimumBounds = min(minimumBounds, blockMinima[i]);
+			maximumBounds = max(maximumBounds, blockMaxima[i]);
+		}
+	}
+
+	// Reorders the triangles into spatially coherent ranges of at most budget triangles each and returns the ends of
+	// the ranges. The triangles are split recursively at the median of their centroids along the longest axis of
+	// the centroid bounds. A budget of 0 keeps all triangles in one range.
+	std::vector<std::size_t> splitIntoChunks(std::vector<uint> & indices, const std::vector<vec3> & positions, std::size_t budget)
+	{
+		const std::size_t triangleCount = indices.size() / 3;
+
+		if (budget == 0 || triangleCount <= budget)
+			return { indices.size() };
+
+		std::vector<vec3> centroids(triangleCount);
+		std::vector<uint> order(triangleCount);
+
+		for (std::size_t t = 0; t < triangleCount; t++)
+		{
+			centroids[t] = (positions[indices[3 * t]] + positions[indices[3 * t + 1]] + positions[indices[3 * t + 2]]) / 3.0f;
+			order[t] = uint(t);
+		}
+
+		// ranges of the order still to be split, the first half is always split first so that the chunks end up in order
+		std::vector<std::pair<std::size_t, std::size_t>> ranges = { { 0, triangleCount } };
+		std::vector<std::size_t> ends;
+
+		while (!ranges.empty())
+		{
+			const std::size_t begin = ranges.back().first;
+			const std::size_t end = ranges.back().second;
+			ranges.pop_back();
+
+			if (end - begin <= budget)
+			{
+				ends.push_back(3 * end);
+				continue;
+			}
+
+			vec3 minimum(std::numeric_limits<float>::max());
+			vec3 maximum(-std::numeric_limits<float>::max());
+
+			for (std::size_t i = begin; i < end; i++)
+			{
+				minimum = min(minimum, centroids[order[i]]);
+				maximum = max(maximum, centroids[order[i]]);
+			}
+
+			const vec3 extent = maximum - minimum;
+			const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+			const std::size_t middle = begin + (end - begin) / 2;
+
+			std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&](uint a, uint b)
+			{
+				return centroids[a][axis] < centroids[b][axis];
+			});
+
+			ranges.emplace_back(middle, end);
+			ranges.emplace_back(begin, middle);
+		}
+
+		// indices of an incomplete last triangle stay at the end
+		std::vector<uint> ordered(indices.size());
+
+		for (std::size_t i = 0; i < triangleCount; i++)
+		{
+			for (int c = 0; c < 3; c++)
+				ordered[3 * i + c] = indices[3 * order[i] + c];
+		}
+
+		std::copy(indices.begin() + 3 * triangleCount, indices.end(), ordered.begin() + 3 * triangleCount);
+		indices.swap(ordered);
+		ends.back() = indices.size();
+
+		return ends;
+	}
+}
+
+void ObjLoader::setChunkTriangleBudget(std::size_t budget)
+{
+	m_chunkTriangleBudget = budget;
+}
+
+bool ObjLoader::loadObjFile(const std::string & filename)
+{
+	std::filesystem::path path(filename);
+
+	ObjData & data = m_data;
+	ObjParser parser;
+
+	if (!parser.parseFile(filename, data))
+		return false;
+
+	std::vector< vec3 > & positions = data.positions;
+	std::vector< ObjGroup > & groupList = data.groups;
+
+	std::unordered_map< std::string, int > & materialMap = m_materialMap;
+	std::vector<ObjMaterial> materials;
+
+	ObjMaterial defaultMaterial;
+	defaultMaterial.name = "default";
+
+	materialMap.insert(std::make_pair(defaultMaterial.name, int(materials.size())));
+	materials.push_back(defaultMaterial);
+
+	for (const std::string & libraryNames : data.materialLibraries)
+	{
+		// the Wavefront obj specification does not really allow for spaces in the mtl file name,
+		// since multiple libraries are supposed to be separated by spaces, but many programs
+		// do not take care of that -- therefore, we first try whether it is a single filename,
+		// and only if that fails we use the interpretation according to the specification
+		std::filesystem::path libraryPath = libraryNames;
+
+		// first try
+		if (libraryPath.is_absolute())
+		{
+			if (loadMtlFile(libraryPath.string(), materials, materialMap))
+				continue;
+		}
+
+		std::stringstream mss(libraryNames);
+		std::string libraryName;
+
+		while (mss >> libraryName)
+		{
+			libraryName = trim(libraryName);
+			std::filesystem::path libraryPath = path.parent_path();
+			libraryPath.append(libraryName);
+			loadMtlFile(libraryPath.string(), materials, materialMap);
+		}
+	}
+
+	if (materials.size() <= 1)
+	{
+		std::filesystem::path libraryPath = path;
+		libraryPath.replace_extension("mtl");
+		loadMtlFile(libraryPath.string(), materials, materialMap);
+	}
+
+	// bounds of all referenced positions, and the number of indices the groups will be assembled into
+	m_minimumBounds = vec3(std::numeric_limits<float>::max());
+	m_maximumBounds = vec3(-std::numeric_limits<float>::max());
+	m_indexCount = 0;
+
+	for (const auto & g : groupList)
+	{
+		m_indexCount += g.positionIndices.size();
+
+		for (auto i : g.positionIndices)
+		{
+			m_minimumBounds = min(m_minimumBounds, positions[i]);
+			m_maximumBounds = max(m_maximumBounds, positions[i]);
+		}
+	}
+
+	// closed triangle meshes have about one vertex per six corners
+	m_vertexMap.reserve(m_indexCount / 6);
+
+	m_materials.reserve(materials.size());
+
+	// textures are decoded separately, so that cached models can reuse the resolved paths
+	auto resolveTexturePath = [&](const std::string& map)
+	{
+		if (map.empty())
+			return std::string();
+
+		std::filesystem::path texturePath = map;
+
+		if (!texturePath.is_absolute())
+		{
+			texturePath = path.parent_path();
+			texturePath.append(map);
+		}
+
+		return texturePath.string();
+	};
+
+	for (auto & m : materials)
+	{
+		Material newMaterial;
+		newMaterial.name = m.name;
+		newMaterial.ambient = m.Ka;
+		newMaterial.diffuse = m.Kd;
+		newMaterial.specular = m.Ks;
+		newMaterial.shininess = m.Ns;
+
+		newMaterial.ambientTexturePath = resolveTexturePath(m.map_Ka);
+		newMaterial.diffuseTexturePath = resolveTexturePath(m.map_Kd);
+		newMaterial.specularTexturePath = resolveTexturePath(m.map_Ks);
+		newMaterial.shininessTexturePath = resolveTexturePath(m.map_Ns);
+		newMaterial.bumpTexturePath = resolveTexturePath(m.map_bump);
+		//Assignment 2 - Object / Tangent Normal Map
+		newMaterial.objectNormalsPath = resolveTexturePath(m.map_ObjectNormals);
+		newMaterial.tangentNormalsPath = resolveTexturePath(m.map_TangentNormals);
+
+		m_materials.push_back(newMaterial);
+	}
+
+	return true;
+}
+
+void ObjLoader::generateNormals(NormalWeighting weighting, float creaseAngle)
+{
+	const std::vector< vec3 > & positions = m_data.positions;
+	std::vector< vec3 > & normals = m_data.normals;
+	std::vector< ObjGroup > & groupList = m_data.groups;
+
+	// compute normals if not present in the file
+	if (normals.size() > 1)
+		return;
+
+	// corners of all groups are numbered consecutively, three per triangle
+	std::vector<std::size_t> groupCorners(groupList.size() + 1, 0);
+
+	for (std::size_t i = 0; i < groupList.size(); i++)
+		groupCorners[i + 1] = groupCorners[i] + groupList[i].positionIndices.size() / 3 * 3;
+
+	const std::size_t cornerCount = groupCorners.back();
+	const std::size_t triangleCount = cornerCount / 3;
+
+	std::vector<uint> cornerPositions(cornerCount);
+	std::vector<uint> triangleGroups(triangleCount);
+
+	for (std::size_t i = 0; i < groupList.size(); i++)
+	{
+		std::copy(groupList[i].positionIndices.begin(), groupList[i].positionIndices.begin() + (groupCorners[i + 1] - groupCorners[i]), cornerPositions.begin() + groupCorners[i]);
+		std::fill(triangleGroups.begin() + groupCorners[i] / 3, triangleGroups.begin() + groupCorners[i + 1] / 3, uint(i));
+	}
+
+	// unit face normals and the weight of each corner
+	std::vector<vec3> faceNormals(triangleCount);
+	std::vector<float> cornerWeights(cornerCount);
+
+	const std::size_t blockSize = 16 * 1024;
+
+	parallelFor((triangleCount + blockSize - 1) / blockSize, [&](std::size_t block)
+	{
+		const std::size_t end = std::min(triangleCount, (block + 1) * blockSize);
+
+		for (std::size_t t = block * blockSize; t < end; t++)
+		{
+			const vec3 & p0 = positions[cornerPositions[3 * t + 0]];
+			const vec3 & p1 = positions[cornerPositions[3 * t + 1]];
+			const vec3 & p2 = positions[cornerPositions[3 * t + 2]];
+
+			const vec3 n = cross(p2 - p1, p0 - p1);
+			const float doubleArea = length(n);
+
+			// degenerate triangles do not contribute
+			if (!(doubleArea > 0.0f))
+				continue;
+
+			faceNormals[t] = n / doubleArea;
+
+			if (weighting == NormalWeighting::Area)
+			{
+				cornerWeights[3 * t + 0] = cornerWeights[3 * t + 1] = cornerWeights[3 * t + 2] = doubleArea;
+			}
+			else
+			{
+				const vec3 corners[3] = { p0, p1, p2 };
+
+				for (int c = 0; c < 3; c++)
+				{
+					const vec3 a = corners[(c + 1) % 3] - corners[c];
+					const vec3 b = corners[(c + 2) % 3] - corners[c];
+					const float lengths = length(a) * length(b);
+
+					if (lengths > 0.0f)
+						cornerWeights[3 * t + c] = acos(clamp(dot(a, b) / lengths, -1.0f, 1.0f));
+				}
+			}
+		}
+	});
+
+	// corners sorted by position, so that every position can be processed by a single thread without atomics
+	std::vector<std::size_t> positionCorners(positions.size() + 1, 0);
+
+	for (auto p : cornerPositions)
+		positionCorners[p + 1]++;
+
+	for (std::size_t i = 0; i < positions.size(); i++)
+		positionCorners[i + 1] += positionCorners[i];
+
+	std::vector<uint> corners(cornerCount);
+	{
+		std::vector<std::size_t> next(positionCorners.begin(), positionCorners.end() - 1);
+
+		for (std::size_t c = 0; c < cornerCount; c++)
+			corners[next[cornerPositions[c]]++] = uint(c);
+	}
+
+	// Corners of a position form one smooth vertex as long as they are in the same group and their faces deviate
+	// less than the crease angle from the face that started it; each such vertex gets one normal. In the first
+	// pass, the vertices of every position are counted, so that the second can write the normals to their place.
+	const float creaseCosine = creaseAngle >= 180.0f ? -1.0f : cos(radians(creaseAngle));
+
+	std::vector<unsigned char> cornerVertices(cornerCount);
+	std::vector<uint> positionNormals(positions.size() + 1, 0);
+
+	auto forEachPositionBlock = [&](const std::function<void(std::size_t)>& task)
+	{
+		parallelFor((positions.size() + blockSize - 1) / blockSize, [&](std::size_t block)
+		{
+			const std::size_t end = std::min(positions.size(), (block + 1) * blockSize);
+
+			for (std::size_t p = block * blockSize; p < end; p++)
+				task(p);
+		});
+	};
+
+	forEachPositionBlock([&](std::size_t p)
+	{
+		// first corner of every smooth vertex, positions with more vertices than that merge the rest into the last one
+		uint firstCorners[256];
+		uint vertexCount = 0;
+
+		// corners of degenerate triangles have no direction and join any vertex of their group, so they come last
+		for (int pass = 0; pass < 2; pass++)
+		{
+			const bool degenerate = pass == 1;
+
+			for (std::size_t i = positionCorners[p]; i < positionCorners[p + 1]; i++)
+			{
+				const uint c = corners[i];
+
+				if ((cornerWeights[c] == 0.0f) != degenerate)
+					continue;
+
+				uint v = 0;
+
+				while (v < vertexCount)
+				{
+					const uint f = firstCorners[v];
+
+					if (triangleGroups[f / 3] == triangleGroups[c / 3] && (degenerate || dot(faceNormals[f / 3], faceNormals[c / 3]) >= creaseCosine))
+						break;
+
+					v++;
+				}
+
+				if (v == vertexCount && vertexCount < 256)
+					firstCorners[vertexCount++] = c;
+
+				cornerVertices[c] = (unsigned char)std::min(v, 255u);
+			}
+		}
+
+		positionNormals[p + 1] = vertexCount;
+	});
+
+	// index 0 stays the dummy normal
+	positionNormals[0] = 1;
+
+	for (std::size_t i = 0; i < positions.size(); i++)
+		positionNormals[i + 1] += positionNormals[i];
+
+	std::vector<vec3> vertexNormals(positionNormals.back(), vec3(0.0f));
+
+	forEachPositionBlock([&](std::size_t p)
+	{
+		for (std::size_t i = positionCorners[p]; i < positionCorners[p + 1]; i++)
+		{
+			const uint c = corners[i];
+			vertexNormals[positionNormals[p] + cornerVertices[c]] += cornerWeights[c] * faceNormals[c / 3];
+		}
+
+		for (uint n = positionNormals[p]; n < positionNormals[p + 1]; n++)
+		{
+			const float l = length(vertexNormals[n]);
+
+			if (l > 0.0f)
+				vertexNormals[n] /= l;
+		}
+	});
+
+	for (std::size_t i = 0; i < groupList.size(); i++)
+	{
+		std::vector<uint> & normalIndices = groupList[i].normalIndices;
+
+		for (std::size_t j = 0; j < groupCorners[i + 1] - groupCorners[i]; j++)
+		{
+			const std::size_t c = groupCorners[i] + j;
+			normalIndices[j] = positionNormals[cornerPositions[c]] + cornerVertices[c];
+		}
+	}
+
+	normals.swap(vertexNormals);
+}
+
+std::size_t ObjLoader::groupCount() const
+{
+	return m_data.groups.size();
+}
+
+bool ObjLoader::assembleGroup(std::size_t index, std::vector<Vertex> & vertices, std::vector<uint> & indices, std::vector<Meshlet> & meshlets, Group & group)
+{
+	const ObjGroup & objGroup = m_data.groups[index];
+
+	if (objGroup.positionIndices.empty())
+		return false;
+
+	group.name = objGroup.name;
+	group.startIndex = m_assembledIndexCount;
+
+	std::unordered_map<std::string, int>::const_iterator j = m_materialMap.find(objGroup.material);
+
+	if (j != m_materialMap.end())
+		group.materialIndex = j->second;
+	else
+		group.materialIndex = 0;
+
+	computeBounds(m_data.positions, objGroup.positionIndices, group.minimumBounds, group.maximumBounds);
+
+	const uint groupStamp = uint(index) + 1;
+	const uint firstVertex = m_vertexCount;
+	const std::size_t firstOutputVertex = vertices.size();
+
+	// Vertices are identified by the order of their creation until the group is optimized, then the new ones
+	// are renumbered. The triangles are first collected with indices local to the group, numbered by first use.
+	std::vector<uint> groupVertices;
+	std::vector<uint> localIndices;
+	localIndices.reserve(objGroup.positionIndices.size());
+
+	// corners that share position, texcoord and normal indices share one vertex
+	for (uint j = 0; j < objGroup.positionIndices.size(); j++)
+	{
+		const uvec3 key(objGroup.positionIndices[j], objGroup.texCoordIndices[j], objGroup.normalIndices[j]);
+		const uint vertexIndex = m_vertexMap.insert(key, m_vertexCount);
+
+		if (vertexIndex == m_vertexCount)
+		{
+			Vertex vertex;
+			vertex.position = m_data.positions[key.x];
+			vertex.normal = m_data.normals[key.z];
+			vertex.texcoord = m_data.texCoords[key.y];
+			vertices.push_back(vertex);
+			m_vertexGroups.push_back(0);
+			m_vertexLocalIndices.push_back(0);
+			m_vertexFinalIndices.push_back(std::numeric_limits<uint>::max());
+			m_vertexPositions.push_back(vertex.position);
+			m_vertexCount++;
+		}
+
+		// the group stamp marks vertices already recorded for this group, so no clearing is needed between groups
+		if (m_vertexGroups[vertexIndex] != groupStamp)
+		{
+			m_vertexGroups[vertexIndex] = groupStamp;
+			m_vertexLocalIndices[vertexIndex] = uint(groupVertices.size());
+			groupVertices.push_back(vertexIndex);
+		}
+
+		localIndices.push_back(m_vertexLocalIndices[vertexIndex]);
+	}
+
+	std::vector<vec3> localPositions(groupVertices.size());
+
+	for (std::size_t i = 0; i < groupVertices.size(); i++)
+		localPositions[i] = m_vertexPositions[groupVertices[i]];
+
+	m_cacheMissesBefore += MeshOptimizer::vertexCacheMisses(localIndices, groupVertices.size());
+
+	// Large groups are split into chunks first, then every chunk is optimized and divided into meshlets on its own,
+	// with the vertices numbered locally, so that its triangles stay together.
+	const std::vector<std::size_t> chunkEnds = splitIntoChunks(localIndices, localPositions, m_chunkTriangleBudget);
+	std::vector<Meshlet> groupMeshlets;
+	std::vector<uint> chunkLocalIndices(groupVertices.size(), std::numeric_limits<uint>::max());
+	std::size_t chunkStart = 0;
+
+	for (auto chunkEnd : chunkEnds)
+	{
+		std::vector<uint> chunkVertices;
+		std::vector<uint> chunkIndices;
+		chunkIndices.reserve(chunkEnd - chunkStart);
+
+		for (std::size_t i = chunkStart; i < chunkEnd; i++)
+		{
+			const uint v = localIndices[i];
+
+			if (chunkLocalIndices[v] == std::numeric_limits<uint>::max())
+			{
+				chunkLocalIndices[v] = uint(chunkVertices.size());
+				chunkVertices.push_back(v);
+			}
+
+			chunkIndices.push_back(chunkLocalIndices[v]);
+		}
+
+		std::vector<vec3> chunkPositions(chunkVertices.size());
+
+		for (std::size_t i = 0; i < chunkVertices.size(); i++)
+			chunkPositions[i] = localPositions[chunkVertices[i]];
+
+		MeshOptimizer::optimizeVertexCache(chunkIndices, chunkVertices.size());
+		MeshOptimizer::optimizeOverdraw(chunkIndices, chunkPositions);
+
+		std::vector<Meshlet> chunkMeshlets;
+		MeshOptimizer::buildMeshlets(chunkIndices, chunkPositions, chunkMeshlets);
+
+		for (auto& m : chunkMeshlets)
+		{
+			m.startIndex += uint(chunkStart);
+			m.endIndex += uint(chunkStart);
+		}
+
+		groupMeshlets.insert(groupMeshlets.end(), chunkMeshlets.begin(), chunkMeshlets.end());
+
+		Chunk chunk;
+		chunk.startIndex = m_assembledIndexCount + uint(chunkStart);
+		chunk.endIndex = m_assembledIndexCount + uint(chunkEnd);
+		computeBounds(chunkPositions, chunkIndices, chunk.minimumBounds, chunk.maximumBounds);
+		group.chunks.push_back(chunk);
+
+		for (std::size_t i = 0; i < chunkIndices.size(); i++)
+			localIndices[chunkStart + i] = chunkVertices[chunkIndices[i]];
+
+		for (auto v : chunkVertices)
+			chunkLocalIndices[v] = std::numeric_limits<uint>::max();
+
+		chunkStart = chunkEnd;
+	}
+
+	m_cacheMissesAfter += MeshOptimizer::vertexCacheMisses(localIndices, groupVertices.size());
+	m_optimizedTriangleCount += localIndices.size() / 3;
+
+	for (auto& m : groupMeshlets)
+	{
+		m.startIndex += m_assembledIndexCount;
+		m.endIndex += m_assembledIndexCount;
+	}
+
+	group.startMeshlet = m_assembledMeshletCount;
+	m_assembledMeshletCount += uint(groupMeshlets.size());
+	group.endMeshlet = m_assembledMeshletCount;
+	meshlets.insert(meshlets.end(), groupMeshlets.begin(), groupMeshlets.end());
+
+	// new vertices are numbered in the order the optimized triangles use them, for vertex fetch locality
+	std::vector<Vertex> newVertices(vertices.size() - firstOutputVertex);
+	uint nextVertex = firstVertex;
+	std::vector<bool> used(groupVertices.size(), false);
+
+	for (auto i : localIndices)
+	{
+		const uint vertexIndex = groupVertices[i];
+
+		if (!used[i])
+		{
+			used[i] = true;
+
+			if (vertexIndex >= firstVertex)
+			{
+				m_vertexFinalIndices[vertexIndex] = nextVertex;
+				newVertices[nextVertex - firstVertex] = vertices[firstOutputVertex + (vertexIndex - firstVertex)];
+				nextVertex++;
+			}
+
+			group.indexes.push_back(m_vertexFinalIndices[vertexIndex]);
+		}
+
+		indices.push_back(m_vertexFinalIndices[vertexIndex]);
+	}
+
+	std::copy(newVertices.begin(), newVertices.end(), vertices.begin() + firstOutputVertex);
+
+	m_assembledIndexCount += uint(objGroup.positionIndices.size());
+	group.endIndex = m_assembledIndexCount;
+
+	// the levels of detail only use vertices of the group, their indices follow those of the group
+	std::vector<uint> levelIndices;
+	MeshSimplifier::buildLevelsOfDetail(localIndices, localPositions, levelIndices, group.levels);
+
+	for (auto i : levelIndices)
+		indices.push_back(m_vertexFinalIndices[groupVertices[i]]);
+
+	for (auto& l : group.levels)
+	{
+		l.startIndex += m_assembledIndexCount;
+		l.endIndex += m_assembledIndexCount;
+	}
+
+	m_assembledIndexCount += uint(levelIndices.size());
+
+	return true;
+}
+
+const std::vector<Material> & ObjLoader::materials() const
+{
+	return m_materials;
+}
+
+const std::vector<std::string> & ObjLoader::dependencies() const
+{
+	return m_dependencies;
+}
+
+vec3 ObjLoader::minimumBounds() const
+{
+	return m_minimumBounds;
+}
+
+vec3 ObjLoader::maximumBounds() const
+{
+	return m_maximumBounds;
+}
+
+float ObjLoader::originalCacheMissRatio() const
+{
+	return m_optimizedTriangleCount > 0 ? float(m_cacheMissesBefore) / float(m_optimizedTriangleCount) : 0.0f;
+}
+
+float ObjLoader::cacheMissRatio() const
+{
+	return m_optimizedTriangleCount > 0 ? float(m_cacheMissesAfter) / float(m_optimizedTriangleCount) : 0.0f;
+}
+
+std::size_t ObjLoader::indexCount() const
+{
+	return m_indexCount;
+}
+
+std::size_t ObjLoader::vertexCountEstimate() const
+{
+	return m_data.positions.size();
+}
+
+bool ObjLoader::loadMtlFile(const std::string & filename, std::vector<ObjMaterial> & materials, std::unordered_map< std::string, int > & materialMap)
+{
+	// libraries that do not exist are dependencies as well, the model changes once they are added
+	m_dependencies.push_back(filename);
+
+	std::ifstream is(filename);
+
+	if (!is.is_open())
+		return false;
+
+	std::string buffer;
+	int currentMaterialIndex = 0;
+
+	while (is.good())
+	{
+		if (getline(is, buffer))
+		{
+			std::istringstream iss(buffer);
+			std::string token;
+
+			if (iss >> token)
+			{
+				if (token == "newmtl")
+				{
+					std::string materialName;
+
+					if (getline(iss, materialName))
+					{
+						materialName = trim(materialName);
+
+						auto i = materialMap.find(materialName);
+
+						if (i == materialMap.end())
+						{
+							ObjMaterial newMaterial;
+							newMaterial.name = materialName;
+							currentMaterialIndex = uint(materials.size());
+							materialMap.insert(std::make_pair(newMaterial.name, currentMaterialIndex));
+							materials.push_back(newMaterial);
+						}
+						else
+						{
+							currentMaterialIndex = i->second;
+						}
+					}
+				}
+				// Ambient Color
+				else if (token == "Ka")
+				{
+					vec3 Ka(0.0f);
+					if (iss >> Ka.x >> Ka.y >> Ka.z)
+						materials[currentMaterialIndex].Ka = Ka;
+				}
+				// Diffuse Color
+				else if (token == "Kd")
+				{
+					vec3 Kd(0.0f);
+					if (iss >> Kd.x >> Kd.y >> Kd.z)
+						materials[currentMaterialIndex].Kd = Kd;
+				}
+				// Specular Color
+				else if (token == "Ks")
+				{
+					vec3 Ks(0.0f);
+					if (iss >> Ks.x >> Ks.y >> Ks.z)
+						materials[currentMaterialIndex].Ks = Ks;
+				}
+				// Specular Exponent
+				else if (token == "Ns")
+				{
+					float Ns = 0.0f;
+					if (iss >> Ns)
+						materials[currentMaterialIndex].Ns = Ns;
+				}
+				// Dissolve
+				else if (token == "d")
+				{
+					float d = 0.0f;
+					if (iss >> d)
+						materials[currentMaterialIndex].d = d;
+				}
+				// Illumination
+				else if (token == "illum")
+				{
+					int illum = 0;
+					if (iss >> illum)
+						materials[currentMaterialIndex].illum = illum;
+				}
+				// Ambient Texture Map
+				else if (token == "map_Ka")
+				{
+					std::string map_Ka;
+					if (getline(iss, map_Ka))
+					{
+						map_Ka = trim(map_Ka);
+						materials[currentMaterialIndex].map_Ka = map_Ka;
+					}
+				}
+				// Diffuse Texture Map
+				else if (token == "map_Kd")
+				{
+					std::string map_Kd;
+					if (getline(iss, map_Kd))
+					{
+						map_Kd = trim(map_Kd);
+						materials[currentMaterialIndex].map_Kd = map_Kd;
+					}
+				}
+				// Specular Texture Map
+				else if (token == "map_Ks")
+				{
+					std::string map_Ks;
+					if (getline(iss, map_Ks))
+					{
+						map_Ks = trim(map_Ks);
+						materials[currentMaterialIndex].map_Ks = map_Ks;
+					}
+				}
+				// Specular Hightlight Map
+				else if (token == "map_Ns")
+				{
+					std::string map_Ns;
+					if (getline(iss, map_Ns))
+					{
+						map_Ns = trim(map_Ns);
+						materials[currentMaterialIndex].map_Ns = map_Ns;
+					}
+				}
+				// Alpha Texture Map
+				else if (token == "map_d")
+				{
+					std::string map_d;
+					if (getline(iss, map_d))
+					{
+						map_d = trim(map_d);
+						materials[currentMaterialIndex].map_d = map_d;
+					}
+				}
+				// Bump Map
+				else if (token == "map_bump" || token == "map_Bump" || token == "bump")
+				{
+					std::string map_bump;
+					if (getline(iss, map_bump))
+					{
+						map_bump = trim(map_bump);
+						materials[currentMaterialIndex].map_bump = map_bump;
+					}
+				}
+				//Assignment 2
+				// Object Normal Map
+				else if (token == "map_objectnormals" || token == "map_objectNormals" || token == "map_ObjectNormals" || token == "objectnormals" || token == "objectNormals")
+				{
+					std::string map_ObjectNormals;
+					if (getline(iss, map_ObjectNormals))
+					{
+						map_ObjectNormals = trim(map_ObjectNormals);
+						materials[currentMaterialIndex].map_ObjectNormals = map_ObjectNormals;
+					}
+				}
+				// Tangent Normal Map
+				else if (token == "map_tangentnormals" || token == "map_tangentNormals" || token == "map_TangentNormals" || token == "tangentnormals" || token == "tangentNormals")
+				{
+					std::string map_TangentNormals;
+					if (getline(iss, map_TangentNormals))
+					{
+						map_TangentNormals = trim(map_TangentNormals);
+						materials[currentMaterialIndex].map_TangentNormals = map_TangentNormals;
+					}
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+bool ObjLoader::decodeTexture(const std::string & filename, TextureKind kind, bool colorCompression, TextureImage & image)
+{
+	if (TextureCompressor::read(filename, kind, colorCompression, image))
+		return true;
+
+	int width, height, channels;
+
+	// textures are decoded on several threads at once, so the global flag must not be written here
+	stbi_set_flip_vertically_on_load_thread(true);
+	unsigned char *data = stbi_load(filename.c_str(), &width, &height, &channels, 4);
+
+	if (!data)
+		return false;
+
+	image.filename = filename;
+	TextureCompressor::compress(data, ivec2(width, height), kind, colorCompression, image);
+	stbi_image_free(data);
+
+	if (!TextureCompressor::write(filename, kind, image))
+		globjects::debug() << "Could not write texture cache " << TextureCompressor::cacheFilename(filename, kind);
+
+	return true;
+}
+
+bool ObjLoader::s3tcSupported()
+{
+	static const bool supported = globjects::hasExtension(GLextension::GL_EXT_texture_compression_s3tc);
+	return supported;
+}
+
+std::unique_ptr<Buffer> ObjLoader::stageTexture(const TextureImage & image)
+{
+	auto pixelBuffer = std::make_unique<Buffer>();
+	pixelBuffer->setData(image.byteSize(), image.data.data(), GL_STREAM_DRAW);
+
+	return pixelBuffer;
+}
+
+std::unique_ptr<Texture> ObjLoader::createTexture(const TextureImage & image, Buffer & pixelBuffer, const TextureSampling & sampling)
+{
+	std::cout << "Loaded " << image.filename << std::endl;
+
+	auto texture = Texture::create(GL_TEXTURE_2D);
+	texture->setParameter(GL_TEXTURE_MIN_FILTER, sampling.minFilter);
+	texture->setParameter(GL_TEXTURE_MAG_FILTER, sampling.magFilter);
+	texture->setParameter(GL_TEXTURE_WRAP_S, sampling.wrapS);
+	texture->setParameter(GL_TEXTURE_WRAP_T, sampling.wrapT);
+
+	// immutable storage where available, otherwise the levels are specified one by one
+	const bool immutable = globjects::hasExtension(GLextension::GL_ARB_texture_storage);
+
+	if (immutable)
+		texture->storage2D(GLsizei(image.levels.size()), image.internalFormat, image.size());
+	else
+		texture->setParameter(GL_TEXTURE_MAX_LEVEL, GLint(image.levels.size() - 1));
+
+	// rows of uncompressed levels are tightly packed
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	pixelBuffer.bind(GL_PIXEL_UNPACK_BUFFER);
+
+	for (std::size_t i = 0; i < image.levels.size(); i++)
+	{
+		const TextureImage::Level& level = image.levels[i];
+		const void* offset = reinterpret_cast<const void*>(level.offset);
+
+		if (image.compressed())
+		{
+			if (immutable)
+				texture->compressedSubImage2D(GLint(i), ivec2(0), level.size, image.internalFormat, GLsizei(level.byteSize), offset);
+			else
+				texture->compressedImage2D(GLint(i), image.internalFormat, level.size, 0, GLsizei(level.byteSize), offset);
+		}
+		else
+		{
+			if (immutable)
+				texture->subImage2D(GLint(i), ivec2(0), level.size, GL_RGBA, GL_UNSIGNED_BYTE, offset);
+			else
+				texture->image2D(GLint(i), image.internalFormat, level.size, 0, GL_RGBA, GL_UNSIGNED_BYTE, offset);
+		}
+	}
+
+	pixelBuffer.unbind(GL_PIXEL_UNPACK_BUFFER);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	return texture;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "Model.h"
+#include "ObjParser.h"
+#include "TextureCache.h"
+#include "TextureCompressor.h"
+#include "VertexIndexMap.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace minity
+{
+	// Loads Wavefront OBJ files together with their material libraries. Loading is split into stages that
+	// do not need a GL context, so that it can run on a background thread: loadObjFile() parses the files,
+	// generateNormals() computes missing normals, and assembleGroup() then turns one group at a time into
+	// vertices and indices. Materials and bounds are available right after loadObjFile().
+	class ObjLoader
+	{
+	public:
+
+	struct ObjMaterial
+	{
+		// Material Name
+		std::string name;
+		// Ambient Color
+		glm::vec3 Ka = glm::vec3(0.2f,0.2f,0.2f);
+		// Diffuse Color
+		glm::vec3 Kd = glm::vec3(0.8f,0.8f,0.8f);
+		// Specular Color
+		glm::vec3 Ks = glm::vec3(1.0f,1.0f,1.0f);
+		// Specular Exponent
+		float Ns = 0.0f;
+		// Dissolve
+		float d = 1.0f;
+		// Illumination
+		int illum = 0;
+		// Ambient Texture Map
+		std::string map_Ka;
+		// Diffuse Texture Map
+		std::string map_Kd;
+		// Specular Texture Map
+		std::string map_Ks;
+		// Specular Hightlight Map
+		std::string map_Ns;
+		// Alpha Texture Map
+		std::string map_d;
+		// Bump Map
+		std::string map_bump;
+		//Assignment 2 new imports
+		//Object Normals Map
+		std::string  map_ObjectNormals;
+		//Tangent Normals Map
+		std::string map_TangentNormals;
+	};
+
+		// groups with more triangles are split into spatially coherent chunks by assembleGroup(), 0 disables splitting
+		void setChunkTriangleBudget(std::size_t budget);
+
+		bool loadObjFile(const std::string & filename);
+
+		// Computes vertex normals if the file does not contain any, has to be called before assembleGroup().
+		// Face normals are averaged per position and group, weighted by the corner angle or the face area.
+		// Faces meeting at more than the crease angle (in degrees) get separate vertices; 180 smooths everything.
+		void generateNormals(NormalWeighting weighting = NormalWeighting::Angle, float creaseAngle = 60.0f);
+
+		// number of groups in the file, including empty ones
+		std::size_t groupCount() const;
+
+		// Appends the vertices and indices of the given group and fills in the group, including its distinct
+		// vertices and bounds. Vertices shared with previously assembled groups are not appended again, indices
+		// refer to all vertices assembled so far. The triangles are split into chunks, reordered for vertex cache
+		// efficiency and low overdraw within every chunk, and the new vertices are numbered in the order of their
+		// first use. The meshlets of the group are appended as well, with index ranges and numbering that
+		// continue those of previous groups. The indices of simplified levels of detail are appended after those
+		// of the group. Returns false for empty groups.
+		bool assembleGroup(std::size_t index, std::vector<Vertex> & vertices, std::vector<glm::uint> & indices, std::vector<Meshlet> & meshlets, Group & group);
+
+		const std::vector<Material> & materials() const;
+
+		// material libraries the model was built from, including those that were looked up but do not exist
+		const std::vector<std::string> & dependencies() const;
+
+		glm::vec3 minimumBounds() const;
+		glm::vec3 maximumBounds() const;
+
+		// total number of indices of all groups, available after loadObjFile()
+		std::size_t indexCount() const;
+		// number of positions in the file, a lower bound for the number of vertices in most models
+		std::size_t vertexCountEstimate() const;
+
+		// average cache miss ratio (vertex shader invocations per triangle) of the groups assembled so far,
+		// in the order of the file and after optimization
+		float originalCacheMissRatio() const;
+		float cacheMissRatio() const;
+
+		// Decodes an image file into a texture with all mipmap levels, encoded for the kind of map it is used as.
+		// Prepared textures are cached by the TextureCompressor. Can be called from any thread, whether S3TC
+		// can be used for color maps has to be determined on the GL thread, see s3tcSupported().
+		static bool decodeTexture(const std::string & filename, TextureKind kind, bool colorCompression, TextureImage & image);
+		// whether GL_EXT_texture_compression_s3tc is available, queried once on the GL thread
+		static bool s3tcSupported();
+		// Texture upload is split in two steps on the GL thread: stageTexture() copies the pixels into a pixel
+		// buffer object and returns immediately, createTexture() later specifies the texture from that buffer,
+		// so that the transfer can complete asynchronously in between (e.g. during the next frame).
+		static std::unique_ptr<globjects::Buffer> stageTexture(const TextureImage & image);
+		static std::unique_ptr<globjects::Texture> createTexture(const TextureImage & image, globjects::Buffer & pixelBuffer, const TextureSampling & sampling = TextureSampling());
+
+	private:
+
+		bool loadMtlFile(const std::string & filename, std::vector<ObjMaterial> & materials, std::unordered_map< std::string, int > & materialMap);
+
+		ObjData m_data;
+		std::unordered_map< std::string, int > m_materialMap;
+		std::vector < Material > m_materials;
+		std::vector < std::string > m_dependencies;
+
+		VertexIndexMap m_vertexMap;
+		glm::uint m_vertexCount = 0;
+		// per vertex in the order of creation: one more than the index of the group that used it last,
+		// its index within that group, its index in the assembled vertices and its position
+		std::vector<glm::uint> m_vertexGroups;
+		std::vector<glm::uint> m_vertexLocalIndices;
+		std::vector<glm::uint> m_vertexFinalIndices;
+		std::vector<glm::vec3> m_vertexPositions;
+
+		std::size_t m_cacheMissesBefore = 0;
+		std::size_t m_cacheMissesAfter = 0;
+		std::size_t m_optimizedTriangleCount = 0;
+		glm::uint m_assembledIndexCount = 0;
+		glm::uint m_assembledMeshletCount = 0;
+		std::size_t m_chunkTriangleBudget = 0;
+		std::size_t m_indexCount = 0;
+
+		glm::vec3 m_minimumBounds = glm::vec3(0.0f);
+		glm::vec3 m_maximumBounds = glm::vec3(0.0f);
+	};
+}
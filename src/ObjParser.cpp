@@ -0,0 +1,601 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+
+#include <charconv>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <string_view>
+#include <algorithm>
+#include <unordered_map>
+
+using namespace minity;
+using namespace glm;
+
+namespace
+{
+	inline bool isSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+	}
+
+	inline bool isDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	std::string trimmed(const char* begin, const char* end)
+	{
+		while (begin < end && (*begin == ' ' || *begin == '\t' || *begin == '\r' || *begin == '\n'))
+			begin++;
+
+		while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n'))
+			end--;
+
+		return std::string(begin, end);
+	}
+
+	// Reads whitespace-separated values from a single line. Like std::istream, the scanner
+	// stays in a failed state after the first unsuccessful read, so chained reads can be
+	// written the same way as the former operator>> chains.
+	class LineScanner
+	{
+	public:
+		LineScanner(const char* begin, const char* end) : m_current(begin), m_end(end)
+		{
+		}
+
+		explicit operator bool() const
+		{
+			return !m_failed;
+		}
+
+		LineScanner& readInt(int& value)
+		{
+			if (m_failed)
+				return *this;
+
+			skipSpace();
+
+			const char* start = m_current;
+
+			const bool plus = start < m_end && *start == '+';
+
+			if (plus)
+				start++;
+
+			const char* digits = (!plus && start < m_end && *start == '-') ? start + 1 : start;
+
+			if (digits >= m_end || !isDigit(*digits))
+				return fail();
+
+			auto result = std::from_chars(start, m_end, value);
+
+			if (result.ec != std::errc())
+				return fail();
+
+			m_current = result.ptr;
+			return *this;
+		}
+
+		LineScanner& readFloat(float& value)
+		{
+			if (m_failed)
+				return *this;
+
+			skipSpace();
+
+			const char* start = m_current;
+
+			const bool plus = start < m_end && *start == '+';
+
+			if (plus)
+				start++;
+
+			const char* digits = (!plus && start < m_end && *start == '-') ? start + 1 : start;
+
+			// std::from_chars would also accept "inf" and "nan", which the stream extraction did not
+			if (digits >= m_end || !(isDigit(*digits) || *digits == '.'))
+				return fail();
+
+			auto result = std::from_chars(start, m_end, value);
+
+			if (result.ec == std::errc::result_out_of_range)
+			{
+				// underflow is accepted (flushed towards zero), overflow is an error
+				const std::string text(start, result.ptr);
+				const float rangeValue = std::strtof(text.c_str(), nullptr);
+
+				if (std::isinf(rangeValue))
+					return fail();
+
+				value = rangeValue;
+			}
+			else if (result.ec != std::errc())
+			{
+				return fail();
+			}
+
+			m_current = result.ptr;
+			return *this;
+		}
+
+		// skips leading whitespace, then expects the character c
+		LineScanner& readChar(char c)
+		{
+			if (m_failed)
+				return *this;
+
+			skipSpace();
+			return readRawChar(c);
+		}
+
+		// expects the character c immediately at the current position
+		LineScanner& readRawChar(char c)
+		{
+			if (m_failed)
+				return *this;
+
+			if (m_current >= m_end || *m_current != c)
+				return fail();
+
+			m_current++;
+			return *this;
+		}
+
+	private:
+
+		void skipSpace()
+		{
+			while (m_current < m_end && isSpace(*m_current))
+				m_current++;
+		}
+
+		LineScanner& fail()
+		{
+			m_failed = true;
+			return *this;
+		}
+
+		const char* m_current;
+		const char* m_end;
+		bool m_failed = false;
+	};
+
+	// A statement that changes which group the following faces are added to, together with these faces.
+	// Chunks collect their faces in segments, so that the statements can be replayed in file order when
+	// the chunks are merged, without knowing the group and material that are active at the chunk start.
+	struct ObjSegment
+	{
+		enum class Statement { None, Group, Material };
+
+		Statement statement = Statement::None;
+		std::string argument;
+		std::vector<uint> positionIndices;
+		std::vector<uint> normalIndices;
+		std::vector<uint> texCoordIndices;
+	};
+
+	struct ObjChunk
+	{
+		const char* begin = nullptr;
+		const char* end = nullptr;
+
+		// number of attributes defined before the chunk, including the dummy elements
+		std::size_t positionBase = 1;
+		std::size_t normalBase = 1;
+		std::size_t texCoordBase = 1;
+
+		// number of attribute statements found by countAttributes()
+		std::size_t positionCount = 0;
+		std::size_t normalCount = 0;
+		std::size_t texCoordCount = 0;
+
+		std::vector<vec3> positions;
+		std::vector<vec3> normals;
+		std::vector<vec2> texCoords;
+		std::vector<ObjSegment> segments;
+		std::vector<std::string> materialLibraries;
+	};
+
+	// calls handleLine(lineBegin, lineEnd, tokenBegin, tokenEnd) for every line containing a token
+	template <typename LineHandler>
+	void forEachLine(const char* begin, const char* end, LineHandler handleLine)
+	{
+		const char* line = begin;
+
+		while (line < end)
+		{
+			const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', std::size_t(end - line)));
+
+			if (lineEnd == nullptr)
+				lineEnd = end;
+
+			const char* tokenBegin = line;
+
+			while (tokenBegin < lineEnd && isSpace(*tokenBegin))
+				tokenBegin++;
+
+			const char* tokenEnd = tokenBegin;
+
+			while (tokenEnd < lineEnd && !isSpace(*tokenEnd))
+				tokenEnd++;
+
+			if (tokenBegin < tokenEnd)
+				handleLine(line, lineEnd, tokenBegin, tokenEnd);
+
+			if (lineEnd == end)
+				break;
+
+			line = lineEnd + 1;
+		}
+	}
+
+	// pre-pass that counts the v, vn and vt statements, so that relative indices can be resolved during parsing
+	void countAttributes(ObjChunk& chunk)
+	{
+		forEachLine(chunk.begin, chunk.end, [&](const char*, const char*, const char* tokenBegin, const char* tokenEnd)
+		{
+			if (tokenBegin[0] != 'v')
+				return;
+
+			const std::size_t length = std::size_t(tokenEnd - tokenBegin);
+
+			if (length == 1)
+				chunk.positionCount++;
+			else if (length == 2 && tokenBegin[1] == 'n')
+				chunk.normalCount++;
+			else if (length == 2 && tokenBegin[1] == 't')
+				chunk.texCoordCount++;
+		});
+	}
+
+	void parseChunk(ObjChunk& chunk)
+	{
+		std::vector< vec3 >& positions = chunk.positions;
+		std::vector< vec3 >& normals = chunk.normals;
+		std::vector< vec2 >& texCoords = chunk.texCoords;
+
+		positions.reserve(chunk.positionCount);
+		normals.reserve(chunk.normalCount);
+		texCoords.reserve(chunk.texCoordCount);
+
+		chunk.segments.emplace_back();
+
+		// appends the k-th corner of the current face, triangulating polygons as fans around the first corner
+		auto addCorner = [&](uint k, int v, int t, int n)
+		{
+			ObjSegment& segment = chunk.segments.back();
+
+			if (k >= 3)
+			{
+				segment.positionIndices.push_back(segment.positionIndices[segment.positionIndices.size() - 3]);
+				segment.texCoordIndices.push_back(segment.texCoordIndices[segment.texCoordIndices.size() - 3]);
+				segment.normalIndices.push_back(segment.normalIndices[segment.normalIndices.size() - 3]);
+
+				segment.positionIndices.push_back(segment.positionIndices[segment.positionIndices.size() - 2]);
+				segment.texCoordIndices.push_back(segment.texCoordIndices[segment.texCoordIndices.size() - 2]);
+				segment.normalIndices.push_back(segment.normalIndices[segment.normalIndices.size() - 2]);
+			}
+
+			// relative indices refer to the attributes defined so far, including those of preceding chunks
+			segment.positionIndices.push_back(v < 0 ? (uint)(v + chunk.positionBase + positions.size()) : (uint)(v));
+			segment.texCoordIndices.push_back(t < 0 ? (uint)(t + chunk.texCoordBase + texCoords.size()) : (uint)(t));
+			segment.normalIndices.push_back(n < 0 ? (uint)(n + chunk.normalBase + normals.size()) : (uint)(n));
+		};
+
+		auto beginSegment = [&](ObjSegment::Statement statement, std::string argument)
+		{
+			ObjSegment segment;
+			segment.statement = statement;
+			segment.argument = std::move(argument);
+			chunk.segments.push_back(std::move(segment));
+		};
+
+		forEachLine(chunk.begin, chunk.end, [&](const char* line, const char* lineEnd, const char* tokenBegin, const char* tokenEnd)
+		{
+			const std::string_view token(tokenBegin, std::size_t(tokenEnd - tokenBegin));
+
+			// statements that take the rest of the line as their argument ignore lines where nothing follows the keyword
+			const bool hasArgument = tokenEnd < lineEnd;
+
+			switch (token[0])
+			{
+				// v, vn, vt
+			case 'v':
+			{
+				LineScanner scanner(tokenEnd, lineEnd);
+
+				if (token == "v")
+				{
+					vec3 p(0.0f);
+
+					if (scanner.readFloat(p.x).readFloat(p.y).readFloat(p.z))
+						positions.push_back(p);
+				}
+				else if (token == "vn")
+				{
+					vec3 n(0.0f);
+
+					if (scanner.readFloat(n.x).readFloat(n.y).readFloat(n.z))
+						normals.push_back(n);
+				}
+				else if (token == "vt")
+				{
+					vec2 t(0.0f);
+
+					if (scanner.readFloat(t.x).readFloat(t.y))
+						texCoords.push_back(t);
+				}
+			}
+			break;
+
+			// mtllib
+			case 'm':
+			{
+				if (hasArgument)
+					chunk.materialLibraries.push_back(trimmed(tokenEnd, lineEnd));
+			}
+			break;
+
+			// use material
+			case 'u':
+			{
+				if (hasArgument)
+					beginSegment(ObjSegment::Statement::Material, trimmed(tokenEnd, lineEnd));
+			}
+			break;
+
+			// group
+			case 'g':
+			case 'o':
+			{
+				if (hasArgument)
+					beginSegment(ObjSegment::Statement::Group, trimmed(tokenEnd, lineEnd));
+			}
+			break;
+
+			// face
+			case 'f':
+			{
+				int v = 0, n = 0, t = 0;
+				uint k = 0;
+
+				if (std::string_view(line, std::size_t(lineEnd - line)).find("//") != std::string_view::npos)
+				{
+					// v//n
+					LineScanner scanner(tokenEnd, lineEnd);
+
+					while (scanner.readInt(v).readChar('/').readRawChar('/').readInt(n))
+						addCorner(k++, v, 0, n);
+
+					break;
+				}
+
+				{
+					// v/t/n
+					LineScanner scanner(tokenEnd, lineEnd);
+
+					while (scanner.readInt(v).readChar('/').readInt(t).readChar('/').readInt(n))
+						addCorner(k++, v, t, n);
+
+					if (k > 0)
+						break;
+				}
+
+				{
+					// v/t
+					LineScanner scanner(tokenEnd, lineEnd);
+
+					while (scanner.readInt(v).readChar('/').readInt(t))
+						addCorner(k++, v, t, 0);
+
+					if (k > 0)
+						break;
+				}
+
+				{
+					// v
+					LineScanner scanner(tokenEnd, lineEnd);
+
+					while (scanner.readInt(v))
+						addCorner(k++, v, 0, 0);
+				}
+			}
+			break;
+			}
+		});
+	}
+
+	// Concatenates the attributes of all chunks and replays their group and material statements in file order.
+	void mergeChunks(std::vector<ObjChunk>& chunks, ObjData& data, unsigned int threadCount)
+	{
+		const ObjChunk& last = chunks.back();
+
+		data.positions.resize(last.positionBase + last.positions.size());
+		data.normals.resize(last.normalBase + last.normals.size());
+		data.texCoords.resize(last.texCoordBase + last.texCoords.size());
+
+		data.positions[0] = vec3(0.0f);
+		data.normals[0] = vec3(0.0f);
+		data.texCoords[0] = vec2(1.0f);
+
+		std::string currentMaterial = "default";
+
+		std::unordered_map< std::string, std::size_t > groupMap;
+
+		ObjGroup defaultGroup;
+		defaultGroup.name = "default";
+		defaultGroup.material = currentMaterial;
+		data.groups.push_back(defaultGroup);
+		groupMap[defaultGroup.name] = 0;
+
+		std::size_t currentGroup = 0;
+
+		struct SegmentTarget
+		{
+			const ObjSegment* segment;
+			std::size_t group;
+			std::size_t offset;
+		};
+
+		std::vector<SegmentTarget> targets;
+		std::vector<std::size_t> groupSizes(1, 0);
+
+		for (const auto& chunk : chunks)
+		{
+			data.materialLibraries.insert(data.materialLibraries.end(), chunk.materialLibraries.begin(), chunk.materialLibraries.end());
+
+			for (const auto& segment : chunk.segments)
+			{
+				if (segment.statement == ObjSegment::Statement::Group)
+				{
+					auto j = groupMap.find(segment.argument);
+
+					if (j == groupMap.end())
+					{
+						ObjGroup newGroup;
+						newGroup.name = segment.argument;
+
+						data.groups.push_back(newGroup);
+						groupSizes.push_back(0);
+						currentGroup = data.groups.size() - 1;
+					}
+					else
+						currentGroup = j->second;
+
+					data.groups[currentGroup].material = currentMaterial;
+				}
+				else if (segment.statement == ObjSegment::Statement::Material)
+				{
+					currentMaterial = segment.argument;
+					data.groups[currentGroup].material = currentMaterial;
+				}
+
+				if (!segment.positionIndices.empty())
+				{
+					targets.push_back({ &segment, currentGroup, groupSizes[currentGroup] });
+					groupSizes[currentGroup] += segment.positionIndices.size();
+				}
+			}
+		}
+
+		for (std::size_t i = 0; i < data.groups.size(); i++)
+		{
+			data.groups[i].positionIndices.resize(groupSizes[i]);
+			data.groups[i].normalIndices.resize(groupSizes[i]);
+			data.groups[i].texCoordIndices.resize(groupSizes[i]);
+		}
+
+		parallelFor(chunks.size(), [&](std::size_t i)
+		{
+			const ObjChunk& chunk = chunks[i];
+			std::copy(chunk.positions.begin(), chunk.positions.end(), data.positions.begin() + chunk.positionBase);
+			std::copy(chunk.normals.begin(), chunk.normals.end(), data.normals.begin() + chunk.normalBase);
+			std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), data.texCoords.begin() + chunk.texCoordBase);
+		}, threadCount);
+
+		parallelFor(targets.size(), [&](std::size_t i)
+		{
+			const SegmentTarget& target = targets[i];
+			ObjGroup& group = data.groups[target.group];
+			std::copy(target.segment->positionIndices.begin(), target.segment->positionIndices.end(), group.positionIndices.begin() + target.offset);
+			std::copy(target.segment->normalIndices.begin(), target.segment->normalIndices.end(), group.normalIndices.begin() + target.offset);
+			std::copy(target.segment->texCoordIndices.begin(), target.segment->texCoordIndices.end(), group.texCoordIndices.begin() + target.offset);
+		}, threadCount);
+	}
+}
+
+ObjParser::ObjParser(unsigned int threadCount) : m_threadCount(threadCount)
+{
+
+}
+
+void ObjParser::setThreadCount(unsigned int threadCount)
+{
+	m_threadCount = threadCount;
+}
+
+unsigned int ObjParser::threadCount() const
+{
+	return m_threadCount;
+}
+
+bool ObjParser::parseFile(const std::string& filename, ObjData& data)
+{
+	MappedFile file(filename);
+
+	if (!file.isOpen())
+		return false;
+
+	parse(file.begin(), file.end(), data);
+	return true;
+}
+
+void ObjParser::parse(const char* begin, const char* end, ObjData& data)
+{
+	// chunks smaller than this are not worth the additional pre-pass and merge
+	const std::size_t minimumChunkSize = std::size_t(1) << 20;
+
+	const unsigned int threadCount = m_threadCount > 0 ? m_threadCount : hardwareThreadCount();
+	const std::size_t size = std::size_t(end - begin);
+	const std::size_t chunkCount = std::max<std::size_t>(1, std::min<std::size_t>(threadCount, size / minimumChunkSize));
+
+	data.positions.clear();
+	data.normals.clear();
+	data.texCoords.clear();
+	data.groups.clear();
+	data.materialLibraries.clear();
+
+	std::vector<ObjChunk> chunks(chunkCount);
+
+	// split on line boundaries
+	const char* chunkBegin = begin;
+
+	for (std::size_t i = 0; i < chunkCount; i++)
+	{
+		const char* chunkEnd = end;
+
+		if (i + 1 < chunkCount)
+		{
+			chunkEnd = std::max(chunkBegin, begin + size * (i + 1) / chunkCount);
+			const char* lineEnd = static_cast<const char*>(std::memchr(chunkEnd, '\n', std::size_t(end - chunkEnd)));
+			chunkEnd = lineEnd ? lineEnd + 1 : end;
+		}
+
+		chunks[i].begin = chunkBegin;
+		chunks[i].end = chunkEnd;
+		chunkBegin = chunkEnd;
+	}
+
+	if (chunkCount > 1)
+	{
+		parallelFor(chunkCount, [&](std::size_t i) { countAttributes(chunks[i]); }, threadCount);
+
+		for (std::size_t i = 1; i < chunkCount; i++)
+		{
+			chunks[i].positionBase = chunks[i - 1].positionBase + chunks[i - 1].positionCount;
+			chunks[i].normalBase = chunks[i - 1].normalBase + chunks[i - 1].normalCount;
+			chunks[i].texCoordBase = chunks[i - 1].texCoordBase + chunks[i - 1].texCoordCount;
+		}
+	}
+
+	parallelFor(chunkCount, [&](std::size_t i) { parseChunk(chunks[i]); }, threadCount);
+
+	if (chunkCount > 1)
+	{
+		// the pre-pass only counts statements, so a malformed attribute would shift all relative indices after it
+		for (const auto& chunk : chunks)
+		{
+			if (chunk.positions.size() != chunk.positionCount || chunk.normals.size() != chunk.normalCount || chunk.texCoords.size() != chunk.texCoordCount)
+			{
+				ObjParser serialParser(1);
+				serialParser.parse(begin, end, data);
+				return;
+			}
+		}
+	}
+
+	mergeChunks(chunks, data, threadCount);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+namespace minity
+{
+	struct ObjGroup
+	{
+		std::string name;
+		std::string material;
+		std::vector<glm::uint> positionIndices;
+		std::vector<glm::uint> normalIndices;
+		std::vector<glm::uint> texCoordIndices;
+	};
+
+	struct ObjData
+	{
+		// all attribute arrays start with a dummy element, so that index 0 means "not specified"
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec2> texCoords;
+		std::vector<ObjGroup> groups;
+		// trimmed arguments of all mtllib statements, in file order
+		std::vector<std::string> materialLibraries;
+	};
+
+	// Wavefront OBJ tokenizer that works directly on the (memory-mapped) file contents.
+	// Polygons are triangulated as fans; the result matches what the former stream-based
+	// parser in ObjLoader produced, including its handling of malformed statements.
+	// Large files are split on line boundaries and the chunks are parsed concurrently;
+	// the merge restores file order, so the output does not depend on the thread count.
+	class ObjParser
+	{
+	public:
+		// a thread count of 0 uses one thread per hardware thread, 1 parses serially
+		ObjParser(unsigned int threadCount = 0);
+
+		void setThreadCount(unsigned int threadCount);
+		unsigned int threadCount() const;
+
+		bool parseFile(const std::string& filename, ObjData& data);
+		void parse(const char* begin, const char* end, ObjData& data);
+
+	private:
+		unsigned int m_threadCount = 0;
+	};
+}
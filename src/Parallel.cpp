@@ -0,0 +1,164 @@
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace minity;
+
+unsigned int minity::hardwareThreadCount()
+{
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void minity::parallelFor(std::size_t count, const std::function<void(std::size_t)>& task, unsigned int threadCount)
+{
+	if (count == 0)
+		return;
+
+	if (threadCount == 0)
+		threadCount = hardwareThreadCount();
+
+	threadCount = unsigned(std::min<std::size_t>(threadCount, count));
+
+	if (threadCount <= 1)
+	{
+		for (std::size_t i = 0; i < count; i++)
+			task(i);
+
+		return;
+	}
+
+	std::atomic<std::size_t> next(0);
+	std::exception_ptr exception;
+	std::mutex exceptionMutex;
+
+	auto worker = [&]()
+	{
+		try
+		{
+			for (std::size_t i = next++; i < count; i = next++)
+				task(i);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(exceptionMutex);
+
+			if (!exception)
+				exception = std::current_exception();
+
+			// make the other workers run out of work
+			next = count;
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+
+	for (unsigned int i = 1; i < threadCount; i++)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (auto& t : threads)
+		t.join();
+
+	if (exception)
+		std::rethrow_exception(exception);
+}
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	if (threadCount == 0)
+		threadCount = hardwareThreadCount();
+
+	m_threads.reserve(threadCount);
+
+	for (unsigned int i = 0; i < threadCount; i++)
+		m_threads.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_tasksFinished.wait(lock, [this]() { return m_tasks.empty() && m_runningCount == 0; });
+		m_stopping = true;
+	}
+
+	m_taskQueued.notify_all();
+
+	for (auto& t : m_threads)
+		t.join();
+}
+
+void ThreadPool::enqueue(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(std::move(task));
+	}
+
+	m_taskQueued.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_tasksFinished.wait(lock, [this]() { return m_tasks.empty() && m_runningCount == 0; });
+
+	if (m_exception)
+	{
+		std::exception_ptr exception = m_exception;
+		m_exception = nullptr;
+		std::rethrow_exception(exception);
+	}
+}
+
+unsigned int ThreadPool::threadCount() const
+{
+	return unsigned(m_threads.size());
+}
+
+void ThreadPool::work()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		m_taskQueued.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+
+		if (m_tasks.empty())
+			return;
+
+		std::function<void()> task = std::move(m_tasks.front());
+		m_tasks.pop_front();
+		m_runningCount++;
+
+		lock.unlock();
+
+		std::exception_ptr exception;
+
+		try
+		{
+			task();
+		}
+		catch (...)
+		{
+			exception = std::current_exception();
+		}
+
+		lock.lock();
+
+		if (exception && !m_exception)
+			m_exception = exception;
+
+		m_runningCount--;
+
+		if (m_tasks.empty() && m_runningCount == 0)
+			m_tasksFinished.notify_all();
+	}
+}
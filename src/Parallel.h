@@ -0,0 +1,52 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace minity
+{
+	// Number of worker threads used by the parallel loading and processing stages.
+	unsigned int hardwareThreadCount();
+
+	// Calls task(i) for every i in [0, count) on up to threadCount threads (0 = one per hardware thread)
+	// and returns when all calls have finished. The calling thread takes part in the work. An exception
+	// thrown by a task is rethrown on the calling thread after all workers have stopped.
+	void parallelFor(std::size_t count, const std::function<void(std::size_t)>& task, unsigned int threadCount = 0);
+
+	// Fixed set of worker threads that run queued tasks in FIFO order, for work that has to proceed
+	// while the calling thread does something else. The destructor waits for all queued tasks.
+	class ThreadPool
+	{
+	public:
+		ThreadPool(unsigned int threadCount = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		void enqueue(std::function<void()> task);
+
+		// blocks until all queued tasks have finished, rethrows the first exception thrown by a task
+		void wait();
+
+		unsigned int threadCount() const;
+
+	private:
+		void work();
+
+		std::vector<std::thread> m_threads;
+		std::deque<std::function<void()>> m_tasks;
+		std::mutex m_mutex;
+		std::condition_variable m_taskQueued;
+		std::condition_variable m_tasksFinished;
+		std::size_t m_runningCount = 0;
+		std::exception_ptr m_exception;
+		bool m_stopping = false;
+	};
+}
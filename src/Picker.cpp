@@ -0,0 +1,130 @@
+#include "Picker.h"
+#include "Model.h"
+
+#include <chrono>
+
+using namespace minity;
+using namespace glm;
+
+Picker::~Picker()
+{
+	if (m_job.valid())
+		m_job.wait();
+}
+
+void Picker::update(const Model& model)
+{
+	if (m_job.valid())
+	{
+		if (m_job.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return;
+
+		m_result = m_job.get();
+	}
+
+	// The model is only taken over once it is completely loaded, the hierarchies of the previous one are
+	// dropped as soon as loading starts, as its groups and triangles no longer exist.
+	if (model.isLoading())
+	{
+		m_result.reset();
+		return;
+	}
+
+	if (model.generation() == m_generation)
+		return;
+
+	m_generation = model.generation();
+	m_result.reset();
+
+	m_job = std::async(std::launch::async, [vertices = model.vertices(), indices = model.indices(), groups = model.groups()]()
+	{
+		auto result = std::make_unique<BuildResult>();
+		const auto start = std::chrono::steady_clock::now();
+
+		result->groups.resize(groups.size());
+
+		for (std::size_t i = 0; i < groups.size(); i++)
+		{
+			result->groups[i].build(vertices, indices, Bvh::groupTriangles({ groups[i] }));
+			result->triangleCount += result->groups[i].triangleCount();
+		}
+
+		result->buildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return result;
+	});
+}
+
+bool Picker::ready() const
+{
+	return m_result != nullptr;
+}
+
+bool Picker::building() const
+{
+	return m_job.valid();
+}
+
+bool Picker::pick(const mat4& modelViewProjection, vec2 position, const std::vector<vec3>& groupOffsets, Selection& selection) const
+{
+	if (!m_result)
+		return false;
+
+	// the ray from the near to the far plane in the coordinates of the model
+	const mat4 inverseModelViewProjection = inverse(modelViewProjection);
+	vec4 near = inverseModelViewProjection * vec4(position, -1.0f, 1.0f);
+	vec4 far = inverseModelViewProjection * vec4(position, 1.0f, 1.0f);
+	near /= near.w;
+	far /= far.w;
+
+	Ray ray;
+	ray.origin = vec3(near);
+	ray.direction = vec3(far - near);
+	ray.maximumDistance = 1.0f;
+
+	// every group is intersected with the ray moved by the opposite of its offset, and only closer hits count
+	RayHit hit;
+	uint group = Selection::noGroup;
+	vec3 offset = vec3(0.0f);
+
+	for (uint i = 0; i < m_result->groups.size(); i++)
+	{
+		const Bvh& bvh = m_result->groups[i];
+
+		if (bvh.empty())
+			continue;
+
+		Ray groupRay = ray;
+		groupRay.maximumDistance = hit.valid() ? hit.distance : ray.maximumDistance;
+
+		if (i < groupOffsets.size())
+			groupRay.origin -= groupOffsets[i];
+
+		RayHit groupHit;
+
+		if (bvh.intersect(groupRay, groupHit))
+		{
+			hit = groupHit;
+			group = i;
+			offset = ray.origin - groupRay.origin;
+		}
+	}
+
+	if (!hit.valid())
+		return false;
+
+	selection.group = group;
+	selection.triangle = hit.triangle;
+	selection.barycentrics = hit.barycentrics;
+	selection.position = ray.origin - offset + hit.distance * ray.direction;
+	return true;
+}
+
+std::size_t Picker::triangleCount() const
+{
+	return m_result ? m_result->triangleCount : 0;
+}
+
+double Picker::buildTime() const
+{
+	return m_result ? m_result->buildTime : 0.0;
+}
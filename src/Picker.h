@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Bvh.h"
+#include "Scene.h"
+
+#include <glm/glm.hpp>
+
+#include <future>
+#include <memory>
+#include <vector>
+
+namespace minity
+{
+	class Model;
+
+	// Finds the triangle and group of a model under the cursor by casting a ray into bounding volume hierarchies
+	// over the full resolution triangles, one per group, so that groups drawn with an offset are hit where they
+	// are drawn. The hierarchies are built on a background thread whenever a new model has been completely
+	// loaded; until they are available, nothing is picked.
+	class Picker
+	{
+	public:
+		~Picker();
+
+		// Takes over a finished hierarchy and starts building a new one if the model has changed, call once per
+		// frame. Nothing is picked while the model is loading.
+		void update(const Model& model);
+		bool ready() const;
+		bool building() const;
+
+		// Casts a ray through the point in normalized device coordinates at the groups displaced by their offsets,
+		// missing offsets are zero. Returns false if no triangle is hit. The selection is only valid for the model
+		// the hierarchies were built for.
+		bool pick(const glm::mat4& modelViewProjection, glm::vec2 position, const std::vector<glm::vec3>& groupOffsets, Selection& selection) const;
+
+		std::size_t triangleCount() const;
+		// in seconds
+		double buildTime() const;
+
+	private:
+		struct BuildResult
+		{
+			// per group, empty for groups without triangles
+			std::vector<Bvh> groups;
+			std::size_t triangleCount = 0;
+			double buildTime = 0.0;
+		};
+
+		std::future<std::unique_ptr<BuildResult>> m_job;
+		std::unique_ptr<BuildResult> m_result;
+		// the generation of the model the hierarchies were last built for
+		std::size_t m_generation = 0;
+	};
+}
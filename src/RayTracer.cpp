@@ -0,0 +1,218 @@
+#include "RayTracer.h"
+#include "Parallel.h"
+
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace minity;
+using namespace glm;
+
+const int RayTracer::tileSize = 32;
+
+void RayTracer::setScene(const std::vector<Vertex>& vertices, const std::vector<uint>& indices, const std::vector<Group>& groups, const std::vector<Material>& materials, TraversalKernel kernel)
+{
+	clear();
+
+	m_vertices = vertices;
+	m_indices = indices;
+
+	for (const auto& material : materials)
+	{
+		SurfaceMaterial surface;
+		surface.ambient = material.ambient;
+		surface.diffuse = material.diffuse;
+		surface.specular = material.specular;
+		surface.shininess = material.shininess;
+		m_materials.push_back(surface);
+	}
+
+	// for groups without a valid material
+	SurfaceMaterial defaultMaterial;
+	defaultMaterial.diffuse = vec3(0.8f);
+	m_materials.push_back(defaultMaterial);
+
+	m_triangleMaterials.assign(indices.size() / 3, uint(m_materials.size() - 1));
+
+	for (const auto& group : groups)
+	{
+		const uint material = std::min(group.materialIndex, uint(m_materials.size() - 1));
+
+		for (uint i = group.startIndex; i + 3 <= group.endIndex; i += 3)
+			m_triangleMaterials[i / 3] = material;
+	}
+
+	m_bvh.build(m_vertices, m_indices, Bvh::groupTriangles(groups));
+	m_wideBvh.build(m_bvh, kernel);
+}
+
+void RayTracer::clear()
+{
+	m_bvh.clear();
+	m_wideBvh.clear();
+	m_vertices.clear();
+	m_indices.clear();
+	m_triangleMaterials.clear();
+	m_materials.clear();
+}
+
+const Bvh& RayTracer::bvh() const
+{
+	return m_bvh;
+}
+
+const WideBvh& RayTracer::wideBvh() const
+{
+	return m_wideBvh;
+}
+
+bool RayTracer::render(const RayTracingView& view, ivec2 size, RayTracedImage& image, unsigned int threadCount, const std::atomic<bool>* cancelled) const
+{
+	const std::size_t pixelCount = std::size_t(std::max(size.x, 0)) * std::size_t(std::max(size.y, 0));
+
+	image.size = size;
+	image.colors.resize(4 * pixelCount);
+	image.depths.resize(pixelCount);
+
+	if (pixelCount == 0)
+		return true;
+
+	const mat4 inverseModelViewProjection = inverse(view.modelViewProjection);
+	const ivec2 tileCount = (size + ivec2(tileSize - 1)) / tileSize;
+	std::atomic<bool> skipped(false);
+
+	parallelFor(std::size_t(tileCount.x) * std::size_t(tileCount.y), [&](std::size_t tile)
+	{
+		if (cancelled && *cancelled)
+		{
+			skipped = true;
+			return;
+		}
+
+		const ivec2 start = ivec2(int(tile % tileCount.x), int(tile / tileCount.x)) * tileSize;
+		const ivec2 end = min(start + ivec2(tileSize), size);
+
+		// neighbouring pixels in one packet take similar paths through the hierarchy
+		const ivec2 packetSize = ivec2(4, 2);
+		static_assert(4 * 2 == WideBvh::packetSize, "packets are expected to cover 4x2 pixels");
+
+		for (int packetY = start.y; packetY < end.y; packetY += packetSize.y)
+		{
+			for (int packetX = start.x; packetX < end.x; packetX += packetSize.x)
+			{
+				Ray rays[WideBvh::packetSize];
+				RayHit hits[WideBvh::packetSize];
+				ivec2 pixels[WideBvh::packetSize];
+				std::size_t rayCount = 0;
+
+				for (int y = packetY; y < std::min(packetY + packetSize.y, end.y); y++)
+				{
+					for (int x = packetX; x < std::min(packetX + packetSize.x, end.x); x++)
+					{
+						// the same setup as the viewing rays in raytrace-fs.glsl
+						const vec2 position = 2.0f * vec2((float(x) + 0.5f) / float(size.x), (float(y) + 0.5f) / float(size.y)) - 1.0f;
+						vec4 near = inverseModelViewProjection * vec4(position, -1.0f, 1.0f);
+						vec4 far = inverseModelViewProjection * vec4(position, 1.0f, 1.0f);
+						near /= near.w;
+						far /= far.w;
+
+						Ray& ray = rays[rayCount];
+						ray.origin = vec3(near);
+						ray.direction = vec3(far - near);
+						ray.maximumDistance = length(ray.direction);
+						ray.direction /= ray.maximumDistance;
+						pixels[rayCount++] = ivec2(x, y);
+					}
+				}
+
+				m_wideBvh.intersect(rays, rayCount, hits);
+
+				for (std::size_t i = 0; i < rayCount; i++)
+				{
+					vec3 color = view.backgroundColor;
+					float depth = 1.0f;
+
+					if (hits[i].valid())
+					{
+						color = shade(view, rays[i], hits[i]);
+
+						const vec4 clipPosition = view.modelViewProjection * vec4(rays[i].origin + hits[i].distance * rays[i].direction, 1.0f);
+						depth = std::min(std::max(0.5f * clipPosition.z / clipPosition.w + 0.5f, 0.0f), 1.0f);
+					}
+
+					const std::size_t pixel = std::size_t(pixels[i].y) * std::size_t(size.x) + std::size_t(pixels[i].x);
+
+					for (int c = 0; c < 3; c++)
+						image.colors[4 * pixel + c] = (unsigned char)(std::min(std::max(color[c], 0.0f), 1.0f) * 255.0f + 0.5f);
+
+					image.colors[4 * pixel + 3] = 255;
+					image.depths[pixel] = depth;
+				}
+			}
+		}
+	}, threadCount);
+
+	return !skipped;
+}
+
+bool RayTracer::writeImage(const std::string& filename, const RayTracedImage& image)
+{
+	if (image.size.x <= 0 || image.size.y <= 0)
+		return false;
+
+	stbi_flip_vertically_on_write(true);
+	return stbi_write_png(filename.c_str(), image.size.x, image.size.y, 4, image.colors.data(), image.size.x * 4) != 0;
+}
+
+vec3 RayTracer::shade(const RayTracingView& view, const Ray& ray, const RayHit& hit) const
+{
+	const std::size_t first = 3 * std::size_t(hit.triangle);
+	const Vertex& v0 = m_vertices[m_indices[first]];
+	const Vertex& v1 = m_vertices[m_indices[first + 1]];
+	const Vertex& v2 = m_vertices[m_indices[first + 2]];
+	const SurfaceMaterial& material = m_materials[m_triangleMaterials[hit.triangle]];
+
+	vec3 normal = (1.0f - hit.barycentrics.x - hit.barycentrics.y) * v0.normal + hit.barycentrics.x * v1.normal + hit.barycentrics.y * v2.normal;
+
+	if (dot(normal, normal) == 0.0f)
+		normal = cross(v1.position - v0.position, v2.position - v0.position);
+
+	normal = normalize(normal);
+
+	// Blinn-Phong as in model-base-fs.glsl
+	const Lighting& lighting = view.lighting;
+	const vec3 position = ray.origin + hit.distance * ray.direction;
+	const vec3 lightDirection = normalize(view.lightPosition - position);
+	const vec3 viewDirection = -ray.direction;
+
+	vec3 result = vec3(0.0f);
+
+	if (lighting.ambientEnabled)
+		result += lighting.ambientLightIntensity * material.ambient;
+
+	if (view.shadowsEnabled && (lighting.diffuseEnabled || lighting.specularEnabled))
+	{
+		Ray shadowRay;
+		shadowRay.origin = position;
+		shadowRay.direction = view.lightPosition - position;
+		shadowRay.minimumDistance = 1e-4f;
+		shadowRay.maximumDistance = 1.0f - 1e-4f;
+
+		// shadow rays are incoherent, so they are traced one by one
+		if (m_wideBvh.occluded(shadowRay))
+			return result;
+	}
+
+	if (lighting.diffuseEnabled)
+		result += std::max(dot(normal, lightDirection), 0.0f) * lighting.lightIntensity * material.diffuse;
+
+	if (lighting.specularEnabled && material.shininess > 0.0f)
+	{
+		const vec3 halfwayDirection = normalize(lightDirection + viewDirection);
+		const float specular = std::pow(std::max(dot(normal, halfwayDirection), 0.0f), material.shininess);
+		result += specular * lighting.lightIntensity * material.specular * lighting.shininessMultiplier;
+	}
+
+	return result;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Bvh.h"
+#include "Model.h"
+#include "Scene.h"
+#include "WideBvh.h"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace minity
+{
+	// camera and light of a ray traced image, in the object space of the model
+	struct RayTracingView
+	{
+		// rays are cast through the pixel centers from the near to the far plane of this transform
+		glm::mat4 modelViewProjection = glm::mat4(1.0f);
+		glm::vec3 lightPosition = glm::vec3(0.0f);
+		Lighting lighting;
+		// color of pixels where no triangle is hit
+		glm::vec3 backgroundColor = glm::vec3(0.0f);
+		// traces an additional ray towards the light for every hit
+		bool shadowsEnabled = false;
+	};
+
+	struct RayTracedImage
+	{
+		glm::ivec2 size = glm::ivec2(0);
+		// RGBA with 8 bits per channel, bottom row first like glReadPixels() and texture uploads
+		std::vector<unsigned char> colors;
+		// window space depth in [0,1] for the default depth range, 1 where no triangle was hit
+		std::vector<float> depths;
+	};
+
+	// Ray tracer for the triangles of a model on the CPU, for interactive previews on machines without a GPU
+	// and for reference images. Shading follows the Blinn-Phong mode of the model shader with the material
+	// colors; texture maps are not sampled.
+	class RayTracer
+	{
+	public:
+		// edge length of the square tiles images are rendered in
+		static const int tileSize;
+
+		// Copies the full resolution triangles of the groups with their material colors and builds the hierarchy,
+		// which is collapsed for the given traversal kernel.
+		void setScene(const std::vector<Vertex>& vertices, const std::vector<glm::uint>& indices, const std::vector<Group>& groups, const std::vector<Material>& materials, TraversalKernel kernel = WideBvh::fastestKernel());
+		void clear();
+
+		const Bvh& bvh() const;
+		const WideBvh& wideBvh() const;
+
+		// Traces one ray per pixel into an image of the given size, in packets of 4x2 pixels. The tiles are handed
+		// out to up to threadCount threads (0 = one per hardware thread) whenever one of them becomes idle.
+		// Returns false if the flag was set before all tiles were done, the remaining tiles are left unchanged then.
+		bool render(const RayTracingView& view, glm::ivec2 size, RayTracedImage& image, unsigned int threadCount = 0, const std::atomic<bool>* cancelled = nullptr) const;
+
+		static bool writeImage(const std::string& filename, const RayTracedImage& image);
+
+	private:
+		struct SurfaceMaterial
+		{
+			glm::vec3 ambient = glm::vec3(0.0f);
+			glm::vec3 diffuse = glm::vec3(0.0f);
+			glm::vec3 specular = glm::vec3(0.0f);
+			float shininess = 0.0f;
+		};
+
+		glm::vec3 shade(const RayTracingView& view, const Ray& ray, const RayHit& hit) const;
+
+		Bvh m_bvh;
+		WideBvh m_wideBvh;
+		std::vector<Vertex> m_vertices;
+		std::vector<glm::uint> m_indices;
+		// per triangle of the indices, an index into the materials
+		std::vector<glm::uint> m_triangleMaterials;
+		std::vector<SurfaceMaterial> m_materials;
+	};
+}
@@ -1,13 +1,16 @@
 #include "RaytraceRenderer.h"
 #include <globjects/base/File.h>
 #include <globjects/State.h>
+#include <globjects/globjects.h>
 #include <iostream>
 #include <filesystem>
 #include <imgui.h>
 #include "Viewer.h"
 #include "Scene.h"
 #include "Model.h"
+#include "Parallel.h"
 #include <sstream>
+#include <chrono>
 
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -20,6 +23,25 @@ using namespace gl;
 using namespace glm;
 using namespace globjects;
 
+namespace
+{
+	bool sameView(const RayTracingView& first, const RayTracingView& second)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			if (first.modelViewProjection[i] != second.modelViewProjection[i])
+				return false;
+		}
+
+		const Lighting& a = first.lighting;
+		const Lighting& b = second.lighting;
+
+		return first.lightPosition == second.lightPosition && first.backgroundColor == second.backgroundColor && first.shadowsEnabled == second.shadowsEnabled &&
+			a.lightIntensity == b.lightIntensity && a.ambientLightIntensity == b.ambientLightIntensity && a.shininessMultiplier == b.shininessMultiplier &&
+			a.ambientEnabled == b.ambientEnabled && a.diffuseEnabled == b.diffuseEnabled && a.specularEnabled == b.specularEnabled;
+	}
+}
+
 RaytraceRenderer::RaytraceRenderer(Viewer* viewer) : Renderer(viewer)
 {
 	m_quadVertices->setStorage(std::array<vec2, 4>({ vec2(-1.0f, 1.0f), vec2(-1.0f,-1.0f), vec2(1.0f,1.0f), vec2(1.0f,-1.0f) }), gl::GL_NONE_BIT);
@@ -34,6 +56,28 @@ RaytraceRenderer::RaytraceRenderer(Viewer* viewer) : Renderer(viewer)
 			{ GL_FRAGMENT_SHADER,"./res/raytrace/raytrace-fs.glsl" },
 		}, 
 		{ "./res/raytrace/raytrace-globals.glsl" });
+
+	createShaderProgram("raytrace-image", {
+			{ GL_VERTEX_SHADER,"./res/raytrace/raytrace-vs.glsl" },
+			{ GL_FRAGMENT_SHADER,"./res/raytrace/raytrace-image-fs.glsl" },
+		},
+		{ "./res/raytrace/raytrace-globals.glsl" });
+}
+
+RaytraceRenderer::~RaytraceRenderer()
+{
+	m_jobCancelled = true;
+
+	if (m_job.valid())
+		m_job.wait();
+
+	if (m_gpuJob.valid())
+		m_gpuJob.wait();
+}
+
+const char* RaytraceRenderer::name() const
+{
+	return "Raytrace";
 }
 
 void RaytraceRenderer::display()
@@ -44,14 +88,121 @@ void RaytraceRenderer::display()
 	// retrieve/compute all necessary matrices and related properties
 	const mat4 modelViewProjectionMatrix = viewer()->modelViewProjectionTransform();
 	const mat4 inverseModelViewProjectionMatrix = inverse(modelViewProjectionMatrix);
+	const mat4 inverseModelLightMatrix = inverse(viewer()->modelLightTransform());
+	const ivec2 viewportSize = viewer()->viewportSize();
 
-	auto shaderProgramRaytrace = shaderProgram("raytrace");
+	static bool primitivesEnabled = true;
+	static bool modelEnabled = false;
+	static bool gpuModelEnabled = false;
+	static bool shadowsEnabled = false;
+	static bool gpuShadowsEnabled = false;
+	static int resolutionDivisor = 2;
+	static int threadCount = int(hardwareThreadCount());
+
+	if (ImGui::BeginMenu("Raytrace"))
+	{
+		ImGui::Checkbox("Primitives Enabled", &primitivesEnabled);
+		ImGui::Checkbox("Model Enabled (CPU)", &modelEnabled);
+
+		if (modelEnabled)
+		{
+			ImGui::Checkbox("Shadows Enabled", &shadowsEnabled);
+			ImGui::SliderInt("Resolution Divisor", &resolutionDivisor, 1, 8);
+			ImGui::SliderInt("Threads", &threadCount, 1, int(hardwareThreadCount()));
+			ImGui::Text("Traversal: %s", WideBvh::kernelName(WideBvh::fastestKernel()));
+			ImGui::Text("Hierarchy: %zu triangles, %zu nodes, built in %.0f ms", m_sceneTriangleCount, m_sceneNodeCount, m_sceneTime * 1e3);
+
+			if (m_renderTime > 0.0)
+				ImGui::Text("Last image: %.1f ms, %.2f Mrays/s", m_renderTime * 1e3, double(m_renderedPixelCount) / m_renderTime * 1e-6);
+		}
+
+		// shader storage buffers are not part of OpenGL 4.0
+		if (globjects::hasExtension(GLextension::GL_ARB_shader_storage_buffer_object))
+		{
+			ImGui::Checkbox("Model Enabled (GPU)", &gpuModelEnabled);
+
+			if (gpuModelEnabled)
+			{
+				ImGui::Checkbox("GPU Shadows Enabled", &gpuShadowsEnabled);
+
+				if (m_gpuJob.valid())
+					ImGui::Text("Building hierarchy ...");
+				else
+					ImGui::Text("GPU hierarchy: %zu triangles, %zu nodes, built in %.0f ms", m_gpuTriangleCount, m_gpuNodeCount, m_gpuBuildTime * 1e3);
+			}
+		}
+		else
+		{
+			gpuModelEnabled = false;
+		}
+
+		ImGui::EndMenu();
+	}
+
+	if (gpuModelEnabled)
+		updateGpuScene();
+
+	// the model is only traced on the GPU once its hierarchy has been uploaded
+	const bool gpuModelReady = gpuModelEnabled && m_gpuNodeCount > 0;
 
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LESS);
 
+	if (modelEnabled)
+	{
+		RayTracingView view;
+		view.modelViewProjection = modelViewProjectionMatrix;
+		view.lightPosition = vec3(inverseModelLightMatrix * vec4(0.0f, 0.0f, 0.0f, 1.0f));
+		view.lighting = viewer()->scene()->lighting();
+		view.backgroundColor = viewer()->backgroundColor();
+		view.shadowsEnabled = shadowsEnabled;
+
+		m_threadCount = unsigned(threadCount);
+		traceModel(view, max(viewportSize / resolutionDivisor, ivec2(1)));
+
+		if (m_colorTexture)
+		{
+			auto shaderProgramImage = shaderProgram("raytrace-image");
+			shaderProgramImage->setUniform("colorTexture", 0);
+			shaderProgramImage->setUniform("depthTexture", 1);
+
+			m_colorTexture->bindActive(0);
+			m_depthTexture->bindActive(1);
+
+			m_quadArray->bind();
+			shaderProgramImage->use();
+			m_quadArray->drawArrays(GL_TRIANGLE_STRIP, 0, 4);
+			shaderProgramImage->release();
+			m_quadArray->unbind();
+
+			m_depthTexture->unbindActive(1);
+			m_colorTexture->unbindActive(0);
+		}
+	}
+
+	if (!primitivesEnabled && !gpuModelReady)
+		return;
+
+	auto shaderProgramRaytrace = shaderProgram("raytrace");
+
 	shaderProgramRaytrace->setUniform("modelViewProjectionMatrix", modelViewProjectionMatrix);
 	shaderProgramRaytrace->setUniform("inverseModelViewProjectionMatrix", inverseModelViewProjectionMatrix);
+	shaderProgramRaytrace->setUniform("primitivesEnabled", primitivesEnabled);
+	shaderProgramRaytrace->setUniform("modelEnabled", gpuModelReady);
+
+	if (gpuModelReady)
+	{
+		const Lighting& lighting = viewer()->scene()->lighting();
+
+		shaderProgramRaytrace->setUniform("shadowsEnabled", gpuShadowsEnabled);
+		shaderProgramRaytrace->setUniform("lightPosition", vec3(inverseModelLightMatrix * vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+		shaderProgramRaytrace->setUniform("lightIntensity", lighting.lightIntensity);
+		shaderProgramRaytrace->setUniform("ambientLightIntensity", lighting.ambientLightIntensity);
+		shaderProgramRaytrace->setUniform("shininessMultiplier", lighting.shininessMultiplier);
+		shaderProgramRaytrace->setUniform("ambientEnabled", lighting.ambientEnabled);
+		shaderProgramRaytrace->setUniform("diffuseEnabled", lighting.diffuseEnabled);
+		shaderProgramRaytrace->setUniform("specularEnabled", lighting.specularEnabled);
+	}
 
 	//Raytrace test code
 	//Sphere
@@ -93,6 +244,10 @@ void RaytraceRenderer::display()
 
 	m_quadArray->bind();
 	shaderProgramRaytrace->use();
+
+	if (gpuModelReady)
+		bindGpuScene(shaderProgramRaytrace);
+
 	// we are rendering a screen filling quad (as a tringle strip), so we can cast rays for every pixel
 	m_quadArray->drawArrays(GL_TRIANGLE_STRIP, 0, 4);
 	shaderProgramRaytrace->release();
@@ -101,4 +256,161 @@ void RaytraceRenderer::display()
 
 	// Restore OpenGL state (disabled to to issues with some Intel drivers)
 	// currentState->apply();
-}
\ No newline at end of file
+}
+
+void RaytraceRenderer::updateGpuScene()
+{
+	if (m_gpuJob.valid())
+	{
+		if (m_gpuJob.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return;
+
+		const GpuSceneResult result = m_gpuJob.get();
+		m_gpuNodeCount = result.data.nodes.size();
+		m_gpuTriangleCount = result.data.triangles.size();
+		m_gpuBuildTime = result.buildTime;
+
+		if (m_gpuNodeCount > 0)
+		{
+			m_bvhNodes->setData(result.data.nodes, GL_STATIC_DRAW);
+			m_bvhTriangles->setData(result.data.triangles, GL_STATIC_DRAW);
+			m_bvhNormals->setData(result.data.normals, GL_STATIC_DRAW);
+			m_bvhMaterials->setData(result.data.materials, GL_STATIC_DRAW);
+		}
+	}
+
+	// the model is only taken over once it is completely loaded
+	const Model& model = *viewer()->scene()->model();
+
+	if (model.isLoading() || model.generation() == m_gpuSceneGeneration)
+		return;
+
+	m_gpuSceneGeneration = model.generation();
+
+	m_gpuJob = std::async(std::launch::async, [vertices = model.vertices(), indices = model.indices(), groups = model.groups(), materials = model.materials()]()
+	{
+		GpuSceneResult result;
+		const auto start = std::chrono::steady_clock::now();
+
+		if (!result.data.build(vertices, indices, groups, materials))
+			std::cerr << "Model has too many triangles to be traced on the GPU." << std::endl;
+
+		result.buildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return result;
+	});
+}
+
+void RaytraceRenderer::bindGpuScene(Program* program)
+{
+	const char* blockNames[] = { "BvhNodes", "BvhTriangles", "BvhNormals", "BvhMaterials" };
+	const Buffer* buffers[] = { m_bvhNodes.get(), m_bvhTriangles.get(), m_bvhNormals.get(), m_bvhMaterials.get() };
+
+	// GLSL 4.0 has no binding layout qualifier, so the blocks are bound to the buffers from here
+	for (GLuint i = 0; i < 4; i++)
+	{
+		glShaderStorageBlockBinding(program->id(), glGetProgramResourceIndex(program->id(), GL_SHADER_STORAGE_BLOCK, blockNames[i]), i);
+		buffers[i]->bindBase(GL_SHADER_STORAGE_BUFFER, i);
+	}
+}
+
+void RaytraceRenderer::traceModel(const RayTracingView& view, ivec2 size)
+{
+	if (m_job.valid())
+	{
+		if (m_job.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			if (!sameView(view, m_jobView) || size != m_jobSize)
+				m_jobCancelled = true;
+
+			return;
+		}
+
+		const TracingResult result = m_job.get();
+
+		if (result.sceneTime > 0.0)
+		{
+			m_sceneTime = result.sceneTime;
+			m_sceneTriangleCount = result.triangleCount;
+			m_sceneNodeCount = result.nodeCount;
+		}
+
+		if (result.completed)
+		{
+			m_renderTime = result.renderTime;
+			m_renderedPixelCount = std::size_t(m_jobSize.x) * std::size_t(m_jobSize.y);
+			uploadImage(m_jobImage);
+		}
+		else
+		{
+			// make sure that the cancelled view is traced again
+			m_jobSize = ivec2(0);
+		}
+	}
+
+	// the model is only taken over once it is completely loaded
+	const Model& model = *viewer()->scene()->model();
+	const bool sceneChanged = !model.isLoading() && model.generation() != m_sceneGeneration;
+
+	if (!sceneChanged && sameView(view, m_jobView) && size == m_jobSize)
+		return;
+
+	std::vector<Vertex> vertices;
+	std::vector<uint> indices;
+	std::vector<Group> groups;
+	std::vector<Material> materials;
+
+	if (sceneChanged)
+	{
+		m_sceneGeneration = model.generation();
+
+		vertices = model.vertices();
+		indices = model.indices();
+		groups = model.groups();
+		materials = model.materials();
+	}
+
+	m_jobView = view;
+	m_jobSize = size;
+	m_jobCancelled = false;
+
+	m_job = std::async(std::launch::async, [this, sceneChanged, threadCount = m_threadCount, vertices = std::move(vertices), indices = std::move(indices), groups = std::move(groups), materials = std::move(materials)]()
+	{
+		TracingResult result;
+		auto start = std::chrono::steady_clock::now();
+
+		if (sceneChanged)
+		{
+			m_rayTracer.setScene(vertices, indices, groups, materials);
+			result.sceneTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			result.triangleCount = m_rayTracer.bvh().triangleCount();
+			result.nodeCount = m_rayTracer.bvh().nodes().size();
+			start = std::chrono::steady_clock::now();
+		}
+
+		result.completed = m_rayTracer.render(m_jobView, m_jobSize, m_jobImage, threadCount, &m_jobCancelled);
+		result.renderTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return result;
+	});
+}
+
+void RaytraceRenderer::uploadImage(const RayTracedImage& image)
+{
+	if (!m_colorTexture)
+	{
+		m_colorTexture = Texture::create(GL_TEXTURE_2D);
+		m_colorTexture->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		m_colorTexture->setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		m_colorTexture->setParameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		m_colorTexture->setParameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		m_depthTexture = Texture::create(GL_TEXTURE_2D);
+		m_depthTexture->setParameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		m_depthTexture->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		m_depthTexture->setParameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		m_depthTexture->setParameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	m_colorTexture->image2D(0, GL_RGBA8, image.size, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.colors.data());
+	m_depthTexture->image2D(0, GL_R32F, image.size, 0, GL_RED, GL_FLOAT, image.depths.data());
+}
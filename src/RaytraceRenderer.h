@@ -1,6 +1,11 @@
 #pragma once
 #include "Renderer.h"
+#include "RayTracer.h"
+#include "GpuBvh.h"
+#include <atomic>
+#include <future>
 #include <memory>
+#include <string>
 
 #include <glm/glm.hpp>
 #include <glbinding/gl/gl.h>
@@ -28,9 +33,71 @@ namespace minity
 	{
 	public:
 		RaytraceRenderer(Viewer *viewer);
+		~RaytraceRenderer();
 		virtual void display();
+		virtual const char* name() const;
 
 	private:
+		struct TracingResult
+		{
+			bool completed = false;
+			// in seconds, the scene time is 0 if the scene was unchanged
+			double sceneTime = 0.0;
+			double renderTime = 0.0;
+			// of the hierarchy built for a changed scene
+			std::size_t triangleCount = 0;
+			std::size_t nodeCount = 0;
+		};
+
+		struct GpuSceneResult
+		{
+			GpuBvhData data;
+			// in seconds
+			double buildTime = 0.0;
+		};
+
+		// Uploads the hierarchy of a finished build job into the shader storage buffers and starts a new build if
+		// the model has changed since the last one was started.
+		void updateGpuScene();
+		void bindGpuScene(globjects::Program* program);
+
+		// Takes over the image of a finished tracing job and starts a new one if the view or the model has changed
+		// since the last one was started, cancelling a job that is still running for an outdated view.
+		void traceModel(const RayTracingView& view, glm::ivec2 size);
+		void uploadImage(const RayTracedImage& image);
+
+		// the model is traced on a background thread, while the last completed image is displayed
+		RayTracer m_rayTracer;
+		std::future<TracingResult> m_job;
+		std::atomic<bool> m_jobCancelled{ false };
+		RayTracingView m_jobView;
+		RayTracedImage m_jobImage;
+		glm::ivec2 m_jobSize = glm::ivec2(0);
+		// the generation of the model the ray tracer was last given
+		std::size_t m_sceneGeneration = 0;
+
+		// of the last completed scene, the ray tracer itself must not be accessed while a job is running
+		double m_sceneTime = 0.0;
+		std::size_t m_sceneTriangleCount = 0;
+		std::size_t m_sceneNodeCount = 0;
+		double m_renderTime = 0.0;
+		std::size_t m_renderedPixelCount = 0;
+		unsigned int m_threadCount = 0;
+
+		// the model traced by raytrace-fs.glsl, the hierarchy is built on a background thread
+		std::future<GpuSceneResult> m_gpuJob;
+		// the generation of the model the last build was started for
+		std::size_t m_gpuSceneGeneration = 0;
+		std::size_t m_gpuNodeCount = 0;
+		std::size_t m_gpuTriangleCount = 0;
+		double m_gpuBuildTime = 0.0;
+		std::unique_ptr<globjects::Buffer> m_bvhNodes = std::make_unique<globjects::Buffer>();
+		std::unique_ptr<globjects::Buffer> m_bvhTriangles = std::make_unique<globjects::Buffer>();
+		std::unique_ptr<globjects::Buffer> m_bvhNormals = std::make_unique<globjects::Buffer>();
+		std::unique_ptr<globjects::Buffer> m_bvhMaterials = std::make_unique<globjects::Buffer>();
+
+		std::unique_ptr<globjects::Texture> m_colorTexture;
+		std::unique_ptr<globjects::Texture> m_depthTexture;
 		std::unique_ptr<globjects::VertexArray> m_quadArray = std::make_unique<globjects::VertexArray>();
 		std::unique_ptr<globjects::Buffer> m_quadVertices = std::make_unique<globjects::Buffer>();
 	};
@@ -41,12 +41,15 @@ namespace minity
 
 	public:
 		Renderer(Viewer* viewer);
+		virtual ~Renderer() = default;
 		Viewer * viewer();
 		void setEnabled(bool enabled);
 		bool isEnabled() const;
 		
 		virtual void reloadShaders();
 		virtual void display() = 0;
+		// shown in the profiler and external debugging tools
+		virtual const char* name() const = 0;
 
 		bool createShaderProgram(const std::string & name, std::initializer_list< std::pair<gl::GLenum, std::string> > shaders, std::initializer_list < std::string> shaderIncludes = {});
 		globjects::Program* shaderProgram(const std::string & name);
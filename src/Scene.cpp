@@ -12,4 +12,18 @@ Scene::Scene()
 Model * Scene::model()
 {
 	return m_model.get();
+}
+Lighting & Scene::lighting()
+{
+	return m_lighting;
+}
+
+Selection & Scene::selection()
+{
+	return m_selection;
+}
+
+std::vector<glm::vec3> & Scene::groupOffsets()
+{
+	return m_groupOffsets;
 }
\ No newline at end of file
@@ -1,20 +1,61 @@
 #pragma once
 
+#include <glm/glm.hpp>
+
+#include <limits>
 #include <memory>
+#include <vector>
 
 namespace minity
 {
 	class Model;
 
+	// Blinn-Phong lighting of the model, shared by the rasterized and the ray traced views
+	struct Lighting
+	{
+		glm::vec3 lightIntensity = glm::vec3(1.0f, 1.0f, 1.0f);
+		glm::vec3 ambientLightIntensity = glm::vec3(0.1f, 0.08f, 0.06f);
+		float shininessMultiplier = 1.0f;
+		bool ambientEnabled = true;
+		bool diffuseEnabled = true;
+		bool specularEnabled = true;
+	};
+
+	// the triangle of the model picked with the mouse, highlighted by the model renderer
+	struct Selection
+	{
+		static constexpr glm::uint noGroup = std::numeric_limits<glm::uint>::max();
+
+		glm::uint group = noGroup;
+		// index of the first of its indices divided by three
+		glm::uint triangle = 0;
+		// weights of the second and third vertex of the triangle at the picked point
+		glm::vec2 barycentrics = glm::vec2(0.0f);
+		// in the coordinates of the model vertices
+		glm::vec3 position = glm::vec3(0.0f);
+
+		bool valid() const
+		{
+			return group != noGroup;
+		}
+	};
+
 	class Scene
 	{
 	public:
 		Scene();
 		Model* model();
+		Lighting& lighting();
+		Selection& selection();
+		// displacement of every group as the model renderer draws it, e.g. when the model is exploded
+		std::vector<glm::vec3>& groupOffsets();
 
 	private:
 		std::unique_ptr<Model> m_model;
+		Lighting m_lighting;
+		Selection m_selection;
+		std::vector<glm::vec3> m_groupOffsets;
 	};
 
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,112 @@
+#include "TextureCache.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+#include <globjects/globjects.h>
+#include <globjects/logging.h>
+
+using namespace minity;
+using namespace gl;
+using namespace glm;
+using namespace globjects;
+
+TextureCache& TextureCache::instance()
+{
+	static TextureCache cache;
+	return cache;
+}
+
+std::string TextureCache::canonicalPath(const std::string& filename)
+{
+	std::error_code error;
+	std::filesystem::path path = std::filesystem::weakly_canonical(std::filesystem::absolute(filename, error), error);
+
+	if (error)
+		return std::filesystem::path(filename).lexically_normal().generic_string();
+
+	return path.generic_string();
+}
+
+std::shared_ptr<Texture> TextureCache::find(const std::string& filename, TextureKind kind, const TextureSampling& sampling)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto i = m_entries.find(Key(canonicalPath(filename), kind, sampling));
+
+	if (i == m_entries.end())
+		return nullptr;
+
+	i->second.lastUse = ++m_useCounter;
+	return i->second.texture;
+}
+
+std::shared_ptr<Texture> TextureCache::insert(const std::string& filename, TextureKind kind, const TextureSampling& sampling, std::shared_ptr<Texture> texture, std::size_t byteSize)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	Entry& entry = m_entries[Key(canonicalPath(filename), kind, sampling)];
+
+	if (!entry.texture)
+	{
+		entry.texture = std::move(texture);
+		entry.byteSize = byteSize;
+	}
+
+	entry.lastUse = ++m_useCounter;
+	return entry.texture;
+}
+
+void TextureCache::trim()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// textures only referenced by the cache are candidates for eviction, oldest first
+	std::vector<std::map<Key, Entry>::iterator> unused;
+	std::size_t unusedSize = 0;
+
+	for (auto i = m_entries.begin(); i != m_entries.end(); ++i)
+	{
+		if (i->second.texture.use_count() == 1)
+		{
+			unused.push_back(i);
+			unusedSize += i->second.byteSize;
+		}
+	}
+
+	std::sort(unused.begin(), unused.end(), [](const auto& a, const auto& b) { return a->second.lastUse < b->second.lastUse; });
+
+	std::size_t evictedCount = 0;
+
+	for (auto i : unused)
+	{
+		if (unusedSize <= m_budget)
+			break;
+
+		unusedSize -= i->second.byteSize;
+		m_entries.erase(i);
+		evictedCount++;
+	}
+
+	if (evictedCount > 0)
+		globjects::debug() << "Evicted " << evictedCount << " textures from the texture cache.";
+}
+
+void TextureCache::clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries.clear();
+}
+
+std::size_t TextureCache::budget() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_budget;
+}
+
+void TextureCache::setBudget(std::size_t budget)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_budget = budget;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "TextureCompressor.h"
+
+#include <glbinding/gl/enum.h>
+#include <globjects/Texture.h>
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+namespace minity
+{
+	// sampler state a texture is created with, part of the cache key
+	struct TextureSampling
+	{
+		gl::GLenum minFilter = gl::GL_LINEAR_MIPMAP_LINEAR;
+		gl::GLenum magFilter = gl::GL_LINEAR;
+		gl::GLenum wrapS = gl::GL_REPEAT;
+		gl::GLenum wrapT = gl::GL_REPEAT;
+
+		bool operator<(const TextureSampling& other) const
+		{
+			return std::tie(minFilter, magFilter, wrapS, wrapT) < std::tie(other.minFilter, other.magFilter, other.wrapS, other.wrapT);
+		}
+	};
+
+	// Process-wide cache of textures keyed on the canonical path of their image file, the kind of map they
+	// are prepared for and their sampling parameters, so that an image referenced by several material maps
+	// or several models is decoded and uploaded only once. Textures are handed out as shared handles; the
+	// cache keeps textures that are no longer referenced by any model up to a memory budget and evicts the
+	// least recently used ones beyond it. Lookups are thread-safe, inserting and evicting have to happen on
+	// the GL thread.
+	class TextureCache
+	{
+	public:
+		static TextureCache& instance();
+
+		static std::string canonicalPath(const std::string& filename);
+
+		// returns the cached texture or nullptr
+		std::shared_ptr<globjects::Texture> find(const std::string& filename, TextureKind kind, const TextureSampling& sampling = TextureSampling());
+
+		// Adds a texture of the given size in bytes (including mipmaps) and returns the cached one,
+		// which is a previously inserted texture if another loader got there first.
+		std::shared_ptr<globjects::Texture> insert(const std::string& filename, TextureKind kind, const TextureSampling& sampling, std::shared_ptr<globjects::Texture> texture, std::size_t byteSize);
+
+		// evicts the least recently used unreferenced textures until they fit into the budget
+		void trim();
+		// releases all textures, has to be called before the GL context is destroyed
+		void clear();
+
+		std::size_t budget() const;
+		void setBudget(std::size_t budget);
+
+	private:
+		TextureCache() = default;
+
+		struct Entry
+		{
+			std::shared_ptr<globjects::Texture> texture;
+			std::size_t byteSize = 0;
+			std::size_t lastUse = 0;
+		};
+
+		using Key = std::tuple<std::string, TextureKind, TextureSampling>;
+
+		std::map<Key, Entry> m_entries;
+		mutable std::mutex m_mutex;
+		std::size_t m_useCounter = 0;
+		// memory that textures no longer used by any model may occupy, 256 MB by default
+		std::size_t m_budget = 256 * 1024 * 1024;
+	};
+}
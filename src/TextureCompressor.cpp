@@ -0,0 +1,473 @@
+#include "TextureCompressor.h"
+#include "CacheFile.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+using namespace minity;
+using namespace gl;
+using namespace glm;
+
+const unsigned int TextureCompressor::version = 1;
+
+namespace
+{
+	const char cacheMagic[8] = { 'M', 'I', 'N', 'I', 'T', 'E', 'X', '\n' };
+
+	// splits rows into bands that are processed in parallel
+	template <typename Task>
+	void forEachRowBand(int rowCount, const Task& task)
+	{
+		const int bandCount = std::min(rowCount, int(hardwareThreadCount()) * 4);
+		const int bandSize = (rowCount + bandCount - 1) / bandCount;
+
+		parallelFor(std::size_t(bandCount), [&](std::size_t band)
+		{
+			const int begin = int(band) * bandSize;
+			const int end = std::min(rowCount, begin + bandSize);
+
+			for (int y = begin; y < end; y++)
+				task(y);
+		});
+	}
+
+	bool isNormalMap(TextureKind kind)
+	{
+		return kind == TextureKind::ObjectNormals || kind == TextureKind::TangentNormals;
+	}
+
+	// halves an RGBA8 image with a box filter, normal maps are renormalized after filtering
+	std::vector<unsigned char> downsample(const std::vector<unsigned char>& source, ivec2 sourceSize, ivec2 size, TextureKind kind)
+	{
+		std::vector<unsigned char> result(std::size_t(size.x) * std::size_t(size.y) * 4);
+
+		forEachRowBand(size.y, [&](int y)
+		{
+			const int y0 = std::min(2 * y, sourceSize.y - 1);
+			const int y1 = std::min(2 * y + 1, sourceSize.y - 1);
+
+			for (int x = 0; x < size.x; x++)
+			{
+				const int x0 = std::min(2 * x, sourceSize.x - 1);
+				const int x1 = std::min(2 * x + 1, sourceSize.x - 1);
+
+				const unsigned char* texels[4] = {
+					&source[(std::size_t(y0) * sourceSize.x + x0) * 4],
+					&source[(std::size_t(y0) * sourceSize.x + x1) * 4],
+					&source[(std::size_t(y1) * sourceSize.x + x0) * 4],
+					&source[(std::size_t(y1) * sourceSize.x + x1) * 4]
+				};
+
+				unsigned char* target = &result[(std::size_t(y) * size.x + x) * 4];
+
+				for (int c = 0; c < 4; c++)
+					target[c] = (unsigned char)((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+
+				if (isNormalMap(kind))
+				{
+					vec3 normal(0.0f);
+
+					for (auto t : texels)
+						normal += vec3(t[0], t[1], t[2]) / 127.5f - 1.0f;
+
+					if (dot(normal, normal) > 0.0f)
+					{
+						normal = (normalize(normal) + 1.0f) * 127.5f;
+
+						for (int c = 0; c < 3; c++)
+							target[c] = (unsigned char)clamp(normal[c] + 0.5f, 0.0f, 255.0f);
+					}
+				}
+			}
+		});
+
+		return result;
+	}
+
+	// BC4 block: two 8 bit endpoints and 3 bit indices into the eight values interpolated between them
+	void encodeScalarBlock(const unsigned char values[16], unsigned char* block)
+	{
+		int minimum = 255;
+		int maximum = 0;
+
+		for (int i = 0; i < 16; i++)
+		{
+			minimum = std::min(minimum, int(values[i]));
+			maximum = std::max(maximum, int(values[i]));
+		}
+
+		// with the first endpoint greater than the second, indices 2 to 7 interpolate from the first to the second
+		std::uint64_t indices = 0;
+
+		if (maximum > minimum)
+		{
+			const int range = maximum - minimum;
+
+			for (int i = 0; i < 16; i++)
+			{
+				const int step = ((maximum - values[i]) * 14 + range) / (2 * range);
+				const std::uint64_t index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+				indices |= index << (3 * i);
+			}
+		}
+
+		block[0] = (unsigned char)maximum;
+		block[1] = (unsigned char)minimum;
+
+		for (int i = 0; i < 6; i++)
+			block[2 + i] = (unsigned char)(indices >> (8 * i));
+	}
+
+	std::uint16_t packColor(const vec3& color)
+	{
+		const uint r = uint(color.r * 31.0f / 255.0f + 0.5f);
+		const uint g = uint(color.g * 63.0f / 255.0f + 0.5f);
+		const uint b = uint(color.b * 31.0f / 255.0f + 0.5f);
+		return std::uint16_t((r << 11) | (g << 5) | b);
+	}
+
+	vec3 unpackColor(std::uint16_t color)
+	{
+		const uint r = (color >> 11) & 31;
+		const uint g = (color >> 5) & 63;
+		const uint b = color & 31;
+		return vec3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+	}
+
+	// BC1 block: two RGB565 endpoints on the principal axis of the block's colors and 2 bit indices into
+	// the four colors interpolated between them. The first endpoint is always the greater one, which selects
+	// the four color mode that is also used by the color part of BC3 blocks.
+	void encodeColorBlock(const unsigned char texels[16][4], unsigned char* block)
+	{
+		vec3 colors[16];
+		vec3 mean(0.0f);
+
+		for (int i = 0; i < 16; i++)
+		{
+			colors[i] = vec3(texels[i][0], texels[i][1], texels[i][2]);
+			mean += colors[i];
+		}
+
+		mean /= 16.0f;
+
+		// symmetric covariance matrix, stored as its diagonal and the elements above it
+		vec3 diagonal(0.0f);
+		vec3 offDiagonal(0.0f);
+
+		for (const auto& c : colors)
+		{
+			const vec3 d = c - mean;
+			diagonal += d * d;
+			offDiagonal += vec3(d.x * d.y, d.x * d.z, d.y * d.z);
+		}
+
+		// power iteration for the principal axis, starting with the luminance direction
+		vec3 axis(1.0f);
+
+		for (int i = 0; i < 8; i++)
+		{
+			axis = vec3(
+				diagonal.x * axis.x + offDiagonal.x * axis.y + offDiagonal.y * axis.z,
+				offDiagonal.x * axis.x + diagonal.y * axis.y + offDiagonal.z * axis.z,
+				offDiagonal.y * axis.x + offDiagonal.z * axis.y + diagonal.z * axis.z);
+			const float length = max(max(abs(axis.x), abs(axis.y)), abs(axis.z));
+
+			if (length <= 0.0f)
+			{
+				axis = vec3(1.0f);
+				break;
+			}
+
+			axis /= length;
+		}
+
+		int minimumTexel = 0;
+		int maximumTexel = 0;
+
+		for (int i = 1; i < 16; i++)
+		{
+			if (dot(colors[i], axis) < dot(colors[minimumTexel], axis))
+				minimumTexel = i;
+
+			if (dot(colors[i], axis) > dot(colors[maximumTexel], axis))
+				maximumTexel = i;
+		}
+
+		std::uint16_t color0 = packColor(colors[maximumTexel]);
+		std::uint16_t color1 = packColor(colors[minimumTexel]);
+
+		if (color0 < color1)
+			std::swap(color0, color1);
+
+		std::uint32_t indices = 0;
+
+		if (color0 != color1)
+		{
+			const vec3 endpoint0 = unpackColor(color0);
+			const vec3 endpoint1 = unpackColor(color1);
+			const vec3 palette[4] = {
+				endpoint0,
+				endpoint1,
+				(2.0f * endpoint0 + endpoint1) / 3.0f,
+				(endpoint0 + 2.0f * endpoint1) / 3.0f
+			};
+
+			for (int i = 0; i < 16; i++)
+			{
+				std::uint32_t nearest = 0;
+				float nearestDistance = std::numeric_limits<float>::max();
+
+				for (std::uint32_t j = 0; j < 4; j++)
+				{
+					const vec3 d = colors[i] - palette[j];
+					const float distance = dot(d, d);
+
+					if (distance < nearestDistance)
+					{
+						nearest = j;
+						nearestDistance = distance;
+					}
+				}
+
+				indices |= nearest << (2 * i);
+			}
+		}
+
+		block[0] = (unsigned char)(color0 & 0xff);
+		block[1] = (unsigned char)(color0 >> 8);
+		block[2] = (unsigned char)(color1 & 0xff);
+		block[3] = (unsigned char)(color1 >> 8);
+
+		for (int i = 0; i < 4; i++)
+			block[4 + i] = (unsigned char)(indices >> (8 * i));
+	}
+
+	std::size_t blockSize(GLenum format)
+	{
+		return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RED_RGTC1 ? 8 : 16;
+	}
+
+	// encodes one level, 4x4 blocks at the right and bottom border repeat the last texels
+	void encodeLevel(const std::vector<unsigned char>& texels, ivec2 size, GLenum format, unsigned char* target)
+	{
+		const int blocksX = (size.x + 3) / 4;
+		const int blocksY = (size.y + 3) / 4;
+		const std::size_t bytesPerBlock = blockSize(format);
+
+		forEachRowBand(blocksY, [&](int by)
+		{
+			for (int bx = 0; bx < blocksX; bx++)
+			{
+				unsigned char block[16][4];
+
+				for (int i = 0; i < 16; i++)
+				{
+					const int x = std::min(bx * 4 + i % 4, size.x - 1);
+					const int y = std::min(by * 4 + i / 4, size.y - 1);
+					std::memcpy(block[i], &texels[(std::size_t(y) * size.x + x) * 4], 4);
+				}
+
+				unsigned char* output = target + (std::size_t(by) * blocksX + bx) * bytesPerBlock;
+				unsigned char channel[16];
+
+				auto extractChannel = [&](int c)
+				{
+					for (int i = 0; i < 16; i++)
+						channel[i] = block[i][c];
+				};
+
+				if (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+				{
+					encodeColorBlock(block, output);
+				}
+				else if (format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+				{
+					extractChannel(3);
+					encodeScalarBlock(channel, output);
+					encodeColorBlock(block, output + 8);
+				}
+				else if (format == GL_COMPRESSED_RED_RGTC1)
+				{
+					extractChannel(0);
+					encodeScalarBlock(channel, output);
+				}
+				else
+				{
+					extractChannel(0);
+					encodeScalarBlock(channel, output);
+					extractChannel(1);
+					encodeScalarBlock(channel, output + 8);
+				}
+			}
+		});
+	}
+
+	bool isValidFormat(GLenum format)
+	{
+		return format == GL_RGBA8 || format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT || format == GL_COMPRESSED_RED_RGTC1 || format == GL_COMPRESSED_RG_RGTC2;
+	}
+}
+
+ivec2 TextureImage::size() const
+{
+	return levels.empty() ? ivec2(0) : levels.front().size;
+}
+
+bool TextureImage::compressed() const
+{
+	return internalFormat != GL_RGBA8;
+}
+
+std::string TextureCompressor::cacheFilename(const std::string& filename, TextureKind kind)
+{
+	static const char* const kindNames[] = { "color", "scalar", "objectnormals", "tangentnormals" };
+	return filename + "." + kindNames[int(kind)] + ".minity";
+}
+
+bool TextureCompressor::read(const std::string& filename, TextureKind kind, bool colorCompression, TextureImage& image)
+{
+	FileStamp source;
+
+	if (!stampFile(filename, source))
+		return false;
+
+	MappedFile file(cacheFilename(filename, kind));
+
+	if (!file.isOpen())
+		return false;
+
+	CacheReader reader(file.begin(), file.end());
+
+	char magic[sizeof(cacheMagic)] = {};
+	std::uint32_t fileVersion = 0;
+	std::uint32_t fileKind = 0;
+	std::uint32_t format = 0;
+	FileStamp cached;
+
+	reader.readBytes(magic, sizeof(magic)).read(fileVersion).read(fileKind).read(format).readStamp(cached);
+
+	if (!reader || std::memcmp(magic, cacheMagic, sizeof(magic)) != 0 || fileVersion != version || fileKind != std::uint32_t(kind) || !(cached == source))
+		return false;
+
+	std::vector<TextureImage::Level> levels;
+	std::vector<unsigned char> data;
+
+	reader.readArray(levels).readArray(data);
+
+	if (!reader || levels.empty() || !isValidFormat(GLenum(format)))
+		return false;
+
+	// prepared where S3TC is supported, the texture is encoded again without it
+	if (!colorCompression && (GLenum(format) == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || GLenum(format) == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT))
+		return false;
+
+	for (const auto& l : levels)
+	{
+		if (l.size.x <= 0 || l.size.y <= 0 || l.offset > data.size() || l.byteSize > data.size() - l.offset)
+			return false;
+	}
+
+	image.filename = filename;
+	image.internalFormat = GLenum(format);
+	image.levels = std::move(levels);
+	image.data = std::move(data);
+
+	return true;
+}
+
+bool TextureCompressor::write(const std::string& filename, TextureKind kind, const TextureImage& image)
+{
+	FileStamp source;
+
+	if (!stampFile(filename, source))
+		return false;
+
+	CacheWriter writer(cacheFilename(filename, kind));
+
+	if (!writer)
+		return false;
+
+	writer.writeBytes(cacheMagic, sizeof(cacheMagic));
+	writer.write(std::uint32_t(version));
+	writer.write(std::uint32_t(kind));
+	writer.write(std::uint32_t(image.internalFormat));
+	writer.writeStamp(source);
+	writer.writeArray(image.levels);
+	writer.writeArray(image.data);
+
+	return writer.close();
+}
+
+void TextureCompressor::compress(const unsigned char* pixels, ivec2 size, TextureKind kind, bool colorCompression, TextureImage& image)
+{
+	GLenum format = GL_RGBA8;
+
+	switch (kind)
+	{
+	case TextureKind::Color:
+	{
+		if (!colorCompression)
+			break;
+
+		const std::size_t texelCount = std::size_t(size.x) * std::size_t(size.y);
+		bool opaque = true;
+
+		for (std::size_t i = 0; i < texelCount && opaque; i++)
+			opaque = pixels[i * 4 + 3] == 255;
+
+		format = opaque ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		break;
+	}
+
+	case TextureKind::Scalar:
+		format = GL_COMPRESSED_RED_RGTC1;
+		break;
+
+	case TextureKind::ObjectNormals:
+		format = GL_RGBA8;
+		break;
+
+	case TextureKind::TangentNormals:
+		format = GL_COMPRESSED_RG_RGTC2;
+		break;
+	}
+
+	image.internalFormat = format;
+	image.levels.clear();
+	image.data.clear();
+
+	std::vector<unsigned char> level(pixels, pixels + std::size_t(size.x) * std::size_t(size.y) * 4);
+	ivec2 levelSize = size;
+
+	while (true)
+	{
+		TextureImage::Level l;
+		l.size = levelSize;
+		l.offset = image.data.size();
+
+		if (format == GL_RGBA8)
+		{
+			l.byteSize = level.size();
+			image.data.insert(image.data.end(), level.begin(), level.end());
+		}
+		else
+		{
+			l.byteSize = std::size_t((levelSize.x + 3) / 4) * std::size_t((levelSize.y + 3) / 4) * blockSize(format);
+			image.data.resize(l.offset + l.byteSize);
+			encodeLevel(level, levelSize, format, image.data.data() + l.offset);
+		}
+
+		image.levels.push_back(l);
+
+		if (levelSize == ivec2(1))
+			break;
+
+		const ivec2 nextSize = max(levelSize / 2, ivec2(1));
+		level = downsample(level, levelSize, nextSize, kind);
+		levelSize = nextSize;
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glbinding/gl/enum.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace minity
+{
+	// what a texture map contains, determines how it is filtered and encoded
+	enum class TextureKind
+	{
+		Color,
+		Scalar,
+		ObjectNormals,
+		TangentNormals
+	};
+
+	// Texture with its complete mipmap chain, ready to be uploaded on the GL thread.
+	struct TextureImage
+	{
+		struct Level
+		{
+			glm::ivec2 size = glm::ivec2(0);
+			std::size_t offset = 0;
+			std::size_t byteSize = 0;
+		};
+
+		std::string filename;
+		gl::GLenum internalFormat = gl::GL_RGBA8;
+		// all levels are stored back to back in data, starting with the base level
+		std::vector<Level> levels;
+		std::vector<unsigned char> data;
+
+		glm::ivec2 size() const;
+		bool compressed() const;
+
+		std::size_t byteSize() const
+		{
+			return data.size();
+		}
+	};
+
+	// Prepares decoded images for rendering: builds the mipmap chain on the CPU and block-compresses all
+	// levels, using BC1 (opaque) or BC3 (with alpha) for color maps, BC4 for single-channel maps and BC5 for
+	// tangent space normal maps, whose z component is reconstructed in the shader. Object space normal maps
+	// need all three components with their signs and are kept uncompressed. BC1 and BC3 are only core with
+	// GL_EXT_texture_compression_s3tc, without it color maps are kept uncompressed as well, as selected by
+	// colorCompression. The result is cached in "<image>.<kind>.minity" next to the image and used as long as
+	// the image is unchanged and its format can be uploaded.
+	class TextureCompressor
+	{
+	public:
+		// has to be increased whenever the file layout or the encoding changes
+		static const unsigned int version;
+
+		static std::string cacheFilename(const std::string& filename, TextureKind kind);
+
+		static bool read(const std::string& filename, TextureKind kind, bool colorCompression, TextureImage& image);
+		static bool write(const std::string& filename, TextureKind kind, const TextureImage& image);
+
+		// builds and encodes all levels of an image given as tightly packed 8 bit RGBA texels
+		static void compress(const unsigned char* pixels, glm::ivec2 size, TextureKind kind, bool colorCompression, TextureImage& image);
+	};
+}
@@ -0,0 +1,177 @@
+#include "VertexCompressor.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+using namespace minity;
+using namespace gl;
+using namespace glm;
+
+namespace
+{
+	const float quantizationRange = 65535.0f;
+
+	static_assert(sizeof(CompactVertex) == sizeof(Vertex) / 2, "compact vertices are expected to take half the space");
+}
+
+PositionQuantization VertexCompressor::quantization(vec3 minimumBounds, vec3 maximumBounds)
+{
+	PositionQuantization quantization;
+	quantization.offset = minimumBounds;
+	quantization.scale = max(maximumBounds - minimumBounds, vec3(0.0f));
+	return quantization;
+}
+
+CompactVertex VertexCompressor::encode(const Vertex& vertex, const PositionQuantization& quantization)
+{
+	CompactVertex result;
+
+	for (int i = 0; i < 3; i++)
+	{
+		// positions are clamped to the bounds, degenerate extents map everything to the offset
+		const float relative = quantization.scale[i] > 0.0f ? (vertex.position[i] - quantization.offset[i]) / quantization.scale[i] : 0.0f;
+		result.position[i] = std::uint16_t(std::round(std::min(std::max(relative, 0.0f), 1.0f) * quantizationRange));
+	}
+
+	result.normal = encodeOctahedral(vertex.normal);
+	result.texcoord = packHalf2x16(vertex.texcoord);
+	return result;
+}
+
+Vertex VertexCompressor::decode(const CompactVertex& vertex, const PositionQuantization& quantization)
+{
+	Vertex result;
+
+	for (int i = 0; i < 3; i++)
+		result.position[i] = quantization.offset[i] + quantization.scale[i] * (float(vertex.position[i]) / quantizationRange);
+
+	result.normal = decodeOctahedral(vertex.normal);
+	result.texcoord = unpackHalf2x16(vertex.texcoord);
+	return result;
+}
+
+void VertexCompressor::encode(const Vertex* vertices, std::size_t count, const PositionQuantization& quantization, CompactVertex* result)
+{
+	const std::size_t blockSize = 64 * 1024;
+	const std::size_t blockCount = (count + blockSize - 1) / blockSize;
+
+	parallelFor(blockCount, [&](std::size_t block)
+	{
+		const std::size_t end = std::min(count, (block + 1) * blockSize);
+
+		for (std::size_t i = block * blockSize; i < end; i++)
+			result[i] = encode(vertices[i], quantization);
+	});
+}
+
+uint VertexCompressor::encodeOctahedral(vec3 normal)
+{
+	// project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the diagonals
+	const float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+
+	if (sum == 0.0f)
+		return packSnorm2x16(vec2(0.0f));
+
+	vec2 encoded = vec2(normal.x, normal.y) / sum;
+
+	if (normal.z < 0.0f)
+	{
+		const vec2 folded = vec2(1.0f - std::abs(encoded.y), 1.0f - std::abs(encoded.x));
+		encoded.x = encoded.x >= 0.0f ? folded.x : -folded.x;
+		encoded.y = encoded.y >= 0.0f ? folded.y : -folded.y;
+	}
+
+	return packSnorm2x16(encoded);
+}
+
+vec3 VertexCompressor::decodeOctahedral(uint encoded)
+{
+	// has to match the decoding in model-base-vs.glsl
+	const vec2 unpacked = unpackSnorm2x16(encoded);
+	vec3 normal = vec3(unpacked.x, unpacked.y, 1.0f - std::abs(unpacked.x) - std::abs(unpacked.y));
+	const float fold = std::max(-normal.z, 0.0f);
+
+	normal.x += normal.x >= 0.0f ? -fold : fold;
+	normal.y += normal.y >= 0.0f ? -fold : fold;
+
+	return normalize(normal);
+}
+
+void VertexCompressor::encodeIndices(const uint* indices, std::size_t count, bool allowShort, std::vector<unsigned char>& data, std::vector<IndexRange>& ranges)
+{
+	const uint shortRange = std::numeric_limits<std::uint16_t>::max();
+
+	auto appendRange = [&](const uint* rangeIndices, std::size_t rangeCount, uint baseVertex, GLenum type)
+	{
+		IndexRange range;
+		range.type = type;
+		range.count = uint(rangeCount);
+		range.baseVertex = baseVertex;
+
+		data.resize((data.size() + 3) & ~std::size_t(3), 0);
+		range.offset = data.size();
+
+		if (type == GL_UNSIGNED_SHORT)
+		{
+			data.resize(data.size() + range.count * sizeof(std::uint16_t));
+			std::uint16_t* target = reinterpret_cast<std::uint16_t*>(data.data() + range.offset);
+
+			for (std::size_t i = 0; i < rangeCount; i++)
+				target[i] = std::uint16_t(rangeIndices[i] - baseVertex);
+		}
+		else
+		{
+			data.resize(data.size() + range.count * sizeof(uint));
+
+			if (rangeCount > 0)
+				std::memcpy(data.data() + range.offset, rangeIndices, rangeCount * sizeof(uint));
+		}
+
+		ranges.push_back(range);
+	};
+
+	if (!allowShort || count < 3)
+		return appendRange(indices, count, 0, GL_UNSIGNED_INT);
+
+	// Triangles are gathered into ranges that span at most 65536 vertices each, in their original order.
+	// Vertices are numbered in the order of their first use, so that few ranges cover most triangles of a
+	// group. Triangles that span more vertices on their own are collected into a final range of 32 bit indices.
+	std::vector<uint> shortTriangles;
+	std::vector<uint> wideTriangles;
+	uint minimumIndex = std::numeric_limits<uint>::max();
+	uint maximumIndex = 0;
+
+	for (std::size_t t = 0; t + 2 < count; t += 3)
+	{
+		const uint triangleMinimum = std::min({ indices[t], indices[t + 1], indices[t + 2] });
+		const uint triangleMaximum = std::max({ indices[t], indices[t + 1], indices[t + 2] });
+
+		if (triangleMaximum - triangleMinimum > shortRange)
+		{
+			wideTriangles.insert(wideTriangles.end(), indices + t, indices + t + 3);
+			continue;
+		}
+
+		if (!shortTriangles.empty() && std::max(maximumIndex, triangleMaximum) - std::min(minimumIndex, triangleMinimum) > shortRange)
+		{
+			appendRange(shortTriangles.data(), shortTriangles.size(), minimumIndex, GL_UNSIGNED_SHORT);
+			shortTriangles.clear();
+			minimumIndex = std::numeric_limits<uint>::max();
+			maximumIndex = 0;
+		}
+
+		shortTriangles.insert(shortTriangles.end(), indices + t, indices + t + 3);
+		minimumIndex = std::min(minimumIndex, triangleMinimum);
+		maximumIndex = std::max(maximumIndex, triangleMaximum);
+	}
+
+	if (!shortTriangles.empty())
+		appendRange(shortTriangles.data(), shortTriangles.size(), minimumIndex, GL_UNSIGNED_SHORT);
+
+	if (!wideTriangles.empty())
+		appendRange(wideTriangles.data(), wideTriangles.size(), 0, GL_UNSIGNED_INT);
+}
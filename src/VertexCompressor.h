@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Model.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace minity
+{
+	// Encoding of vertices and indices into the compact formats used by VertexFormat::Compact.
+	class VertexCompressor
+	{
+	public:
+		// quantization that covers the given bounds with the full 16 bit range
+		static PositionQuantization quantization(glm::vec3 minimumBounds, glm::vec3 maximumBounds);
+
+		static CompactVertex encode(const Vertex& vertex, const PositionQuantization& quantization);
+		static Vertex decode(const CompactVertex& vertex, const PositionQuantization& quantization);
+
+		// encodes count vertices in parallel
+		static void encode(const Vertex* vertices, std::size_t count, const PositionQuantization& quantization, CompactVertex* result);
+
+		// two 16 bit signed normalized values, the first one in the lower half
+		static glm::uint encodeOctahedral(glm::vec3 normal);
+		static glm::vec3 decodeOctahedral(glm::uint encoded);
+
+		// Appends count triangle indices to data and the ranges they are drawn with to ranges, every range
+		// starting at a four byte boundary. If allowShort is set, the triangles are split into ranges of 16 bit
+		// offsets from a base vertex wherever possible, otherwise they are stored as they are.
+		static void encodeIndices(const glm::uint* indices, std::size_t count, bool allowShort, std::vector<unsigned char>& data, std::vector<IndexRange>& ranges);
+	};
+}
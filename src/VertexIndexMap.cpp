@@ -0,0 +1,85 @@
+#include "VertexIndexMap.h"
+
+using namespace minity;
+using namespace glm;
+
+VertexIndexMap::VertexIndexMap(std::size_t expectedCount)
+{
+	reserve(expectedCount);
+}
+
+void VertexIndexMap::reserve(std::size_t expectedCount)
+{
+	std::size_t capacity = 16;
+
+	while (capacity < 2 * expectedCount)
+		capacity *= 2;
+
+	if (capacity > m_entries.size())
+		rehash(capacity);
+}
+
+uint VertexIndexMap::insert(const uvec3& key, uint index)
+{
+	if (2 * (m_size + 1) > m_entries.size())
+		rehash(2 * m_entries.size());
+
+	for (std::size_t i = hash(key) & m_mask; ; i = (i + 1) & m_mask)
+	{
+		Entry& entry = m_entries[i];
+
+		if (entry.index == emptyIndex)
+		{
+			entry.key = key;
+			entry.index = index;
+			m_size++;
+			return index;
+		}
+
+		if (entry.key == key)
+			return entry.index;
+	}
+}
+
+std::size_t VertexIndexMap::size() const
+{
+	return m_size;
+}
+
+std::size_t VertexIndexMap::hash(const uvec3& key)
+{
+	// combine the components and finish with the MurmurHash3 mixer, since consecutive faces use nearby indices
+	uint h = key.x;
+	h = h * 0x9e3779b1u + key.y;
+	h = h * 0x9e3779b1u + key.z;
+
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+
+	return std::size_t(h);
+}
+
+void VertexIndexMap::rehash(std::size_t capacity)
+{
+	std::vector<Entry> entries(capacity, Entry{ uvec3(0), emptyIndex });
+	const std::size_t mask = capacity - 1;
+
+	for (const auto& e : m_entries)
+	{
+		if (e.index == emptyIndex)
+			continue;
+
+		std::size_t i = hash(e.key) & mask;
+
+		while (entries[i].index != emptyIndex)
+			i = (i + 1) & mask;
+
+		entries[i] = e;
+	}
+
+	m_entries.swap(entries);
+	m_mask = mask;
+}
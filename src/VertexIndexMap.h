@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace minity
+{
+	// Open-addressing hash table that maps (position, texcoord, normal) index triples of OBJ face
+	// corners to indices of assembled vertices. Linear probing over a flat power-of-two sized array;
+	// the table grows when it becomes half full, so an estimate of the final size is enough.
+	class VertexIndexMap
+	{
+	public:
+		VertexIndexMap(std::size_t expectedCount = 0);
+
+		void reserve(std::size_t expectedCount);
+
+		// returns the index stored for key, or stores and returns the given index if key is new
+		glm::uint insert(const glm::uvec3& key, glm::uint index);
+
+		std::size_t size() const;
+
+	private:
+		struct Entry
+		{
+			glm::uvec3 key;
+			glm::uint index;
+		};
+
+		static const glm::uint emptyIndex = ~0u;
+
+		static std::size_t hash(const glm::uvec3& key);
+		void rehash(std::size_t capacity);
+
+		std::vector<Entry> m_entries;
+		std::size_t m_size = 0;
+		std::size_t m_mask = 0;
+	};
+}
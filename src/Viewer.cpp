@@ -19,6 +19,7 @@
 #include "RaytraceRenderer.h"
 #include "Scene.h"
 #include "Model.h"
+#include "TextureCache.h"
 #include <fstream>
 #include <sstream>
 #include <list>
@@ -60,7 +61,9 @@ Viewer::Viewer(GLFWwindow *window, Scene *scene) : m_window(window), m_scene(sce
 	io.Fonts->AddFontFromFileTTF("./res/ui/Lato-Semibold.ttf", 18);
 
 	m_interactors.emplace_back(std::make_unique<CameraInteractor>(this));
-	m_renderers.emplace_back(std::make_unique<ModelRenderer>(this));
+	auto modelRenderer = std::make_unique<ModelRenderer>(this);
+	m_modelRenderer = modelRenderer.get();
+	m_renderers.emplace_back(std::move(modelRenderer));
 	m_renderers.emplace_back(std::make_unique<RaytraceRenderer>(this));
 	m_renderers.emplace_back(std::make_unique<BoundingBoxRenderer>(this));
 
@@ -84,6 +87,11 @@ Viewer::~Viewer()
 
 void Viewer::display()
 {
+	m_benchmark.beginFrame();
+
+	if (m_scene->model()->update())
+		fitModelTransform();
+
 	beginFrame();
 	mainMenu();
 
@@ -95,7 +103,9 @@ void Viewer::display()
 	{
 		if (r->isEnabled())
 		{		
+			m_profiler.beginPass(r->name());
 			r->display();
+			m_profiler.endPass();
 		}
 	}
 	
@@ -105,6 +115,9 @@ void Viewer::display()
 	}
 
 	endFrame();
+	m_profiler.endFrame();
+
+	m_benchmark.endFrame(m_modelRenderer->statistics().drawnTriangles, m_modelRenderer->statistics().drawCalls);
 }
 
 GLFWwindow * Viewer::window()
@@ -205,6 +218,21 @@ void Viewer::saveImage(const std::string & filename)
 	stbi_write_png(filename.c_str(), size.x, size.y, 4, &image.front(), size.x*4);
 }
 
+FrameBenchmark& Viewer::benchmark()
+{
+	return m_benchmark;
+}
+
+GpuProfiler& Viewer::profiler()
+{
+	return m_profiler;
+}
+
+void Viewer::setUiVisible(bool visible)
+{
+	m_showUi = visible;
+}
+
 void Viewer::framebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
 	if (width < 1 || height < 1)
@@ -418,6 +446,14 @@ void Viewer::endFrame()
 	stream << std::fixed << std::setprecision(2) << ImGui::GetIO().Framerate << " fps";
 	std::string s = stream.str();
 
+	if (scene()->model()->isLoading())
+	{
+		ImGui::ProgressBar(scene()->model()->loadingProgress(), ImVec2(160.0f, 0.0f), "Loading ...");
+
+		if (ImGui::SmallButton("Cancel"))
+			scene()->model()->cancelLoading();
+	}
+
 	//		ImGui::Begin("Information");
 	ImGui::SameLine(ImGui::GetWindowWidth() - 220.0f);
 	ImGui::PlotLines(s.c_str(), framerates, int(frameratesList.size()), 0, 0, 0.0f, 200.0f,ImVec2(128.0f,0.0f));
@@ -459,6 +495,8 @@ void Viewer::endFrame()
 
 	if (m_showUi)
 		renderUi();
+	else
+		ImGui::EndFrame();
 }
 
 void Viewer::renderUi()
@@ -467,7 +505,9 @@ void Viewer::renderUi()
 
 	ImGuiIO& io = ImGui::GetIO();
 	ImDrawData* draw_data = ImGui::GetDrawData();
+	m_profiler.beginPass("User Interface");
 	ImGui_ImplOpenGL3_RenderDrawData(draw_data);
+	m_profiler.endPass();
 }
 
 void Viewer::loadNewModel()
@@ -483,22 +523,19 @@ void Viewer::loadNewModel()
 	if (openfileName)
 	{
 		fileName = std::string(openfileName);
-		m_scene->model()->load(fileName);
-		
-
-		auto scene = std::make_unique<Scene>();
-		//scene->model()->load(fileName);
-		// Scaling the model's bounding box to the canonical view volume
-		vec3 boundingBoxSize = scene->model()->maximumBounds() - scene->model()->minimumBounds();
-		float maximumSize = std::max(std::max(boundingBoxSize.x, boundingBoxSize.y), boundingBoxSize.z);
-		mat4 modelTransform = scale(vec3(2.0f) / vec3(maximumSize));
-		modelTransform = modelTransform * translate(-0.5f * (scene->model()->minimumBounds() + scene->model()->maximumBounds()));
-
-		setModelTransform(modelTransform);
+		m_scene->model()->loadAsync(fileName);
 
+		// the textures of the previous model are no longer referenced and are kept only up to the cache budget
+		TextureCache::instance().trim();
 	}
 }
 
+void Viewer::fitModelTransform()
+{
+	// Scaling the model's bounding box to the canonical view volume
+	setModelTransform(CameraInteractor::initialModelTransform(m_scene->model()->minimumBounds(), m_scene->model()->maximumBounds()));
+}
+
 void Viewer::mainMenu()
 {
 	if (ImGui::BeginMenu("File"))
@@ -548,6 +585,50 @@ void Viewer::mainMenu()
 
 		ImGui::EndMenu();
 	}
+
+	profilerMenu();
+}
+
+void Viewer::profilerMenu()
+{
+	if (ImGui::BeginMenu("Profiler"))
+	{
+		bool enabled = m_profiler.isEnabled();
+		ImGui::Checkbox("GPU Timers", &enabled);
+		m_profiler.setEnabled(enabled);
+
+		if (GpuProfiler::pipelineStatisticsSupported())
+		{
+			bool statisticsEnabled = m_profiler.pipelineStatisticsEnabled();
+			ImGui::Checkbox("Pipeline Statistics", &statisticsEnabled);
+			m_profiler.setPipelineStatisticsEnabled(statisticsEnabled);
+		}
+
+		if (enabled)
+		{
+			double total = 0.0;
+
+			for (const auto& pass : m_profiler.passes())
+			{
+				ImGui::Separator();
+				ImGui::Text("%s: %.3f ms (average %.3f ms)", pass.name.c_str(), pass.gpuTime, pass.averageGpuTime);
+				total += pass.averageGpuTime;
+
+				if (pass.statisticsValid)
+				{
+					const PipelineStatistics& statistics = pass.statistics;
+					ImGui::Text("  Vertices: %llu submitted, %llu shaded", (unsigned long long)statistics.verticesSubmitted, (unsigned long long)statistics.vertexShaderInvocations);
+					ImGui::Text("  Primitives: %llu submitted, %llu clipped into %llu", (unsigned long long)statistics.primitivesSubmitted, (unsigned long long)statistics.clippingInputPrimitives, (unsigned long long)statistics.clippingOutputPrimitives);
+					ImGui::Text("  Fragments: %llu shaded", (unsigned long long)statistics.fragmentShaderInvocations);
+				}
+			}
+
+			ImGui::Separator();
+			ImGui::Text("Total: %.3f ms on average", total);
+		}
+
+		ImGui::EndMenu();
+	}
 }
 
 namespace minity
@@ -11,9 +11,13 @@
 #include "Scene.h"
 #include "Interactor.h"
 #include "Renderer.h"
+#include "FrameBenchmark.h"
+#include "GpuProfiler.h"
 
 namespace minity
 {
+	class ModelRenderer;
+
 	class Viewer
 	{
 	public:
@@ -40,6 +44,8 @@ namespace minity
 		void setProjectionTransform(const glm::mat4& m);
 
 		void loadNewModel();
+		// scales and centers the model's bounding box to the canonical view volume
+		void fitModelTransform();
 
 		glm::mat4 modelViewTransform() const;
 		glm::mat4 modelViewProjectionTransform() const;
@@ -49,6 +55,14 @@ namespace minity
 
 		void saveImage(const std::string & filename);
 
+		// measures the following frames while orbiting the model, see FrameBenchmark
+		FrameBenchmark& benchmark();
+		// GPU times of the renderers and the user interface
+		GpuProfiler& profiler();
+
+		// the user interface is drawn over the rendered image, toggled with the space key
+		void setUiVisible(bool visible);
+
 		//
 		bool doAnimation();
 		bool doKeyFrame();
@@ -63,6 +77,7 @@ namespace minity
 		void endFrame();
 		void renderUi();
 		void mainMenu();
+		void profilerMenu();
 
 		static void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 		static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
@@ -75,6 +90,9 @@ namespace minity
 
 		std::vector<std::unique_ptr<Interactor>> m_interactors;
 		std::vector<std::unique_ptr<Renderer>> m_renderers;
+		ModelRenderer* m_modelRenderer = nullptr;
+		FrameBenchmark m_benchmark{ this };
+		GpuProfiler m_profiler;
 
 		glm::vec3 m_backgroundColor = glm::vec3(0.0f, 0.0f, 0.0f);
 		glm::mat4 m_modelTransform = glm::mat4(1.0f);
@@ -0,0 +1,470 @@
+#include "WideBvh.h"
+#include "WideBvhTraversal.h"
+#include "CpuFeatures.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MINITY_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace minity;
+using namespace minity::traversal;
+using namespace glm;
+
+namespace
+{
+	// Four lanes in plain C++, which compilers may still vectorize for the target they compile for. Only has
+	// what single rays need, packets are traced ray by ray without SIMD instructions.
+	struct ScalarLanes
+	{
+		static const int width = 4;
+
+		struct Float
+		{
+			float v[4];
+		};
+
+		// one bit per lane
+		typedef int Mask;
+
+		static Float broadcast(float value)
+		{
+			return { { value, value, value, value } };
+		}
+
+		static Float load(const float* values)
+		{
+			return { { values[0], values[1], values[2], values[3] } };
+		}
+
+		static void store(float* values, Float a)
+		{
+			for (int i = 0; i < 4; i++)
+				values[i] = a.v[i];
+		}
+
+		static Float sub(Float a, Float b)
+		{
+			return { { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } };
+		}
+
+		static Float mul(Float a, Float b)
+		{
+			return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } };
+		}
+
+		static Float min(Float a, Float b)
+		{
+			return { { std::min(a.v[0], b.v[0]), std::min(a.v[1], b.v[1]), std::min(a.v[2], b.v[2]), std::min(a.v[3], b.v[3]) } };
+		}
+
+		static Float max(Float a, Float b)
+		{
+			return { { std::max(a.v[0], b.v[0]), std::max(a.v[1], b.v[1]), std::max(a.v[2], b.v[2]), std::max(a.v[3], b.v[3]) } };
+		}
+
+		static Mask lessEqual(Float a, Float b)
+		{
+			return int(a.v[0] <= b.v[0]) | int(a.v[1] <= b.v[1]) << 1 | int(a.v[2] <= b.v[2]) << 2 | int(a.v[3] <= b.v[3]) << 3;
+		}
+
+		static int bits(Mask mask)
+		{
+			return mask;
+		}
+
+	};
+
+#ifdef MINITY_SSE2
+	struct SseLanes
+	{
+		static const int width = 4;
+		typedef __m128 Float;
+		typedef __m128 Mask;
+
+		static Float broadcast(float value) { return _mm_set1_ps(value); }
+		static Float load(const float* values) { return _mm_load_ps(values); }
+		static Float loadUnaligned(const float* values) { return _mm_loadu_ps(values); }
+		static void store(float* values, Float a) { _mm_storeu_ps(values, a); }
+		static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+		static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+		static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+		static Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+		static Float min(Float a, Float b) { return _mm_min_ps(a, b); }
+		static Float max(Float a, Float b) { return _mm_max_ps(a, b); }
+		static Mask lessEqual(Float a, Float b) { return _mm_cmple_ps(a, b); }
+		static Mask greaterEqual(Float a, Float b) { return _mm_cmpge_ps(a, b); }
+		static Mask notEqual(Float a, Float b) { return _mm_cmpneq_ps(a, b); }
+		static Mask maskAnd(Mask a, Mask b) { return _mm_and_ps(a, b); }
+		static int bits(Mask mask) { return _mm_movemask_ps(mask); }
+		static Float select(Mask mask, Float a, Float b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+	};
+#endif
+
+	float surfaceArea(const BvhNode& node)
+	{
+		const vec3 extent = node.maximumBounds - node.minimumBounds;
+		return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+	}
+
+	// Every wide node takes the children of a binary node and replaces the inner one with the largest surface
+	// area by its children until all slots are used, so the nodes most likely to be visited are skipped.
+	template <int Width>
+	void collapse(const std::vector<BvhNode>& binaryNodes, std::vector<WideBvhNode<Width>>& nodes)
+	{
+		nodes.clear();
+
+		if (binaryNodes.empty())
+			return;
+
+		struct Task
+		{
+			uint binaryNode;
+			uint node;
+		};
+
+		std::vector<Task> tasks;
+		tasks.push_back({ 0, 0 });
+		nodes.emplace_back();
+
+		while (!tasks.empty())
+		{
+			const Task task = tasks.back();
+			tasks.pop_back();
+
+			const BvhNode& binaryNode = binaryNodes[task.binaryNode];
+			uint slots[Width];
+			int slotCount = 0;
+
+			// a hierarchy that is a single leaf becomes a root with a single child
+			if (binaryNode.isLeaf())
+			{
+				slots[slotCount++] = task.binaryNode;
+			}
+			else
+			{
+				slots[slotCount++] = binaryNode.firstIndex;
+				slots[slotCount++] = binaryNode.firstIndex + 1;
+			}
+
+			while (slotCount < Width)
+			{
+				int largest = -1;
+				float largestArea = -1.0f;
+
+				for (int i = 0; i < slotCount; i++)
+				{
+					const BvhNode& child = binaryNodes[slots[i]];
+
+					if (!child.isLeaf() && surfaceArea(child) > largestArea)
+					{
+						largest = i;
+						largestArea = surfaceArea(child);
+					}
+				}
+
+				if (largest < 0)
+					break;
+
+				const uint opened = slots[largest];
+				slots[largest] = binaryNodes[opened].firstIndex;
+				slots[slotCount++] = binaryNodes[opened].firstIndex + 1;
+			}
+
+			WideBvhNode<Width> node;
+
+			for (int i = 0; i < Width; i++)
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					node.bounds[2 * axis][i] = infinity;
+					node.bounds[2 * axis + 1][i] = -infinity;
+				}
+
+				node.children[i] = WideBvhNode<Width>::emptySlot;
+				node.triangleCounts[i] = 0;
+			}
+
+			for (int i = 0; i < slotCount; i++)
+			{
+				const BvhNode& child = binaryNodes[slots[i]];
+
+				for (int axis = 0; axis < 3; axis++)
+				{
+					node.bounds[2 * axis][i] = child.minimumBounds[axis];
+					node.bounds[2 * axis + 1][i] = child.maximumBounds[axis];
+				}
+
+				if (child.isLeaf())
+				{
+					node.children[i] = child.firstIndex;
+					node.triangleCounts[i] = child.triangleCount;
+				}
+				else
+				{
+					node.children[i] = uint(nodes.size());
+					tasks.push_back({ slots[i], uint(nodes.size()) });
+					nodes.emplace_back();
+				}
+			}
+
+			nodes[task.node] = node;
+		}
+	}
+
+	TraversalRay prepareRay(const Ray& ray)
+	{
+		TraversalRay result;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			result.origin[axis] = ray.origin[axis];
+			result.direction[axis] = ray.direction[axis];
+			// keeps the slab distances finite for axis-parallel rays, as in Bvh
+			result.inverseDirection[axis] = std::abs(ray.direction[axis]) > 1e-20f ? 1.0f / ray.direction[axis] : std::copysign(1e20f, ray.direction[axis]);
+			result.nearBounds[axis] = 2 * axis + (result.inverseDirection[axis] < 0.0f ? 1 : 0);
+		}
+
+		result.minimumDistance = ray.minimumDistance;
+		result.maximumDistance = ray.maximumDistance;
+		return result;
+	}
+
+	TraversalHit emptyHit()
+	{
+		return { RayHit::noTriangle, infinity, 0.0f, 0.0f };
+	}
+
+	template <typename Lanes>
+	void tracePackets(const WideBvhNode<Lanes::width>* nodes, const float* triangleData, const TraversalRay* rays, std::size_t count, TraversalHit* hits)
+	{
+		for (std::size_t first = 0; first < count; first += Lanes::width)
+			traversePacket<Lanes>(nodes, triangleData, rays + first, std::min(count - first, std::size_t(Lanes::width)), hits + first);
+	}
+}
+
+TraversalKernel WideBvh::fastestKernel()
+{
+	if (kernelSupported(TraversalKernel::Avx2))
+		return TraversalKernel::Avx2;
+
+	if (kernelSupported(TraversalKernel::Sse))
+		return TraversalKernel::Sse;
+
+	return TraversalKernel::Scalar;
+}
+
+bool WideBvh::kernelSupported(TraversalKernel kernel)
+{
+	const CpuFeatures& features = CpuFeatures::detect();
+
+	switch (kernel)
+	{
+	case TraversalKernel::Scalar:
+		return true;
+	case TraversalKernel::Sse:
+#ifdef MINITY_SSE2
+		return features.sse2;
+#else
+		return false;
+#endif
+	case TraversalKernel::Avx2:
+#ifdef MINITY_AVX2_KERNELS
+		return features.avx2 && features.fma;
+#else
+		return false;
+#endif
+	}
+
+	return false;
+}
+
+const char* WideBvh::kernelName(TraversalKernel kernel)
+{
+	switch (kernel)
+	{
+	case TraversalKernel::Scalar:
+		return "scalar BVH4";
+	case TraversalKernel::Sse:
+		return "SSE2 BVH4";
+	case TraversalKernel::Avx2:
+		return "AVX2 BVH8";
+	}
+
+	return "";
+}
+
+int WideBvh::kernelWidth(TraversalKernel kernel)
+{
+	return kernel == TraversalKernel::Avx2 ? 8 : 4;
+}
+
+void WideBvh::build(const Bvh& bvh, TraversalKernel kernel)
+{
+	clear();
+
+	m_kernel = kernelSupported(kernel) ? kernel : TraversalKernel::Scalar;
+
+	if (kernelWidth(m_kernel) == 8)
+		collapse(bvh.nodes(), m_nodes8);
+	else
+		collapse(bvh.nodes(), m_nodes4);
+
+	const std::vector<vec3>& positions = bvh.positions();
+	m_triangleData.resize(3 * positions.size());
+
+	for (std::size_t i = 0; i < positions.size(); i += 3)
+	{
+		const vec3 edge1 = positions[i + 1] - positions[i];
+		const vec3 edge2 = positions[i + 2] - positions[i];
+		float* triangle = &m_triangleData[3 * i];
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			triangle[axis] = positions[i][axis];
+			triangle[3 + axis] = edge1[axis];
+			triangle[6 + axis] = edge2[axis];
+		}
+	}
+
+	m_triangles = bvh.triangles();
+}
+
+void WideBvh::clear()
+{
+	m_nodes4.clear();
+	m_nodes8.clear();
+	m_triangleData.clear();
+	m_triangles.clear();
+}
+
+bool WideBvh::empty() const
+{
+	return m_nodes4.empty() && m_nodes8.empty();
+}
+
+TraversalKernel WideBvh::kernel() const
+{
+	return m_kernel;
+}
+
+std::size_t WideBvh::nodeCount() const
+{
+	return m_nodes4.size() + m_nodes8.size();
+}
+
+bool WideBvh::intersect(const Ray& ray, RayHit& hit) const
+{
+	if (empty())
+		return false;
+
+	const TraversalRay traversalRay = prepareRay(ray);
+	TraversalHit result = emptyHit();
+	bool found = false;
+
+	switch (m_kernel)
+	{
+	case TraversalKernel::Scalar:
+		found = traverseRay<ScalarLanes, false>(m_nodes4.data(), m_triangleData.data(), traversalRay, result);
+		break;
+	case TraversalKernel::Sse:
+#ifdef MINITY_SSE2
+		found = traverseRay<SseLanes, false>(m_nodes4.data(), m_triangleData.data(), traversalRay, result);
+#endif
+		break;
+	case TraversalKernel::Avx2:
+#ifdef MINITY_AVX2_KERNELS
+		found = intersectAvx2(m_nodes8.data(), m_triangleData.data(), traversalRay, false, result);
+#endif
+		break;
+	}
+
+	if (!found)
+		return false;
+
+	hit.triangle = m_triangles[result.triangle];
+	hit.distance = result.distance;
+	hit.barycentrics = vec2(result.u, result.v);
+	return true;
+}
+
+bool WideBvh::occluded(const Ray& ray) const
+{
+	if (empty())
+		return false;
+
+	const TraversalRay traversalRay = prepareRay(ray);
+	TraversalHit result = emptyHit();
+
+	switch (m_kernel)
+	{
+	case TraversalKernel::Scalar:
+		return traverseRay<ScalarLanes, true>(m_nodes4.data(), m_triangleData.data(), traversalRay, result);
+	case TraversalKernel::Sse:
+#ifdef MINITY_SSE2
+		return traverseRay<SseLanes, true>(m_nodes4.data(), m_triangleData.data(), traversalRay, result);
+#else
+		break;
+#endif
+	case TraversalKernel::Avx2:
+#ifdef MINITY_AVX2_KERNELS
+		return intersectAvx2(m_nodes8.data(), m_triangleData.data(), traversalRay, true, result);
+#else
+		break;
+#endif
+	}
+
+	return false;
+}
+
+void WideBvh::intersect(const Ray* rays, std::size_t count, RayHit* hits) const
+{
+	count = std::min(count, packetSize);
+
+	for (std::size_t i = 0; i < count; i++)
+		hits[i] = RayHit();
+
+	if (empty() || count == 0)
+		return;
+
+	TraversalRay traversalRays[packetSize];
+	TraversalHit results[packetSize];
+
+	for (std::size_t i = 0; i < count; i++)
+		traversalRays[i] = prepareRay(rays[i]);
+
+	switch (m_kernel)
+	{
+	case TraversalKernel::Scalar:
+		// without SIMD instructions, packets only add overhead
+		for (std::size_t i = 0; i < count; i++)
+		{
+			results[i] = emptyHit();
+			traverseRay<ScalarLanes, false>(m_nodes4.data(), m_triangleData.data(), traversalRays[i], results[i]);
+		}
+		break;
+	case TraversalKernel::Sse:
+#ifdef MINITY_SSE2
+		tracePackets<SseLanes>(m_nodes4.data(), m_triangleData.data(), traversalRays, count, results);
+#endif
+		break;
+	case TraversalKernel::Avx2:
+#ifdef MINITY_AVX2_KERNELS
+		intersectPacketAvx2(m_nodes8.data(), m_triangleData.data(), traversalRays, count, results);
+#endif
+		break;
+	}
+
+	for (std::size_t i = 0; i < count; i++)
+	{
+		if (results[i].triangle == RayHit::noTriangle)
+			continue;
+
+		hits[i].triangle = m_triangles[results[i].triangle];
+		hits[i].distance = results[i].distance;
+		hits[i].barycentrics = vec2(results[i].u, results[i].v);
+	}
+}
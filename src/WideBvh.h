@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Bvh.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace minity
+{
+	// instruction sets the traversal of a WideBvh is implemented for
+	enum class TraversalKernel
+	{
+		// plain C++ over nodes of four children, for processors without any of the others
+		Scalar,
+		// SSE2 over nodes of four children
+		Sse,
+		// AVX2 and FMA over nodes of eight children
+		Avx2
+	};
+
+	// Node of a hierarchy with up to Width children, whose bounds are stored per coordinate so that all of them
+	// are tested against a ray at once. Unused slots come last and have empty bounds, that no ray intersects.
+	template <int Width>
+	struct alignas(32) WideBvhNode
+	{
+		static const glm::uint emptySlot = 0xffffffffu;
+
+		// minimum x, maximum x, minimum y, maximum y, minimum z and maximum z of every child
+		float bounds[6][Width];
+		// the node of inner children, the first triangle in the order of the leaves for leaves, or emptySlot
+		glm::uint children[Width];
+		// number of triangles of leaves, 0 for inner children and unused slots
+		glm::uint triangleCounts[Width];
+	};
+
+	// Bounding volume hierarchy with four or eight children per node, collapsed from a binary Bvh, for ray
+	// queries with SIMD instructions. Single rays test all children of a node at once, packets of coherent rays
+	// test one child against all of their rays at once. The hierarchy does not depend on the Bvh afterwards.
+	class WideBvh
+	{
+	public:
+		// maximum number of rays passed to intersect() at once
+		static const std::size_t packetSize = 8;
+
+		// the widest kernel the processor running the program supports
+		static TraversalKernel fastestKernel();
+		static bool kernelSupported(TraversalKernel kernel);
+		static const char* kernelName(TraversalKernel kernel);
+		// number of children per node of the hierarchy the kernel traverses
+		static int kernelWidth(TraversalKernel kernel);
+
+		// falls back to the scalar kernel if the processor does not support the given one
+		void build(const Bvh& bvh, TraversalKernel kernel = fastestKernel());
+		void clear();
+
+		bool empty() const;
+		TraversalKernel kernel() const;
+		std::size_t nodeCount() const;
+
+		// the same results as the queries of Bvh up to rounding
+		bool intersect(const Ray& ray, RayHit& hit) const;
+		bool occluded(const Ray& ray) const;
+
+		// Finds the closest hits of up to packetSize rays, which is faster than tracing them one by one if they
+		// take similar paths through the hierarchy, like the primary rays of neighbouring pixels. The hits of
+		// rays that miss are invalid afterwards.
+		void intersect(const Ray* rays, std::size_t count, RayHit* hits) const;
+
+	private:
+		TraversalKernel m_kernel = TraversalKernel::Scalar;
+		// only those of the width of the kernel are used
+		std::vector<WideBvhNode<4>> m_nodes4;
+		std::vector<WideBvhNode<8>> m_nodes8;
+		// first vertex and the two edges from it of every triangle, in the order of the leaves
+		std::vector<float> m_triangleData;
+		// the triangles as passed to Bvh::build(), in the order of the leaves
+		std::vector<glm::uint> m_triangles;
+	};
+}
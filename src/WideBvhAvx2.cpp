@@ -0,0 +1,53 @@
+#include "WideBvhTraversal.h"
+
+// This file is compiled with AVX2 and FMA enabled and its functions may only be called after checking that the
+// processor supports them, see WideBvh::kernelSupported().
+
+#ifdef MINITY_AVX2_KERNELS
+
+#include <immintrin.h>
+
+using namespace minity;
+using namespace minity::traversal;
+
+namespace
+{
+	struct Avx2Lanes
+	{
+		static const int width = 8;
+		typedef __m256 Float;
+		typedef __m256 Mask;
+
+		static Float broadcast(float value) { return _mm256_set1_ps(value); }
+		static Float load(const float* values) { return _mm256_load_ps(values); }
+		static Float loadUnaligned(const float* values) { return _mm256_loadu_ps(values); }
+		static void store(float* values, Float a) { _mm256_storeu_ps(values, a); }
+		static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+		static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+		static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+		static Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+		static Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+		static Float max(Float a, Float b) { return _mm256_max_ps(a, b); }
+		static Mask lessEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+		static Mask greaterEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+		static Mask notEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); }
+		static Mask maskAnd(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+		static int bits(Mask mask) { return _mm256_movemask_ps(mask); }
+		static Float select(Mask mask, Float a, Float b) { return _mm256_blendv_ps(b, a, mask); }
+	};
+}
+
+bool minity::traversal::intersectAvx2(const WideBvhNode<8>* nodes, const float* triangleData, const TraversalRay& ray, bool anyHit, TraversalHit& hit)
+{
+	if (anyHit)
+		return traverseRay<Avx2Lanes, true>(nodes, triangleData, ray, hit);
+
+	return traverseRay<Avx2Lanes, false>(nodes, triangleData, ray, hit);
+}
+
+void minity::traversal::intersectPacketAvx2(const WideBvhNode<8>* nodes, const float* triangleData, const TraversalRay* rays, std::size_t count, TraversalHit* hits)
+{
+	traversePacket<Avx2Lanes>(nodes, triangleData, rays, count, hits);
+}
+
+#endif
@@ -0,0 +1,375 @@
+#pragma once
+
+#include "WideBvh.h"
+
+#include <cstddef>
+#include <limits>
+
+// Traversal of WideBvh, shared by kernels compiled for different instruction sets. It is written against the
+// lanes of an instruction set, a struct with the vector types and operations, which every kernel defines in an
+// anonymous namespace of its own source file. That makes all instantiations local to that file, so the linker
+// never picks code compiled for AVX2 in place of the same function of another file.
+
+namespace minity
+{
+	namespace traversal
+	{
+		static constexpr float infinity = std::numeric_limits<float>::infinity();
+
+		// Wide nodes push at most all but one of their children, on at most as many levels as the binary
+		// hierarchy has, whose depth is bounded by 64.
+		const std::size_t stackSize = 64 * 8;
+
+		// a ray with what the traversal needs precomputed, in plain floats
+		struct TraversalRay
+		{
+			float origin[3];
+			float direction[3];
+			float inverseDirection[3];
+			// row of the bounds of a node through which the ray enters it along each axis, the minimum for
+			// positive directions and the maximum for negative ones
+			int nearBounds[3];
+			float minimumDistance;
+			float maximumDistance;
+		};
+
+		struct TraversalHit
+		{
+			// in the order of the leaves
+			glm::uint triangle;
+			float distance;
+			float u;
+			float v;
+		};
+
+		struct StackEntry
+		{
+			glm::uint child;
+			glm::uint triangleCount;
+			// at which the ray or the closest ray of a packet enters the bounds of the child
+			float distance;
+		};
+
+#ifdef MINITY_AVX2_KERNELS
+		// in WideBvhAvx2.cpp, only to be called if the processor supports AVX2 and FMA
+		bool intersectAvx2(const WideBvhNode<8>* nodes, const float* triangleData, const TraversalRay& ray, bool anyHit, TraversalHit& hit);
+		void intersectPacketAvx2(const WideBvhNode<8>* nodes, const float* triangleData, const TraversalRay* rays, std::size_t count, TraversalHit* hits);
+#endif
+
+		// Moeller and Trumbore as in Bvh, on a triangle given by its first vertex and the edges from it
+		static inline bool intersectTriangle(const float* triangle, const TraversalRay& ray, float maximumDistance, TraversalHit& hit)
+		{
+			const float* vertex = triangle;
+			const float* edge1 = triangle + 3;
+			const float* edge2 = triangle + 6;
+			const float* direction = ray.direction;
+
+			const float p[3] = { direction[1] * edge2[2] - edge2[1] * direction[2], direction[2] * edge2[0] - edge2[2] * direction[0], direction[0] * edge2[1] - edge2[0] * direction[1] };
+			const float determinant = edge1[0] * p[0] + edge1[1] * p[1] + edge1[2] * p[2];
+
+			if (determinant == 0.0f)
+				return false;
+
+			const float inverseDeterminant = 1.0f / determinant;
+			const float s[3] = { ray.origin[0] - vertex[0], ray.origin[1] - vertex[1], ray.origin[2] - vertex[2] };
+			const float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverseDeterminant;
+
+			if (u < 0.0f || u > 1.0f)
+				return false;
+
+			const float q[3] = { s[1] * edge1[2] - edge1[1] * s[2], s[2] * edge1[0] - edge1[2] * s[0], s[0] * edge1[1] - edge1[0] * s[1] };
+			const float v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inverseDeterminant;
+
+			if (v < 0.0f || u + v > 1.0f)
+				return false;
+
+			const float t = (edge2[0] * q[0] + edge2[1] * q[1] + edge2[2] * q[2]) * inverseDeterminant;
+
+			if (t < ray.minimumDistance || t > maximumDistance)
+				return false;
+
+			hit.distance = t;
+			hit.u = u;
+			hit.v = v;
+			return true;
+		}
+
+		// Inserts an intersected child into entries sorted from the farthest to the closest one.
+		template <int Width>
+		static inline void insertSorted(StackEntry (&entries)[Width], int& count, StackEntry entry)
+		{
+			int i = count++;
+
+			for (; i > 0 && entries[i - 1].distance < entry.distance; i--)
+				entries[i] = entries[i - 1];
+
+			entries[i] = entry;
+		}
+
+		// One ray against all children of a node at once. Visits the closest intersected child next and
+		// postpones the others, which are skipped later if they are entered behind the closest hit so far.
+		template <typename Lanes, bool anyHit>
+		bool traverseRay(const WideBvhNode<Lanes::width>* nodes, const float* triangleData, const TraversalRay& ray, TraversalHit& hit)
+		{
+			typedef typename Lanes::Float Float;
+			const int width = Lanes::width;
+
+			const Float originX = Lanes::broadcast(ray.origin[0]);
+			const Float originY = Lanes::broadcast(ray.origin[1]);
+			const Float originZ = Lanes::broadcast(ray.origin[2]);
+			const Float inverseX = Lanes::broadcast(ray.inverseDirection[0]);
+			const Float inverseY = Lanes::broadcast(ray.inverseDirection[1]);
+			const Float inverseZ = Lanes::broadcast(ray.inverseDirection[2]);
+			const Float minimumDistance = Lanes::broadcast(ray.minimumDistance);
+			const int nearX = ray.nearBounds[0], nearY = ray.nearBounds[1], nearZ = ray.nearBounds[2];
+			float maximumDistance = ray.maximumDistance;
+
+			StackEntry stack[stackSize];
+			std::size_t stackCount = 0;
+			StackEntry current = { 0, 0, ray.minimumDistance };
+			bool found = false;
+
+			for (;;)
+			{
+				if (current.triangleCount > 0)
+				{
+					for (glm::uint i = current.child; i < current.child + current.triangleCount; i++)
+					{
+						if (intersectTriangle(triangleData + 9 * std::size_t(i), ray, maximumDistance, hit))
+						{
+							maximumDistance = hit.distance;
+							hit.triangle = i;
+							found = true;
+
+							if (anyHit)
+								return true;
+						}
+					}
+				}
+				else
+				{
+					// empty slots are entered at infinity and left at minus infinity
+					const WideBvhNode<width>& node = nodes[current.child];
+					const Float entryX = Lanes::mul(Lanes::sub(Lanes::load(node.bounds[nearX]), originX), inverseX);
+					const Float entryY = Lanes::mul(Lanes::sub(Lanes::load(node.bounds[nearY]), originY), inverseY);
+					const Float entryZ = Lanes::mul(Lanes::sub(Lanes::load(node.bounds[nearZ]), originZ), inverseZ);
+					const Float exitX = Lanes::mul(Lanes::sub(Lanes::load(node.bounds[nearX ^ 1]), originX), inverseX);
+					const Float exitY = Lanes::mul(Lanes::sub(Lanes::load(node.bounds[nearY ^ 1]), originY), inverseY);
+					const Float exitZ = Lanes::mul(Lanes::sub(Lanes::load(node.bounds[nearZ ^ 1]), originZ), inverseZ);
+
+					const Float entry = Lanes::max(Lanes::max(entryX, entryY), Lanes::max(entryZ, minimumDistance));
+					const Float exit = Lanes::min(Lanes::min(exitX, exitY), Lanes::min(exitZ, Lanes::broadcast(maximumDistance)));
+					const int mask = Lanes::bits(Lanes::lessEqual(entry, exit));
+
+					if (mask != 0)
+					{
+						float distances[width];
+						Lanes::store(distances, entry);
+
+						StackEntry intersected[width];
+						int intersectedCount = 0;
+
+						for (int slot = 0; slot < width; slot++)
+						{
+							if ((mask >> slot) & 1)
+								insertSorted(intersected, intersectedCount, { node.children[slot], node.triangleCounts[slot], distances[slot] });
+						}
+
+						for (int i = 0; i < intersectedCount - 1; i++)
+							stack[stackCount++] = intersected[i];
+
+						current = intersected[intersectedCount - 1];
+						continue;
+					}
+				}
+
+				// continue with the closest postponed child that is not behind the closest hit
+				do
+				{
+					if (stackCount == 0)
+						return found;
+
+					stackCount--;
+				} while (stack[stackCount].distance > maximumDistance);
+
+				current = stack[stackCount];
+			}
+		}
+
+		// A packet of one ray per lane against one child at a time. Children are visited if any of the rays
+		// intersects them, closest first by the distance of the closest of those rays. Lanes beyond count
+		// repeat the first ray with an empty distance range.
+		template <typename Lanes>
+		void traversePacket(const WideBvhNode<Lanes::width>* nodes, const float* triangleData, const TraversalRay* rays, std::size_t count, TraversalHit* hits)
+		{
+			typedef typename Lanes::Float Float;
+			typedef typename Lanes::Mask Mask;
+			const int width = Lanes::width;
+
+			// origin, direction and inverse direction per axis, then the distance range
+			float values[11][width];
+
+			for (int lane = 0; lane < width; lane++)
+			{
+				const TraversalRay& ray = rays[std::size_t(lane) < count ? lane : 0];
+
+				for (int axis = 0; axis < 3; axis++)
+				{
+					values[axis][lane] = ray.origin[axis];
+					values[3 + axis][lane] = ray.direction[axis];
+					values[6 + axis][lane] = ray.inverseDirection[axis];
+				}
+
+				values[9][lane] = ray.minimumDistance;
+				values[10][lane] = std::size_t(lane) < count ? ray.maximumDistance : -infinity;
+			}
+
+			const Float originX = Lanes::loadUnaligned(values[0]);
+			const Float originY = Lanes::loadUnaligned(values[1]);
+			const Float originZ = Lanes::loadUnaligned(values[2]);
+			const Float directionX = Lanes::loadUnaligned(values[3]);
+			const Float directionY = Lanes::loadUnaligned(values[4]);
+			const Float directionZ = Lanes::loadUnaligned(values[5]);
+			const Float inverseX = Lanes::loadUnaligned(values[6]);
+			const Float inverseY = Lanes::loadUnaligned(values[7]);
+			const Float inverseZ = Lanes::loadUnaligned(values[8]);
+			const Float minimumDistance = Lanes::loadUnaligned(values[9]);
+			Float maximumDistance = Lanes::loadUnaligned(values[10]);
+
+			const Float zero = Lanes::broadcast(0.0f);
+			const Float one = Lanes::broadcast(1.0f);
+			Float hitU = zero;
+			Float hitV = zero;
+			glm::uint hitTriangles[width];
+
+			for (int lane = 0; lane < width; lane++)
+				hitTriangles[lane] = RayHit::noTriangle;
+
+			StackEntry stack[stackSize];
+			std::size_t stackCount = 0;
+			StackEntry current = { 0, 0, -infinity };
+
+			for (;;)
+			{
+				if (current.triangleCount > 0)
+				{
+					for (glm::uint i = current.child; i < current.child + current.triangleCount; i++)
+					{
+						const float* triangle = triangleData + 9 * std::size_t(i);
+						const Float edge1X = Lanes::broadcast(triangle[3]);
+						const Float edge1Y = Lanes::broadcast(triangle[4]);
+						const Float edge1Z = Lanes::broadcast(triangle[5]);
+						const Float edge2X = Lanes::broadcast(triangle[6]);
+						const Float edge2Y = Lanes::broadcast(triangle[7]);
+						const Float edge2Z = Lanes::broadcast(triangle[8]);
+
+						const Float pX = Lanes::sub(Lanes::mul(directionY, edge2Z), Lanes::mul(edge2Y, directionZ));
+						const Float pY = Lanes::sub(Lanes::mul(directionZ, edge2X), Lanes::mul(edge2Z, directionX));
+						const Float pZ = Lanes::sub(Lanes::mul(directionX, edge2Y), Lanes::mul(edge2X, directionY));
+						const Float determinant = Lanes::add(Lanes::add(Lanes::mul(edge1X, pX), Lanes::mul(edge1Y, pY)), Lanes::mul(edge1Z, pZ));
+						const Float inverseDeterminant = Lanes::div(one, determinant);
+
+						const Float sX = Lanes::sub(originX, Lanes::broadcast(triangle[0]));
+						const Float sY = Lanes::sub(originY, Lanes::broadcast(triangle[1]));
+						const Float sZ = Lanes::sub(originZ, Lanes::broadcast(triangle[2]));
+						const Float u = Lanes::mul(Lanes::add(Lanes::add(Lanes::mul(sX, pX), Lanes::mul(sY, pY)), Lanes::mul(sZ, pZ)), inverseDeterminant);
+
+						const Float qX = Lanes::sub(Lanes::mul(sY, edge1Z), Lanes::mul(edge1Y, sZ));
+						const Float qY = Lanes::sub(Lanes::mul(sZ, edge1X), Lanes::mul(edge1Z, sX));
+						const Float qZ = Lanes::sub(Lanes::mul(sX, edge1Y), Lanes::mul(edge1X, sY));
+						const Float v = Lanes::mul(Lanes::add(Lanes::add(Lanes::mul(directionX, qX), Lanes::mul(directionY, qY)), Lanes::mul(directionZ, qZ)), inverseDeterminant);
+						const Float t = Lanes::mul(Lanes::add(Lanes::add(Lanes::mul(edge2X, qX), Lanes::mul(edge2Y, qY)), Lanes::mul(edge2Z, qZ)), inverseDeterminant);
+
+						Mask mask = Lanes::notEqual(determinant, zero);
+						mask = Lanes::maskAnd(mask, Lanes::maskAnd(Lanes::greaterEqual(u, zero), Lanes::lessEqual(u, one)));
+						mask = Lanes::maskAnd(mask, Lanes::maskAnd(Lanes::greaterEqual(v, zero), Lanes::lessEqual(Lanes::add(u, v), one)));
+						mask = Lanes::maskAnd(mask, Lanes::maskAnd(Lanes::greaterEqual(t, minimumDistance), Lanes::lessEqual(t, maximumDistance)));
+
+						const int bits = Lanes::bits(mask);
+
+						if (bits != 0)
+						{
+							maximumDistance = Lanes::select(mask, t, maximumDistance);
+							hitU = Lanes::select(mask, u, hitU);
+							hitV = Lanes::select(mask, v, hitV);
+
+							for (int lane = 0; lane < width; lane++)
+							{
+								if ((bits >> lane) & 1)
+									hitTriangles[lane] = i;
+							}
+						}
+					}
+				}
+				else
+				{
+					const WideBvhNode<width>& node = nodes[current.child];
+					StackEntry intersected[width];
+					int intersectedCount = 0;
+
+					for (int slot = 0; slot < width && node.children[slot] != WideBvhNode<width>::emptySlot; slot++)
+					{
+						const Float x0 = Lanes::mul(Lanes::sub(Lanes::broadcast(node.bounds[0][slot]), originX), inverseX);
+						const Float x1 = Lanes::mul(Lanes::sub(Lanes::broadcast(node.bounds[1][slot]), originX), inverseX);
+						const Float y0 = Lanes::mul(Lanes::sub(Lanes::broadcast(node.bounds[2][slot]), originY), inverseY);
+						const Float y1 = Lanes::mul(Lanes::sub(Lanes::broadcast(node.bounds[3][slot]), originY), inverseY);
+						const Float z0 = Lanes::mul(Lanes::sub(Lanes::broadcast(node.bounds[4][slot]), originZ), inverseZ);
+						const Float z1 = Lanes::mul(Lanes::sub(Lanes::broadcast(node.bounds[5][slot]), originZ), inverseZ);
+
+						const Float entry = Lanes::max(Lanes::max(Lanes::min(x0, x1), Lanes::min(y0, y1)), Lanes::max(Lanes::min(z0, z1), minimumDistance));
+						const Float exit = Lanes::min(Lanes::min(Lanes::max(x0, x1), Lanes::max(y0, y1)), Lanes::min(Lanes::max(z0, z1), maximumDistance));
+						const int bits = Lanes::bits(Lanes::lessEqual(entry, exit));
+
+						if (bits == 0)
+							continue;
+
+						float distances[width];
+						Lanes::store(distances, entry);
+						float closest = infinity;
+
+						for (int lane = 0; lane < width; lane++)
+						{
+							if (((bits >> lane) & 1) && distances[lane] < closest)
+								closest = distances[lane];
+						}
+
+						insertSorted(intersected, intersectedCount, { node.children[slot], node.triangleCounts[slot], closest });
+					}
+
+					if (intersectedCount > 0)
+					{
+						for (int i = 0; i < intersectedCount - 1; i++)
+							stack[stackCount++] = intersected[i];
+
+						current = intersected[intersectedCount - 1];
+						continue;
+					}
+				}
+
+				// children entered behind the closest hits of all rays are skipped
+				float distances[width];
+				Lanes::store(distances, maximumDistance);
+				float farthest = -infinity;
+
+				for (int lane = 0; lane < width; lane++)
+					farthest = distances[lane] > farthest ? distances[lane] : farthest;
+
+				while (stackCount > 0 && stack[stackCount - 1].distance > farthest)
+					stackCount--;
+
+				if (stackCount == 0)
+					break;
+
+				current = stack[--stackCount];
+			}
+
+			float distances[width], us[width], vs[width];
+			Lanes::store(distances, maximumDistance);
+			Lanes::store(us, hitU);
+			Lanes::store(vs, hitV);
+
+			for (std::size_t lane = 0; lane < count; lane++)
+				hits[lane] = { hitTriangles[lane], distances[lane], us[lane], vs[lane] };
+		}
+	}
+}
@@ -16,16 +16,28 @@
 #include <glm/glm.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/transform.hpp>
+#include <glm/gtc/constants.hpp>
 
 #include <globjects/globjects.h>
 #include <globjects/logging.h>
+#include <globjects/Framebuffer.h>
+#include <globjects/Renderbuffer.h>
 #include <tinyfiledialogs.h>
 
 #include "Scene.h"
 #include "Model.h"
 #include "Viewer.h"
 #include "Interactor.h"
+#include "CameraInteractor.h"
 #include "Renderer.h"
+#include "TextureCache.h"
+#include "ModelCache.h"
+#include "ObjLoader.h"
+#include "RayTracer.h"
+
+#include <chrono>
+#include <iomanip>
+#include <sstream>
 
 using namespace gl;
 using namespace glm;
@@ -37,8 +49,280 @@ void error_callback(int errnum, const char * errmsg)
 	globjects::critical() << errnum << ": " << errmsg << std::endl;
 }
 
+// Renders a model with the CPU ray tracer from the initial view of the viewer and writes the image, without
+// creating a window or GL context, e.g. for reference images on machines without a GPU.
+int raytraceImage(int argc, char *argv[])
+{
+	if (argc < 4)
+	{
+		std::cerr << "usage: minity --raytrace <model.obj> <image.png> [width height]" << std::endl;
+		return 1;
+	}
+
+	const std::string modelFilename = argv[2];
+	const std::string imageFilename = argv[3];
+	const ivec2 size = argc >= 6 ? ivec2(std::atoi(argv[4]), std::atoi(argv[5])) : ivec2(1280, 720);
+
+	if (size.x <= 0 || size.y <= 0)
+	{
+		std::cerr << "invalid image size" << std::endl;
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	ModelData data;
+
+	if (!ModelCache::read(modelFilename, data))
+	{
+		ObjLoader loader;
+
+		if (!loader.loadObjFile(modelFilename))
+		{
+			std::cerr << "could not load " << modelFilename << std::endl;
+			return 1;
+		}
+
+		// the defaults of Model, as data is still empty
+		loader.generateNormals(data.normalWeighting, data.creaseAngle);
+		data.materials = loader.materials();
+		data.minimumBounds = loader.minimumBounds();
+		data.maximumBounds = loader.maximumBounds();
+
+		for (std::size_t i = 0; i < loader.groupCount(); i++)
+		{
+			Group group;
+
+			if (loader.assembleGroup(i, data.vertices, data.indices, data.meshlets, group))
+				data.groups.push_back(group);
+		}
+	}
+
+	const double loadTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	start = std::chrono::steady_clock::now();
+
+	RayTracer rayTracer;
+	rayTracer.setScene(data.vertices, data.indices, data.groups, data.materials);
+
+	const double sceneTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	const mat4 modelTransform = CameraInteractor::initialModelTransform(data.minimumBounds, data.maximumBounds);
+	const mat4 viewTransform = CameraInteractor::initialViewTransform();
+	const mat4 lightTransform = CameraInteractor::initialLightTransform();
+	const mat4 projectionTransform = CameraInteractor::initialProjectionTransform(float(size.x) / float(size.y));
+
+	RayTracingView view;
+	view.modelViewProjection = projectionTransform * viewTransform * modelTransform;
+	view.lightPosition = vec3(inverse(lightTransform * modelTransform) * vec4(0.0f, 0.0f, 0.0f, 1.0f));
+
+	RayTracedImage image;
+	start = std::chrono::steady_clock::now();
+	rayTracer.render(view, size, image);
+
+	const double renderTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "Loaded in " << loadTime << " s, hierarchy over " << rayTracer.bvh().triangleCount() << " triangles built in " << sceneTime << " s" << std::endl;
+	std::cout << "Traced " << size.x << "x" << size.y << " pixels in " << renderTime << " s, " << double(size.x) * double(size.y) / renderTime * 1e-6 << " Mrays/s" << std::endl;
+
+	if (!RayTracer::writeImage(imageFilename, image))
+	{
+		std::cerr << "could not write " << imageFilename << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+// Renders a model offscreen for a number of frames and writes the images, e.g. for batch jobs on machines without
+// a display. The context is created by GLFW's null platform through EGL (surfaceless on Mesa) or OSMesa, and the
+// viewer draws into a framebuffer object of the requested size.
+int renderHeadless(int argc, char *argv[])
+{
+	if (argc < 4)
+	{
+		std::cerr << "usage: minity --headless <model.obj> <image.png> [width height [frames]]" << std::endl;
+		return 1;
+	}
+
+	const std::string modelFilename = argv[2];
+	const std::string imageFilename = argv[3];
+	const ivec2 size = argc >= 6 ? ivec2(std::atoi(argv[4]), std::atoi(argv[5])) : ivec2(1280, 720);
+	const int frameCount = argc >= 7 ? std::atoi(argv[6]) : 1;
+
+	if (size.x <= 0 || size.y <= 0 || frameCount <= 0)
+	{
+		std::cerr << "invalid image size or frame count" << std::endl;
+		return 1;
+	}
+
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 4)
+	glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#else
+	std::cerr << "headless rendering requires GLFW 3.4 or newer" << std::endl;
+	return 1;
+#endif
+
+	if (!glfwInit())
+		return 1;
+
+	glfwSetErrorCallback(error_callback);
+
+	GLFWwindow* window = nullptr;
+
+	// EGL is preferred, as it may use a GPU, OSMesa always renders in software
+	for (int api : { GLFW_EGL_CONTEXT_API, GLFW_OSMESA_CONTEXT_API })
+	{
+		glfwDefaultWindowHints();
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, api);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+		window = glfwCreateWindow(size.x, size.y, "minity", NULL, NULL);
+
+		if (window)
+			break;
+	}
+
+	if (window == nullptr)
+	{
+		globjects::critical() << "Offscreen context creation failed - terminating execution.";
+
+		glfwTerminate();
+		return 1;
+	}
+
+	glfwMakeContextCurrent(window);
+
+	globjects::init([](const char * name) {
+		return glfwGetProcAddress(name);
+	});
+
+	globjects::debug()
+		<< "OpenGL Version:  " << glbinding::aux::ContextInfo::version() << std::endl
+		<< "OpenGL Vendor:   " << glbinding::aux::ContextInfo::vendor() << std::endl
+		<< "OpenGL Renderer: " << glbinding::aux::ContextInfo::renderer() << std::endl;
+
+	int result = 0;
+
+	{
+		// a surfaceless context has no default framebuffer, so everything is drawn into this one
+		auto colorBuffer = Renderbuffer::create();
+		colorBuffer->storage(GL_RGBA8, size.x, size.y);
+		auto depthBuffer = Renderbuffer::create();
+		depthBuffer->storage(GL_DEPTH_COMPONENT24, size.x, size.y);
+
+		auto framebuffer = Framebuffer::create();
+		framebuffer->attachRenderBuffer(GL_COLOR_ATTACHMENT0, colorBuffer.get());
+		framebuffer->attachRenderBuffer(GL_DEPTH_ATTACHMENT, depthBuffer.get());
+		framebuffer->setDrawBuffer(GL_COLOR_ATTACHMENT0);
+		framebuffer->setReadBuffer(GL_COLOR_ATTACHMENT0);
+
+		if (framebuffer->checkStatus() != GL_FRAMEBUFFER_COMPLETE)
+		{
+			globjects::critical() << "Offscreen framebuffer is incomplete - terminating execution.";
+			result = 1;
+		}
+		else
+		{
+			framebuffer->bind(GL_FRAMEBUFFER);
+
+			auto scene = std::make_unique<Scene>();
+			scene->model()->loadAsync(modelFilename);
+			auto viewer = std::make_unique<Viewer>(window, scene.get());
+			viewer->setUiVisible(false);
+
+			// the frames are only rendered once the model is complete
+			while (scene->model()->isLoading())
+				viewer->display();
+
+			viewer->display();
+
+			if (scene->model()->groups().empty())
+			{
+				std::cerr << "could not load " << modelFilename << std::endl;
+				result = 1;
+			}
+
+			// the view orbits once around the model over all frames, which are numbered like screenshots
+			std::string basename = imageFilename;
+			const std::size_t extension = basename.rfind('.');
+
+			if (extension != std::string::npos)
+				basename = basename.substr(0, extension);
+
+			double renderTime = 0.0;
+
+			for (int i = 0; i < frameCount && result == 0; i++)
+			{
+				if (i > 0)
+				{
+					const mat4 viewTransform = viewer->viewTransform();
+					const vec4 transformedAxis = inverse(viewTransform) * vec4(0.0f, 1.0f, 0.0f, 0.0f);
+					viewer->setViewTransform(rotate(viewTransform, 2.0f * pi<float>() / float(frameCount), vec3(transformedAxis)));
+				}
+
+				const auto start = std::chrono::steady_clock::now();
+				viewer->display();
+				glFinish();
+				renderTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+				std::string filename = imageFilename;
+
+				if (frameCount > 1)
+				{
+					std::stringstream ss;
+					ss << basename << "-" << std::setw(4) << std::setfill('0') << i << ".png";
+					filename = ss.str();
+				}
+
+				viewer->saveImage(filename);
+			}
+
+			if (result == 0)
+				std::cout << "Rendered " << frameCount << " frames of " << size.x << "x" << size.y << " pixels in " << renderTime << " s, " << double(frameCount) / renderTime << " frames/s" << std::endl;
+		}
+	}
+
+	// cached textures have to be released while the context still exists
+	TextureCache::instance().clear();
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+
+	return result;
+}
+
 int main(int argc, char *argv[])
 {
+	if (argc > 1 && std::string(argv[1]) == "--raytrace")
+		return raytraceImage(argc, argv);
+
+	if (argc > 1 && std::string(argv[1]) == "--headless")
+		return renderHeadless(argc, argv);
+
+	// measures the frames of a model once it is loaded, then writes the results and exits
+	const bool benchmark = argc > 1 && std::string(argv[1]) == "--benchmark";
+	std::string benchmarkFilename;
+	FrameBenchmark::Settings benchmarkSettings;
+
+	if (benchmark)
+	{
+		if (argc < 4)
+		{
+			std::cerr << "usage: minity --benchmark <model.obj> <results.json|results.csv> [frames [warmup frames]]" << std::endl;
+			return 1;
+		}
+
+		benchmarkFilename = argv[3];
+
+		if (argc >= 5)
+			benchmarkSettings.frameCount = uint(std::max(1, std::atoi(argv[4])));
+
+		if (argc >= 6)
+			benchmarkSettings.warmupFrames = uint(std::max(0, std::atoi(argv[5])));
+	}
+
 	// Initialize GLFW
 	if (!glfwInit())
 		return 1;
@@ -92,7 +376,9 @@ int main(int argc, char *argv[])
 
 	std::string fileName = "./dat/bunny.obj";
 
-	if (argc > 1)
+	if (benchmark)
+		fileName = std::string(argv[2]);
+	else if (argc > 1)
 		fileName = std::string(argv[1]);
 	else
 	{
@@ -103,37 +389,60 @@ int main(int argc, char *argv[])
 			fileName = std::string(openfileName);
 	}
 
+	int result = 0;
+
 	{
 		auto scene = std::make_unique<Scene>();
-		scene->model()->load(fileName);
+		// the viewer fits the model transform as soon as the bounds of the model are known
+		scene->model()->loadAsync(fileName);
 		auto viewer = std::make_unique<Viewer>(window, scene.get());
 
-		// Scaling the model's bounding box to the canonical view volume
-		vec3 boundingBoxSize = scene->model()->maximumBounds() - scene->model()->minimumBounds();
-		float maximumSize = std::max( std::max(boundingBoxSize.x, boundingBoxSize.y), boundingBoxSize.z );
-		mat4 modelTransform =  scale(vec3(2.0f) / vec3(maximumSize)); 
-		modelTransform = modelTransform * translate(-0.5f*(scene->model()->minimumBounds() + scene->model()->maximumBounds()));
-		viewer->setModelTransform(modelTransform);
-
-
 		glfwSwapInterval(0);
 
+		bool benchmarkStarted = false;
+
 		// Main loop
 		while (!glfwWindowShouldClose(window))
 		{
 			glfwPollEvents();
+
+			if (benchmark && !benchmarkStarted && !scene->model()->isLoading())
+			{
+				viewer->benchmark().start(benchmarkSettings);
+				benchmarkStarted = true;
+			}
+
 			viewer->display();
 			//glFinish();
 			glfwSwapBuffers(window);
+
+			if (benchmarkStarted && viewer->benchmark().finished())
+			{
+				viewer->benchmark().printSummary(std::cout);
+
+				const bool csv = benchmarkFilename.size() >= 4 && benchmarkFilename.compare(benchmarkFilename.size() - 4, 4, ".csv") == 0;
+				const bool written = csv ? viewer->benchmark().writeCsv(benchmarkFilename) : viewer->benchmark().writeJson(benchmarkFilename);
+
+				if (!written)
+				{
+					std::cerr << "could not write " << benchmarkFilename << std::endl;
+					result = 1;
+				}
+
+				break;
+			}
 		}
 
 	}
 
+	// cached textures have to be released while the context still exists
+	TextureCache::instance().clear();
+
 	// Destroy window
 	glfwDestroyWindow(window);
 
 	// Properly shutdown GLFW
 	glfwTerminate();
 
-	return 0;
+	return result;
 }